@@ -67,6 +67,9 @@ class Buffer {
 
   /// Writes data to buffer memory.
   ///
+  /// Writes to buffers using private mode are staged, and deferred
+  /// until the next queue submission.
+  ///
   virtual void write(uint64_t offset, const void* data, uint64_t size) = 0;
 
   /// Gets the size of the buffer.
@@ -18,10 +18,12 @@
 #include "yf/cg/Image.h"
 #include "yf/cg/Limits.h"
 #include "yf/cg/Pass.h"
+#include "yf/cg/Query.h"
 #include "yf/cg/Queue.h"
 #include "yf/cg/Sampler.h"
 #include "yf/cg/Shader.h"
 #include "yf/cg/State.h"
+#include "yf/cg/TransientBuffer.h"
 #include "yf/cg/Types.h"
 #include "yf/cg/Wsi.h"
 
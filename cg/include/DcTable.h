@@ -23,11 +23,23 @@ using DcId = uint32_t;
 
 /// Descriptor types.
 ///
+/// The offset of a `DcTypeUniformDynamic` descriptor is given when its
+/// allocation is set in an encoder, added to the offset it was written
+/// with.
+///
+/// The elements of a `DcTypeImgSamplerArray` descriptor need not all be
+/// written, and can be written while the allocation is in use by the
+/// device. Its element count is limited by `maxDcImgSamplerArray`, which
+/// is zero when such descriptors are not supported. It cannot share a
+/// table with `DcTypeUniformDynamic` descriptors.
+///
 enum DcType {
   DcTypeUniform,
+  DcTypeUniformDynamic,
   DcTypeStorage,
   DcTypeImage,
-  DcTypeImgSampler
+  DcTypeImgSampler,
+  DcTypeImgSamplerArray
 };
 
 /// Descriptor table entry.
@@ -51,6 +63,10 @@ class DcTable {
 
   /// Allocates a given number of resources.
   ///
+  /// Existing allocations, and the resources written to them, are kept
+  /// when the number grows. Shrinking keeps the memory for later reuse,
+  /// while `allocate(0)` releases it.
+  ///
   virtual void allocate(uint32_t n) = 0;
 
   /// Retrives the number of allocations.
@@ -73,6 +89,18 @@ class DcTable {
                      Image& image, uint32_t layer, uint32_t level,
                      Sampler& sampler) = 0;
 
+  /// Begins a batch of writes.
+  ///
+  /// Writes issued until `commit()` is called are recorded and applied
+  /// together. A table allocation must not be used by the device while
+  /// it has writes pending.
+  ///
+  virtual void begin() = 0;
+
+  /// Applies the writes recorded since `begin()`.
+  ///
+  virtual void commit() = 0;
+
   /// Gets the list of table entries.
   ///
   virtual const std::vector<DcEntry>& entries() const = 0;
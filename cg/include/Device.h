@@ -14,6 +14,7 @@
 #include "yf/cg/Defs.h"
 #include "yf/cg/Queue.h"
 #include "yf/cg/Buffer.h"
+#include "yf/cg/TransientBuffer.h"
 #include "yf/cg/Image.h"
 #include "yf/cg/Sampler.h"
 #include "yf/cg/Shader.h"
@@ -22,6 +23,7 @@
 #include "yf/cg/State.h"
 #include "yf/cg/Wsi.h"
 #include "yf/cg/Limits.h"
+#include "yf/cg/Query.h"
 
 CG_NS_BEGIN
 
@@ -36,6 +38,10 @@ class Device {
 
   /// Gets execution queues.
   ///
+  /// `queue()` gets the queue best suited to the given capabilities,
+  /// which may not be the default queue (e.g., a queue dedicated to
+  /// transfers). Resources can be used in any queue.
+  ///
   virtual Queue& defaultQueue() = 0;
   virtual Queue& queue(Queue::CapabilityMask capabilities) = 0;
 
@@ -43,6 +49,11 @@ class Device {
   ///
   virtual Buffer::Ptr buffer(const Buffer::Desc& desc) = 0;
 
+  /// Creates a new transient buffer object.
+  ///
+  virtual TransientBuffer::Ptr
+    transientBuffer(const TransientBuffer::Desc& desc) = 0;
+
   /// Creates a new image object.
   ///
   virtual Image::Ptr image(const Image::Desc& desc) = 0;
@@ -51,6 +62,10 @@ class Device {
   ///
   virtual Sampler::Ptr sampler(const Sampler::Desc& desc) = 0;
 
+  /// Creates a new query pool object.
+  ///
+  virtual QueryPool::Ptr queryPool(const QueryPool::Desc& desc) = 0;
+
   /// Creates a new shader object.
   ///
   virtual Shader::Ptr shader(const Shader::Desc& desc) = 0;
@@ -16,6 +16,7 @@
 
 #include "yf/cg/Defs.h"
 #include "yf/cg/Types.h"
+#include "yf/cg/Shader.h"
 
 CG_NS_BEGIN
 
@@ -102,6 +103,8 @@ class Target;
 class DcTable;
 class Buffer;
 class Image;
+class CmdBuffer;
+class QueryPool;
 
 struct Cmd;
 using Encoding = std::vector<std::unique_ptr<Cmd>>;
@@ -149,7 +152,20 @@ class GrEncoder final : public Encoder {
 
   /// Sets a descriptor table allocation.
   ///
+  /// `dynamicOffsets` must contain one offset for every element of the
+  /// table's dynamic descriptors, in increasing id order.
+  ///
   void setDcTable(uint32_t tableIndex, uint32_t allocIndex);
+  void setDcTable(uint32_t tableIndex, uint32_t allocIndex,
+                  const std::vector<uint32_t>& dynamicOffsets);
+
+  /// Sets push constants.
+  ///
+  /// The `size` bytes of `data` are copied when encoded. The range must
+  /// be contained in one of the state's `constRanges` for `stageMask`.
+  ///
+  void setConstants(StageMask stageMask, uint32_t offset, uint32_t size,
+                    const void* data);
 
   /// Sets the vertex buffer.
   ///
@@ -173,6 +189,34 @@ class GrEncoder final : public Encoder {
   /// Synchronizes commands.
   ///
   void synchronize();
+
+  /// Executes a secondary command buffer.
+  ///
+  /// `subBuffer` must have been created with `Queue::subBuffer()` and
+  /// encoded for the current target. Once a secondary command buffer is
+  /// executed in a target, no other commands can be encoded for that
+  /// target besides further `execute()`s, and state set before must be
+  /// set again to draw in later targets. `subBuffer` must not be encoded
+  /// again until the command buffer executing it completes, and the
+  /// thread that created it must not be encoding other command buffers
+  /// while this encoder is encoded.
+  ///
+  void execute(CmdBuffer& subBuffer);
+
+  /// Writes a timestamp once previous commands complete.
+  ///
+  /// Timestamps cannot follow `execute()` in a target.
+  ///
+  void writeTimestamp(QueryPool& pool, uint32_t index);
+
+  /// Begins/ends an occlusion or statistics query.
+  ///
+  /// Queries must end in the same encoder, and queries begun in a
+  /// target must end in that target. No query can be active when
+  /// `execute()` is encoded.
+  ///
+  void beginQuery(QueryPool& pool, uint32_t index);
+  void endQuery(QueryPool& pool, uint32_t index);
 };
 
 /// Compute encoder.
@@ -188,7 +232,20 @@ class CpEncoder final : public Encoder {
 
   /// Sets a descriptor table allocation.
   ///
+  /// `dynamicOffsets` must contain one offset for every element of the
+  /// table's dynamic descriptors, in increasing id order.
+  ///
   void setDcTable(uint32_t tableIndex, uint32_t allocIndex);
+  void setDcTable(uint32_t tableIndex, uint32_t allocIndex,
+                  const std::vector<uint32_t>& dynamicOffsets);
+
+  /// Sets push constants.
+  ///
+  /// The `size` bytes of `data` are copied when encoded. The range must
+  /// be contained in one of the state's `constRanges` for `stageMask`.
+  ///
+  void setConstants(StageMask stageMask, uint32_t offset, uint32_t size,
+                    const void* data);
 
   /// Dispatches a workgroup.
   ///
@@ -197,6 +254,17 @@ class CpEncoder final : public Encoder {
   /// Synchronizes commands.
   ///
   void synchronize();
+
+  /// Writes a timestamp once previous commands complete.
+  ///
+  void writeTimestamp(QueryPool& pool, uint32_t index);
+
+  /// Begins/ends a statistics query.
+  ///
+  /// Queries must end in the same encoder.
+  ///
+  void beginQuery(QueryPool& pool, uint32_t index);
+  void endQuery(QueryPool& pool, uint32_t index);
 };
 
 /// Transfer encoder.
@@ -216,6 +284,26 @@ class TfEncoder final : public Encoder {
   void copy(Image& dst, Offset2 dstOffset, uint32_t dstLayer, uint32_t dstLevel,
             Image& src, Offset2 srcOffset, uint32_t srcLayer, uint32_t srcLevel,
             Size2 size, uint32_t layerCount);
+
+  /// Writes a timestamp once previous commands complete.
+  ///
+  void writeTimestamp(QueryPool& pool, uint32_t index);
+
+  /// Resets queries so they can be written again.
+  ///
+  /// Resets and copies of queries require a graphics or compute queue.
+  ///
+  void resetQueries(QueryPool& pool, uint32_t first, uint32_t count);
+
+  /// Copies query results to a buffer.
+  ///
+  /// The results are copied as 64-bit values once the queries complete,
+  /// without blocking the host, so every query in the range must be
+  /// written. `dst` must have been created with the `Buffer::Query`
+  /// usage, and `dstOffset` must be a multiple of 8.
+  ///
+  void copyQueries(Buffer& dst, uint64_t dstOffset, QueryPool& pool,
+                   uint32_t first, uint32_t count);
 };
 
 CG_NS_END
@@ -71,7 +71,19 @@ enum class Format {
   D32Float,
   S8,
   D24UnormS8,
-  D32FloatS8
+  D32FloatS8,
+
+  // Block-compressed (4x4)
+  Bc1Unorm,
+  Bc1Srgb,
+  Bc3Unorm,
+  Bc3Srgb,
+  Bc4Unorm,
+  Bc4Norm,
+  Bc5Unorm,
+  Bc5Norm,
+  Bc7Unorm,
+  Bc7Srgb
 };
 
 /// Mask of `Samples` bits.
@@ -96,7 +108,7 @@ class Image;
 ///
 class ImgView {
  public:
-  using Ptr = std::unique_ptr<ImgView>;
+  using Ptr = std::shared_ptr<ImgView>;
 
   /// View dimensionality.
   ///
@@ -198,8 +210,26 @@ class Image {
     Transient  = 0x40
   };
 
+  /// Arrangements of texels in memory.
+  ///
+  enum class Tiling {
+    Optimal,
+    Linear
+  };
+  // TODO: Update this when migrating to C++20
+#if __cplusplus >= 202002L
+# error Use `using` instead
+#else
+  static constexpr Tiling Optimal = Tiling::Optimal;
+  static constexpr Tiling Linear = Tiling::Linear;
+#endif
+
   /// Image descriptor.
   ///
+  /// Linear tiling is used only when requested and supported for the
+  /// given format and usage. Otherwise, the implementation-defined
+  /// optimal tiling is used.
+  ///
   struct Desc {
     Format format;
     Size3 size;
@@ -207,6 +237,7 @@ class Image {
     Samples samples;
     Dimension dimension;
     UsageMask usageMask;
+    Tiling tiling = Tiling::Optimal;
   };
 
   Image(const Desc& desc);
@@ -214,12 +245,22 @@ class Image {
   Image& operator=(const Image&) = delete;
   virtual ~Image() = default;
 
-  /// Creates a new image view object.
+  /// Gets an image view object.
+  ///
+  /// Views are shared: requesting a view with a descriptor equal to that
+  /// of a view that is still in use yields the same object. Views must
+  /// not be used after their image is destroyed.
   ///
   virtual ImgView::Ptr view(const ImgView::Desc& desc) = 0;
 
   /// Writes data to image memory.
   ///
+  /// Writes to images using optimal tiling may be deferred until the
+  /// next queue submission.
+  ///
+  /// For block-compressed formats, `origin` must be aligned to the block
+  /// size, and `bytesPerRow`/`rowsPerSlice` refer to rows of blocks.
+  ///
   virtual void write(uint32_t plane, Origin3 origin, uint32_t level,
                      const void* data, Size3 size, uint32_t bytesPerRow = 0,
                      uint32_t rowsPerSlice = 0) = 0;
@@ -250,9 +291,18 @@ class Image {
 
   /// Gets the number of bytes in a single texel of the `Format`.
   ///
+  /// For block-compressed formats, this is the size of a whole block.
+  ///
   static uint32_t texelSize(Format format);
   uint32_t texelSize() const;
 
+  /// Gets the dimensions of a texel block of the `Format`.
+  ///
+  /// Uncompressed formats have 1x1 blocks.
+  ///
+  static Size2 blockSize(Format format);
+  Size2 blockSize() const;
+
  private:
   const Format format_;
   const Size3 size_;
@@ -45,9 +45,16 @@ struct Limits {
   uint64_t maxDcUniformWriteSize;
   uint64_t minDcStorageWriteAlignedOffset;
   uint64_t maxDcStorageWriteSize;
+  uint32_t maxDcImgSamplerArray;
+
+  uint32_t maxConstSize;
 
   uint32_t maxVxInputs;
   uint32_t maxVxAttrs;
+
+  /// Nanoseconds per timestamp tick.
+  ///
+  float timestampPeriod;
 };
 
 CG_NS_END
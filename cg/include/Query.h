@@ -0,0 +1,114 @@
+//
+// CG
+// Query.h
+//
+// Copyright © 2023 Gustavo C. Viegas.
+//
+
+#ifndef YF_CG_QUERY_H
+#define YF_CG_QUERY_H
+
+#include <cstdint>
+#include <memory>
+
+#include "yf/cg/Defs.h"
+
+CG_NS_BEGIN
+
+/// Pool of GPU queries.
+///
+/// Queries are written by encoded commands and must be reset with
+/// `TfEncoder::resetQueries()` before each use. Results are 64-bit
+/// values, which can be either read from the host or copied to a buffer
+/// with `TfEncoder::copyQueries()`.
+///
+class QueryPool {
+ public:
+  using Ptr = std::unique_ptr<QueryPool>;
+
+  /// Query types.
+  ///
+  /// Timestamps are in device ticks. Occlusion results are only
+  /// guaranteed to be nonzero when samples pass.
+  ///
+  enum class Type {
+    Timestamp,
+    Occlusion,
+    Statistics
+  };
+  // TODO: Update this when migrating to C++20
+#if __cplusplus >= 202002L
+# error Use `using` instead
+#else
+  static constexpr Type Timestamp = Type::Timestamp;
+  static constexpr Type Occlusion = Type::Occlusion;
+  static constexpr Type Statistics = Type::Statistics;
+#endif
+
+  /// Mask of `Statistic` bits.
+  ///
+  using StatisticMask = uint32_t;
+
+  /// Pipeline statistics.
+  ///
+  /// A statistics query yields one result per bit set in the pool's
+  /// `statisticMask`, in the order of the bits below.
+  ///
+  enum Statistic : uint32_t {
+    InputVertices       = 0x01,
+    InputPrimitives     = 0x02,
+    VertexInvocations   = 0x04,
+    ClippingInvocations = 0x08,
+    ClippingPrimitives  = 0x10,
+    FragmentInvocations = 0x20,
+    ComputeInvocations  = 0x40
+  };
+
+  /// Query pool descriptor.
+  ///
+  /// `statisticMask` is only used by statistics queries.
+  ///
+  struct Desc {
+    Type type;
+    uint32_t count;
+    StatisticMask statisticMask = 0;
+  };
+
+  QueryPool(const Desc& desc);
+  QueryPool(const QueryPool&) = delete;
+  QueryPool& operator=(const QueryPool&) = delete;
+  virtual ~QueryPool() = 0;
+
+  /// Gets the query type.
+  ///
+  Type type() const;
+
+  /// Gets the number of queries in the pool.
+  ///
+  uint32_t count() const;
+
+  /// Gets the pipeline statistics that queries collect.
+  ///
+  StatisticMask statisticMask() const;
+
+  /// Gets the number of 64-bit results that a single query yields.
+  ///
+  uint32_t resultCount() const;
+
+  /// Reads query results.
+  ///
+  /// `results` must have room for `count * resultCount()` values. This
+  /// does not wait for the queries to complete - if any of them is not
+  /// available yet, `false` is returned and `results` is left undefined.
+  ///
+  virtual bool read(uint32_t first, uint32_t count, uint64_t* results) = 0;
+
+ private:
+  const Type type_;
+  const uint32_t count_;
+  const StatisticMask statisticMask_;
+};
+
+CG_NS_END
+
+#endif // YF_CG_QUERY_H
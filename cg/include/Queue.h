@@ -35,6 +35,9 @@ class CmdBuffer {
 
   /// Enqueues the command buffer for execution.
   ///
+  /// Command buffers are submitted in the order they were enqueued.
+  /// Enqueuing does not block, even while another thread submits.
+  ///
   virtual void enqueue() = 0;
 
   /// Resets the command buffer encodings.
@@ -48,6 +51,23 @@ class CmdBuffer {
   /// Gets the queue that owns the command buffer.
   ///
   virtual Queue& queue() = 0;
+
+  /// Counts of encoded commands that were dropped because they would
+  /// not change the bound state.
+  ///
+  /// Vertex buffer counts include binds coalesced into a single call.
+  ///
+  struct Dropped {
+    uint64_t viewports;
+    uint64_t scissors;
+    uint64_t vxBuffers;
+    uint64_t ixBuffers;
+    uint64_t dcTables;
+  };
+
+  /// Gets the counts of dropped commands since creation.
+  ///
+  virtual Dropped dropped() const { return {}; }
 };
 
 /// Queue.
@@ -73,10 +93,31 @@ class Queue {
 
   /// Creates a new command buffer object.
   ///
+  /// Command buffers must be encoded by the thread that created them.
+  /// Creating command buffers is cheap, as destroyed ones are recycled.
+  ///
   virtual CmdBuffer::Ptr cmdBuffer() = 0;
 
+  /// Creates a new secondary command buffer object.
+  ///
+  /// Secondary command buffers are not enqueued. Instead, they are
+  /// executed within a render target by a command buffer created with
+  /// `cmdBuffer()` (see `GrEncoder::execute()`). Only graphics encoders
+  /// can be encoded into them, and the first encoding must set the
+  /// target that the commands will be executed within. Viewport,
+  /// scissor and other state are not inherited from the executing
+  /// command buffer.
+  ///
+  /// Distinct command buffers can be created and encoded concurrently,
+  /// each by its creating thread.
+  ///
+  virtual CmdBuffer::Ptr subBuffer() = 0;
+
   /// Submits enqueued command buffers for execution.
   ///
+  /// This can be called from any thread. Submissions are serialized, and
+  /// uploads issued by any thread before the call execute first.
+  ///
   virtual void submit() = 0;
 
   /// Gets the capabilities of the queue.
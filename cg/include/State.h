@@ -13,6 +13,7 @@
 #include <vector>
 
 #include "yf/cg/Defs.h"
+#include "yf/cg/Shader.h"
 
 CG_NS_BEGIN
 
@@ -188,8 +189,17 @@ enum Winding {
   WindingCounterCw
 };
 
+/// Range of push constants.
+///
+/// `offset` and `size` must be multiples of four bytes.
+///
+struct ConstRange {
+  StageMask stageMask;
+  uint32_t offset;
+  uint32_t size;
+};
+
 class Pass;
-class Shader;
 class DcTable;
 
 /// Graphics state.
@@ -209,6 +219,7 @@ class GrState {
     PolyMode polyMode;
     CullMode cullMode;
     Winding winding;
+    std::vector<ConstRange> constRanges;
   };
 
   GrState() = default;
@@ -232,6 +243,7 @@ class CpState {
   struct Config {
     Shader* shader;
     std::vector<DcTable*> dcTables;
+    std::vector<ConstRange> constRanges;
   };
 
   CpState() = default;
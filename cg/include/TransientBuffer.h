@@ -0,0 +1,82 @@
+//
+// CG
+// TransientBuffer.h
+//
+// Copyright © 2023 Gustavo C. Viegas.
+//
+
+#ifndef YF_CG_TRANSIENTBUFFER_H
+#define YF_CG_TRANSIENTBUFFER_H
+
+#include <cstdint>
+#include <memory>
+
+#include "yf/cg/Defs.h"
+#include "yf/cg/Buffer.h"
+
+CG_NS_BEGIN
+
+class CmdBuffer;
+
+/// Ring of persistently mapped memory for short-lived data.
+///
+/// Sub-allocations are written directly through a pointer, and remain
+/// valid until the command buffer that they are committed to completes
+/// execution, at which point their space is reclaimed. When the ring is
+/// exhausted, a larger one replaces it.
+///
+class TransientBuffer {
+ public:
+  using Ptr = std::unique_ptr<TransientBuffer>;
+
+  /// Transient buffer descriptor.
+  ///
+  struct Desc {
+    uint64_t size;
+    Buffer::UsageMask usageMask;
+  };
+
+  /// Sub-allocation of a transient buffer.
+  ///
+  struct Allocation {
+    Buffer* buffer;
+    uint64_t offset;
+    void* data;
+  };
+
+  TransientBuffer(const Desc& desc);
+  TransientBuffer(const TransientBuffer&) = delete;
+  TransientBuffer& operator=(const TransientBuffer&) = delete;
+  virtual ~TransientBuffer() = default;
+
+  /// Allocates transient memory.
+  ///
+  /// The offset is aligned to `alignment` and to the device's minimum
+  /// offset alignment for the usages of the buffer.
+  ///
+  virtual Allocation allocate(uint64_t size, uint64_t alignment = 1) = 0;
+
+  /// Commits allocations to a command buffer.
+  ///
+  /// Allocations made since the previous call are reclaimed once the
+  /// next execution of `cmdBuffer` completes, regardless of any other
+  /// submission. Uncommitted allocations are never reclaimed. The
+  /// command buffer must be a primary one, and must not be pending.
+  ///
+  virtual void commit(CmdBuffer& cmdBuffer) = 0;
+
+  /// Gets the current size of the ring.
+  ///
+  virtual uint64_t size() const = 0;
+
+  /// Gets the buffer's usage mask.
+  ///
+  Buffer::UsageMask usageMask() const;
+
+ private:
+  const Buffer::UsageMask usageMask_;
+};
+
+CG_NS_END
+
+#endif // YF_CG_TRANSIENTBUFFER_H
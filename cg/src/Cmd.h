@@ -24,6 +24,7 @@ struct Cmd {
     StateGrT,
     StateCpT,
     DcTableT,
+    ConstT,
     VxBufferT,
     IxBufferT,
     DrawT,
@@ -31,7 +32,13 @@ struct Cmd {
     DispatchT,
     CopyBBT,
     CopyIIT,
-    SyncT
+    SyncT,
+    ExecuteT,
+    TimestampT,
+    BeginQueryT,
+    EndQueryT,
+    ResetQueriesT,
+    CopyQueriesT
   };
 
   /// The subclass of this command.
@@ -93,9 +100,26 @@ struct StateCpCmd : Cmd {
 struct DcTableCmd : Cmd {
   uint32_t tableIndex;
   uint32_t allocIndex;
+  std::vector<uint32_t> dynamicOffsets;
 
-  DcTableCmd(uint32_t tableIndex, uint32_t allocIndex)
-    : Cmd(DcTableT), tableIndex(tableIndex), allocIndex(allocIndex) { }
+  DcTableCmd(uint32_t tableIndex, uint32_t allocIndex,
+             const std::vector<uint32_t>& dynamicOffsets = {})
+    : Cmd(DcTableT), tableIndex(tableIndex), allocIndex(allocIndex),
+      dynamicOffsets(dynamicOffsets) { }
+};
+
+/// Set push constants command.
+///
+struct ConstCmd : Cmd {
+  StageMask stageMask;
+  uint32_t offset;
+  std::vector<char> data;
+
+  ConstCmd(StageMask stageMask, uint32_t offset, uint32_t size,
+           const void* data)
+    : Cmd(ConstT), stageMask(stageMask), offset(offset),
+      data(static_cast<const char*>(data),
+           static_cast<const char*>(data) + size) { }
 };
 
 /// Set vertex buffer command.
@@ -202,6 +226,71 @@ struct SyncCmd : Cmd {
   SyncCmd() : Cmd(SyncT) { }
 };
 
+/// Execute secondary command buffer command.
+///
+struct ExecuteCmd : Cmd {
+  CmdBuffer& subBuffer;
+
+  explicit ExecuteCmd(CmdBuffer& subBuffer)
+    : Cmd(ExecuteT), subBuffer(subBuffer) { }
+};
+
+/// Write timestamp command.
+///
+struct TimestampCmd : Cmd {
+  QueryPool& pool;
+  uint32_t index;
+
+  TimestampCmd(QueryPool& pool, uint32_t index)
+    : Cmd(TimestampT), pool(pool), index(index) { }
+};
+
+/// Begin query command.
+///
+struct BeginQueryCmd : Cmd {
+  QueryPool& pool;
+  uint32_t index;
+
+  BeginQueryCmd(QueryPool& pool, uint32_t index)
+    : Cmd(BeginQueryT), pool(pool), index(index) { }
+};
+
+/// End query command.
+///
+struct EndQueryCmd : Cmd {
+  QueryPool& pool;
+  uint32_t index;
+
+  EndQueryCmd(QueryPool& pool, uint32_t index)
+    : Cmd(EndQueryT), pool(pool), index(index) { }
+};
+
+/// Reset queries command.
+///
+struct ResetQueriesCmd : Cmd {
+  QueryPool& pool;
+  uint32_t first;
+  uint32_t count;
+
+  ResetQueriesCmd(QueryPool& pool, uint32_t first, uint32_t count)
+    : Cmd(ResetQueriesT), pool(pool), first(first), count(count) { }
+};
+
+/// Copy query results command.
+///
+struct CopyQueriesCmd : Cmd {
+  Buffer& dst;
+  uint64_t dstOffset;
+  QueryPool& pool;
+  uint32_t first;
+  uint32_t count;
+
+  CopyQueriesCmd(Buffer& dst, uint64_t dstOffset, QueryPool& pool,
+                 uint32_t first, uint32_t count)
+    : Cmd(CopyQueriesT), dst(dst), dstOffset(dstOffset), pool(pool),
+      first(first), count(count) { }
+};
+
 CG_NS_END
 
 #endif // YF_CG_CMD_H
@@ -63,6 +63,19 @@ void GrEncoder::setDcTable(uint32_t tableIndex, uint32_t allocIndex) {
   impl_->encode(make_unique<DcTableCmd>(tableIndex, allocIndex));
 }
 
+void GrEncoder::setDcTable(uint32_t tableIndex, uint32_t allocIndex,
+                           const vector<uint32_t>& dynamicOffsets) {
+
+  impl_->encode(make_unique<DcTableCmd>(tableIndex, allocIndex,
+                                        dynamicOffsets));
+}
+
+void GrEncoder::setConstants(StageMask stageMask, uint32_t offset,
+                             uint32_t size, const void* data) {
+
+  impl_->encode(make_unique<ConstCmd>(stageMask, offset, size, data));
+}
+
 void GrEncoder::setVertexBuffer(Buffer& buffer, uint64_t offset,
                                 uint32_t inputIndex) {
 
@@ -94,6 +107,22 @@ void GrEncoder::synchronize() {
   impl_->encode(make_unique<SyncCmd>());
 }
 
+void GrEncoder::execute(CmdBuffer& subBuffer) {
+  impl_->encode(make_unique<ExecuteCmd>(subBuffer));
+}
+
+void GrEncoder::writeTimestamp(QueryPool& pool, uint32_t index) {
+  impl_->encode(make_unique<TimestampCmd>(pool, index));
+}
+
+void GrEncoder::beginQuery(QueryPool& pool, uint32_t index) {
+  impl_->encode(make_unique<BeginQueryCmd>(pool, index));
+}
+
+void GrEncoder::endQuery(QueryPool& pool, uint32_t index) {
+  impl_->encode(make_unique<EndQueryCmd>(pool, index));
+}
+
 //
 // CpEncoder
 //
@@ -108,6 +137,19 @@ void CpEncoder::setDcTable(uint32_t tableIndex, uint32_t allocIndex) {
   impl_->encode(make_unique<DcTableCmd>(tableIndex, allocIndex));
 }
 
+void CpEncoder::setDcTable(uint32_t tableIndex, uint32_t allocIndex,
+                           const vector<uint32_t>& dynamicOffsets) {
+
+  impl_->encode(make_unique<DcTableCmd>(tableIndex, allocIndex,
+                                        dynamicOffsets));
+}
+
+void CpEncoder::setConstants(StageMask stageMask, uint32_t offset,
+                             uint32_t size, const void* data) {
+
+  impl_->encode(make_unique<ConstCmd>(stageMask, offset, size, data));
+}
+
 void CpEncoder::dispatch(Size3 size) {
   impl_->encode(make_unique<DispatchCmd>(size));
 }
@@ -116,6 +158,18 @@ void CpEncoder::synchronize() {
   impl_->encode(make_unique<SyncCmd>());
 }
 
+void CpEncoder::writeTimestamp(QueryPool& pool, uint32_t index) {
+  impl_->encode(make_unique<TimestampCmd>(pool, index));
+}
+
+void CpEncoder::beginQuery(QueryPool& pool, uint32_t index) {
+  impl_->encode(make_unique<BeginQueryCmd>(pool, index));
+}
+
+void CpEncoder::endQuery(QueryPool& pool, uint32_t index) {
+  impl_->encode(make_unique<EndQueryCmd>(pool, index));
+}
+
 //
 // TfEncoder
 //
@@ -139,3 +193,20 @@ void TfEncoder::copy(Image& dst, Offset2 dstOffset,
                                        src, srcOffset, srcLayer, srcLevel,
                                        size, layerCount));
 }
+
+void TfEncoder::writeTimestamp(QueryPool& pool, uint32_t index) {
+  impl_->encode(make_unique<TimestampCmd>(pool, index));
+}
+
+void TfEncoder::resetQueries(QueryPool& pool, uint32_t first,
+                             uint32_t count) {
+
+  impl_->encode(make_unique<ResetQueriesCmd>(pool, first, count));
+}
+
+void TfEncoder::copyQueries(Buffer& dst, uint64_t dstOffset, QueryPool& pool,
+                            uint32_t first, uint32_t count) {
+
+  impl_->encode(make_unique<CopyQueriesCmd>(dst, dstOffset, pool, first,
+                                            count));
+}
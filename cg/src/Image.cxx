@@ -96,6 +96,20 @@ uint32_t Image::texelSize(Format format) {
   case Format::D32FloatS8:
     return 5;
 
+  case Format::Bc1Unorm:
+  case Format::Bc1Srgb:
+  case Format::Bc4Unorm:
+  case Format::Bc4Norm:
+    return 8;
+
+  case Format::Bc3Unorm:
+  case Format::Bc3Srgb:
+  case Format::Bc5Unorm:
+  case Format::Bc5Norm:
+  case Format::Bc7Unorm:
+  case Format::Bc7Srgb:
+    return 16;
+
   case Format::Undefined:
   default:
     throw invalid_argument(__func__);
@@ -106,6 +120,32 @@ uint32_t Image::texelSize() const {
   return texelSize(format());
 }
 
+Size2 Image::blockSize(Format format) {
+  switch (format) {
+  case Format::Bc1Unorm:
+  case Format::Bc1Srgb:
+  case Format::Bc3Unorm:
+  case Format::Bc3Srgb:
+  case Format::Bc4Unorm:
+  case Format::Bc4Norm:
+  case Format::Bc5Unorm:
+  case Format::Bc5Norm:
+  case Format::Bc7Unorm:
+  case Format::Bc7Srgb:
+    return {4, 4};
+
+  case Format::Undefined:
+    throw invalid_argument(__func__);
+
+  default:
+    return {1, 1};
+  }
+}
+
+Size2 Image::blockSize() const {
+  return blockSize(format());
+}
+
 // TODO: Validate parameters here rather than on backend.
 ImgView::ImgView(Image& image, const Desc& desc)
   : image_(image), levels_(desc.levels), layers_(desc.layers),
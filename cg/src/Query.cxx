@@ -0,0 +1,44 @@
+//
+// CG
+// Query.cxx
+//
+// Copyright © 2023 Gustavo C. Viegas.
+//
+
+#include <stdexcept>
+#include <bitset>
+
+#include "Query.h"
+
+using namespace CG_NS;
+using namespace std;
+
+QueryPool::QueryPool(const Desc& desc)
+  : type_(desc.type), count_(desc.count),
+    statisticMask_(desc.type == Statistics ? desc.statisticMask : 0) {
+
+  if (count_ == 0)
+    throw invalid_argument("QueryPool::Desc::count must be at least 1");
+
+  if (type_ == Statistics &&
+      (statisticMask_ == 0 || statisticMask_ & ~0x7FU))
+    throw invalid_argument("QueryPool::Desc has invalid statistic mask");
+}
+
+QueryPool::~QueryPool() { }
+
+QueryPool::Type QueryPool::type() const {
+  return type_;
+}
+
+uint32_t QueryPool::count() const {
+  return count_;
+}
+
+QueryPool::StatisticMask QueryPool::statisticMask() const {
+  return statisticMask_;
+}
+
+uint32_t QueryPool::resultCount() const {
+  return type_ == Statistics ? bitset<32>(statisticMask_).count() : 1;
+}
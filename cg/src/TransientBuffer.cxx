@@ -0,0 +1,17 @@
+//
+// CG
+// TransientBuffer.cxx
+//
+// Copyright © 2023 Gustavo C. Viegas.
+//
+
+#include "TransientBuffer.h"
+
+using namespace CG_NS;
+
+TransientBuffer::TransientBuffer(const Desc& desc)
+  : usageMask_(desc.usageMask) { }
+
+Buffer::UsageMask TransientBuffer::usageMask() const {
+  return usageMask_;
+}
@@ -7,10 +7,13 @@
 
 #include <cstring>
 #include <stdexcept>
+#include <algorithm>
 
 #include "BufferVK.h"
 #include "MemoryVK.h"
 #include "DeviceVK.h"
+#include "StagingVK.h"
+#include "UploadVK.h"
 #include "yf/Except.h"
 
 using namespace CG_NS;
@@ -28,7 +31,8 @@ BufferVK::BufferVK(const Desc& desc) : Buffer(desc) {
   VkBufferUsageFlags usage = 0;
   if (usageMask() & CopySrc)
     usage |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-  if (usageMask() & (CopyDst | Query))
+  // Private buffers are written through staging copies
+  if ((usageMask() & (CopyDst | Query)) || mode() == Private)
     usage |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
   if (usageMask() & Vertex)
     usage |= VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
@@ -47,9 +51,16 @@ BufferVK::BufferVK(const Desc& desc) : Buffer(desc) {
   info.flags = 0;
   info.size = size();
   info.usage = usage;
-  info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-  info.queueFamilyIndexCount = 0;
-  info.pQueueFamilyIndices = nullptr;
+  const auto& families = deviceVK().sharingFamilies();
+  if (families.empty()) {
+    info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    info.queueFamilyIndexCount = 0;
+    info.pQueueFamilyIndices = nullptr;
+  } else {
+    info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+    info.queueFamilyIndexCount = families.size();
+    info.pQueueFamilyIndices = families.data();
+  }
 
   res = vkCreateBuffer(dev, &info, nullptr, &handle_);
   if (res != VK_SUCCESS)
@@ -86,6 +97,13 @@ BufferVK::BufferVK(const Desc& desc) : Buffer(desc) {
 
 BufferVK::~BufferVK() {
   // TODO: Notify
+  // Staged copies must not outlive the buffer
+  if (pendingCopies_ != 0) {
+    try {
+      deviceVK().defaultQueue().submit();
+    } catch (...) { }
+  }
+
   auto dev = deviceVK().device();
   vkDestroyBuffer(dev, handle_, nullptr);
   deallocateVK(memory_);
@@ -99,12 +117,73 @@ void BufferVK::write(uint64_t offset, const void* data, uint64_t size) {
   case Shared:
     memcpy(reinterpret_cast<char*>(data_)+offset, data, size);
     break;
-  default:
-    // TODO: Consider allowing this (do the write through a staging buffer)
-    throw runtime_error("BufferVK::write() requires shared mode");
+  default: {
+    if (size == 0)
+      break;
+
+    // Write the data to the staging ring and then issue a buffer copy
+    // command - copies are batched by the upload scheduler and execute
+    // before the next submission
+    auto& staging = deviceVK().staging();
+    const auto alignment = max<uint64_t>(16, deviceVK().physLimits()
+                                             .optimalBufferCopyOffsetAlignment);
+    const auto range = staging.acquire(size, alignment);
+    range.buffer->write(range.offset, data, size);
+
+    lock_guard<mutex> lock(mutex_);
+
+    try {
+      deviceVK().upload().encode([&](VkCommandBuffer cbuf) {
+        // Copies recorded in a previous priority command buffer were
+        // submitted already
+        if (cbuf != pendingCmd_ || pendingCopies_ == 0) {
+          pendingCmd_ = cbuf;
+          pendingBegin_ = pendingEnd_ = 0;
+        }
+
+        // Copies to the same range must not overlap
+        if (offset < pendingEnd_ && offset + size > pendingBegin_) {
+          VkMemoryBarrier barrier;
+          barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+          barrier.pNext = nullptr;
+          barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+          barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+          vkCmdPipelineBarrier(cbuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                               VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier,
+                               0, nullptr, 0, nullptr);
+          pendingBegin_ = offset;
+          pendingEnd_ = offset + size;
+        } else if (pendingEnd_ == 0) {
+          pendingBegin_ = offset;
+          pendingEnd_ = offset + size;
+        } else {
+          pendingBegin_ = min(pendingBegin_, offset);
+          pendingEnd_ = max(pendingEnd_, offset + size);
+        }
+
+        VkBufferCopy region;
+        region.srcOffset = range.offset;
+        region.dstOffset = offset;
+        region.size = size;
+        vkCmdCopyBuffer(cbuf, range.buffer->handle(), handle_, 1, &region);
+        pendingCopies_++;
+      }, [this, range](bool) {
+        // Completion handlers may run in the thread that submits
+        deviceVK().staging().release(range);
+        pendingCopies_--;
+      });
+    } catch (...) {
+      staging.release(range);
+      throw;
+    }
+  } break;
   }
 }
 
 VkBuffer BufferVK::handle() {
   return handle_;
 }
+
+void* BufferVK::data() {
+  return data_;
+}
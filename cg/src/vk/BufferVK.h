@@ -8,6 +8,9 @@
 #ifndef YF_CG_BUFFERVK_H
 #define YF_CG_BUFFERVK_H
 
+#include <atomic>
+#include <mutex>
+
 #include "Buffer.h"
 #include "VK.h"
 
@@ -20,14 +23,25 @@ class BufferVK final : public Buffer {
 
   void write(uint64_t offset, const void* data, uint64_t size);
 
-  /// Getter.
+  /// Getters.
   ///
   VkBuffer handle();
+  void* data();
 
  private:
   VkDeviceMemory memory_ = VK_NULL_HANDLE;
   VkBuffer handle_ = VK_NULL_HANDLE;
   void* data_ = nullptr;
+
+  /// Range of staged copies recorded in `pendingCmd_`, and number of
+  /// staged copies yet to complete. Writes from different threads
+  /// lock the buffer.
+  ///
+  std::mutex mutex_{};
+  uint64_t pendingBegin_ = 0;
+  uint64_t pendingEnd_ = 0;
+  VkCommandBuffer pendingCmd_ = VK_NULL_HANDLE;
+  std::atomic<uint32_t> pendingCopies_{0};
 };
 
 CG_NS_END
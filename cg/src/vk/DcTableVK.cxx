@@ -5,12 +5,16 @@
 // Copyright © 2020-2023 Gustavo C. Viegas.
 //
 
+#include <cstdint>
+#include <cstdlib>
+#include <cassert>
 #include <algorithm>
 #include <stdexcept>
 
 #include "DcTableVK.h"
 #include "BufferVK.h"
 #include "DeviceVK.h"
+#include "LayoutCacheVK.h"
 #include "yf/Except.h"
 
 using namespace CG_NS;
@@ -23,22 +27,43 @@ DcTableVK::DcTableVK(const vector<DcEntry>& entries) : entries_(entries) {
   sort(entries_.begin(), entries_.end(),
        [](auto& a, auto& b) { return a.id < b.id; });
 
+  // Entries are sorted, so the last one has the largest id
+  entryIndices_.resize(entries_.back().id + 1, UINT32_MAX);
+  for (uint32_t i = 0; i < entries_.size(); i++) {
+    if (entryIndices_[entries_[i].id] != UINT32_MAX)
+      throw invalid_argument("DcTableVK requires unique entry ids");
+    entryIndices_[entries_[i].id] = i;
+  }
+
   vector<VkDescriptorSetLayoutBinding> binds;
+  vector<VkDescriptorBindingFlags> bindFlags;
   VkDescriptorType type;
+  VkDescriptorBindingFlags flags;
   uint32_t unifN = 0;
+  uint32_t unifDynN = 0;
   uint32_t storN = 0;
   uint32_t imgN = 0;
   uint32_t isplrN = 0;
+  uint32_t arrayN = 0;
 
   for (const auto& e : entries_) {
     if (e.elements == 0)
       throw invalid_argument("DcEntry requires elements > 0");
 
+    flags = 0;
+    if (e.type != DcTypeUniformDynamic)
+      dynamicIndices_.push_back(UINT32_MAX);
     switch (e.type) {
     case DcTypeUniform:
       type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
       unifN += e.elements;
       break;
+    case DcTypeUniformDynamic:
+      type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+      // Offsets are given in binding order
+      dynamicIndices_.push_back(unifDynN);
+      unifDynN += e.elements;
+      break;
     case DcTypeStorage:
       type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
       storN += e.elements;
@@ -51,27 +76,64 @@ DcTableVK::DcTableVK(const vector<DcEntry>& entries) : entries_(entries) {
       type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
       isplrN += e.elements;
       break;
+    case DcTypeImgSamplerArray:
+      type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+      flags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+              VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT;
+      isplrN += e.elements;
+      arrayN += e.elements;
+      break;
     default:
       throw invalid_argument("Invalid DcType value");
     }
 
     binds.push_back({e.id, type, e.elements, VK_SHADER_STAGE_ALL, nullptr});
+    bindFlags.push_back(flags);
   }
 
+  if (unifDynN > deviceVK().physLimits().maxDescriptorSetUniformBuffersDynamic)
+    throw LimitExcept("Too many dynamic uniform descriptors in DcTable");
+  dynamicCount_ = unifDynN;
+
+  if (arrayN > 0) {
+    const auto maxArray = deviceVK().limits().maxDcImgSamplerArray;
+    if (maxArray == 0)
+      throw UnsupportedExcept("DcTypeImgSamplerArray not supported");
+    if (arrayN > maxArray)
+      throw LimitExcept("Too many image/sampler array descriptors in DcTable");
+    if (unifDynN > 0)
+      throw invalid_argument("DcTypeImgSamplerArray cannot be used with "
+                             "DcTypeUniformDynamic");
+    poolFlags_ = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+  }
+
+  VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo;
+  flagsInfo.sType =
+    VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+  flagsInfo.pNext = nullptr;
+  flagsInfo.bindingCount = bindFlags.size();
+  flagsInfo.pBindingFlags = bindFlags.data();
+
   VkDescriptorSetLayoutCreateInfo info;
   info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-  info.pNext = nullptr;
-  info.flags = 0;
+  if (arrayN > 0) {
+    info.pNext = &flagsInfo;
+    info.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+  } else {
+    info.pNext = nullptr;
+    info.flags = 0;
+  }
   info.bindingCount = binds.size();
   info.pBindings = binds.data();
 
-  auto dev = deviceVK().device();
-  auto res = vkCreateDescriptorSetLayout(dev, &info, nullptr, &dsLayout_);
-  if (res != VK_SUCCESS)
-    throw DeviceExcept("Could not create descriptor set layout");
+  // Tables with equal entries share the set layout
+  dsLayout_ = deviceVK().layoutCache().dsLayout(entries_, info);
 
   if (unifN > 0)
     poolSizes_.push_back({VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, unifN});
+  if (unifDynN > 0)
+    poolSizes_.push_back({VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+                          unifDynN});
   if (storN > 0)
     poolSizes_.push_back({VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, storN});
   if (imgN > 0)
@@ -82,42 +144,39 @@ DcTableVK::DcTableVK(const vector<DcEntry>& entries) : entries_(entries) {
 
 DcTableVK::~DcTableVK() {
   // TODO: Notify
-  auto dev = deviceVK().device();
-  vkDestroyDescriptorPool(dev, pool_, nullptr);
-  vkDestroyDescriptorSetLayout(dev, dsLayout_, nullptr);
+  release();
 }
 
 void DcTableVK::allocate(uint32_t n) {
-  // XXX: Since currently held resources will only be freed after (and if)
-  // the new allocation succeeds, one may need to call `allocate(0)` first
-
-  if (n == sets_.size())
+  if (n == count_)
     return;
 
-  auto dev = deviceVK().device();
-
   if (n == 0) {
-    vkDestroyDescriptorPool(dev, pool_, nullptr);
-    pool_ = VK_NULL_HANDLE;
-    sets_.clear();
-    imgRefs_.clear();
+    release();
+    return;
+  }
+
+  if (n <= sets_.size()) {
+    count_ = n;
     return;
   }
 
-  // Create new pool
+  // Create a new pool for the missing sets only
+  const uint32_t m = n - sets_.size();
   auto sizes = poolSizes_;
-  if (n > 1) {
+  if (m > 1) {
     for (auto& s : sizes)
-      s.descriptorCount *= n;
+      s.descriptorCount *= m;
   }
+  auto dev = deviceVK().device();
   VkDescriptorPool pool;
   VkResult res;
 
   VkDescriptorPoolCreateInfo poolInfo;
   poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
   poolInfo.pNext = nullptr;
-  poolInfo.flags = 0;
-  poolInfo.maxSets = n;
+  poolInfo.flags = poolFlags_;
+  poolInfo.maxSets = m;
   poolInfo.poolSizeCount = sizes.size();
   poolInfo.pPoolSizes = sizes.data();
 
@@ -126,15 +185,15 @@ void DcTableVK::allocate(uint32_t n) {
     throw DeviceExcept("Could not create descriptor pool");
 
   // Allocate new descriptor sets
-  vector<VkDescriptorSetLayout> layouts(n, dsLayout_);
+  vector<VkDescriptorSetLayout> layouts(m, *dsLayout_);
   vector<VkDescriptorSet> sets;
-  sets.resize(n);
+  sets.resize(m);
 
   VkDescriptorSetAllocateInfo allocInfo;
   allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
   allocInfo.pNext = nullptr;
   allocInfo.descriptorPool = pool;
-  allocInfo.descriptorSetCount = n;
+  allocInfo.descriptorSetCount = m;
   allocInfo.pSetLayouts = layouts.data();
 
   res = vkAllocateDescriptorSets(dev, &allocInfo, sets.data());
@@ -143,58 +202,71 @@ void DcTableVK::allocate(uint32_t n) {
     throw DeviceExcept("Could not allocate descriptor set(s)");
   }
 
-  vkDestroyDescriptorPool(dev, pool_, nullptr);
-  pool_ = pool;
-  sets_ = sets;
-  resetImgRefs();
+  pools_.push_back(pool);
+  sets_.insert(sets_.end(), sets.begin(), sets.end());
+  dynamicLimits_.resize(sets_.size() * dynamicCount_, 0);
+  appendImgRefs(m);
+  count_ = n;
 }
 
 uint32_t DcTableVK::allocations() const {
-  return sets_.size();
+  return count_;
 }
 
 void DcTableVK::write(uint32_t allocation, DcId id, uint32_t element,
                       Buffer& buffer, uint64_t offset, uint64_t size) {
 
-  const auto ent = lower_bound(entries_.begin(), entries_.end(),
-                               DcEntry{id, DcTypeUniform, 0},
-                               [](auto& a, auto& b) { return a.id < b.id; });
+  const auto ent = entry(id);
 
-  if (allocation >= sets_.size() || ent == entries_.end() || ent->id != id ||
-      (ent->type != DcTypeUniform && ent->type != DcTypeStorage) ||
+  if (allocation >= count_ || !ent ||
+      (ent->type != DcTypeUniform && ent->type != DcTypeUniformDynamic &&
+       ent->type != DcTypeStorage) ||
       element >= ent->elements || offset + size > buffer.size())
     throw invalid_argument("DcTable write() [Buffer]");
 
   const auto& lim = deviceVK().physLimits();
+  VkDescriptorType type;
 
-  VkDescriptorBufferInfo info;
+  if (ent->type != DcTypeStorage) {
+    type = ent->type == DcTypeUniform ?
+           VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER :
+           VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    if (offset % lim.minUniformBufferOffsetAlignment ||
+        size > lim.maxUniformBufferRange)
+      throw invalid_argument("DcTable write [Buffer] - limit");
+    if (ent->type == DcTypeUniformDynamic) {
+      const auto i = dynamicIndices_[entryIndices_[id]] + element;
+      dynamicLimits_[allocation * dynamicCount_ + i] =
+        buffer.size() - offset - size;
+    }
+  } else {
+    type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    if (offset % lim.minStorageBufferOffsetAlignment ||
+        size > lim.maxStorageBufferRange)
+      throw invalid_argument("DcTable write [Buffer] - limit");
+  }
+
+  bufInfos_.push_back({});
+  auto& info = bufInfos_.back();
   info.buffer = static_cast<BufferVK&>(buffer).handle();
   info.offset = offset;
   info.range = size;
 
-  VkWriteDescriptorSet wr;
+  writes_.push_back({});
+  auto& wr = writes_.back();
   wr.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
   wr.pNext = nullptr;
   wr.dstSet = sets_[allocation];
   wr.dstBinding = id;
   wr.dstArrayElement = element;
   wr.descriptorCount = 1;
-  if (ent->type == DcTypeUniform) {
-    wr.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    if (offset % lim.minUniformBufferOffsetAlignment ||
-        size > lim.maxUniformBufferRange)
-      throw invalid_argument("DcTable write [Buffer] - limit");
-  } else {
-    wr.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    if (offset % lim.minStorageBufferOffsetAlignment ||
-        size > lim.maxStorageBufferRange)
-      throw invalid_argument("DcTable write [Buffer] - limit");
-  }
+  wr.descriptorType = type;
   wr.pImageInfo = nullptr;
   wr.pBufferInfo = &info;
   wr.pTexelBufferView = nullptr;
 
-  vkUpdateDescriptorSets(deviceVK().device(), 1, &wr, 0, nullptr);
+  if (!batching_)
+    flush();
 }
 
 void DcTableVK::write(uint32_t allocation, DcId id, uint32_t element,
@@ -214,97 +286,172 @@ void DcTableVK::write(uint32_t allocation, DcId id, uint32_t element,
                       Image& image, uint32_t layer, uint32_t level,
                       Sampler* sampler) {
 
-  const auto ent = lower_bound(entries_.begin(), entries_.end(),
-                               DcEntry{id, DcTypeImage, 0},
-                               [](auto& a, auto& b) { return a.id < b.id; });
+  const auto ent = entry(id);
 
-  if (allocation >= sets_.size() || ent == entries_.end() || ent->id != id ||
-      (ent->type != DcTypeImage && ent->type != DcTypeImgSampler) ||
+  if (allocation >= count_ || !ent ||
+      (ent->type != DcTypeImage && ent->type != DcTypeImgSampler &&
+       ent->type != DcTypeImgSamplerArray) ||
       element >= ent->elements || layer >= image.size().depthOrLayers)
     throw invalid_argument("DcTableVK write() [Image]");
 
   ImgRef& ref = imgRefs_[allocation].find(id)->second[element];
 
-  // Check if view object can be reused
-  if (!ref.view || &ref.view->image() != &image ||
-      ref.view->levels().start != level || ref.view->layers().start != layer)
-    ref.view = image.view({{level, level + 1},
-                           {layer, layer + 1},
-                           ImgView::Dim2});
+  // Views are cached by the image, so this will not usually create one
+  auto view = image.view({{level, level + 1}, {layer, layer + 1},
+                          ImgView::Dim2});
+  if (view != ref.view) {
+    if (batching_ && ref.view)
+      oldViews_.push_back(move(ref.view));
+    ref.view = move(view);
+  }
+
+  // Check if sampler is needed
+  VkSampler splr = VK_NULL_HANDLE;
+  VkDescriptorType type;
+
+  switch (ent->type) {
+  case DcTypeImage:
+    type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    break;
+  case DcTypeImgSampler:
+  case DcTypeImgSamplerArray:
+    if (!sampler) {
+      if (!defaultSampler_)
+        defaultSampler_ = make_unique<SamplerVK>(Sampler::Desc{});
+      splr = defaultSampler_->handle();
+    } else {
+      splr = static_cast<SamplerVK*>(sampler)->handle();
+    }
+    type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    break;
+  default:
+    assert(false);
+    abort();
+  }
 
-  VkDescriptorImageInfo info;
+  imgInfos_.push_back({});
+  auto& info = imgInfos_.back();
+  info.sampler = splr;
   info.imageView = static_cast<ImgViewVK*>(ref.view.get())->handle();
   info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
 
-  VkWriteDescriptorSet wr;
+  writes_.push_back({});
+  auto& wr = writes_.back();
   wr.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
   wr.pNext = nullptr;
   wr.dstSet = sets_[allocation];
   wr.dstBinding = id;
   wr.dstArrayElement = element;
   wr.descriptorCount = 1;
+  wr.descriptorType = type;
   wr.pImageInfo = &info;
   wr.pBufferInfo = nullptr;
   wr.pTexelBufferView = nullptr;
 
-  // Check if sampler is needed
-  switch (ent->type) {
-  case DcTypeImage:
-    ref.sampler = nullptr;
-    info.sampler = VK_NULL_HANDLE;
-    wr.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-    break;
-  case DcTypeImgSampler:
-    if (!sampler) {
-      ref.sampler = make_unique<SamplerVK>(Sampler::Desc{});
-      info.sampler = static_cast<SamplerVK*>(ref.sampler.get())->handle();
-    } else {
-      info.sampler = static_cast<SamplerVK*>(sampler)->handle();
-    }
-    wr.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    break;
-  default:
-    break;
-  }
+  if (!batching_)
+    flush();
+}
 
-  vkUpdateDescriptorSets(deviceVK().device(), 1, &wr, 0, nullptr);
+void DcTableVK::begin() {
+  batching_ = true;
+}
+
+void DcTableVK::commit() {
+  batching_ = false;
+  flush();
 }
 
 const vector<DcEntry>& DcTableVK::entries() const {
   return entries_;
 }
 
-void DcTableVK::resetImgRefs() {
+const DcEntry* DcTableVK::entry(DcId id) const {
+  if (id >= entryIndices_.size() || entryIndices_[id] == UINT32_MAX)
+    return nullptr;
+  return &entries_[entryIndices_[id]];
+}
+
+void DcTableVK::flush() {
+  if (!writes_.empty())
+    vkUpdateDescriptorSets(deviceVK().device(), writes_.size(),
+                           writes_.data(), 0, nullptr);
+  discard();
+}
+
+void DcTableVK::discard() {
+  writes_.clear();
+  bufInfos_.clear();
+  imgInfos_.clear();
+  oldViews_.clear();
+}
+
+void DcTableVK::release() {
+  // Pending writes refer to the released sets
+  discard();
+
+  auto dev = deviceVK().device();
+  for (auto pool : pools_)
+    vkDestroyDescriptorPool(dev, pool, nullptr);
+  pools_.clear();
+  sets_.clear();
+  dynamicLimits_.clear();
   imgRefs_.clear();
+  count_ = 0;
+}
+
+void DcTableVK::appendImgRefs(uint32_t n) {
+  const bool hasImages = any_of(entries_.begin(), entries_.end(),
+                                [](const auto& e) {
+    return e.type == DcTypeImgSampler || e.type == DcTypeImgSamplerArray ||
+           e.type == DcTypeImage;
+  });
+  if (!hasImages)
+    return;
 
   // Cannot copy unique pointers
-  for (auto i = sets_.size(); i > 0; i--) {
+  for (; n > 0; n--) {
     imgRefs_.push_back({});
-
     for (const auto& e : entries_) {
-      if (e.type != DcTypeImgSampler && e.type != DcTypeImage)
-        continue;
+      if (e.type == DcTypeImgSampler || e.type == DcTypeImgSamplerArray ||
+          e.type == DcTypeImage)
+        imgRefs_.back().emplace(e.id, vector<ImgRef>(e.elements));
+    }
+  }
+}
 
-      auto it = imgRefs_.back().emplace(e.id, vector<ImgRef>()).first;
+uint32_t DcTableVK::dynamicCount() const {
+  return dynamicCount_;
+}
 
-      for (auto j = e.elements; j > 0; j--)
-        it->second.push_back({nullptr, nullptr});
-    }
+void DcTableVK::checkDynamicOffsets(uint32_t allocation,
+                                    const vector<uint32_t>& offsets) const {
 
-    // TODO: Do this once
-    if (imgRefs_[0].empty()) {
-      imgRefs_.clear();
-      return;
-    }
+  assert(allocation < count_);
+
+  if (offsets.size() != dynamicCount_)
+    throw invalid_argument("setDcTable() dynamic offset count mismatch");
+
+  const auto& lim = deviceVK().physLimits();
+  const auto alignment = lim.minUniformBufferOffsetAlignment;
+  const auto limits = dynamicLimits_.data() + allocation * dynamicCount_;
+  for (uint32_t i = 0; i < dynamicCount_; i++) {
+    if (offsets[i] % alignment)
+      throw invalid_argument("setDcTable() dynamic offset misaligned");
+    if (offsets[i] > limits[i])
+      throw invalid_argument("setDcTable() dynamic offset out of range");
   }
 }
 
 VkDescriptorSetLayout DcTableVK::dsLayout() {
+  return *dsLayout_;
+}
+
+const LayoutCacheVK::DsRef& DcTableVK::dsLayoutRef() const {
   return dsLayout_;
 }
 
 VkDescriptorSet DcTableVK::ds(uint32_t index) {
-  if (index >= sets_.size())
+  if (index >= count_)
     throw invalid_argument("Descriptor set index out of range");
 
   return sets_[index];
@@ -9,12 +9,14 @@
 #define YF_CG_DCTABLEVK_H
 
 #include <vector>
+#include <deque>
 #include <unordered_map>
 
 #include "DcTable.h"
 #include "VK.h"
 #include "ImageVK.h"
 #include "SamplerVK.h"
+#include "LayoutCacheVK.h"
 
 CG_NS_BEGIN
 
@@ -36,39 +38,95 @@ class DcTableVK final : public DcTable {
              Image& image, uint32_t layer, uint32_t level,
              Sampler& sampler);
 
+  void begin();
+  void commit();
+
   const std::vector<DcEntry>& entries() const;
 
+  /// Gets the number of dynamic offsets required when binding.
+  ///
+  uint32_t dynamicCount() const;
+
+  /// Checks dynamic offsets given to bind an allocation.
+  ///
+  /// Throws `std::invalid_argument` if the count does not match, if an
+  /// offset is misaligned, or if it would move a descriptor's range past
+  /// the end of the buffer written to it.
+  ///
+  void checkDynamicOffsets(uint32_t allocation,
+                           const std::vector<uint32_t>& offsets) const;
+
   /// Getters.
   ///
   VkDescriptorSetLayout dsLayout();
   VkDescriptorSet ds(uint32_t index);
 
+  /// Gets the shared reference to the descriptor set layout.
+  ///
+  const LayoutCacheVK::DsRef& dsLayoutRef() const;
+
  private:
   std::vector<DcEntry> entries_{};
-  VkDescriptorSetLayout dsLayout_ = VK_NULL_HANDLE;
-  VkDescriptorPool pool_ = VK_NULL_HANDLE;
+  uint32_t dynamicCount_ = 0;
+
+  /// Index of the first dynamic offset of every entry, and the largest
+  /// dynamic offset that every allocation's descriptors can be bound at.
+  ///
+  std::vector<uint32_t> dynamicIndices_{};
+  std::vector<uint64_t> dynamicLimits_{};
+  LayoutCacheVK::DsRef dsLayout_{};
   std::vector<VkDescriptorPoolSize> poolSizes_{};
+  VkDescriptorPoolCreateFlags poolFlags_ = 0;
+
+  /// Growing chains a new pool, from which only the missing sets are
+  /// allocated. Shrinking just lowers `count_`, so sets past it are kept
+  /// (along with their descriptors) for when the table grows again.
+  ///
+  std::vector<VkDescriptorPool> pools_{};
   std::vector<VkDescriptorSet> sets_{};
+  uint32_t count_ = 0;
+  void release();
+
+  /// Maps a `DcId` to its index in `entries_`.
+  ///
+  std::vector<uint32_t> entryIndices_{};
+  const DcEntry* entry(DcId id) const;
+
+  /// Writes are recorded here and applied on `flush()`. The info
+  /// structures live in deques, so their addresses remain valid while
+  /// more writes are recorded. Views replaced during a batch are kept
+  /// alive until the batch is applied.
+  ///
+  bool batching_ = false;
+  std::vector<VkWriteDescriptorSet> writes_{};
+  std::deque<VkDescriptorBufferInfo> bufInfos_{};
+  std::deque<VkDescriptorImageInfo> imgInfos_{};
+  std::vector<ImgViewVK::Ptr> oldViews_{};
+  void flush();
+  void discard();
 
   void write(uint32_t allocation, DcId id, uint32_t element,
              Image& image, uint32_t layer, uint32_t level,
              Sampler* sampler);
 
-  /// Image views and sampler objects used in `write()`s are managed by
-  /// the table. Every image/sampler descriptor has a list of `elements`
-  /// size holding resources used in the most recent update. A list of
-  /// `allocations` size holds descriptor-to-resource-list mappings.
+  /// Image views used in `write()`s are referenced by the table. Every
+  /// image/sampler descriptor has a list of `elements` size holding
+  /// views used in the most recent update. A list of `allocations` size
+  /// holds descriptor-to-view-list mappings.
   ///
   // TODO: Deprecate
   struct ImgRef {
     ImgViewVK::Ptr view;
-    SamplerVK::Ptr sampler;
   };
 
   using ImgRefs = std::unordered_map<DcId, std::vector<ImgRef>>;
   std::vector<ImgRefs> imgRefs_{};
 
-  void resetImgRefs();
+  void appendImgRefs(uint32_t n);
+
+  /// Sampler used when `write()` is not given one.
+  ///
+  SamplerVK::Ptr defaultSampler_{};
 };
 
 CG_NS_END
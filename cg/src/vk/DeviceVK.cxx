@@ -13,8 +13,14 @@
 #include "DeviceVK.h"
 #include "VK.h"
 #include "QueueVK.h"
+#include "StagingVK.h"
+#include "UploadVK.h"
+#include "SamplerCacheVK.h"
+#include "LayoutCacheVK.h"
 #include "BufferVK.h"
+#include "TransientVK.h"
 #include "ImageVK.h"
+#include "QueryVK.h"
 #include "ShaderVK.h"
 #include "DcTableVK.h"
 #include "PassVK.h"
@@ -40,7 +46,12 @@ DeviceVK::~DeviceVK() {
     vkDeviceWaitIdle(device_);
     vkDestroyPipelineCache(device_, cache_, nullptr);
     // TODO: Ensure that all VK objects were disposed of prior to this point
+    delete upload_;
+    delete transferQueue_;
     delete queue_;
+    delete staging_;
+    delete samplerCache_;
+    delete layoutCache_;
     vkDestroyDevice(device_, nullptr);
   }
   vkDestroyInstance(instance_, nullptr);
@@ -207,6 +218,7 @@ void DeviceVK::initPhysicalDevice() {
   // Find a physical device that supports both graphics and compute
   int32_t queueFamily = -1;
   int32_t presFamily = -1;
+  int32_t xferFamily = -1;
   for (const auto& p : physProps) {
     vector<VkQueueFamilyProperties> families;
     uint32_t familyN;
@@ -242,6 +254,25 @@ void DeviceVK::initPhysicalDevice() {
         }
       }
 
+      // Find a transfer-only queue family, which usually maps to
+      // dedicated copy engines - families that can copy single texels
+      // are preferred, as coarser image copies fall back to the default
+      // queue
+      for (uint32_t i = 0; i < familyN; i++) {
+        const auto flags = families[i].queueFlags;
+        if ((flags & VK_QUEUE_TRANSFER_BIT) &&
+            !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) &&
+            static_cast<int32_t>(i) != presFamily) {
+          const auto& gran = families[i].minImageTransferGranularity;
+          if (gran.width == 1 && gran.height == 1 && gran.depth == 1) {
+            xferFamily = i;
+            break;
+          }
+          if (xferFamily < 0)
+            xferFamily = i;
+        }
+      }
+
       break;
     }
   }
@@ -254,10 +285,11 @@ void DeviceVK::initPhysicalDevice() {
   setLimits();
 
   // Now the logical device can be initialized
-  initDevice(queueFamily, presFamily);
+  initDevice(queueFamily, presFamily, xferFamily);
 }
 
-void DeviceVK::initDevice(int32_t queueFamily, int32_t presFamily) {
+void DeviceVK::initDevice(int32_t queueFamily, int32_t presFamily,
+                          int32_t xferFamily) {
   assert(queueFamily > -1);
   assert(physicalDev_ != nullptr);
   assert(device_ == nullptr);
@@ -278,13 +310,19 @@ void DeviceVK::initDevice(int32_t queueFamily, int32_t presFamily) {
 
   if (presFamily > -1 && presFamily != queueFamily) {
     queueInfos.push_back(queueInfos[0]);
-    queueInfos[1].queueFamilyIndex = presFamily;
+    queueInfos.back().queueFamilyIndex = presFamily;
+  }
+
+  if (xferFamily > -1) {
+    assert(xferFamily != queueFamily && xferFamily != presFamily);
+    queueInfos.push_back(queueInfos[0]);
+    queueInfos.back().queueFamilyIndex = xferFamily;
   }
 
   // Create device
   VkDeviceCreateInfo devInfo;
   devInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-  devInfo.pNext = nullptr;
+  devInfo.pNext = descriptorIndexing_ ? &indexingFeatures_ : nullptr;
   devInfo.flags = 0;
   devInfo.queueCreateInfoCount = queueInfos.size();
   devInfo.pQueueCreateInfos = queueInfos.data();
@@ -302,7 +340,8 @@ void DeviceVK::initDevice(int32_t queueFamily, int32_t presFamily) {
   setProcsVK(device_);
   VkQueue queue;
   vkGetDeviceQueue(device_, queueFamily, 0, &queue);
-  queue_ = new QueueVK(queue, queueFamily);
+  queue_ = new QueueVK(queue, queueFamily,
+                       Queue::Graphics|Queue::Compute|Queue::Transfer);
   if (presFamily < 0) {
     // Cannot present
     WsiVK::setQueue(nullptr, -1);
@@ -312,6 +351,24 @@ void DeviceVK::initDevice(int32_t queueFamily, int32_t presFamily) {
     WsiVK::setQueue(queue, presFamily);
   }
 
+  // Uploads go through the transfer queue when there is one
+  VkExtent3D granularity{1, 1, 1};
+  if (xferFamily > -1) {
+    vkGetDeviceQueue(device_, xferFamily, 0, &queue);
+    transferQueue_ = new QueueVK(queue, xferFamily, Queue::Transfer);
+    sharingFamilies_ = {static_cast<uint32_t>(queueFamily),
+                        static_cast<uint32_t>(xferFamily)};
+
+    uint32_t familyN;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDev_, &familyN, nullptr);
+    vector<VkQueueFamilyProperties> families(familyN);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDev_, &familyN,
+                                             families.data());
+    granularity = families[xferFamily].minImageTransferGranularity;
+  }
+  upload_ = new UploadVK(*queue_, transferQueue_, granularity);
+  queue_->setUpload(upload_);
+
   // Use a single cache for state creation
   VkPipelineCacheCreateInfo cacheInfo;
   cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
@@ -339,15 +396,42 @@ void DeviceVK::setFeatures() {
   features_.wideLines = feat.wideLines;
   features_.largePoints = feat.largePoints;
   features_.multiViewport = feat.multiViewport;
+  features_.pipelineStatisticsQuery = feat.pipelineStatisticsQuery;
 #ifdef YF_DEVEL
   features_.occlusionQueryPrecise = feat.occlusionQueryPrecise;
-  features_.pipelineStatisticsQuery = feat.pipelineStatisticsQuery;
 #endif
   features_.vertexPipelineStoresAndAtomics =
     feat.vertexPipelineStoresAndAtomics;
   features_.fragmentStoresAndAtomics = feat.fragmentStoresAndAtomics;
   features_.shaderClipDistance = feat.shaderClipDistance;
   features_.shaderCullDistance = feat.shaderCullDistance;
+  features_.textureCompressionBC = feat.textureCompressionBC;
+
+  // Descriptor indexing (core in v1.2) is only used for arrays of
+  // combined image samplers that are partially bound and updated after
+  // being bound
+  if (instVersion_ < VK_API_VERSION_1_2 ||
+      physProperties_.apiVersion < VK_API_VERSION_1_2)
+    return;
+
+  VkPhysicalDeviceDescriptorIndexingFeatures idx{};
+  idx.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+  VkPhysicalDeviceFeatures2 feat2{};
+  feat2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  feat2.pNext = &idx;
+  vkGetPhysicalDeviceFeatures2(physicalDev_, &feat2);
+
+  if (idx.shaderSampledImageArrayNonUniformIndexing &&
+      idx.descriptorBindingSampledImageUpdateAfterBind &&
+      idx.descriptorBindingPartiallyBound) {
+    indexingFeatures_.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+    indexingFeatures_.pNext = nullptr;
+    indexingFeatures_.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    indexingFeatures_.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    indexingFeatures_.descriptorBindingPartiallyBound = VK_TRUE;
+    descriptorIndexing_ = true;
+  }
 }
 
 void DeviceVK::setLimits() {
@@ -383,8 +467,30 @@ void DeviceVK::setLimits() {
   limits_.minDcStorageWriteAlignedOffset = lim.minStorageBufferOffsetAlignment;
   limits_.maxDcStorageWriteSize = lim.maxStorageBufferRange;
 
+  limits_.maxConstSize = lim.maxPushConstantsSize;
+
+  if (descriptorIndexing_) {
+    VkPhysicalDeviceDescriptorIndexingProperties idx{};
+    idx.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+    VkPhysicalDeviceProperties2 prop2{};
+    prop2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    prop2.pNext = &idx;
+    vkGetPhysicalDeviceProperties2(physicalDev_, &prop2);
+
+    limits_.maxDcImgSamplerArray =
+      min({idx.maxDescriptorSetUpdateAfterBindSampledImages,
+           idx.maxDescriptorSetUpdateAfterBindSamplers,
+           idx.maxPerStageDescriptorUpdateAfterBindSampledImages,
+           idx.maxPerStageDescriptorUpdateAfterBindSamplers});
+  } else {
+    limits_.maxDcImgSamplerArray = 0;
+  }
+
   limits_.maxVxInputs = lim.maxVertexInputBindings;
   limits_.maxVxAttrs = lim.maxVertexInputAttributes;
+
+  limits_.timestampPeriod = lim.timestampPeriod;
 }
 
 VkInstance DeviceVK::instance() {
@@ -435,15 +541,50 @@ const VkPhysicalDeviceFeatures& DeviceVK::features() const {
   return features_;
 }
 
+bool DeviceVK::descriptorIndexing() const {
+  return descriptorIndexing_;
+}
+
 const VkPhysicalDeviceLimits& DeviceVK::physLimits() const {
   return physProperties_.limits;
 }
 
+StagingVK& DeviceVK::staging() {
+  call_once(stagingFlag_, [&] { staging_ = new StagingVK; });
+  return *staging_;
+}
+
+UploadVK& DeviceVK::upload() {
+  return *upload_;
+}
+
+const vector<uint32_t>& DeviceVK::sharingFamilies() const {
+  return sharingFamilies_;
+}
+
+SamplerCacheVK& DeviceVK::samplerCache() {
+  call_once(samplerCacheFlag_, [&] { samplerCache_ = new SamplerCacheVK; });
+  return *samplerCache_;
+}
+
+LayoutCacheVK& DeviceVK::layoutCache() {
+  call_once(layoutCacheFlag_, [&] { layoutCache_ = new LayoutCacheVK; });
+  return *layoutCache_;
+}
+
 Queue& DeviceVK::defaultQueue() {
   return *queue_;
 }
 
-Queue& DeviceVK::queue(Queue::CapabilityMask) {
+Queue& DeviceVK::queue(Queue::CapabilityMask capabilities) {
+  // Transfer-only work goes to the transfer queue
+  if (transferQueue_ && capabilities != 0 &&
+      (capabilities & ~transferQueue_->capabilities()) == 0)
+    return *transferQueue_;
+
+  if (capabilities & ~queue_->capabilities())
+    throw UnsupportedExcept("No queue with the requested capabilities");
+
   return *queue_;
 }
 
@@ -451,6 +592,11 @@ Buffer::Ptr DeviceVK::buffer(const Buffer::Desc& desc) {
   return make_unique<BufferVK>(desc);
 }
 
+TransientBuffer::Ptr
+DeviceVK::transientBuffer(const TransientBuffer::Desc& desc) {
+  return make_unique<TransientVK>(desc);
+}
+
 Image::Ptr DeviceVK::image(const Image::Desc& desc) {
   return make_unique<ImageVK>(desc);
 }
@@ -459,6 +605,10 @@ Sampler::Ptr DeviceVK::sampler(const Sampler::Desc& desc) {
   return make_unique<SamplerVK>(desc);
 }
 
+QueryPool::Ptr DeviceVK::queryPool(const QueryPool::Desc& desc) {
+  return make_unique<QueryPoolVK>(desc);
+}
+
 Shader::Ptr DeviceVK::shader(const Shader::Desc& desc) {
   return make_unique<ShaderVK>(desc);
 }
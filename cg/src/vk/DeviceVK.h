@@ -8,6 +8,8 @@
 #ifndef YF_CG_DEVICEVK_H
 #define YF_CG_DEVICEVK_H
 
+#include <mutex>
+
 #include "Defs.h"
 #include "Device.h"
 #include "VK.h"
@@ -15,6 +17,10 @@
 CG_NS_BEGIN
 
 class QueueVK;
+class StagingVK;
+class UploadVK;
+class SamplerCacheVK;
+class LayoutCacheVK;
 class DeviceVK;
 
 /// Gets the device instance.
@@ -28,8 +34,10 @@ class DeviceVK final : public Device {
   Queue& defaultQueue();
   Queue& queue(Queue::CapabilityMask capabilities);
   Buffer::Ptr buffer(const Buffer::Desc& desc);
+  TransientBuffer::Ptr transientBuffer(const TransientBuffer::Desc& desc);
   Image::Ptr image(const Image::Desc& desc);
   Sampler::Ptr sampler(const Sampler::Desc& desc);
+  QueryPool::Ptr queryPool(const QueryPool::Desc& desc);
   Shader::Ptr shader(const Shader::Desc& desc);
 
   DcTable::Ptr dcTable(const std::vector<DcEntry>& entries);
@@ -59,10 +67,46 @@ class DeviceVK final : public Device {
   uint32_t instVersion() const;
   uint32_t devVersion() const;
   const VkPhysicalDeviceFeatures& features() const;
+  bool descriptorIndexing() const;
   const VkPhysicalDeviceLimits& physLimits() const;
 
+  /// Gets the staging ring used for uploads.
+  ///
+  /// This can be called from any thread.
+  ///
+  StagingVK& staging();
+
+  /// Gets the scheduler of staging copies.
+  ///
+  UploadVK& upload();
+
+  /// Gets the queue families among which resources are shared.
+  ///
+  /// This is empty if every queue belongs to the same family. Resources
+  /// are otherwise created with concurrent sharing, so the transfer
+  /// queue can write to them without ownership transfers.
+  ///
+  const std::vector<uint32_t>& sharingFamilies() const;
+
+  /// Gets the cache from which sampler objects are obtained.
+  ///
+  SamplerCacheVK& samplerCache();
+
+  /// Gets the cache from which layout objects are obtained.
+  ///
+  LayoutCacheVK& layoutCache();
+
  private:
   QueueVK* queue_ = nullptr;
+  QueueVK* transferQueue_ = nullptr;
+  UploadVK* upload_ = nullptr;
+  std::vector<uint32_t> sharingFamilies_{};
+  StagingVK* staging_ = nullptr;
+  std::once_flag stagingFlag_{};
+  SamplerCacheVK* samplerCache_ = nullptr;
+  std::once_flag samplerCacheFlag_{};
+  LayoutCacheVK* layoutCache_ = nullptr;
+  std::once_flag layoutCacheFlag_{};
 
   VkInstance instance_ = nullptr;
   uint32_t instVersion_ = 0;
@@ -73,6 +117,8 @@ class DeviceVK final : public Device {
   VkPhysicalDeviceProperties physProperties_{};
   VkPhysicalDeviceMemoryProperties memProperties_{};
   VkPhysicalDeviceFeatures features_{};
+  VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures_{};
+  bool descriptorIndexing_ = false;
 
   Limits limits_{};
 
@@ -88,7 +134,7 @@ class DeviceVK final : public Device {
   bool checkDeviceExtensions();
   void initInstance();
   void initPhysicalDevice();
-  void initDevice(int32_t, int32_t);
+  void initDevice(int32_t, int32_t, int32_t);
   void setFeatures();
   void setLimits();
 };
@@ -6,16 +6,34 @@
 //
 
 #include <cstring>
+#include <algorithm>
+#include <numeric>
 
 #include "ImageVK.h"
+#include "BufferVK.h"
 #include "MemoryVK.h"
 #include "QueueVK.h"
 #include "DeviceVK.h"
+#include "StagingVK.h"
+#include "UploadVK.h"
 #include "yf/Except.h"
 
 using namespace CG_NS;
 using namespace std;
 
+INTERNAL_NS_BEGIN
+
+/// Records a layout transition.
+///
+// TODO: Needs improvement
+void encodeLayout(VkCommandBuffer cbuf, const VkImageMemoryBarrier& barrier) {
+  vkCmdPipelineBarrier(cbuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &barrier);
+}
+
+INTERNAL_NS_END
+
 //
 // ImageVK
 //
@@ -72,7 +90,8 @@ ImageVK::ImageVK(const Image::Desc& desc) : Image(desc), owned_(true) {
     if (deviceVK().devVersion() >= VK_API_VERSION_1_1)
       fmtFeat |= VK_FORMAT_FEATURE_TRANSFER_SRC_BIT;
   }
-  if (usageMask() & CopyDst) {
+  // Contents of sampled and storage images may be uploaded with `write()`
+  if (usageMask() & (CopyDst | Sampled | Storage)) {
     usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
     if (deviceVK().devVersion() >= VK_API_VERSION_1_1)
       fmtFeat |= VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
@@ -172,9 +191,10 @@ ImageVK::ImageVK(const Image::Desc& desc) : Image(desc), owned_(true) {
     }
   };
 
-  // Prefer linear tiling
-  // TODO: Maybe check usage too
-  if (samples() != Samples1 || !setTiling(VK_IMAGE_TILING_LINEAR))
+  // Linear tiling must be requested explicitly, since sampling from it
+  // is usually much slower
+  if (desc.tiling != Linear || samples() != Samples1 ||
+      !setTiling(VK_IMAGE_TILING_LINEAR))
     if (!setTiling(VK_IMAGE_TILING_OPTIMAL))
       throw UnsupportedExcept("Format not supported by ImageVK");
 
@@ -196,9 +216,16 @@ ImageVK::ImageVK(const Image::Desc& desc) : Image(desc), owned_(true) {
   info.samples = spl;
   info.tiling = tiling_;
   info.usage = usage;
-  info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-  info.queueFamilyIndexCount = 0;
-  info.pQueueFamilyIndices = nullptr;
+  const auto& families = deviceVK().sharingFamilies();
+  if (families.empty()) {
+    info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    info.queueFamilyIndexCount = 0;
+    info.pQueueFamilyIndices = nullptr;
+  } else {
+    info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+    info.queueFamilyIndexCount = families.size();
+    info.pQueueFamilyIndices = families.data();
+  }
   info.initialLayout = layout_;
 
   res = vkCreateImage(dev, &info, nullptr, &handle_);
@@ -253,17 +280,44 @@ ImageVK::ImageVK(const Desc& desc, VkImage handle, void* data,
 }
 
 ImageVK::~ImageVK() {
+  // Views that are still referenced will hold null handles
+  for (auto& v : views_)
+    v->invalidate();
+
   // TODO: Notify
   if (owned_) {
+    // Staged copies and layout transitions must not outlive the image
+    const auto lay = layout();
+    if (pendingCopies_ != 0 || lay.first != lay.second) {
+      try {
+        deviceVK().defaultQueue().submit();
+      } catch (...) { }
+    }
+
     auto dev = deviceVK().device();
     vkDestroyImage(dev, handle_, nullptr);
     deallocateVK(memory_);
   }
 }
 
-// TODO: Manage views' lifetimes
 ImgView::Ptr ImageVK::view(const ImgView::Desc& desc) {
-  return ImgView::Ptr(new ImgViewVK(*this, desc));
+  for (const auto& v : views_) {
+    if (v->levels() == desc.levels && v->layers() == desc.layers &&
+        v->dimension() == desc.dimension)
+      return v;
+  }
+
+  auto view = make_shared<ImgViewVK>(*this, desc);
+
+  if (views_.size() >= viewLimit_) {
+    // Drop views that only the cache refers to
+    views_.erase(remove_if(views_.begin(), views_.end(),
+                           [](const auto& v) { return v.use_count() == 1; }),
+                 views_.end());
+  }
+  views_.push_back(view);
+
+  return view;
 }
 
 void ImageVK::write(uint32_t plane, Origin3 origin, uint32_t level,
@@ -296,15 +350,22 @@ void ImageVK::write(uint32_t plane, Origin3 origin, uint32_t level,
     break;
   }
 
+  // Block-compressed data is written in whole blocks
   const auto txSz = texelSize();
+  const auto blkSz = blockSize();
+  if (origin.x % blkSz.width != 0 || origin.y % blkSz.height != 0)
+    throw invalid_argument("ImageVK write() origin not block-aligned");
+  const auto blkCols = (size.width + blkSz.width - 1) / blkSz.width;
+  const auto blkRows = (size.height + blkSz.height - 1) / blkSz.height;
 
   if (tiling_ == VK_IMAGE_TILING_LINEAR) {
     // For linear tiling, just query subresource layout and then write
     // contents to memory (through `data_` pointer) directly
 
     // Must be host-visible
-    if (layout_ != VK_IMAGE_LAYOUT_PREINITIALIZED &&
-        layout_ != VK_IMAGE_LAYOUT_GENERAL)
+    const auto lay = layout().first;
+    if (lay != VK_IMAGE_LAYOUT_PREINITIALIZED &&
+        lay != VK_IMAGE_LAYOUT_GENERAL)
       changeLayout(VK_IMAGE_LAYOUT_GENERAL, false);
 
     const auto dev = deviceVK().device();
@@ -322,25 +383,25 @@ void ImageVK::write(uint32_t plane, Origin3 origin, uint32_t level,
                           layout.depthPitch :
                           layout.arrayPitch;
 
-    const auto rowSz = size.width * txSz;
+    const auto rowSz = blkCols * txSz;
 
     if (bytesPerRow == 0)
       bytesPerRow = rowSz;
     if (rowsPerSlice == 0)
-      rowsPerSlice = size.height;
+      rowsPerSlice = blkRows;
 
     // Write data to each selected slice, row by row
     for (uint32_t i = 0; i < size.depthOrLayers; i++) {
       auto dst = reinterpret_cast<char*>(data_) +
                  layout.offset +
-                 origin.x * txSz +
-                 origin.y * layout.rowPitch +
+                 origin.x / blkSz.width * txSz +
+                 origin.y / blkSz.height * layout.rowPitch +
                  (origin.z + i) * slcPitch;
 
       auto src = reinterpret_cast<const char*>(data) +
                  bytesPerRow * rowsPerSlice * i;
 
-      for (uint32_t row = 0; row < size.height; row++) {
+      for (uint32_t row = 0; row < blkRows; row++) {
         memcpy(dst, src, rowSz);
         dst += layout.rowPitch;
         src += bytesPerRow;
@@ -349,14 +410,168 @@ void ImageVK::write(uint32_t plane, Origin3 origin, uint32_t level,
 
   } else {
     // For optimal tiling, write the data to a staging buffer and then
-    // issue a buffer-to-image copy command
+    // issue a buffer-to-image copy command - copies are batched by the
+    // upload scheduler and execute before the next submission
+
+    const auto rowSz = blkCols * txSz;
+    const uint64_t slcSz = static_cast<uint64_t>(rowSz) * blkRows;
+
+    if (bytesPerRow == 0)
+      bytesPerRow = rowSz;
+    if (rowsPerSlice == 0)
+      rowsPerSlice = blkRows;
+
+    // Buffer offsets must be a multiple of both the texel size and four
+    auto& staging = deviceVK().staging();
+    const auto range = staging.acquire(slcSz * size.depthOrLayers,
+                                       lcm<uint64_t>(txSz, 4));
+    auto stg = range.buffer;
+
+    // Staged data is tightly packed
+    if (bytesPerRow == rowSz && rowsPerSlice == blkRows) {
+      stg->write(range.offset, data, range.size);
+    } else {
+      for (uint32_t i = 0; i < size.depthOrLayers; i++) {
+        auto src = reinterpret_cast<const char*>(data) +
+                   bytesPerRow * rowsPerSlice * i;
+        for (uint32_t row = 0; row < blkRows; row++) {
+          stg->write(range.offset + slcSz * i + rowSz * row, src, rowSz);
+          src += bytesPerRow;
+        }
+      }
+    }
 
-    // TODO
-    throw runtime_error("ImageVK::write() WIP");
+    VkBufferImageCopy region;
+    region.bufferOffset = range.offset;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+    region.imageSubresource.aspectMask = aspFlg;
+    region.imageSubresource.mipLevel = level;
+    if (dimension() == Dim3) {
+      region.imageSubresource.baseArrayLayer = 0;
+      region.imageSubresource.layerCount = 1;
+      region.imageOffset = {static_cast<int32_t>(origin.x),
+                            static_cast<int32_t>(origin.y),
+                            static_cast<int32_t>(origin.z)};
+      region.imageExtent = {size.width, size.height, size.depthOrLayers};
+    } else {
+      region.imageSubresource.baseArrayLayer = origin.z;
+      region.imageSubresource.layerCount = size.depthOrLayers;
+      region.imageOffset = {static_cast<int32_t>(origin.x),
+                            static_cast<int32_t>(origin.y), 0};
+      region.imageExtent = {size.width, size.height, 1};
+    }
+
+    // Copies must satisfy the transfer granularity of the queue, which
+    // is given in texel blocks
+    auto& upload = deviceVK().upload();
+    auto blocks = [&](uint32_t texels, uint32_t blkDim) {
+      return (texels + blkDim - 1) / blkDim;
+    };
+    const VkOffset3D blkOffset{
+      static_cast<int32_t>(region.imageOffset.x / blkSz.width),
+      static_cast<int32_t>(region.imageOffset.y / blkSz.height),
+      region.imageOffset.z};
+    const VkExtent3D blkExtent{blocks(region.imageExtent.width, blkSz.width),
+                               blocks(region.imageExtent.height,
+                                      blkSz.height),
+                               region.imageExtent.depth};
+    const VkExtent3D levelExtent{
+      blocks(max(this->size().width >> level, 1U), blkSz.width),
+      blocks(max(this->size().height >> level, 1U), blkSz.height),
+      dimension() == Dim3 ? max(this->size().depthOrLayers >> level, 1U) : 1};
+    const bool granular = upload.isGranular(blkOffset, blkExtent, levelExtent);
+    auto& queue = upload.queue(granular);
+
+    unique_lock<mutex> lock(mutex_);
+
+    // Priority command buffers of newer threads are submitted first, so
+    // a transition pending elsewhere must be submitted before the copy
+    // is recorded - a pending transition to a layout other than general
+    // is submitted as well, so the barrier below starts from `layout_`
+    while (layout_ != nextLayout_ &&
+           (layoutThread_ != this_thread::get_id() ||
+            layoutQueue_ != &queue ||
+            nextLayout_ != VK_IMAGE_LAYOUT_GENERAL)) {
+      auto layQueue = layoutQueue_;
+      lock.unlock();
+      layQueue->submit();
+      lock.lock();
+    }
+
+    // The transition and the copy are recorded together, so they are
+    // submitted in order
+    const bool transition = nextLayout_ != VK_IMAGE_LAYOUT_GENERAL;
+    VkImageMemoryBarrier barrier;
+    if (transition) {
+      barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+      barrier.pNext = nullptr;
+      barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+      barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT |
+                              VK_ACCESS_MEMORY_READ_BIT;
+      // Previous contents are discarded if the layout is undefined
+      barrier.oldLayout = layout_;
+      barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+      barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.image = handle_;
+      barrier.subresourceRange.aspectMask = aspectOfVK(format());
+      barrier.subresourceRange.baseMipLevel = 0;
+      barrier.subresourceRange.levelCount = levels();
+      barrier.subresourceRange.baseArrayLayer = 0;
+      barrier.subresourceRange.layerCount = dimension() == Dim3 ?
+                                            1 : this->size().depthOrLayers;
+    }
+
+    try {
+      upload.encode([&](VkCommandBuffer cbuf) {
+        if (transition) {
+          encodeLayout(cbuf, barrier);
+          nextLayout_ = VK_IMAGE_LAYOUT_GENERAL;
+          layoutThread_ = this_thread::get_id();
+          layoutQueue_ = &queue;
+        }
+
+        // Copies recorded in a previous priority command buffer were
+        // submitted already
+        if (cbuf != pendingCmd_ || pendingCopies_ == 0) {
+          pendingCmd_ = cbuf;
+          pendingLevels_ = 0;
+        }
+
+        // Copies to the same level must not overlap
+        if (pendingLevels_ & (1U << level)) {
+          VkMemoryBarrier barrier;
+          barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+          barrier.pNext = nullptr;
+          barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+          barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+          vkCmdPipelineBarrier(cbuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                               VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier,
+                               0, nullptr, 0, nullptr);
+        }
+        pendingLevels_ |= 1U << level;
+
+        vkCmdCopyBufferToImage(cbuf, stg->handle(), handle_,
+                               VK_IMAGE_LAYOUT_GENERAL, 1, &region);
+        pendingCopies_++;
+      }, [this, range, transition](bool result) {
+        deviceVK().staging().release(range);
+        if (transition)
+          layoutDone(result);
+        pendingCopies_--;
+      }, granular);
+    } catch (...) {
+      staging.release(range);
+      throw;
+    }
   }
 }
 
-void ImageVK::changeLayout(VkImageLayout newLayout, bool defer) {
+void ImageVK::changeLayout(VkImageLayout newLayout, bool defer,
+                           QueueVK* queue) {
+  unique_lock<mutex> lock(mutex_);
+
   if (nextLayout_ == newLayout)
     return;
 
@@ -379,43 +594,61 @@ void ImageVK::changeLayout(VkImageLayout newLayout, bool defer) {
   barrier.subresourceRange.baseArrayLayer = 0;
   barrier.subresourceRange.layerCount = size().depthOrLayers; // XXX: 3D
 
-  barrier_ = barrier;
-  changeLayout(defer);
+  if (!queue)
+    queue = static_cast<QueueVK*>(&deviceVK().defaultQueue());
+  changeLayout(barrier, queue);
+
+  // Completion handlers lock the image
+  lock.unlock();
+  if (!defer)
+    queue->submit();
 }
 
-void ImageVK::changeLayout(const VkImageMemoryBarrier& barrier, bool defer) {
+void ImageVK::changeLayout(const VkImageMemoryBarrier& barrier, bool defer,
+                           QueueVK* queue) {
+  unique_lock<mutex> lock(mutex_);
+
   if (nextLayout_ == barrier.newLayout)
     return;
 
   if (layout_ != nextLayout_)
     throw runtime_error("Multiple layout transitions requested");
 
-  barrier_ = barrier;
-  changeLayout(defer);
+  if (!queue)
+    queue = static_cast<QueueVK*>(&deviceVK().defaultQueue());
+  changeLayout(barrier, queue);
+
+  lock.unlock();
+  if (!defer)
+    queue->submit();
 }
 
-void ImageVK::changeLayout(bool defer) {
-  nextLayout_ = barrier_.newLayout;
+void ImageVK::changeLayout(const VkImageMemoryBarrier& barrier,
+                           QueueVK* queue) {
+  queue->encodePriority(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                        [&](VkCommandBuffer cbuf) {
+    encodeLayout(cbuf, barrier);
+  }, [this](bool result) {
+    layoutDone(result);
+  });
 
-  // TODO: Needs improvement
-  VkPipelineStageFlags srcMask = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-  VkPipelineStageFlags dstMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+  nextLayout_ = barrier.newLayout;
+  layoutThread_ = this_thread::get_id();
+  layoutQueue_ = queue;
+}
 
-  auto& queue = static_cast<QueueVK&>(deviceVK().defaultQueue());
-  auto cbuf = queue.getPriority(dstMask, [&](bool result) {
-    if (result)
-      layout_ = nextLayout_;
-    else
-      nextLayout_ = layout_;
-  });
+void ImageVK::layoutDone(bool result) {
+  lock_guard<mutex> lock(mutex_);
 
-  vkCmdPipelineBarrier(cbuf, srcMask, dstMask, 0, 0, nullptr, 0, nullptr,
-                       1, &barrier_);
-  if (!defer)
-    queue.submit();
+  if (result)
+    layout_ = nextLayout_;
+  else
+    nextLayout_ = layout_;
 }
 
 void ImageVK::layoutChanged(VkImageLayout newLayout) {
+  lock_guard<mutex> lock(mutex_);
+
   if (layout_ != nextLayout_)
     throw runtime_error("Bad layout transition");
 
@@ -427,6 +660,7 @@ VkImage ImageVK::handle() {
 }
 
 pair<VkImageLayout, VkImageLayout> ImageVK::layout() const {
+  lock_guard<mutex> lock(mutex_);
   return {layout_, nextLayout_};
 }
 
@@ -527,7 +761,12 @@ ImgViewVK::ImgViewVK(ImageVK& image, const ImgView::Desc& desc)
 }
 
 ImgViewVK::~ImgViewVK() {
+  invalidate();
+}
+
+void ImgViewVK::invalidate() {
   vkDestroyImageView(deviceVK().device(), handle_, nullptr);
+  handle_ = VK_NULL_HANDLE;
 }
 
 VkImageView ImgViewVK::handle() {
@@ -9,12 +9,20 @@
 #define YF_CG_IMAGEVK_H
 
 #include <stdexcept>
+#include <memory>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
 
 #include "Image.h"
 #include "VK.h"
 
 CG_NS_BEGIN
 
+class ImgViewVK;
+class QueueVK;
+
 class ImageVK final : public Image {
  public:
   ImageVK(const Desc& desc);
@@ -30,6 +38,8 @@ class ImageVK final : public Image {
 
   ~ImageVK();
 
+  /// Views are cached by the image and destroyed along with it.
+  ///
   ImgView::Ptr view(const ImgView::Desc& desc);
 
   void write(uint32_t plane, Origin3 origin, uint32_t level,
@@ -38,12 +48,16 @@ class ImageVK final : public Image {
 
   /// Performs a layout transition.
   ///
-  void changeLayout(VkImageLayout newLayout, bool defer);
-  void changeLayout(const VkImageMemoryBarrier& barrier, bool defer);
+  /// The transition is encoded in `queue`, or in the default queue if
+  /// `queue` is null.
+  ///
+  void changeLayout(VkImageLayout newLayout, bool defer,
+                    QueueVK* queue = nullptr);
+  void changeLayout(const VkImageMemoryBarrier& barrier, bool defer,
+                    QueueVK* queue = nullptr);
 
   /// Notifies the image that it has transitioned to a new layout.
   ///
-  // TODO: This should be atomic
   void layoutChanged(VkImageLayout newLayout);
 
   /// Getters.
@@ -60,11 +74,33 @@ class ImageVK final : public Image {
   VkImage handle_ = VK_NULL_HANDLE;
   void* data_ = nullptr;
 
+  /// Layout state, which completion handlers update from the thread
+  /// that submits. A pending transition is recorded in the priority
+  /// command buffer of `layoutThread_` in `layoutQueue_`.
+  ///
+  mutable std::mutex mutex_{};
   VkImageLayout layout_ = VK_IMAGE_LAYOUT_UNDEFINED;
   VkImageLayout nextLayout_ = VK_IMAGE_LAYOUT_UNDEFINED;
-  VkImageMemoryBarrier barrier_{};
+  std::thread::id layoutThread_{};
+  QueueVK* layoutQueue_ = nullptr;
+
+  /// Mask of levels with staged copies recorded in `pendingCmd_`, and
+  /// number of staged copies yet to complete.
+  ///
+  uint32_t pendingLevels_ = 0;
+  VkCommandBuffer pendingCmd_ = VK_NULL_HANDLE;
+  std::atomic<uint32_t> pendingCopies_{0};
+
+  /// Views created by `view()`.
+  ///
+  /// Entries not referenced elsewhere are only dropped when the cache
+  /// grows past `viewLimit_`, so views rebound every frame are kept.
+  ///
+  std::vector<std::shared_ptr<ImgViewVK>> views_{};
+  static constexpr size_t viewLimit_ = 16;
 
-  void changeLayout(bool);
+  void changeLayout(const VkImageMemoryBarrier&, QueueVK*);
+  void layoutDone(bool result);
 };
 
 class ImgViewVK final : public ImgView {
@@ -72,6 +108,13 @@ class ImgViewVK final : public ImgView {
   ImgViewVK(ImageVK& image, const ImgView::Desc& desc);
   ~ImgViewVK();
 
+  /// Destroys the view object.
+  ///
+  /// This is called when the image is destroyed. The handle will be
+  /// null afterwards.
+  ///
+  void invalidate();
+
   /// Getter.
   ///
   VkImageView handle();
@@ -134,6 +177,17 @@ inline VkFormat toFormatVK(Format format) {
   case Format::D24UnormS8: return VK_FORMAT_D24_UNORM_S8_UINT;
   case Format::D32FloatS8: return VK_FORMAT_D32_SFLOAT_S8_UINT;
 
+  case Format::Bc1Unorm: return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+  case Format::Bc1Srgb:  return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+  case Format::Bc3Unorm: return VK_FORMAT_BC3_UNORM_BLOCK;
+  case Format::Bc3Srgb:  return VK_FORMAT_BC3_SRGB_BLOCK;
+  case Format::Bc4Unorm: return VK_FORMAT_BC4_UNORM_BLOCK;
+  case Format::Bc4Norm:  return VK_FORMAT_BC4_SNORM_BLOCK;
+  case Format::Bc5Unorm: return VK_FORMAT_BC5_UNORM_BLOCK;
+  case Format::Bc5Norm:  return VK_FORMAT_BC5_SNORM_BLOCK;
+  case Format::Bc7Unorm: return VK_FORMAT_BC7_UNORM_BLOCK;
+  case Format::Bc7Srgb:  return VK_FORMAT_BC7_SRGB_BLOCK;
+
   default:
     throw std::invalid_argument(__func__);
   }
@@ -190,6 +244,17 @@ inline Format fromFormatVK(VkFormat format) {
   case VK_FORMAT_D24_UNORM_S8_UINT:  return Format::D24UnormS8;
   case VK_FORMAT_D32_SFLOAT_S8_UINT: return Format::D32FloatS8;
 
+  case VK_FORMAT_BC1_RGBA_UNORM_BLOCK: return Format::Bc1Unorm;
+  case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:  return Format::Bc1Srgb;
+  case VK_FORMAT_BC3_UNORM_BLOCK:      return Format::Bc3Unorm;
+  case VK_FORMAT_BC3_SRGB_BLOCK:       return Format::Bc3Srgb;
+  case VK_FORMAT_BC4_UNORM_BLOCK:      return Format::Bc4Unorm;
+  case VK_FORMAT_BC4_SNORM_BLOCK:      return Format::Bc4Norm;
+  case VK_FORMAT_BC5_UNORM_BLOCK:      return Format::Bc5Unorm;
+  case VK_FORMAT_BC5_SNORM_BLOCK:      return Format::Bc5Norm;
+  case VK_FORMAT_BC7_UNORM_BLOCK:      return Format::Bc7Unorm;
+  case VK_FORMAT_BC7_SRGB_BLOCK:       return Format::Bc7Srgb;
+
   case VK_FORMAT_UNDEFINED:
   default:
     return Format::Undefined;
@@ -283,6 +348,16 @@ inline VkImageAspectFlags aspectOfVK(Format format) {
   case Format::Rgba32Uint:
   case Format::Rgba32Int:
   case Format::Rgba32Float:
+  case Format::Bc1Unorm:
+  case Format::Bc1Srgb:
+  case Format::Bc3Unorm:
+  case Format::Bc3Srgb:
+  case Format::Bc4Unorm:
+  case Format::Bc4Norm:
+  case Format::Bc5Unorm:
+  case Format::Bc5Norm:
+  case Format::Bc7Unorm:
+  case Format::Bc7Srgb:
     return VK_IMAGE_ASPECT_COLOR_BIT;
 
   case Format::D16Unorm:
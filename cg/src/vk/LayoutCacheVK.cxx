@@ -0,0 +1,175 @@
+//
+// CG
+// LayoutCacheVK.cxx
+//
+// Copyright © 2023 Gustavo C. Viegas.
+//
+
+#include <cassert>
+#include <algorithm>
+#include <functional>
+
+#include "LayoutCacheVK.h"
+#include "DeviceVK.h"
+#include "yf/Except.h"
+
+using namespace CG_NS;
+using namespace std;
+
+INTERNAL_NS_BEGIN
+
+/// Combines a value into a hash.
+///
+inline void combineHash(size_t& h, size_t x) {
+  h ^= x + 0x9e3779b9 + (h << 6) + (h >> 2);
+}
+
+INTERNAL_NS_END
+
+bool LayoutCacheVK::DsKey::operator==(const DsKey& other) const {
+  return equal(entries.begin(), entries.end(),
+               other.entries.begin(), other.entries.end(),
+               [](const auto& a, const auto& b) {
+                 return a.id == b.id && a.type == b.type &&
+                        a.elements == b.elements;
+               });
+}
+
+size_t LayoutCacheVK::DsKeyHash::operator()(const DsKey& key) const {
+  size_t h = 0;
+  for (const auto& e : key.entries) {
+    combineHash(h, e.id);
+    combineHash(h, e.type);
+    combineHash(h, e.elements);
+  }
+  return h;
+}
+
+bool LayoutCacheVK::PlKey::operator==(const PlKey& other) const {
+  return dsLayouts == other.dsLayouts &&
+         equal(pcRanges.begin(), pcRanges.end(),
+               other.pcRanges.begin(), other.pcRanges.end(),
+               [](const auto& a, const auto& b) {
+                 return a.stageFlags == b.stageFlags &&
+                        a.offset == b.offset && a.size == b.size;
+               });
+}
+
+size_t LayoutCacheVK::PlKeyHash::operator()(const PlKey& key) const {
+  size_t h = 0;
+  for (const auto& l : key.dsLayouts)
+    combineHash(h, hash<VkDescriptorSetLayout>()(l));
+  for (const auto& r : key.pcRanges) {
+    combineHash(h, r.stageFlags);
+    combineHash(h, r.offset);
+    combineHash(h, r.size);
+  }
+  return h;
+}
+
+LayoutCacheVK::DsRef
+LayoutCacheVK::dsLayout(const vector<DcEntry>& entries,
+                        const VkDescriptorSetLayoutCreateInfo& info) {
+
+  assert(is_sorted(entries.begin(), entries.end(),
+                   [](auto& a, auto& b) { return a.id < b.id; }));
+  assert(info.bindingCount == entries.size());
+
+  const DsKey key{entries};
+
+  lock_guard<mutex> lock(mutex_);
+
+  auto& entry = dsLayouts_[key];
+  if (auto ref = entry.lock())
+    return ref;
+
+  VkDescriptorSetLayout handle;
+  const auto res = vkCreateDescriptorSetLayout(deviceVK().device(), &info,
+                                               nullptr, &handle);
+  if (res != VK_SUCCESS) {
+    dsLayouts_.erase(key);
+    throw DeviceExcept("Could not create descriptor set layout");
+  }
+
+  DsRef ref(new VkDescriptorSetLayout(handle),
+            [](const VkDescriptorSetLayout* p) {
+    vkDestroyDescriptorSetLayout(deviceVK().device(), *p, nullptr);
+    delete p;
+  });
+  entry = ref;
+
+  if (dsLayouts_.size() + plLayouts_.size() >= pruneSize_)
+    prune();
+
+  return ref;
+}
+
+LayoutCacheVK::PlRef
+LayoutCacheVK::plLayout(const vector<DsRef>& dsLayouts,
+                        const vector<VkPushConstantRange>& pcRanges) {
+
+  PlKey key{{}, pcRanges};
+  for (const auto& l : dsLayouts)
+    key.dsLayouts.push_back(*l);
+
+  lock_guard<mutex> lock(mutex_);
+
+  auto& entry = plLayouts_[key];
+  if (auto ref = entry.lock())
+    return ref;
+
+  VkPipelineLayoutCreateInfo info;
+  info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  info.pNext = nullptr;
+  info.flags = 0;
+  info.setLayoutCount = key.dsLayouts.size();
+  info.pSetLayouts = key.dsLayouts.data();
+  info.pushConstantRangeCount = pcRanges.size();
+  info.pPushConstantRanges = pcRanges.data();
+
+  VkPipelineLayout handle;
+  const auto res = vkCreatePipelineLayout(deviceVK().device(), &info,
+                                          nullptr, &handle);
+  if (res != VK_SUCCESS) {
+    plLayouts_.erase(key);
+    throw DeviceExcept("Could not create pipeline layout");
+  }
+
+  // The set layouts are kept alive so their handles stay unique among
+  // the keys of live pipeline layouts
+  PlRef ref(new VkPipelineLayout(handle),
+            [dsLayouts](const VkPipelineLayout* p) {
+    vkDestroyPipelineLayout(deviceVK().device(), *p, nullptr);
+    delete p;
+  });
+  entry = ref;
+
+  if (dsLayouts_.size() + plLayouts_.size() >= pruneSize_)
+    prune();
+
+  return ref;
+}
+
+size_t LayoutCacheVK::size() const {
+  lock_guard<mutex> lock(mutex_);
+  auto live = [](const auto& l) { return !l.second.expired(); };
+  return count_if(dsLayouts_.begin(), dsLayouts_.end(), live) +
+         count_if(plLayouts_.begin(), plLayouts_.end(), live);
+}
+
+void LayoutCacheVK::prune() {
+  // Entries of destroyed layouts are only removed here
+  for (auto it = dsLayouts_.begin(); it != dsLayouts_.end();) {
+    if (it->second.expired())
+      it = dsLayouts_.erase(it);
+    else
+      ++it;
+  }
+  for (auto it = plLayouts_.begin(); it != plLayouts_.end();) {
+    if (it->second.expired())
+      it = plLayouts_.erase(it);
+    else
+      ++it;
+  }
+  pruneSize_ = max<size_t>(64, (dsLayouts_.size() + plLayouts_.size()) << 1);
+}
@@ -0,0 +1,97 @@
+//
+// CG
+// LayoutCacheVK.h
+//
+// Copyright © 2023 Gustavo C. Viegas.
+//
+
+#ifndef YF_CG_LAYOUTCACHEVK_H
+#define YF_CG_LAYOUTCACHEVK_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+
+#include "DcTable.h"
+#include "VK.h"
+
+CG_NS_BEGIN
+
+/// Cache of descriptor set layouts and pipeline layouts.
+///
+/// Layouts are looked up by their contents, so tables with equal entries
+/// share one `VkDescriptorSetLayout` and states with equal tables and
+/// push constant ranges share one `VkPipelineLayout`. This makes such
+/// pipeline layouts compatible for descriptor set binding. A layout is
+/// destroyed when its last reference goes away. The cache can be used
+/// from multiple threads.
+///
+class LayoutCacheVK {
+ public:
+  /// Shared reference to a descriptor set layout.
+  ///
+  using DsRef = std::shared_ptr<const VkDescriptorSetLayout>;
+
+  /// Shared reference to a pipeline layout.
+  ///
+  using PlRef = std::shared_ptr<const VkPipelineLayout>;
+
+  LayoutCacheVK() = default;
+  LayoutCacheVK(const LayoutCacheVK&) = delete;
+  LayoutCacheVK& operator=(const LayoutCacheVK&) = delete;
+  ~LayoutCacheVK() = default;
+
+  /// Gets a descriptor set layout matching the given entries.
+  ///
+  /// `entries` must be sorted by id and `info` must have been created
+  /// from them.
+  ///
+  DsRef dsLayout(const std::vector<DcEntry>& entries,
+                 const VkDescriptorSetLayoutCreateInfo& info);
+
+  /// Gets a pipeline layout matching the given set layouts and push
+  /// constant ranges.
+  ///
+  PlRef plLayout(const std::vector<DsRef>& dsLayouts,
+                 const std::vector<VkPushConstantRange>& pcRanges);
+
+  /// Gets the number of layouts created and not yet destroyed.
+  ///
+  size_t size() const;
+
+ private:
+  struct DsKey {
+    std::vector<DcEntry> entries;
+
+    bool operator==(const DsKey& other) const;
+  };
+
+  struct DsKeyHash {
+    size_t operator()(const DsKey& key) const;
+  };
+
+  struct PlKey {
+    std::vector<VkDescriptorSetLayout> dsLayouts;
+    std::vector<VkPushConstantRange> pcRanges;
+
+    bool operator==(const PlKey& other) const;
+  };
+
+  struct PlKeyHash {
+    size_t operator()(const PlKey& key) const;
+  };
+
+  std::unordered_map<DsKey, std::weak_ptr<const VkDescriptorSetLayout>,
+                     DsKeyHash> dsLayouts_{};
+  std::unordered_map<PlKey, std::weak_ptr<const VkPipelineLayout>,
+                     PlKeyHash> plLayouts_{};
+  size_t pruneSize_ = 64;
+  mutable std::mutex mutex_{};
+  void prune();
+};
+
+CG_NS_END
+
+#endif // YF_CG_LAYOUTCACHEVK_H
@@ -0,0 +1,60 @@
+//
+// CG
+// QueryVK.cxx
+//
+// Copyright © 2023 Gustavo C. Viegas.
+//
+
+#include "QueryVK.h"
+#include "DeviceVK.h"
+#include "yf/Except.h"
+
+using namespace CG_NS;
+using namespace std;
+
+QueryPoolVK::QueryPoolVK(const Desc& desc) : QueryPool(desc) {
+  auto& dev = deviceVK();
+
+  if (type() == Statistics && !dev.features().pipelineStatisticsQuery)
+    throw UnsupportedExcept("Pipeline statistics queries not supported");
+
+  VkQueryPoolCreateInfo info;
+  info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  info.pNext = nullptr;
+  info.flags = 0;
+  info.queryType = toQueryTypeVK(type());
+  info.queryCount = count();
+  info.pipelineStatistics = toPipelineStatisticsVK(statisticMask());
+
+  if (vkCreateQueryPool(dev.device(), &info, nullptr, &handle_) != VK_SUCCESS)
+    throw DeviceExcept("Could not create query pool");
+}
+
+QueryPoolVK::~QueryPoolVK() {
+  vkDestroyQueryPool(deviceVK().device(), handle_, nullptr);
+}
+
+bool QueryPoolVK::read(uint32_t first, uint32_t count, uint64_t* results) {
+  if (count == 0 || first >= this->count() || count > this->count() - first)
+    throw invalid_argument("QueryPool read() invalid range");
+
+  const VkDeviceSize stride = resultCount() * sizeof(uint64_t);
+  const size_t size = stride * count;
+
+  // Without the wait flag, this never blocks
+  auto res = vkGetQueryPoolResults(deviceVK().device(), handle_, first, count,
+                                   size, results, stride,
+                                   VK_QUERY_RESULT_64_BIT);
+  switch (res) {
+  case VK_SUCCESS:
+    return true;
+  case VK_NOT_READY:
+    return false;
+  default:
+    throw DeviceExcept("Could not get query pool results");
+  }
+}
+
+VkQueryPool QueryPoolVK::handle() {
+  return handle_;
+}
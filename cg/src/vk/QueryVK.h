@@ -0,0 +1,69 @@
+//
+// CG
+// QueryVK.h
+//
+// Copyright © 2023 Gustavo C. Viegas.
+//
+
+#ifndef YF_CG_QUERYVK_H
+#define YF_CG_QUERYVK_H
+
+#include <stdexcept>
+
+#include "Query.h"
+#include "VK.h"
+
+CG_NS_BEGIN
+
+class QueryPoolVK final : public QueryPool {
+ public:
+  QueryPoolVK(const Desc& desc);
+  ~QueryPoolVK();
+
+  bool read(uint32_t first, uint32_t count, uint64_t* results);
+
+  /// Getter.
+  ///
+  VkQueryPool handle();
+
+ private:
+  VkQueryPool handle_ = VK_NULL_HANDLE;
+};
+
+/// Converts from a `QueryPool::Type` value.
+///
+inline VkQueryType toQueryTypeVK(QueryPool::Type type) {
+  switch (type) {
+  case QueryPool::Timestamp:  return VK_QUERY_TYPE_TIMESTAMP;
+  case QueryPool::Occlusion:  return VK_QUERY_TYPE_OCCLUSION;
+  case QueryPool::Statistics: return VK_QUERY_TYPE_PIPELINE_STATISTICS;
+  default:
+    throw std::invalid_argument(__func__);
+  }
+}
+
+/// Converts from a `QueryPool::StatisticMask` value.
+///
+inline VkQueryPipelineStatisticFlags
+toPipelineStatisticsVK(QueryPool::StatisticMask mask) {
+  VkQueryPipelineStatisticFlags flags = 0;
+  if (mask & QueryPool::InputVertices)
+    flags |= VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT;
+  if (mask & QueryPool::InputPrimitives)
+    flags |= VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT;
+  if (mask & QueryPool::VertexInvocations)
+    flags |= VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT;
+  if (mask & QueryPool::ClippingInvocations)
+    flags |= VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT;
+  if (mask & QueryPool::ClippingPrimitives)
+    flags |= VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT;
+  if (mask & QueryPool::FragmentInvocations)
+    flags |= VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+  if (mask & QueryPool::ComputeInvocations)
+    flags |= VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+  return flags;
+}
+
+CG_NS_END
+
+#endif // YF_CG_QUERYVK_H
@@ -8,6 +8,8 @@
 #include <cstdlib>
 #include <stdexcept>
 #include <cassert>
+#include <algorithm>
+#include <iterator>
 
 #include "QueueVK.h"
 #include "DeviceVK.h"
@@ -15,6 +17,9 @@
 #include "DcTableVK.h"
 #include "PassVK.h"
 #include "StateVK.h"
+#include "ShaderVK.h"
+#include "UploadVK.h"
+#include "QueryVK.h"
 #include "Cmd.h"
 #include "Encoder.h"
 #include "yf/Except.h"
@@ -22,12 +27,165 @@
 using namespace CG_NS;
 using namespace std;
 
+INTERNAL_NS_BEGIN
+
+/// Checks whether a push constants update lies within the state's ranges.
+///
+bool isValidConstCmd(const ConstCmd& cmd, const vector<ConstRange>& ranges) {
+  const uint32_t size = cmd.data.size();
+  if (size == 0 || size % 4 != 0 || cmd.offset % 4 != 0)
+    return false;
+
+  // Every stage being updated must have a range covering the update
+  StageMask mask = 0;
+  for (const auto& r : ranges) {
+    if (cmd.offset >= r.offset && cmd.offset + size <= r.offset + r.size)
+      mask |= r.stageMask;
+  }
+  return cmd.stageMask != 0 && (cmd.stageMask & mask) == cmd.stageMask;
+}
+
+/// Descriptor sets bound in a command buffer.
+///
+/// Pipeline layouts that share set layouts and push constant ranges are
+/// compatible, so switching between them keeps bound sets valid and
+/// binding the same set again can be skipped.
+///
+class BoundSets {
+ public:
+  /// Notifies that a pipeline was bound.
+  ///
+  void setLayout(const vector<DcTable*>& dcTables,
+                 const vector<ConstRange>& constRanges) {
+    const bool sameRanges =
+      equal(constRanges.begin(), constRanges.end(),
+            constRanges_.begin(), constRanges_.end(),
+            [](const auto& a, const auto& b) {
+              return a.stageMask == b.stageMask && a.offset == b.offset &&
+                     a.size == b.size;
+            });
+
+    // Sets past the first incompatible one are disturbed
+    size_t i = 0;
+    if (sameRanges) {
+      const auto n = min(dcTables.size(), bindings_.size());
+      while (i < n && bindings_[i].layout ==
+                      static_cast<DcTableVK*>(dcTables[i])->dsLayout())
+        i++;
+    }
+    bindings_.resize(i);
+
+    for (; i < dcTables.size(); i++)
+      bindings_.push_back({static_cast<DcTableVK*>(dcTables[i])->dsLayout(),
+                           VK_NULL_HANDLE, {}});
+
+    constRanges_ = constRanges;
+  }
+
+  /// Records a set binding.
+  ///
+  /// Returns whether the set needs to be bound.
+  ///
+  bool bind(uint32_t index, VkDescriptorSet ds,
+            const vector<uint32_t>& dynamicOffsets) {
+    assert(index < bindings_.size());
+
+    auto& b = bindings_[index];
+    if (b.ds == ds && b.dynamicOffsets == dynamicOffsets)
+      return false;
+    b.ds = ds;
+    b.dynamicOffsets = dynamicOffsets;
+    return true;
+  }
+
+ private:
+  struct Binding {
+    VkDescriptorSetLayout layout;
+    VkDescriptorSet ds;
+    vector<uint32_t> dynamicOffsets;
+  };
+  vector<Binding> bindings_{};
+  vector<ConstRange> constRanges_{};
+};
+
+/// Checks whether a range of queries lies within a pool.
+///
+bool isValidQueryRange(const QueryPool& pool, uint32_t first, uint32_t count) {
+  return count != 0 && first < pool.count() && count <= pool.count() - first;
+}
+
+/// Queries active in a command buffer.
+///
+/// Only one query of each type can be active at a time, and queries
+/// begun in a render pass must end in it.
+///
+class ActiveQueries {
+ public:
+  /// Records the beginning of a query.
+  ///
+  void begin(const BeginQueryCmd& cmd, bool inPass) {
+    const auto type = cmd.pool.type();
+    if (type == QueryPool::Timestamp)
+      throw invalid_argument("beginQuery() cannot begin timestamp queries");
+    if (!isValidQueryRange(cmd.pool, cmd.index, 1))
+      throw invalid_argument("beginQuery() index out of range");
+
+    for (const auto& q : queries_) {
+      if (q.pool->type() == type)
+        throw invalid_argument("beginQuery() query of same type is active");
+    }
+    queries_.push_back({&cmd.pool, cmd.index, inPass});
+  }
+
+  /// Records the end of a query.
+  ///
+  void end(const EndQueryCmd& cmd, bool inPass) {
+    auto it = find_if(queries_.begin(), queries_.end(), [&](const auto& q) {
+      return q.pool == &cmd.pool && q.index == cmd.index;
+    });
+    if (it == queries_.end())
+      throw invalid_argument("endQuery() query is not active");
+    if (it->inPass != inPass)
+      throw invalid_argument("endQuery() query begun in another target");
+    queries_.erase(it);
+  }
+
+  /// Checks whether any query is active, optionally only in a pass.
+  ///
+  bool any(bool inPassOnly = false) const {
+    if (!inPassOnly)
+      return !queries_.empty();
+    return any_of(queries_.begin(), queries_.end(),
+                  [](const auto& q) { return q.inPass; });
+  }
+
+ private:
+  struct Query {
+    const QueryPool* pool;
+    uint32_t index;
+    bool inPass;
+  };
+  vector<Query> queries_{};
+};
+
+INTERNAL_NS_END
+
 //
 // QueueVK
 //
 
-QueueVK::QueueVK(VkQueue handle, int32_t family)
-  : handle_(handle), family_(family) {
+INTERNAL_NS_BEGIN
+
+/// Source of queue identifiers, which are never reused.
+///
+atomic<uint64_t> queueIds{1};
+
+INTERNAL_NS_END
+
+QueueVK::QueueVK(VkQueue handle, int32_t family,
+                 CapabilityMask capabilities)
+  : handle_(handle), family_(family), capabilities_(capabilities),
+    id_(queueIds++) {
 
   assert(handle != nullptr);
   assert(family > -1);
@@ -36,11 +194,22 @@ QueueVK::QueueVK(VkQueue handle, int32_t family)
 }
 
 QueueVK::~QueueVK() {
-  deinitPool(poolPrio_);
-  if (!pools_.empty()) {
-    // XXX: No command buffer shall outlive its queue
-    assert(false);
-    abort();
+  for (auto p = priorities_.load(); p;) {
+    auto next = p->next;
+    // This frees the priority command buffers
+    if (p->pool)
+      deinitPool(p->pool);
+    delete p;
+    p = next;
+  }
+  for (auto& p : pools_) {
+    if (p.second.live != 0) {
+      // XXX: No command buffer shall outlive its queue
+      assert(false);
+      abort();
+    }
+    // This frees the recycled command buffers
+    deinitPool(p.second.handle);
   }
 }
 
@@ -64,56 +233,144 @@ void QueueVK::deinitPool(VkCommandPool pool) {
   vkDestroyCommandPool(deviceVK().device(), pool, nullptr);
 }
 
-CmdBuffer::Ptr QueueVK::cmdBuffer() {
-  auto pool = initPool();
+CmdBuffer::Ptr QueueVK::make(bool secondary) {
+  Pool* pool;
+  {
+    lock_guard<mutex> lock(poolMutex_);
+    pool = &pools_[this_thread::get_id()];
+  }
 
-  VkCommandBufferAllocateInfo info;
-  info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-  info.pNext = nullptr;
-  info.commandPool = pool;
-  info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-  info.commandBufferCount = 1;
+  // Other threads only access the pool to recycle command buffers
+  lock_guard<mutex> lock(pool->mutex);
+  auto dev = deviceVK().device();
+
+  if (!pool->handle)
+    pool->handle = initPool();
+
+  if (pool->live == 0 && pool->dirty) {
+    if (vkResetCommandPool(dev, pool->handle, 0) != VK_SUCCESS)
+      throw DeviceExcept("Could not reset command pool");
+    pool->dirty = false;
+  }
 
+  auto& free = secondary ? pool->secondaries : pool->primaries;
   VkCommandBuffer handle;
-  auto res = vkAllocateCommandBuffers(deviceVK().device(), &info, &handle);
-  if (res != VK_SUCCESS) {
-    deinitPool(pool);
-    throw DeviceExcept("Could not allocate command buffer");
+
+  if (!free.empty()) {
+    handle = free.back();
+    if (pool->dirty && vkResetCommandBuffer(handle, 0) != VK_SUCCESS)
+      throw DeviceExcept("Could not reset command buffer");
+    free.pop_back();
+  } else {
+    VkCommandBufferAllocateInfo info;
+    info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    info.pNext = nullptr;
+    info.commandPool = pool->handle;
+    info.level = secondary ? VK_COMMAND_BUFFER_LEVEL_SECONDARY
+                           : VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    info.commandBufferCount = 1;
+
+    auto res = vkAllocateCommandBuffers(dev, &info, &handle);
+    if (res != VK_SUCCESS)
+      throw DeviceExcept("Could not allocate command buffer");
   }
 
-  auto it = pools_.emplace(new CmdBufferVK(*this, handle), pool).first;
-  return CmdBuffer::Ptr(it->first);
+  pool->live++;
+  return CmdBuffer::Ptr(new CmdBufferVK(*this, *pool, handle, secondary));
+}
+
+CmdBuffer::Ptr QueueVK::cmdBuffer() {
+  return make(false);
+}
+
+CmdBuffer::Ptr QueueVK::subBuffer() {
+  return make(true);
 }
 
 void QueueVK::submit() {
+  // Uploads encoded so far must be waited for
+  if (upload_)
+    upload_->flush();
+
+  lock_guard<mutex> lock(submitMutex_);
+
   auto dev = deviceVK().device();
   VkSemaphore sem = VK_NULL_HANDLE;
   VkResult res;
 
-  auto notifyAndClear = [&](bool result) {
-    semaphores_.clear();
-    stageMasks_.clear();
-    maskPrio_ = 0;
+  // Take the enqueued command buffers, restoring their enqueue order
+  vector<CmdBufferVK*> pending;
+  for (auto cb = pending_.exchange(nullptr, memory_order_acquire); cb;
+       cb = cb->next())
+    pending.push_back(cb);
+  reverse(pending.begin(), pending.end());
+
+  // Take the priority command buffers of every thread, so they can go
+  // on encoding while this submission executes
+  vector<VkCommandBuffer> prioHandles;
+  vector<function<void (bool)>> prioCallbacks;
+  VkPipelineStageFlags prioMask = 0;
+  bool prioFailed = false;
+  for (auto p = priorities_.load(memory_order_acquire); p; p = p->next) {
+    lock_guard<mutex> prioLock(p->mutex);
+    if (!p->pending)
+      continue;
+
+    if (vkEndCommandBuffer(p->handles[0]) == VK_SUCCESS)
+      prioHandles.push_back(p->handles[0]);
+    else
+      prioFailed = true;
+    prioMask |= p->stageMask;
+    move(p->callbacks.begin(), p->callbacks.end(),
+         back_inserter(prioCallbacks));
+
+    swap(p->handles[0], p->handles[1]);
+    p->stageMask = 0;
+    p->callbacks.clear();
+    p->pending = false;
+  }
+
+  vector<function<void (bool)>> callbacks;
+  vector<VkSemaphore> semaphores;
+  vector<VkPipelineStageFlags> stageMasks;
+  vector<VkSemaphore> signals;
+  {
+    lock_guard<mutex> complLock(completionMutex_);
+    callbacks.swap(callbacks_);
+    semaphores.swap(semaphores_);
+    stageMasks.swap(stageMasks_);
+    signals.swap(signals_);
+  }
+
+  auto notify = [&](bool result) {
     vkDestroySemaphore(dev, sem, nullptr);
 
-    for (auto& fn : callbsPrio_)
+    for (auto& fn : prioCallbacks)
       fn(result);
-    callbsPrio_.clear();
-    pendPrio_ = false;
 
-    for (auto& cb : pending_)
+    for (auto& cb : pending)
       cb->didExecute();
-    pending_.clear();
+
+    for (auto& fn : callbacks)
+      fn(result);
   };
 
-  if (pendPrio_) {
-    res = vkEndCommandBuffer(cmdPrio_);
-    if (res != VK_SUCCESS) {
-      notifyAndClear(false);
-      throw DeviceExcept("Could not end priority command buffer");
+  if (prioFailed) {
+    notify(false);
+    throw DeviceExcept("Could not end priority command buffer");
+  }
+
+  if (prioHandles.empty() && pending.empty() && signals.empty()) {
+    // Nothing to execute, but completion may still be expected
+    if (!semaphores.empty() || !callbacks.empty()) {
+      lock_guard<mutex> complLock(completionMutex_);
+      callbacks_.insert(callbacks_.begin(), callbacks.begin(),
+                        callbacks.end());
+      semaphores_.insert(semaphores_.begin(), semaphores.begin(),
+                         semaphores.end());
+      stageMasks_.insert(stageMasks_.begin(), stageMasks.begin(),
+                         stageMasks.end());
     }
-  } else if (pending_.empty()) {
-    // Nothing to do
     return;
   }
 
@@ -122,22 +379,22 @@ void QueueVK::submit() {
   uint32_t infoN = 0;
   vector<VkCommandBuffer> handles;
 
-  if (pendPrio_) {
+  if (!prioHandles.empty()) {
     infos[infoN].sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
     infos[infoN].pNext = nullptr;
     infos[infoN].waitSemaphoreCount = 0;
     infos[infoN].pWaitSemaphores = nullptr;
     infos[infoN].pWaitDstStageMask = nullptr;
-    infos[infoN].commandBufferCount = 1;
-    infos[infoN].pCommandBuffers = &cmdPrio_;
+    infos[infoN].commandBufferCount = prioHandles.size();
+    infos[infoN].pCommandBuffers = prioHandles.data();
     infos[infoN].signalSemaphoreCount = 0;
     infos[infoN].pSignalSemaphores = nullptr;
 
     infoN++;
   }
 
-  if (!pending_.empty()) {
-    for (const auto& cb : pending_)
+  if (!pending.empty()) {
+    for (const auto& cb : pending)
       handles.push_back(cb->handle());
 
     infos[infoN].sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -153,6 +410,21 @@ void QueueVK::submit() {
     infoN++;
   }
 
+  if (infoN == 0) {
+    // Only semaphores to signal
+    infos[0].sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    infos[0].pNext = nullptr;
+    infos[0].waitSemaphoreCount = 0;
+    infos[0].pWaitSemaphores = nullptr;
+    infos[0].pWaitDstStageMask = nullptr;
+    infos[0].commandBufferCount = 0;
+    infos[0].pCommandBuffers = nullptr;
+    infos[0].signalSemaphoreCount = 0;
+    infos[0].pSignalSemaphores = nullptr;
+
+    infoN++;
+  }
+
   // Sync. setup
   if (infoN == 2) {
     VkSemaphoreCreateInfo info;
@@ -162,7 +434,7 @@ void QueueVK::submit() {
 
     res = vkCreateSemaphore(dev, &info, nullptr, &sem);
     if (res != VK_SUCCESS) {
-      notifyAndClear(false);
+      notify(false);
       throw DeviceExcept("Could not create semaphore for queue submission");
     }
 
@@ -171,109 +443,156 @@ void QueueVK::submit() {
 
     infos[1].waitSemaphoreCount = 1;
     infos[1].pWaitSemaphores = &sem;
-    infos[1].pWaitDstStageMask = &maskPrio_;
+    infos[1].pWaitDstStageMask = &prioMask;
+  }
+
+  if (!semaphores.empty()) {
+    infos[0].waitSemaphoreCount = semaphores.size();
+    infos[0].pWaitSemaphores = semaphores.data();
+    infos[0].pWaitDstStageMask = stageMasks.data();
   }
 
-  if (!semaphores_.empty()) {
-    infos[0].waitSemaphoreCount = semaphores_.size();
-    infos[0].pWaitSemaphores = semaphores_.data();
-    infos[0].pWaitDstStageMask = stageMasks_.data();
+  if (!signals.empty()) {
+    infos[infoN-1].signalSemaphoreCount = signals.size();
+    infos[infoN-1].pSignalSemaphores = signals.data();
   }
 
   // Submit and wait completion
   res = vkQueueSubmit(handle_, infoN, infos, VK_NULL_HANDLE);
   if (res != VK_SUCCESS) {
-    notifyAndClear(false);
+    notify(false);
     throw DeviceExcept("Queue submission failed");
   }
 
   res = vkQueueWaitIdle(handle_);
   if (res != VK_SUCCESS) {
-    notifyAndClear(false);
+    notify(false);
     throw DeviceExcept("Could not wait for queue operations to complete");
   }
 
-  notifyAndClear(true);
+  notify(true);
 }
 
 Queue::CapabilityMask QueueVK::capabilities() const {
-  return Graphics|Compute|Transfer;
+  return capabilities_;
 }
 
 void QueueVK::enqueue(CmdBufferVK* cmdBuffer) {
-  assert(pending_.find(cmdBuffer) == pending_.end());
-
-  // TODO: Lock
-  pending_.insert(cmdBuffer);
+  assert(cmdBuffer);
+  assert(cmdBuffer->isPending());
+
+  auto head = pending_.load(memory_order_relaxed);
+  do
+    cmdBuffer->setNext(head);
+  while (!pending_.compare_exchange_weak(head, cmdBuffer,
+                                         memory_order_release,
+                                         memory_order_relaxed));
 }
 
 void QueueVK::unmake(CmdBufferVK* cmdBuffer) noexcept {
-  assert(pools_.find(cmdBuffer) != pools_.end());
-
   if (cmdBuffer->isPending()) {
     // TODO: Gate command buffer destruction
     assert(false);
     abort();
   }
 
-  auto it = pools_.find(cmdBuffer);
-  vkDestroyCommandPool(deviceVK().device(), it->second, nullptr);
-  pools_.erase(it);
+  // The command buffer is reset when reused
+  auto& pool = cmdBuffer->pool();
+  lock_guard<mutex> lock(pool.mutex);
+  assert(pool.live > 0);
+  if (cmdBuffer->isSecondary())
+    pool.secondaries.push_back(cmdBuffer->handle());
+  else
+    pool.primaries.push_back(cmdBuffer->handle());
+  pool.live--;
+  pool.dirty = true;
 }
 
-VkCommandBuffer QueueVK::getPriority(VkPipelineStageFlags stageMask,
-                                     function<void (bool)> completionHandler) {
+QueueVK::Priority& QueueVK::threadPriority() {
+  // Queue identifiers are unique, so stale entries never match
+  thread_local vector<pair<uint64_t, Priority*>> prios;
+  for (const auto& p : prios) {
+    if (p.first == id_)
+      return *p.second;
+  }
 
-  if (stageMask == VK_PIPELINE_STAGE_ALL_COMMANDS_BIT)
-    maskPrio_ = stageMask;
-  else
-    maskPrio_ |= stageMask;
+  auto prio = new Priority;
+  prio->next = priorities_.load(memory_order_relaxed);
+  while (!priorities_.compare_exchange_weak(prio->next, prio,
+                                            memory_order_release,
+                                            memory_order_relaxed)) { }
 
-  if (pendPrio_) {
-    callbsPrio_.push_back(completionHandler);
-    return cmdPrio_;
-  }
+  prios.push_back({id_, prio});
+  return *prio;
+}
 
-  VkResult res;
+void QueueVK::encodePriority(VkPipelineStageFlags stageMask,
+                             const function<void (VkCommandBuffer)>& encode,
+                             function<void (bool)> completionHandler) {
 
-  if (!cmdPrio_) {
-    poolPrio_ = initPool();
+  auto& prio = threadPriority();
+  lock_guard<mutex> lock(prio.mutex);
 
-    VkCommandBufferAllocateInfo info;
-    info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    info.pNext = nullptr;
-    info.commandPool = poolPrio_;
-    info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    info.commandBufferCount = 1;
+  if (!prio.pending) {
+    VkResult res;
 
-    res = vkAllocateCommandBuffers(deviceVK().device(), &info, &cmdPrio_);
-    if (res != VK_SUCCESS) {
-      deinitPool(poolPrio_);
-      poolPrio_ = VK_NULL_HANDLE;
-      throw DeviceExcept("Could not allocate command buffer");
+    if (!prio.pool) {
+      prio.pool = initPool();
+
+      VkCommandBufferAllocateInfo info;
+      info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+      info.pNext = nullptr;
+      info.commandPool = prio.pool;
+      info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+      info.commandBufferCount = 2;
+
+      res = vkAllocateCommandBuffers(deviceVK().device(), &info,
+                                     prio.handles);
+      if (res != VK_SUCCESS) {
+        deinitPool(prio.pool);
+        prio.pool = VK_NULL_HANDLE;
+        throw DeviceExcept("Could not allocate command buffer");
+      }
     }
-  }
 
-  VkCommandBufferBeginInfo info;
-  info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-  info.pNext = nullptr;
-  info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-  info.pInheritanceInfo = nullptr;
+    VkCommandBufferBeginInfo info;
+    info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    info.pNext = nullptr;
+    info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    info.pInheritanceInfo = nullptr;
 
-  res = vkBeginCommandBuffer(cmdPrio_, &info);
-  if (res != VK_SUCCESS)
-    throw DeviceExcept("Could not begin command buffer");
+    res = vkBeginCommandBuffer(prio.handles[0], &info);
+    if (res != VK_SUCCESS)
+      throw DeviceExcept("Could not begin command buffer");
+
+    prio.pending = true;
+  }
+
+  encode(prio.handles[0]);
+  prio.stageMask |= stageMask;
+  prio.callbacks.push_back(completionHandler);
+}
 
-  callbsPrio_.push_back(completionHandler);
-  pendPrio_ = true;
-  return cmdPrio_;
+void QueueVK::onCompletion(function<void (bool)> completionHandler) {
+  lock_guard<mutex> lock(completionMutex_);
+  callbacks_.push_back(completionHandler);
 }
 
 void QueueVK::waitFor(VkSemaphore semaphore, VkPipelineStageFlags stageMask) {
+  lock_guard<mutex> lock(completionMutex_);
   semaphores_.push_back(semaphore);
   stageMasks_.push_back(stageMask);
 }
 
+void QueueVK::signal(VkSemaphore semaphore) {
+  lock_guard<mutex> lock(completionMutex_);
+  signals_.push_back(semaphore);
+}
+
+void QueueVK::setUpload(UploadVK* upload) {
+  upload_ = upload;
+}
+
 VkQueue QueueVK::handle() {
   return handle_;
 }
@@ -282,37 +601,72 @@ int32_t QueueVK::family() const {
   return family_;
 }
 
+bool QueueVK::timestamps() {
+  call_once(timestampFlag_, [&] {
+    auto phys = deviceVK().physicalDev();
+    uint32_t familyN;
+    vkGetPhysicalDeviceQueueFamilyProperties(phys, &familyN, nullptr);
+    vector<VkQueueFamilyProperties> families(familyN);
+    vkGetPhysicalDeviceQueueFamilyProperties(phys, &familyN, families.data());
+    timestamps_ = families[family_].timestampValidBits != 0;
+  });
+  return timestamps_;
+}
+
 //
 // CmdBufferVK
 //
 
-CmdBufferVK::CmdBufferVK(QueueVK& queue, VkCommandBuffer handle)
-  : queue_(queue), handle_(handle), pending_(false), begun_(false) {
+CmdBufferVK::CmdBufferVK(QueueVK& queue, QueueVK::Pool& pool,
+                         VkCommandBuffer handle, bool secondary)
+  : queue_(queue), pool_(pool), handle_(handle), pending_(false),
+    begun_(false), secondary_(secondary) {
 
   assert(handle != nullptr);
 }
 
 CmdBufferVK::~CmdBufferVK() {
   queue_.unmake(this);
+
+  // The device will not use resources tied to this command buffer
+  for (const auto& h : completionHandlers_)
+    h();
 }
 
 void CmdBufferVK::encode(const Encoder& encoder) {
   if (pending_)
     throw runtime_error("Attempt to encode a pending command buffer");
 
-  if (!begun_) {
-    VkCommandBufferBeginInfo info;
-    info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    info.pNext = nullptr;
-    // TODO: Consider reusing the command buffer instead
-    info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-    info.pInheritanceInfo = nullptr;
-
-    auto res = vkBeginCommandBuffer(handle_, &info);
-    if (res != VK_SUCCESS)
-      throw DeviceExcept("Could not set command buffer for encoding");
-
-    begun_ = true;
+  Queue::Capability capability;
+  switch (encoder.type()) {
+  case Encoder::Graphics:
+    capability = Queue::Graphics;
+    break;
+  case Encoder::Compute:
+    capability = Queue::Compute;
+    break;
+  default:
+    capability = Queue::Transfer;
+    break;
+  }
+  if (!(queue_.capabilities() & capability))
+    throw invalid_argument("Encoder type not supported by queue");
+
+  if (secondary_) {
+    // Secondary command buffers inherit the target set by the first
+    // encoding
+    const auto& enc = encoder.encoding();
+    if (encoder.type() != Encoder::Graphics ||
+        (!begun_ && (enc.empty() || enc.front()->cmd != Cmd::TargetT)))
+      throw invalid_argument("Secondary command buffers require a graphics "
+                             "encoder that sets a target first");
+
+    if (!begun_) {
+      auto tgt = &static_cast<TargetCmd*>(enc.front().get())->target;
+      begin(static_cast<TargetVK*>(tgt));
+    }
+  } else if (!begun_) {
+    begin(nullptr);
   }
 
   try {
@@ -334,19 +688,20 @@ void CmdBufferVK::encode(const Encoder& encoder) {
 }
 
 void CmdBufferVK::enqueue() {
+  if (secondary_)
+    throw runtime_error("Attempt to enqueue a secondary command buffer");
+
   if (pending_)
     throw runtime_error("Attempt to enqueue a pending command buffer");
 
   if (!begun_)
     throw runtime_error("Attempt to enqueue an empty command buffer");
 
-  begun_ = false;
-
-  auto res = vkEndCommandBuffer(handle_);
-  if (res != VK_SUCCESS)
-    throw DeviceExcept("Invalid command buffer encoding(s)");
+  end();
 
   pending_ = true;
+  for (auto& sb : subBuffers_)
+    sb->pending_ = true;
   queue_.enqueue(this);
 }
 
@@ -355,6 +710,10 @@ void CmdBufferVK::reset() {
     throw runtime_error("Attempt to reset a pending command buffer");
 
   vkResetCommandBuffer(handle_, 0);
+  begun_ = false;
+  ended_ = false;
+  inherited_ = nullptr;
+  subBuffers_.clear();
 }
 
 bool CmdBufferVK::isPending() {
@@ -373,6 +732,101 @@ void CmdBufferVK::didExecute() {
   assert(pending_);
 
   pending_ = false;
+  for (auto& sb : subBuffers_)
+    sb->pending_ = false;
+  subBuffers_.clear();
+
+  auto handlers = move(completionHandlers_);
+  completionHandlers_.clear();
+  for (const auto& h : handlers)
+    h();
+}
+
+void CmdBufferVK::onCompletion(function<void ()> handler) {
+  completionHandlers_.push_back(move(handler));
+}
+
+bool CmdBufferVK::isSecondary() const {
+  return secondary_;
+}
+
+QueueVK::Pool& CmdBufferVK::pool() {
+  return pool_;
+}
+
+CmdBufferVK* CmdBufferVK::next() const {
+  return next_;
+}
+
+void CmdBufferVK::setNext(CmdBufferVK* cmdBuffer) {
+  next_ = cmdBuffer;
+}
+
+void CmdBufferVK::begin(TargetVK* target) {
+  assert(!begun_);
+  assert(!secondary_ || target);
+
+  VkCommandBufferInheritanceInfo inhInfo;
+  VkCommandBufferBeginInfo info;
+  info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  info.pNext = nullptr;
+
+  if (secondary_) {
+    inhInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inhInfo.pNext = nullptr;
+    inhInfo.renderPass = static_cast<PassVK&>(target->pass()).renderPass();
+    inhInfo.subpass = 0;
+    inhInfo.framebuffer = target->framebuffer();
+    inhInfo.occlusionQueryEnable = false;
+    inhInfo.queryFlags = 0;
+    inhInfo.pipelineStatistics = 0;
+
+    // Secondary command buffers can be executed again without being
+    // encoded anew
+    info.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    info.pInheritanceInfo = &inhInfo;
+  } else {
+    // Primary command buffers are encoded anew for every submission
+    info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    info.pInheritanceInfo = nullptr;
+  }
+
+  auto res = vkBeginCommandBuffer(handle_, &info);
+  if (res != VK_SUCCESS)
+    throw DeviceExcept("Could not set command buffer for encoding");
+
+  begun_ = true;
+  ended_ = false;
+  inherited_ = target;
+}
+
+void CmdBufferVK::end() {
+  assert(begun_);
+
+  begun_ = false;
+
+  auto res = vkEndCommandBuffer(handle_);
+  if (res != VK_SUCCESS)
+    throw DeviceExcept("Invalid command buffer encoding(s)");
+
+  ended_ = true;
+}
+
+void CmdBufferVK::writeTimestamp(const TimestampCmd& cmd) {
+  if (cmd.pool.type() != QueryPool::Timestamp)
+    throw invalid_argument("writeTimestamp() requires a timestamp pool");
+  if (!isValidQueryRange(cmd.pool, cmd.index, 1))
+    throw invalid_argument("writeTimestamp() index out of range");
+  if (!queue_.timestamps())
+    throw UnsupportedExcept("Timestamps not supported by queue");
+
+  // Written once every previous command completes
+  vkCmdWriteTimestamp(handle_, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                      static_cast<QueryPoolVK&>(cmd.pool).handle(), cmd.index);
+}
+
+CmdBuffer::Dropped CmdBufferVK::dropped() const {
+  return dropped_;
 }
 
 void CmdBufferVK::encode(const GrEncoder& encoder) {
@@ -394,24 +848,78 @@ void CmdBufferVK::encode(const GrEncoder& encoder) {
   const TargetOp* tgtOp = nullptr;
   GrStateVK* gst = nullptr;
   vector<const DcTableCmd*> dtbs;
+  BoundSets bound;
+  ActiveQueries queries;
+
+  // Dynamic state is only set when it changes
+  VkViewport vport{};
+  VkRect2D sciss{};
+
+  // Vertex buffers are bound before drawing, with changes to adjacent
+  // inputs coalesced
+  using VxBuf = pair<VkBuffer, VkDeviceSize>;
+  vector<VxBuf> vxBufs;
+  vector<VxBuf> vxBufsNext;
+  uint64_t vxBufCmds = 0;
+
+  struct {
+    VkBuffer buffer;
+    VkDeviceSize offset;
+    VkIndexType type;
+  } ixBuf{VK_NULL_HANDLE, 0, VK_INDEX_TYPE_UINT16};
+
+  // Render passes begin when their contents are known
+  bool passBegun = false;
+  VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE;
+
+  // Secondary command buffers are always within a render pass
+  if (secondary_) {
+    tgt = inherited_;
+    status |= STgt;
+  }
 
   // Begin render pass
-  auto beginPass = [&] {
+  auto beginPass = [&](VkSubpassContents subpassContents) {
+    assert(!secondary_);
+
     VkRenderPassBeginInfo info;
     vector<VkClearValue> clear;
     tgt->setBeginInfo(info, clear, *tgtOp);
 
-    vkCmdBeginRenderPass(handle_, &info, VK_SUBPASS_CONTENTS_INLINE);
-    status |= STgt;
+    vkCmdBeginRenderPass(handle_, &info, subpassContents);
+    passBegun = true;
+    contents = subpassContents;
   };
 
   // End render pass
   auto endPass = [&] {
+    if (queries.any(true))
+      throw invalid_argument("Queries begun in a target must end in it");
+
+    // Load operations apply even if nothing was encoded
+    if (!passBegun)
+      beginPass(VK_SUBPASS_CONTENTS_INLINE);
+
     vkCmdEndRenderPass(handle_);
+    passBegun = false;
     tgt = nullptr;
     status &= ~STgt;
   };
 
+  // Check that commands can be encoded inline
+  auto checkInline = [&] {
+    if (passBegun && contents != VK_SUBPASS_CONTENTS_INLINE)
+      throw invalid_argument("Only execute() can follow execute() in a "
+                             "target");
+  };
+
+  // Begin render pass for inline commands if needed
+  auto inlinePass = [&] {
+    checkInline();
+    if (tgt && !passBegun && !secondary_)
+      beginPass(VK_SUBPASS_CONTENTS_INLINE);
+  };
+
   // Bind descriptor sets
   auto bindSets = [&] {
     auto plLay = gst->plLayout();
@@ -424,83 +932,187 @@ void CmdBufferVK::encode(const GrEncoder& encoder) {
           j >= gst->config().dcTables[i]->allocations())
         throw invalid_argument("setDcTable() index out of range");
 
-      auto ds = static_cast<DcTableVK*>(gst->config().dcTables[i])->ds(j);
-      vkCmdBindDescriptorSets(handle_, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                              plLay, i, 1, &ds, 0, nullptr);
+      auto dtb = static_cast<DcTableVK*>(gst->config().dcTables[i]);
+      const auto& offs = d->dynamicOffsets;
+      dtb->checkDynamicOffsets(j, offs);
+
+      auto ds = dtb->ds(j);
+      if (bound.bind(i, ds, offs))
+        vkCmdBindDescriptorSets(handle_, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                plLay, i, 1, &ds, offs.size(), offs.data());
+      else
+        dropped_.dcTables++;
     }
 
     dtbs.clear();
   };
 
+  // Bind vertex buffers
+  auto bindVxBufs = [&] {
+    if (vxBufs.size() < vxBufsNext.size())
+      vxBufs.resize(vxBufsNext.size(), {VK_NULL_HANDLE, 0});
+
+    auto changed = [&](uint32_t i) {
+      return vxBufsNext[i].first != VK_NULL_HANDLE &&
+             vxBufsNext[i] != vxBufs[i];
+    };
+
+    vector<VkBuffer> handles;
+    vector<VkDeviceSize> offsets;
+    uint64_t calls = 0;
+
+    for (uint32_t i = 0; i < vxBufsNext.size();) {
+      if (!changed(i)) {
+        i++;
+        continue;
+      }
+
+      const uint32_t first = i;
+      handles.clear();
+      offsets.clear();
+      for (; i < vxBufsNext.size() && changed(i); i++) {
+        handles.push_back(vxBufsNext[i].first);
+        offsets.push_back(vxBufsNext[i].second);
+        vxBufs[i] = vxBufsNext[i];
+      }
+
+      vkCmdBindVertexBuffers(handle_, first, handles.size(), handles.data(),
+                             offsets.data());
+      calls++;
+    }
+
+    dropped_.vxBuffers += vxBufCmds - calls;
+    vxBufCmds = 0;
+  };
+
   // Set viewport
   auto setViewport = [&](const ViewportCmd* sub) {
+    checkInline();
+
     // TODO: Support for multiple viewports
     if (sub->viewportIndex != 0)
       throw UnsupportedExcept("Multiple viewports not supported");
 
-    VkViewport vport{sub->viewport.x, sub->viewport.y,
-                     sub->viewport.width, sub->viewport.height,
-                     sub->viewport.zNear, sub->viewport.zFar};
+    const VkViewport vp{sub->viewport.x, sub->viewport.y,
+                        sub->viewport.width, sub->viewport.height,
+                        sub->viewport.zNear, sub->viewport.zFar};
+
+    if ((status & SVport) && vp.x == vport.x && vp.y == vport.y &&
+        vp.width == vport.width && vp.height == vport.height &&
+        vp.minDepth == vport.minDepth && vp.maxDepth == vport.maxDepth) {
+      dropped_.viewports++;
+      return;
+    }
 
+    vport = vp;
     vkCmdSetViewport(handle_, sub->viewportIndex, 1, &vport);
     status |= SVport;
   };
 
   // Set scissor
   auto setScissor = [&](const ScissorCmd* sub) {
+    checkInline();
+
     // TODO: Support for multiple viewports
     if (sub->viewportIndex != 0)
       throw UnsupportedExcept("Multiple viewports not supported");
 
-    VkRect2D sciss{{sub->scissor.offset.x, sub->scissor.offset.y},
-                   {sub->scissor.size.width, sub->scissor.size.height}};
+    const VkRect2D sc{{sub->scissor.offset.x, sub->scissor.offset.y},
+                      {sub->scissor.size.width, sub->scissor.size.height}};
+
+    if ((status & SSciss) && sc.offset.x == sciss.offset.x &&
+        sc.offset.y == sciss.offset.y &&
+        sc.extent.width == sciss.extent.width &&
+        sc.extent.height == sciss.extent.height) {
+      dropped_.scissors++;
+      return;
+    }
 
+    sciss = sc;
     vkCmdSetScissor(handle_, sub->viewportIndex, 1, &sciss);
     status |= SSciss;
   };
 
   // Set target
   auto setTarget = [&](const TargetCmd* sub) {
+    if (secondary_) {
+      if (&sub->target != inherited_)
+        throw invalid_argument("Secondary command buffers cannot change "
+                               "target");
+      return;
+    }
+
     if (tgt)
       endPass();
     tgt = &static_cast<TargetVK&>(sub->target);
     tgtOp = &sub->targetOp;
-    beginPass();
+    status |= STgt;
   };
 
   // Set graphics state
   auto setState = [&](const StateGrCmd* sub) {
+    checkInline();
+
     auto st = &static_cast<GrStateVK&>(sub->state);
     if (st != gst) {
       gst = st;
       auto pl = gst->pipeline();
       vkCmdBindPipeline(handle_, VK_PIPELINE_BIND_POINT_GRAPHICS, pl);
+      bound.setLayout(gst->config().dcTables, gst->config().constRanges);
       status |= SGst;
     }
   };
 
   // Set descriptor table
   auto setDcTable = [&](const DcTableCmd* sub) {
+    checkInline();
+
     dtbs.push_back(sub);
   };
 
+  // Set push constants
+  auto setConsts = [&](const ConstCmd* sub) {
+    checkInline();
+
+    if (!(status & SGst))
+      throw invalid_argument("setConstants() requires a state to be set");
+    if (!isValidConstCmd(*sub, gst->config().constRanges))
+      throw invalid_argument("setConstants() range not in state's ranges");
+
+    vkCmdPushConstants(handle_, gst->plLayout(),
+                       toMultipleShaderStagesVK(sub->stageMask), sub->offset,
+                       sub->data.size(), sub->data.data());
+  };
+
   // Set vertex buffer
   auto setVxBuffer = [&](const VxBufferCmd* sub) {
+    checkInline();
+
     auto buf = &static_cast<BufferVK&>(sub->buffer);
-    auto bufHandle = buf->handle();
-    auto off = sub->offset;
 
-    vkCmdBindVertexBuffers(handle_, sub->inputIndex, 1, &bufHandle, &off);
+    if (sub->inputIndex >= vxBufsNext.size())
+      vxBufsNext.resize(sub->inputIndex + 1, {VK_NULL_HANDLE, 0});
+    vxBufsNext[sub->inputIndex] = {buf->handle(), sub->offset};
+    vxBufCmds++;
     status |= SVbuf;
   };
 
   // Set index buffer
   auto setIxBuffer = [&](const IxBufferCmd* sub) {
+    checkInline();
+
     auto buf = &static_cast<BufferVK&>(sub->buffer);
     auto bufHandle = buf->handle();
     auto type = sub->type == IndexTypeU16 ? VK_INDEX_TYPE_UINT16
                                           : VK_INDEX_TYPE_UINT32;
 
+    if ((status & SIbuf) && bufHandle == ixBuf.buffer &&
+        sub->offset == ixBuf.offset && type == ixBuf.type) {
+      dropped_.ixBuffers++;
+      return;
+    }
+
+    ixBuf = {bufHandle, sub->offset, type};
     vkCmdBindIndexBuffer(handle_, bufHandle, sub->offset, type);
     status |= SIbuf;
   };
@@ -510,6 +1122,9 @@ void CmdBufferVK::encode(const GrEncoder& encoder) {
     if ((status & SDraw) != SDraw)
       throw invalid_argument("Invalid draw() encoding");
 
+    inlinePass();
+    if (vxBufCmds != 0)
+      bindVxBufs();
     if (!dtbs.empty())
       bindSets();
 
@@ -523,6 +1138,9 @@ void CmdBufferVK::encode(const GrEncoder& encoder) {
     if ((status & SDrawi) != SDrawi)
       throw invalid_argument("Invalid drawIndexed() encoding");
 
+    inlinePass();
+    if (vxBufCmds != 0)
+      bindVxBufs();
     if (!dtbs.empty())
       bindSets();
 
@@ -534,6 +1152,8 @@ void CmdBufferVK::encode(const GrEncoder& encoder) {
   // Synchronize
   // TODO: Improve this
   auto sync = [&](const SyncCmd*) {
+    inlinePass();
+
     VkMemoryBarrier barrier;
     barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
     barrier.pNext = nullptr;
@@ -550,6 +1170,73 @@ void CmdBufferVK::encode(const GrEncoder& encoder) {
                          0, nullptr, 0, nullptr);
   };
 
+  // Execute secondary command buffer
+  auto execute = [&](const ExecuteCmd* sub) {
+    if (secondary_)
+      throw invalid_argument("execute() cannot be encoded in a secondary "
+                             "command buffer");
+    if (!tgt)
+      throw invalid_argument("execute() requires a target to be set");
+    if (queries.any())
+      throw invalid_argument("execute() cannot be encoded while queries are "
+                             "active");
+
+    auto cb = static_cast<CmdBufferVK*>(&sub->subBuffer);
+    if (!cb->secondary_ || cb->inherited_ != tgt)
+      throw invalid_argument("execute() requires a secondary command buffer "
+                             "encoded for the current target");
+    if (cb->pending_)
+      throw runtime_error("Attempt to execute a pending command buffer");
+
+    if (cb->begun_)
+      cb->end();
+    else if (!cb->ended_)
+      throw runtime_error("Attempt to execute an empty command buffer");
+
+    if (!passBegun)
+      beginPass(VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+    else if (contents != VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS)
+      throw invalid_argument("execute() cannot follow other commands in a "
+                             "target");
+
+    vkCmdExecuteCommands(handle_, 1, &cb->handle_);
+    subBuffers_.push_back(cb);
+
+    // Bound state is undefined after executing
+    status &= STgt;
+    gst = nullptr;
+    dtbs.clear();
+    bound = BoundSets();
+    vxBufs.clear();
+    vxBufsNext.clear();
+    vxBufCmds = 0;
+  };
+
+  // Write timestamp
+  auto timestamp = [&](const TimestampCmd* sub) {
+    inlinePass();
+
+    writeTimestamp(*sub);
+  };
+
+  // Begin query
+  auto beginQuery = [&](const BeginQueryCmd* sub) {
+    inlinePass();
+
+    queries.begin(*sub, tgt != nullptr);
+    vkCmdBeginQuery(handle_, static_cast<QueryPoolVK&>(sub->pool).handle(),
+                    sub->index, 0);
+  };
+
+  // End query
+  auto endQuery = [&](const EndQueryCmd* sub) {
+    inlinePass();
+
+    queries.end(*sub, tgt != nullptr);
+    vkCmdEndQuery(handle_, static_cast<QueryPoolVK&>(sub->pool).handle(),
+                  sub->index);
+  };
+
   for (const auto& cmd : encoder.encoding()) {
     switch (cmd->cmd) {
     case Cmd::ViewportT:
@@ -567,6 +1254,9 @@ void CmdBufferVK::encode(const GrEncoder& encoder) {
     case Cmd::DcTableT:
       setDcTable(static_cast<DcTableCmd*>(cmd.get()));
       break;
+    case Cmd::ConstT:
+      setConsts(static_cast<ConstCmd*>(cmd.get()));
+      break;
     case Cmd::VxBufferT:
       setVxBuffer(static_cast<VxBufferCmd*>(cmd.get()));
       break;
@@ -582,25 +1272,42 @@ void CmdBufferVK::encode(const GrEncoder& encoder) {
     case Cmd::SyncT:
       sync(static_cast<SyncCmd*>(cmd.get()));
       break;
+    case Cmd::ExecuteT:
+      execute(static_cast<ExecuteCmd*>(cmd.get()));
+      break;
+    case Cmd::TimestampT:
+      timestamp(static_cast<TimestampCmd*>(cmd.get()));
+      break;
+    case Cmd::BeginQueryT:
+      beginQuery(static_cast<BeginQueryCmd*>(cmd.get()));
+      break;
+    case Cmd::EndQueryT:
+      endQuery(static_cast<EndQueryCmd*>(cmd.get()));
+      break;
     default:
       assert(false);
       abort();
     }
   }
 
-  if (tgt)
+  if (tgt && !secondary_)
     endPass();
+  if (queries.any())
+    throw invalid_argument("Queries must end in the encoder that begins them");
 }
 
 void CmdBufferVK::encode(const CpEncoder& encoder) {
   CpStateVK* cst = nullptr;
   vector<const DcTableCmd*> dtbs;
+  BoundSets bound;
+  ActiveQueries queries;
 
   // Set compute state
   auto setState = [&](const StateCpCmd* sub) {
     cst = &static_cast<CpStateVK&>(sub->state);
     auto pl = cst->pipeline();
     vkCmdBindPipeline(handle_, VK_PIPELINE_BIND_POINT_COMPUTE, pl);
+    bound.setLayout(cst->config().dcTables, cst->config().constRanges);
   };
 
   // Set descriptor table
@@ -608,6 +1315,18 @@ void CmdBufferVK::encode(const CpEncoder& encoder) {
     dtbs.push_back(sub);
   };
 
+  // Set push constants
+  auto setConsts = [&](const ConstCmd* sub) {
+    if (!cst)
+      throw invalid_argument("setConstants() requires a state to be set");
+    if (!isValidConstCmd(*sub, cst->config().constRanges))
+      throw invalid_argument("setConstants() range not in state's ranges");
+
+    vkCmdPushConstants(handle_, cst->plLayout(),
+                       toMultipleShaderStagesVK(sub->stageMask), sub->offset,
+                       sub->data.size(), sub->data.data());
+  };
+
   // Dispatch
   auto dispatch = [&](const DispatchCmd* sub) {
     if (!cst)
@@ -624,9 +1343,16 @@ void CmdBufferVK::encode(const CpEncoder& encoder) {
             j >= cst->config().dcTables[i]->allocations())
           throw invalid_argument("setDcTable() index out of range");
 
-        auto ds = static_cast<DcTableVK*>(cst->config().dcTables[i])->ds(j);
-        vkCmdBindDescriptorSets(handle_, VK_PIPELINE_BIND_POINT_COMPUTE,
-                                plLay, i, 1, &ds, 0, nullptr);
+        auto dtb = static_cast<DcTableVK*>(cst->config().dcTables[i]);
+        const auto& offs = d->dynamicOffsets;
+        dtb->checkDynamicOffsets(j, offs);
+
+        auto ds = dtb->ds(j);
+        if (bound.bind(i, ds, offs))
+          vkCmdBindDescriptorSets(handle_, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                  plLay, i, 1, &ds, offs.size(), offs.data());
+        else
+          dropped_.dcTables++;
       }
 
       dtbs.clear();
@@ -655,6 +1381,24 @@ void CmdBufferVK::encode(const CpEncoder& encoder) {
                          0, nullptr, 0, nullptr);
   };
 
+  // Begin query
+  auto beginQuery = [&](const BeginQueryCmd* sub) {
+    if (sub->pool.type() == QueryPool::Occlusion)
+      throw invalid_argument("beginQuery() occlusion queries require a "
+                             "graphics encoder");
+
+    queries.begin(*sub, false);
+    vkCmdBeginQuery(handle_, static_cast<QueryPoolVK&>(sub->pool).handle(),
+                    sub->index, 0);
+  };
+
+  // End query
+  auto endQuery = [&](const EndQueryCmd* sub) {
+    queries.end(*sub, false);
+    vkCmdEndQuery(handle_, static_cast<QueryPoolVK&>(sub->pool).handle(),
+                  sub->index);
+  };
+
   for (const auto& cmd : encoder.encoding()) {
     switch (cmd->cmd) {
     case Cmd::StateCpT:
@@ -663,17 +1407,32 @@ void CmdBufferVK::encode(const CpEncoder& encoder) {
     case Cmd::DcTableT:
       setDcTable(static_cast<DcTableCmd*>(cmd.get()));
       break;
+    case Cmd::ConstT:
+      setConsts(static_cast<ConstCmd*>(cmd.get()));
+      break;
     case Cmd::DispatchT:
       dispatch(static_cast<DispatchCmd*>(cmd.get()));
       break;
     case Cmd::SyncT:
       sync(static_cast<SyncCmd*>(cmd.get()));
       break;
+    case Cmd::TimestampT:
+      writeTimestamp(*static_cast<TimestampCmd*>(cmd.get()));
+      break;
+    case Cmd::BeginQueryT:
+      beginQuery(static_cast<BeginQueryCmd*>(cmd.get()));
+      break;
+    case Cmd::EndQueryT:
+      endQuery(static_cast<EndQueryCmd*>(cmd.get()));
+      break;
     default:
       assert(false);
       abort();
     }
   }
+
+  if (queries.any())
+    throw invalid_argument("Queries must end in the encoder that begins them");
 }
 
 void CmdBufferVK::encode(const TfEncoder& encoder) {
@@ -725,8 +1484,8 @@ void CmdBufferVK::encode(const TfEncoder& encoder) {
       throw invalid_argument("copy(img, img) samples differ");
 
     // XXX
-    dst->changeLayout(VK_IMAGE_LAYOUT_GENERAL, true);
-    src->changeLayout(VK_IMAGE_LAYOUT_GENERAL, true);
+    dst->changeLayout(VK_IMAGE_LAYOUT_GENERAL, true, &queue_);
+    src->changeLayout(VK_IMAGE_LAYOUT_GENERAL, true, &queue_);
 
     VkImageCopy region;
     region.srcSubresource.aspectMask = aspectOfVK(src->format());
@@ -745,6 +1504,48 @@ void CmdBufferVK::encode(const TfEncoder& encoder) {
                    dst->layout().second, 1, &region);
   };
 
+  // Queries are only reset and copied by graphics or compute queues
+  auto checkQueue = [&] {
+    if (!(queue_.capabilities() & (Queue::Graphics | Queue::Compute)))
+      throw UnsupportedExcept("Query operations not supported by queue");
+  };
+
+  // Reset queries
+  auto resetQueries = [&](const ResetQueriesCmd* sub) {
+    checkQueue();
+
+    if (!isValidQueryRange(sub->pool, sub->first, sub->count))
+      throw invalid_argument("resetQueries() invalid range");
+
+    vkCmdResetQueryPool(handle_, static_cast<QueryPoolVK&>(sub->pool).handle(),
+                        sub->first, sub->count);
+  };
+
+  // Copy query results
+  auto copyQueries = [&](const CopyQueriesCmd* sub) {
+    checkQueue();
+
+    auto dst = &static_cast<BufferVK&>(sub->dst);
+    const uint64_t stride = sub->pool.resultCount() * sizeof(uint64_t);
+
+    if (!(dst->usageMask() & Buffer::Query))
+      throw invalid_argument("copyQueries() requires a query buffer");
+    if (sub->dstOffset % sizeof(uint64_t) != 0)
+      throw invalid_argument("copyQueries() offset must be a multiple of 8");
+    if (!isValidQueryRange(sub->pool, sub->first, sub->count) ||
+        sub->dstOffset > dst->size() ||
+        stride * sub->count > dst->size() - sub->dstOffset)
+      throw invalid_argument("copyQueries() invalid range");
+
+    // The device waits for the results, the host does not
+    vkCmdCopyQueryPoolResults(handle_,
+                              static_cast<QueryPoolVK&>(sub->pool).handle(),
+                              sub->first, sub->count, dst->handle(),
+                              sub->dstOffset, stride,
+                              VK_QUERY_RESULT_64_BIT |
+                              VK_QUERY_RESULT_WAIT_BIT);
+  };
+
   for (const auto& cmd : encoder.encoding()) {
     switch (cmd->cmd) {
     case Cmd::CopyBBT:
@@ -753,6 +1554,15 @@ void CmdBufferVK::encode(const TfEncoder& encoder) {
     case Cmd::CopyIIT:
       copyII(static_cast<CopyIICmd*>(cmd.get()));
       break;
+    case Cmd::TimestampT:
+      writeTimestamp(*static_cast<TimestampCmd*>(cmd.get()));
+      break;
+    case Cmd::ResetQueriesT:
+      resetQueries(static_cast<ResetQueriesCmd*>(cmd.get()));
+      break;
+    case Cmd::CopyQueriesT:
+      copyQueries(static_cast<CopyQueriesCmd*>(cmd.get()));
+      break;
     default:
       assert(false);
       abort();
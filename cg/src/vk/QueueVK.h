@@ -8,10 +8,13 @@
 #ifndef YF_CG_QUEUEVK_H
 #define YF_CG_QUEUEVK_H
 
+#include <cstdint>
+#include <atomic>
 #include <unordered_map>
-#include <unordered_set>
 #include <vector>
 #include <functional>
+#include <mutex>
+#include <thread>
 
 #include "Defs.h"
 #include "Queue.h"
@@ -20,64 +23,143 @@
 CG_NS_BEGIN
 
 class CmdBufferVK;
+class UploadVK;
 
 class QueueVK final : public Queue {
  public:
-  QueueVK(VkQueue handle, int32_t family);
+  QueueVK(VkQueue handle, int32_t family, CapabilityMask capabilities);
   ~QueueVK();
 
   CmdBuffer::Ptr cmdBuffer();
+  CmdBuffer::Ptr subBuffer();
   void submit();
   CapabilityMask capabilities() const;
 
+  /// Command pool shared by the command buffers that a thread creates.
+  ///
+  /// Destroyed command buffers are kept in the pool for reuse. The pool
+  /// is reset in bulk when a command buffer is requested and none of the
+  /// pool's command buffers are in use.
+  ///
+  struct Pool {
+    VkCommandPool handle = VK_NULL_HANDLE;
+    std::vector<VkCommandBuffer> primaries{};
+    std::vector<VkCommandBuffer> secondaries{};
+    uint32_t live = 0;
+    bool dirty = false;
+    std::mutex mutex{};
+  };
+
   /// Called by `CmdBufferVK` to enqueue itself.
   ///
+  /// This can be called from any thread without blocking.
+  ///
   void enqueue(CmdBufferVK* cmdBuffer);
 
   /// Called by `CmdBufferVK` when it is about to be destroyed.
   ///
   void unmake(CmdBufferVK* cmdBuffer) noexcept;
 
-  /// Gets a command buffer handle that executes before the next batch.
+  /// Encodes commands in the calling thread's priority command buffer.
+  ///
+  /// The priority command buffers of every thread execute before the
+  /// next batch. `encode` is called with the command buffer handle and
+  /// must only record commands into it.
+  ///
+  void encodePriority(VkPipelineStageFlags stageMask,
+                      const std::function<void (VkCommandBuffer)>& encode,
+                      std::function<void (bool)> completionHandler);
+
+  /// Sets a handler to be called when the next submission completes.
   ///
-  VkCommandBuffer getPriority(VkPipelineStageFlags stageMask,
-                              std::function<void (bool)> completionHandler);
+  void onCompletion(std::function<void (bool)> completionHandler);
 
   /// Sets a semaphore upon which to wait in the next submission.
   ///
   void waitFor(VkSemaphore semaphore, VkPipelineStageFlags stageMask);
 
+  /// Sets a semaphore to signal in the next submission.
+  ///
+  void signal(VkSemaphore semaphore);
+
+  /// Sets an upload scheduler to flush before every submission.
+  ///
+  void setUpload(UploadVK* upload);
+
   /// Getters.
   ///
   VkQueue handle();
   int32_t family() const;
 
+  /// Checks whether the queue supports timestamps.
+  ///
+  bool timestamps();
+
  private:
   VkQueue handle_ = nullptr;
   int32_t family_ = -1;
-  std::unordered_map<CmdBufferVK*, VkCommandPool> pools_{};
-  std::unordered_set<CmdBufferVK*> pending_{};
+  const CapabilityMask capabilities_ = 0;
+  bool timestamps_ = false;
+  std::once_flag timestampFlag_{};
+  UploadVK* upload_ = nullptr;
+
+  /// Command buffers are only encoded by the thread that creates them,
+  /// so each thread has its own pool.
+  ///
+  std::unordered_map<std::thread::id, Pool> pools_{};
+  std::mutex poolMutex_{};
+
+  /// Enqueued command buffers, linked through `CmdBufferVK::next()` in
+  /// reverse order. Any thread can push, and only `submit()` pops.
+  ///
+  std::atomic<CmdBufferVK*> pending_{nullptr};
+
+  /// Priority command buffer of a thread.
+  ///
+  /// The second handle is the one in use by the last submission, so
+  /// threads can encode new commands while `submit()` executes.
+  ///
+  struct Priority {
+    std::mutex mutex{};
+    VkCommandPool pool = VK_NULL_HANDLE;
+    VkCommandBuffer handles[2]{};
+    VkPipelineStageFlags stageMask = 0;
+    std::vector<std::function<void (bool)>> callbacks{};
+    bool pending = false;
+    Priority* next = nullptr;
+  };
+
+  /// Priority command buffers of every thread that has used the queue.
+  ///
+  std::atomic<Priority*> priorities_{nullptr};
+  const uint64_t id_ = 0;
+  Priority& threadPriority();
 
-  VkCommandPool poolPrio_ = VK_NULL_HANDLE;
-  VkCommandBuffer cmdPrio_ = VK_NULL_HANDLE;
-  VkPipelineStageFlags maskPrio_ = 0;
-  std::vector<std::function<void (bool)>> callbsPrio_{};
-  bool pendPrio_ = false;
+  /// Submissions are serialized.
+  ///
+  std::mutex submitMutex_{};
 
+  std::mutex completionMutex_{};
+  std::vector<std::function<void (bool)>> callbacks_{};
   std::vector<VkSemaphore> semaphores_{};
   std::vector<VkPipelineStageFlags> stageMasks_{};
+  std::vector<VkSemaphore> signals_{};
 
   VkCommandPool initPool();
   void deinitPool(VkCommandPool);
+  CmdBuffer::Ptr make(bool secondary);
 };
 
 class GrEncoder;
 class CpEncoder;
 class TfEncoder;
+class TargetVK;
+struct TimestampCmd;
 
 class CmdBufferVK final : public CmdBuffer {
  public:
-  explicit CmdBufferVK(QueueVK& queue, VkCommandBuffer handle);
+  CmdBufferVK(QueueVK& queue, QueueVK::Pool& pool, VkCommandBuffer handle,
+              bool secondary);
   ~CmdBufferVK();
 
   void encode(const Encoder& encoder);
@@ -85,6 +167,7 @@ class CmdBufferVK final : public CmdBuffer {
   void reset();
   bool isPending();
   Queue& queue();
+  Dropped dropped() const;
 
   /// Getter.
   ///
@@ -94,11 +177,52 @@ class CmdBufferVK final : public CmdBuffer {
   ///
   void didExecute();
 
+  /// Adds a handler to be called once the next execution of this
+  /// command buffer completes, or when it is destroyed otherwise.
+  ///
+  void onCompletion(std::function<void ()> handler);
+
+  /// Checks whether this is a secondary command buffer.
+  ///
+  bool isSecondary() const;
+
+  /// Gets the pool from which the command buffer was allocated.
+  ///
+  QueueVK::Pool& pool();
+
+  /// Gets or sets the next command buffer in the queue's pending list.
+  ///
+  CmdBufferVK* next() const;
+  void setNext(CmdBufferVK* cmdBuffer);
+
  private:
   QueueVK& queue_;
+  QueueVK::Pool& pool_;
   VkCommandBuffer handle_ = nullptr;
-  bool pending_ = false;
+  std::atomic<bool> pending_{false};
   bool begun_ = false;
+  Dropped dropped_{};
+
+  /// Secondary command buffers record the target that they are encoded
+  /// for, and whether they have been ended and can be executed.
+  ///
+  const bool secondary_ = false;
+  TargetVK* inherited_ = nullptr;
+  bool ended_ = false;
+
+  /// Secondary command buffers executed by this one, which are pending
+  /// while this one is.
+  ///
+  std::vector<CmdBufferVK*> subBuffers_{};
+
+  std::vector<std::function<void ()>> completionHandlers_{};
+
+  CmdBufferVK* next_ = nullptr;
+
+  void begin(TargetVK* target);
+  void end();
+
+  void writeTimestamp(const TimestampCmd& cmd);
 
   void encode(const GrEncoder&);
   void encode(const CpEncoder&);
@@ -0,0 +1,112 @@
+//
+// CG
+// SamplerCacheVK.cxx
+//
+// Copyright © 2023 Gustavo C. Viegas.
+//
+
+#include <cassert>
+#include <algorithm>
+#include <functional>
+
+#include "SamplerCacheVK.h"
+#include "DeviceVK.h"
+#include "yf/Except.h"
+
+using namespace CG_NS;
+using namespace std;
+
+bool SamplerCacheVK::Key::operator==(const Key& other) const {
+  return magFilter == other.magFilter &&
+         minFilter == other.minFilter &&
+         mipmapMode == other.mipmapMode &&
+         addressModeU == other.addressModeU &&
+         addressModeV == other.addressModeV &&
+         addressModeW == other.addressModeW &&
+         mipLodBias == other.mipLodBias &&
+         anisotropyEnable == other.anisotropyEnable &&
+         maxAnisotropy == other.maxAnisotropy &&
+         compareEnable == other.compareEnable &&
+         compareOp == other.compareOp &&
+         minLod == other.minLod &&
+         maxLod == other.maxLod &&
+         borderColor == other.borderColor &&
+         unnormalizedCoordinates == other.unnormalizedCoordinates;
+}
+
+size_t SamplerCacheVK::KeyHash::operator()(const Key& key) const {
+  size_t h = 0;
+  auto combine = [&](size_t x) {
+    h ^= x + 0x9e3779b9 + (h << 6) + (h >> 2);
+  };
+
+  combine(key.magFilter);
+  combine(key.minFilter);
+  combine(key.mipmapMode);
+  combine(key.addressModeU);
+  combine(key.addressModeV);
+  combine(key.addressModeW);
+  combine(hash<float>()(key.mipLodBias));
+  combine(key.anisotropyEnable);
+  combine(hash<float>()(key.maxAnisotropy));
+  combine(key.compareEnable);
+  combine(key.compareOp);
+  combine(hash<float>()(key.minLod));
+  combine(hash<float>()(key.maxLod));
+  combine(key.borderColor);
+  combine(key.unnormalizedCoordinates);
+  return h;
+}
+
+SamplerCacheVK::Ref SamplerCacheVK::get(const VkSamplerCreateInfo& info) {
+  assert(info.pNext == nullptr);
+  assert(info.flags == 0);
+
+  const Key key{info.magFilter, info.minFilter, info.mipmapMode,
+                info.addressModeU, info.addressModeV, info.addressModeW,
+                info.mipLodBias, info.anisotropyEnable, info.maxAnisotropy,
+                info.compareEnable, info.compareOp, info.minLod, info.maxLod,
+                info.borderColor, info.unnormalizedCoordinates};
+
+  lock_guard<mutex> lock(mutex_);
+
+  auto& entry = samplers_[key];
+  if (auto ref = entry.lock())
+    return ref;
+
+  VkSampler handle;
+  const auto res = vkCreateSampler(deviceVK().device(), &info, nullptr,
+                                   &handle);
+  if (res != VK_SUCCESS) {
+    samplers_.erase(key);
+    throw DeviceExcept("Could not create sampler");
+  }
+
+  Ref ref(new VkSampler(handle), [](const VkSampler* p) {
+    vkDestroySampler(deviceVK().device(), *p, nullptr);
+    delete p;
+  });
+  entry = ref;
+
+  if (samplers_.size() >= pruneSize_)
+    prune();
+
+  return ref;
+}
+
+size_t SamplerCacheVK::size() const {
+  lock_guard<mutex> lock(mutex_);
+  return count_if(samplers_.begin(), samplers_.end(),
+                  [](const auto& s) { return !s.second.expired(); });
+}
+
+void SamplerCacheVK::prune() {
+  // Entries of destroyed samplers are only removed here
+  for (auto it = samplers_.begin(); it != samplers_.end();) {
+    if (it->second.expired())
+      it = samplers_.erase(it);
+    else
+      ++it;
+  }
+  pruneSize_ = max<size_t>(64, samplers_.size() << 1);
+}
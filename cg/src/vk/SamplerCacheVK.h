@@ -0,0 +1,82 @@
+//
+// CG
+// SamplerCacheVK.h
+//
+// Copyright © 2023 Gustavo C. Viegas.
+//
+
+#ifndef YF_CG_SAMPLERCACHEVK_H
+#define YF_CG_SAMPLERCACHEVK_H
+
+#include <cstddef>
+#include <memory>
+#include <unordered_map>
+#include <mutex>
+
+#include "Defs.h"
+#include "VK.h"
+
+CG_NS_BEGIN
+
+/// Cache of sampler objects.
+///
+/// Samplers are looked up by their creation parameters, so equal
+/// parameters yield the same `VkSampler`. A sampler is destroyed when
+/// its last reference goes away. The cache can be used from multiple
+/// threads.
+///
+class SamplerCacheVK {
+ public:
+  /// Shared reference to a sampler object.
+  ///
+  using Ref = std::shared_ptr<const VkSampler>;
+
+  SamplerCacheVK() = default;
+  SamplerCacheVK(const SamplerCacheVK&) = delete;
+  SamplerCacheVK& operator=(const SamplerCacheVK&) = delete;
+  ~SamplerCacheVK() = default;
+
+  /// Gets a sampler object matching the given parameters.
+  ///
+  /// `info.pNext` must be null and `info.flags` must be zero.
+  ///
+  Ref get(const VkSamplerCreateInfo& info);
+
+  /// Gets the number of samplers created and not yet destroyed.
+  ///
+  size_t size() const;
+
+ private:
+  struct Key {
+    VkFilter magFilter;
+    VkFilter minFilter;
+    VkSamplerMipmapMode mipmapMode;
+    VkSamplerAddressMode addressModeU;
+    VkSamplerAddressMode addressModeV;
+    VkSamplerAddressMode addressModeW;
+    float mipLodBias;
+    VkBool32 anisotropyEnable;
+    float maxAnisotropy;
+    VkBool32 compareEnable;
+    VkCompareOp compareOp;
+    float minLod;
+    float maxLod;
+    VkBorderColor borderColor;
+    VkBool32 unnormalizedCoordinates;
+
+    bool operator==(const Key& other) const;
+  };
+
+  struct KeyHash {
+    size_t operator()(const Key& key) const;
+  };
+
+  std::unordered_map<Key, std::weak_ptr<const VkSampler>, KeyHash> samplers_{};
+  size_t pruneSize_ = 64;
+  mutable std::mutex mutex_{};
+  void prune();
+};
+
+CG_NS_END
+
+#endif // YF_CG_SAMPLERCACHEVK_H
@@ -9,7 +9,6 @@
 
 #include "SamplerVK.h"
 #include "DeviceVK.h"
-#include "yf/Except.h"
 
 using namespace CG_NS;
 using namespace std;
@@ -46,15 +45,12 @@ SamplerVK::SamplerVK(const Desc& desc) : Sampler(desc) {
   info.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK;
   info.unnormalizedCoordinates = VK_FALSE;
 
-  const auto res = vkCreateSampler(dev.device(), &info, nullptr, &handle_);
-  if (res != VK_SUCCESS)
-    throw DeviceExcept("Could not create sampler");
+  // Samplers with equal parameters share the same object
+  handle_ = dev.samplerCache().get(info);
 };
 
-SamplerVK::~SamplerVK() {
-  vkDestroySampler(deviceVK().device(), handle_, nullptr);
-}
+SamplerVK::~SamplerVK() { }
 
 VkSampler SamplerVK::handle() {
-  return handle_;
+  return *handle_;
 }
@@ -12,6 +12,7 @@
 
 #include "Sampler.h"
 #include "VK.h"
+#include "SamplerCacheVK.h"
 
 CG_NS_BEGIN
 
@@ -25,7 +26,7 @@ class SamplerVK final : public Sampler {
   VkSampler handle();
 
  private:
-  VkSampler handle_ = VK_NULL_HANDLE;
+  SamplerCacheVK::Ref handle_{};
 };
 
 /// Converts from a `WrapMode` value.
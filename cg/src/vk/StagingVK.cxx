@@ -0,0 +1,113 @@
+//
+// CG
+// StagingVK.cxx
+//
+// Copyright © 2023 Gustavo C. Viegas.
+//
+
+#include <algorithm>
+#include <cassert>
+
+#include "StagingVK.h"
+#include "BufferVK.h"
+
+using namespace CG_NS;
+using namespace std;
+
+INTERNAL_NS_BEGIN
+
+/// Size of each staging chunk.
+///
+constexpr uint64_t ChunkSize = 1ULL << 22;
+
+/// Number of idle chunks kept for reuse, besides the current one.
+///
+constexpr size_t IdleChunks = 2;
+
+/// Creates a new staging buffer.
+///
+unique_ptr<BufferVK> makeStaging(uint64_t size) {
+  return make_unique<BufferVK>(Buffer::Desc{size, Buffer::Shared,
+                                            Buffer::CopySrc});
+}
+
+INTERNAL_NS_END
+
+StagingVK::~StagingVK() { }
+
+StagingVK::Range StagingVK::acquire(uint64_t size, uint64_t alignment) {
+  assert(size > 0);
+  assert(alignment > 0);
+
+  lock_guard<mutex> lock(mutex_);
+
+  if (size > ChunkSize) {
+    dedicated_.push_back(makeStaging(size));
+    return {dedicated_.back().get(), 0, size};
+  }
+
+  auto fits = [&](const Chunk& chunk) {
+    const auto offset = (chunk.head + alignment - 1) / alignment * alignment;
+    return offset + size <= ChunkSize;
+  };
+
+  // Try the current chunk first, then the next idle one in ring order,
+  // and only create a new chunk if every other is in use
+  if (chunks_.empty() || !fits(chunks_[current_])) {
+    const auto n = chunks_.size();
+    size_t i = 1;
+    for (; i < n; i++) {
+      if (chunks_[(current_ + i) % n].users == 0)
+        break;
+    }
+
+    if (i < n) {
+      current_ = (current_ + i) % n;
+    } else {
+      current_ = n == 0 ? 0 : current_ + 1;
+      chunks_.insert(chunks_.begin() + current_,
+                     {makeStaging(ChunkSize), 0, 0});
+    }
+  }
+
+  auto& chunk = chunks_[current_];
+  const auto offset = (chunk.head + alignment - 1) / alignment * alignment;
+  chunk.head = offset + size;
+  chunk.users++;
+  return {chunk.buffer.get(), offset, size};
+}
+
+void StagingVK::release(const Range& range) {
+  lock_guard<mutex> lock(mutex_);
+
+  auto it = find_if(chunks_.begin(), chunks_.end(), [&](const auto& c) {
+    return c.buffer.get() == range.buffer;
+  });
+
+  if (it == chunks_.end()) {
+    auto dit = find_if(dedicated_.begin(), dedicated_.end(),
+                       [&](const auto& b) { return b.get() == range.buffer; });
+    assert(dit != dedicated_.end());
+    dedicated_.erase(dit);
+    return;
+  }
+
+  assert(it->users > 0);
+  if (--it->users > 0)
+    return;
+
+  // Chunk is idle, so it can be reused from the start
+  it->head = 0;
+
+  const size_t index = it - chunks_.begin();
+  if (index == current_)
+    return;
+
+  const auto idle = count_if(chunks_.begin(), chunks_.end(),
+                             [](const auto& c) { return c.users == 0; });
+  if (static_cast<size_t>(idle) > IdleChunks + 1) {
+    chunks_.erase(it);
+    if (index < current_)
+      current_--;
+  }
+}
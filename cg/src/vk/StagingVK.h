@@ -0,0 +1,72 @@
+//
+// CG
+// StagingVK.h
+//
+// Copyright © 2023 Gustavo C. Viegas.
+//
+
+#ifndef YF_CG_STAGINGVK_H
+#define YF_CG_STAGINGVK_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <mutex>
+
+#include "Defs.h"
+#include "VK.h"
+
+CG_NS_BEGIN
+
+class BufferVK;
+
+/// Ring of host-visible buffers from which uploads are staged.
+///
+/// Memory is sub-allocated from fixed-size chunks. A chunk is reused
+/// once every range acquired from it has been released, so releasing
+/// must only happen after the copies that read from a range complete.
+///
+/// Ranges can be acquired and released from any thread.
+///
+class StagingVK {
+ public:
+  /// Range of staging memory.
+  ///
+  struct Range {
+    BufferVK* buffer;
+    uint64_t offset;
+    uint64_t size;
+  };
+
+  StagingVK() = default;
+  StagingVK(const StagingVK&) = delete;
+  StagingVK& operator=(const StagingVK&) = delete;
+  ~StagingVK();
+
+  /// Acquires a range of staging memory.
+  ///
+  /// Requests larger than the chunk size are served by a dedicated
+  /// buffer, which is destroyed when the range is released.
+  ///
+  Range acquire(uint64_t size, uint64_t alignment);
+
+  /// Releases a range previously acquired.
+  ///
+  void release(const Range& range);
+
+ private:
+  struct Chunk {
+    std::unique_ptr<BufferVK> buffer;
+    uint64_t head;
+    uint32_t users;
+  };
+
+  std::vector<Chunk> chunks_{};
+  size_t current_ = 0;
+  std::vector<std::unique_ptr<BufferVK>> dedicated_{};
+  std::mutex mutex_{};
+};
+
+CG_NS_END
+
+#endif // YF_CG_STAGINGVK_H
@@ -10,6 +10,7 @@
 #include "DcTableVK.h"
 #include "PassVK.h"
 #include "DeviceVK.h"
+#include "LayoutCacheVK.h"
 #include "yf/Except.h"
 
 using namespace CG_NS;
@@ -17,30 +18,27 @@ using namespace std;
 
 INTERNAL_NS_BEGIN
 
-/// Creates pipeline layout object.
+/// Gets a pipeline layout object from the device's layout cache.
 ///
-inline VkPipelineLayout plLayoutVK(const vector<DcTable*>& dcTables) {
-  vector<VkDescriptorSetLayout> dsLays;
+inline LayoutCacheVK::PlRef plLayoutVK(const vector<DcTable*>& dcTables,
+                                       const vector<ConstRange>& constRanges) {
+  vector<LayoutCacheVK::DsRef> dsLays;
   for (const auto dtb : dcTables)
     // XXX: Assuming non-null
-    dsLays.push_back(static_cast<DcTableVK*>(dtb)->dsLayout());
-
-  VkPipelineLayoutCreateInfo info;
-  info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-  info.pNext = nullptr;
-  info.flags = 0;
-  info.setLayoutCount = dsLays.size();
-  info.pSetLayouts = dsLays.data();
-  info.pushConstantRangeCount = 0;
-  info.pPushConstantRanges = nullptr;
-
-  VkPipelineLayout plLay;
-  auto dev = deviceVK().device();
-  auto res = vkCreatePipelineLayout(dev, &info, nullptr, &plLay);
-  if (res != VK_SUCCESS)
-    throw yf::DeviceExcept("Could not create pipeline layout");
+    dsLays.push_back(static_cast<DcTableVK*>(dtb)->dsLayoutRef());
+
+  const auto maxSize = deviceVK().limits().maxConstSize;
+  vector<VkPushConstantRange> pcRanges;
+  for (const auto& r : constRanges) {
+    if (r.size == 0 || r.offset % 4 != 0 || r.size % 4 != 0)
+      throw invalid_argument("Invalid push constant range");
+    if (r.offset + r.size > maxSize)
+      throw yf::LimitExcept("Push constant range exceeds limit");
+    pcRanges.push_back({toMultipleShaderStagesVK(r.stageMask), r.offset,
+                        r.size});
+  }
 
-  return plLay;
+  return deviceVK().layoutCache().plLayout(dsLays, pcRanges);
 }
 
 INTERNAL_NS_END
@@ -50,16 +48,14 @@ INTERNAL_NS_END
 //
 
 GrStateVK::GrStateVK(const Config& config)
-  : config_(config), stgFlags_(0), plLayout_(plLayoutVK(config.dcTables)) {
+  : config_(config), stgFlags_(0),
+    plLayout_(plLayoutVK(config.dcTables, config.constRanges)) {
 
   auto dev = deviceVK().device();
   auto cache = deviceVK().cache();
-  auto deinit = [&] { vkDestroyPipelineLayout(dev, plLayout_, nullptr); };
 
-  if (!config.pass) {
-    deinit();
+  if (!config.pass)
     throw invalid_argument("GrStateVK requires a valid pass");
-  }
 
   // Define shader stages
   vector<VkPipelineShaderStageCreateInfo> stgInfos;
@@ -76,18 +72,14 @@ GrStateVK::GrStateVK(const Config& config)
     info.pName = static_cast<ShaderVK*>(shd)->entryPoint().data();
     info.pSpecializationInfo = nullptr;
 
-    if (info.stage & stgFlags_) {
-      deinit();
+    if (info.stage & stgFlags_)
       throw invalid_argument("GrStateVK requires a unique set of stages");
-    }
 
     stgFlags_ |= info.stage;
   }
 
-  if (!(stgFlags_ & VK_SHADER_STAGE_VERTEX_BIT)) {
-    deinit();
+  if (!(stgFlags_ & VK_SHADER_STAGE_VERTEX_BIT))
     throw invalid_argument("GrStateVK requires a vertex shader");
-  }
   // TODO: Check other invalid stage combinations
 
   // Define vertex input state
@@ -263,7 +255,7 @@ GrStateVK::GrStateVK(const Config& config)
   plInfo.pDepthStencilState = &depInfo;
   plInfo.pColorBlendState = &cbdInfo;
   plInfo.pDynamicState = &dynInfo;
-  plInfo.layout = plLayout_;
+  plInfo.layout = *plLayout_;
   plInfo.renderPass = static_cast<PassVK*>(config.pass)->renderPass();
   plInfo.subpass = 0;
   plInfo.basePipelineHandle = VK_NULL_HANDLE;
@@ -271,17 +263,14 @@ GrStateVK::GrStateVK(const Config& config)
 
   auto res = vkCreateGraphicsPipelines(dev, cache, 1, &plInfo, nullptr,
                                        &pipeline_);
-  if (res != VK_SUCCESS) {
-    deinit();
+  if (res != VK_SUCCESS)
     throw DeviceExcept("Could not create graphics pipeline");
-  }
 }
 
 GrStateVK::~GrStateVK() {
   // TODO: Notify
   auto dev = deviceVK().device();
   vkDestroyPipeline(dev, pipeline_, nullptr);
-  vkDestroyPipelineLayout(dev, plLayout_, nullptr);
 }
 
 const GrState::Config& GrStateVK::config() const {
@@ -293,7 +282,7 @@ VkShaderStageFlags GrStateVK::stgFlags() const {
 }
 
 VkPipelineLayout GrStateVK::plLayout() {
-  return plLayout_;
+  return *plLayout_;
 }
 
 VkPipeline GrStateVK::pipeline() {
@@ -305,7 +294,8 @@ VkPipeline GrStateVK::pipeline() {
 //
 
 CpStateVK::CpStateVK(const Config& config)
-  : config_(config), plLayout_(plLayoutVK(config.dcTables)) {
+  : config_(config),
+    plLayout_(plLayoutVK(config.dcTables, config.constRanges)) {
 
   if (!config.shader || config.shader->stage() != StageCompute)
     throw invalid_argument("CpStateVK requires a compute shader");
@@ -329,23 +319,20 @@ CpStateVK::CpStateVK(const Config& config)
   plInfo.pNext = nullptr;
   plInfo.flags = 0;
   plInfo.stage = stgInfo;
-  plInfo.layout = plLayout_;
+  plInfo.layout = *plLayout_;
   plInfo.basePipelineHandle = VK_NULL_HANDLE;
   plInfo.basePipelineIndex = -1;
 
   auto res = vkCreateComputePipelines(dev, cache, 1, &plInfo, nullptr,
                                       &pipeline_);
-  if (res != VK_SUCCESS) {
-    vkDestroyPipelineLayout(dev, plLayout_, nullptr);
+  if (res != VK_SUCCESS)
     throw DeviceExcept("Could not create compute pipeline");
-  }
 }
 
 CpStateVK::~CpStateVK() {
   // TODO: Notify
   auto dev = deviceVK().device();
   vkDestroyPipeline(dev, pipeline_, nullptr);
-  vkDestroyPipelineLayout(dev, plLayout_, nullptr);
 }
 
 const CpState::Config& CpStateVK::config() const {
@@ -353,7 +340,7 @@ const CpState::Config& CpStateVK::config() const {
 }
 
 VkPipelineLayout CpStateVK::plLayout() {
-  return plLayout_;
+  return *plLayout_;
 }
 
 VkPipeline CpStateVK::pipeline() {
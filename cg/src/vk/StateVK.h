@@ -12,6 +12,7 @@
 
 #include "State.h"
 #include "VK.h"
+#include "LayoutCacheVK.h"
 
 CG_NS_BEGIN
 
@@ -31,7 +32,7 @@ class GrStateVK final : public GrState {
  private:
   const Config config_{};
   VkShaderStageFlags stgFlags_ = 0;
-  VkPipelineLayout plLayout_ = VK_NULL_HANDLE;
+  LayoutCacheVK::PlRef plLayout_{};
   VkPipeline pipeline_ = VK_NULL_HANDLE;
 };
 
@@ -49,7 +50,7 @@ class CpStateVK final : public CpState {
 
  private:
   const Config config_{};
-  VkPipelineLayout plLayout_ = VK_NULL_HANDLE;
+  LayoutCacheVK::PlRef plLayout_{};
   VkPipeline pipeline_ = VK_NULL_HANDLE;
 };
 
@@ -0,0 +1,127 @@
+//
+// CG
+// TransientVK.cxx
+//
+// Copyright © 2023 Gustavo C. Viegas.
+//
+
+#include <numeric>
+#include <stdexcept>
+
+#include "TransientVK.h"
+#include "BufferVK.h"
+#include "QueueVK.h"
+#include "DeviceVK.h"
+
+using namespace CG_NS;
+using namespace std;
+
+TransientVK::TransientVK(const Desc& desc) : TransientBuffer(desc) {
+  if (desc.size == 0)
+    throw invalid_argument("TransientVK requires size > 0");
+
+  // Offsets must satisfy the alignment of every usage
+  const auto& lim = deviceVK().limits();
+  if (usageMask() & Buffer::Uniform)
+    alignment_ = lcm(alignment_, lim.minDcUniformWriteAlignedOffset);
+  if (usageMask() & Buffer::Storage)
+    alignment_ = lcm(alignment_, lim.minDcStorageWriteAlignedOffset);
+
+  state_ = make_shared<State>();
+  state_->buffer = makeBuffer(desc.size);
+  state_->head = 0;
+  state_->tail = 0;
+}
+
+TransientVK::~TransientVK() { }
+
+TransientBuffer::Allocation TransientVK::allocate(uint64_t size,
+                                                  uint64_t alignment) {
+  if (size == 0 || alignment == 0)
+    throw invalid_argument("Invalid TransientVK::allocate() argument(s)");
+
+  alignment = lcm(alignment, alignment_);
+  auto align = [&](uint64_t x) {
+    return (x + alignment - 1) / alignment * alignment;
+  };
+
+  auto& st = *state_;
+  const auto capacity = st.buffer->size();
+  auto offset = align(st.head);
+
+  // Data in use by the device lies in the [tail, head) range, which
+  // may wrap around - the ring is empty when no group, committed or
+  // not, has allocations in the current buffer
+  const bool empty = st.open.buffer != st.buffer &&
+                     (st.committed.empty() ||
+                      st.committed.back()->buffer != st.buffer);
+  bool fits;
+  if (empty) {
+    if (offset + size > capacity)
+      offset = 0;
+    fits = offset + size <= capacity;
+    st.tail = offset;
+  } else if (st.head > st.tail) {
+    if (offset + size > capacity)
+      offset = 0;
+    fits = offset + size <= (offset == 0 ? st.tail : capacity);
+  } else {
+    fits = st.head < st.tail && offset + size <= st.tail;
+  }
+
+  if (!fits) {
+    // Replace the ring with a larger one - the current buffer is kept
+    // by the groups that use it
+    auto newCapacity = capacity << 1;
+    while (newCapacity < size)
+      newCapacity <<= 1;
+    if (st.open.buffer == st.buffer)
+      st.open.replaced.push_back(st.buffer);
+    st.buffer = makeBuffer(newCapacity);
+    offset = 0;
+    st.tail = 0;
+  }
+
+  st.head = offset + size;
+  st.open.buffer = st.buffer;
+  st.open.end = st.head;
+
+  auto data = reinterpret_cast<char*>(st.buffer->data()) + offset;
+  return {st.buffer.get(), offset, data};
+}
+
+void TransientVK::commit(CmdBuffer& cmdBuffer) {
+  auto& cb = static_cast<CmdBufferVK&>(cmdBuffer);
+  if (cb.isSecondary())
+    throw invalid_argument("TransientVK::commit() requires a primary "
+                           "command buffer");
+  if (cb.isPending())
+    throw runtime_error("Attempt to commit to a pending command buffer");
+
+  auto& st = *state_;
+  if (!st.open.buffer)
+    return;
+
+  auto group = make_shared<Group>(move(st.open));
+  st.open = Group();
+  st.committed.push_back(group);
+
+  cb.onCompletion([state = state_, group] {
+    group->done = true;
+    auto& committed = state->committed;
+    while (!committed.empty() && committed.front()->done) {
+      if (committed.front()->buffer == state->buffer)
+        state->tail = committed.front()->end;
+      committed.pop_front();
+    }
+  });
+}
+
+uint64_t TransientVK::size() const {
+  return state_->buffer->size();
+}
+
+shared_ptr<BufferVK> TransientVK::makeBuffer(uint64_t size) {
+  return make_shared<BufferVK>(Buffer::Desc{size, Buffer::Shared,
+                                            usageMask()});
+}
@@ -0,0 +1,65 @@
+//
+// CG
+// TransientVK.h
+//
+// Copyright © 2023 Gustavo C. Viegas.
+//
+
+#ifndef YF_CG_TRANSIENTVK_H
+#define YF_CG_TRANSIENTVK_H
+
+#include <memory>
+#include <vector>
+#include <deque>
+
+#include "TransientBuffer.h"
+#include "VK.h"
+
+CG_NS_BEGIN
+
+class BufferVK;
+
+class TransientVK final : public TransientBuffer {
+ public:
+  TransientVK(const Desc& desc);
+  ~TransientVK();
+
+  Allocation allocate(uint64_t size, uint64_t alignment);
+  void commit(CmdBuffer& cmdBuffer);
+  uint64_t size() const;
+
+ private:
+  /// Allocations committed together.
+  ///
+  /// Groups hold the buffers of their allocations, so that buffers in
+  /// use by the device outlive both the ring and the transient buffer.
+  ///
+  struct Group {
+    std::shared_ptr<BufferVK> buffer{};
+    std::vector<std::shared_ptr<BufferVK>> replaced{};
+    uint64_t end = 0;
+    bool done = false;
+  };
+
+  /// Ring state, which is shared with completion handlers.
+  ///
+  /// Groups occupy the ring in commit order, so space is reclaimed in
+  /// that order too, even if command buffers complete in another.
+  ///
+  struct State {
+    std::shared_ptr<BufferVK> buffer;
+    uint64_t head;
+    uint64_t tail;
+    std::deque<std::shared_ptr<Group>> committed;
+    Group open;
+  };
+
+  std::shared_ptr<State> state_{};
+  uint64_t alignment_ = 1;
+
+  std::shared_ptr<BufferVK> makeBuffer(uint64_t size);
+};
+
+CG_NS_END
+
+#endif // YF_CG_TRANSIENTVK_H
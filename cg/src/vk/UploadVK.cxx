@@ -0,0 +1,103 @@
+//
+// CG
+// UploadVK.cxx
+//
+// Copyright © 2023 Gustavo C. Viegas.
+//
+
+#include <cassert>
+
+#include "UploadVK.h"
+#include "QueueVK.h"
+#include "DeviceVK.h"
+#include "yf/Except.h"
+
+using namespace CG_NS;
+using namespace std;
+
+UploadVK::UploadVK(QueueVK& queue, QueueVK* transferQueue,
+                   VkExtent3D granularity)
+  : queue_(queue), transferQueue_(transferQueue), granularity_(granularity) {
+
+  assert(&queue != transferQueue);
+}
+
+void UploadVK::encode(const function<void (VkCommandBuffer)>& encode,
+                      function<void (bool)> completionHandler,
+                      bool granular) {
+
+  auto& que = queue(granular);
+  if (&que == &queue_) {
+    que.encodePriority(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, encode,
+                       completionHandler);
+    return;
+  }
+
+  que.encodePriority(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                     [&](VkCommandBuffer cbuf) {
+    encode(cbuf);
+    encoded_.fetch_add(1, memory_order_release);
+  }, completionHandler);
+}
+
+bool UploadVK::isGranular(const VkOffset3D& offset, const VkExtent3D& extent,
+                          const VkExtent3D& levelExtent) const {
+
+  // A zero granularity only allows whole subresources to be copied
+  auto check = [](uint32_t off, uint32_t ext, uint32_t levelExt,
+                  uint32_t gran) {
+    if (gran == 0)
+      return off == 0 && ext == levelExt;
+    return off % gran == 0 &&
+           (ext % gran == 0 || off + ext == levelExt);
+  };
+
+  return check(offset.x, extent.width, levelExtent.width,
+               granularity_.width) &&
+         check(offset.y, extent.height, levelExtent.height,
+               granularity_.height) &&
+         check(offset.z, extent.depth, levelExtent.depth,
+               granularity_.depth);
+}
+
+void UploadVK::flush() {
+  if (!transferQueue_)
+    return;
+
+  lock_guard<mutex> lock(mutex_);
+
+  // Uploads encoded after this point may be submitted as well, in
+  // which case the next flush submits an empty batch
+  const auto encoded = encoded_.load(memory_order_acquire);
+  if (encoded == flushed_)
+    return;
+
+  auto dev = deviceVK().device();
+
+  VkSemaphoreCreateInfo info;
+  info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  info.pNext = nullptr;
+  info.flags = 0;
+
+  VkSemaphore sem;
+  if (vkCreateSemaphore(dev, &info, nullptr, &sem) != VK_SUCCESS)
+    throw DeviceExcept("Could not create semaphore for uploads");
+
+  transferQueue_->signal(sem);
+  try {
+    transferQueue_->submit();
+  } catch (...) {
+    vkDestroySemaphore(dev, sem, nullptr);
+    throw;
+  }
+  flushed_ = encoded;
+
+  queue_.waitFor(sem, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+  queue_.onCompletion([sem](bool) {
+    vkDestroySemaphore(deviceVK().device(), sem, nullptr);
+  });
+}
+
+QueueVK& UploadVK::queue(bool granular) {
+  return transferQueue_ && granular ? *transferQueue_ : queue_;
+}
@@ -0,0 +1,84 @@
+//
+// CG
+// UploadVK.h
+//
+// Copyright © 2023 Gustavo C. Viegas.
+//
+
+#ifndef YF_CG_UPLOADVK_H
+#define YF_CG_UPLOADVK_H
+
+#include <cstdint>
+#include <atomic>
+#include <functional>
+#include <mutex>
+
+#include "Defs.h"
+#include "VK.h"
+
+CG_NS_BEGIN
+
+class QueueVK;
+
+/// Scheduler of staging copies.
+///
+/// When the device exposes a transfer-only queue, uploads are encoded
+/// there and flushed in batches, each signaling a semaphore upon which
+/// the next submission of the default queue waits. Otherwise, uploads
+/// are encoded in the default queue itself.
+///
+/// Image copies that do not satisfy the minimum image transfer
+/// granularity of the transfer queue are encoded in the default queue.
+///
+class UploadVK {
+ public:
+  /// `granularity` is the minimum image transfer granularity of the
+  /// transfer queue's family.
+  ///
+  UploadVK(QueueVK& queue, QueueVK* transferQueue,
+           VkExtent3D granularity = {1, 1, 1});
+  UploadVK(const UploadVK&) = delete;
+  UploadVK& operator=(const UploadVK&) = delete;
+  ~UploadVK() = default;
+
+  /// Encodes upload commands.
+  ///
+  /// This can be called from any thread. Commands are recorded in the
+  /// calling thread's priority command buffer of `queue(granular)`.
+  ///
+  void encode(const std::function<void (VkCommandBuffer)>& encode,
+              std::function<void (bool)> completionHandler,
+              bool granular = true);
+
+  /// Checks whether an image copy can be encoded in the transfer queue.
+  ///
+  /// Values are given in texel blocks. `levelExtent` is the extent of
+  /// the image subresource being copied to.
+  ///
+  bool isGranular(const VkOffset3D& offset, const VkExtent3D& extent,
+                  const VkExtent3D& levelExtent) const;
+
+  /// Submits the uploads encoded so far.
+  ///
+  /// This is called by the default queue before it submits.
+  ///
+  void flush();
+
+  /// Gets the queue in which uploads are encoded.
+  ///
+  /// Uploads that are not `granular` are encoded in the default queue.
+  ///
+  QueueVK& queue(bool granular = true);
+
+ private:
+  QueueVK& queue_;
+  QueueVK* transferQueue_ = nullptr;
+  VkExtent3D granularity_{1, 1, 1};
+  std::atomic<uint64_t> encoded_{0};
+  uint64_t flushed_ = 0;
+  std::mutex mutex_{};
+};
+
+CG_NS_END
+
+#endif // YF_CG_UPLOADVK_H
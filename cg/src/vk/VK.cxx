@@ -205,6 +205,9 @@ void CG_NS::setProcsVK(VkDevice device) {
   CG_DEVPROCVK(device, vkBindImageMemory);
   CG_DEVPROCVK(device, vkCreateSampler);
   CG_DEVPROCVK(device, vkDestroySampler);
+  CG_DEVPROCVK(device, vkCreateQueryPool);
+  CG_DEVPROCVK(device, vkDestroyQueryPool);
+  CG_DEVPROCVK(device, vkGetQueryPoolResults);
   CG_DEVPROCVK(device, vkCreateDescriptorSetLayout);
   CG_DEVPROCVK(device, vkDestroyDescriptorSetLayout);
   CG_DEVPROCVK(device, vkGetDescriptorSetLayoutSupport);
@@ -246,6 +249,11 @@ void CG_NS::setProcsVK(VkDevice device) {
   CG_DEVPROCVK(device, vkCmdSetBlendConstants);
   CG_DEVPROCVK(device, vkCmdDispatch);
   CG_DEVPROCVK(device, vkCmdDispatchIndirect);
+  CG_DEVPROCVK(device, vkCmdResetQueryPool);
+  CG_DEVPROCVK(device, vkCmdBeginQuery);
+  CG_DEVPROCVK(device, vkCmdEndQuery);
+  CG_DEVPROCVK(device, vkCmdWriteTimestamp);
+  CG_DEVPROCVK(device, vkCmdCopyQueryPoolResults);
   CG_DEVPROCVK(device, vkCreateSwapchainKHR);
   CG_DEVPROCVK(device, vkDestroySwapchainKHR);
   CG_DEVPROCVK(device, vkGetSwapchainImagesKHR);
@@ -368,6 +376,9 @@ CG_DEFVK(vkBindBufferMemory);
 CG_DEFVK(vkBindImageMemory);
 CG_DEFVK(vkCreateSampler);
 CG_DEFVK(vkDestroySampler);
+CG_DEFVK(vkCreateQueryPool);
+CG_DEFVK(vkDestroyQueryPool);
+CG_DEFVK(vkGetQueryPoolResults);
 CG_DEFVK(vkCreateDescriptorSetLayout);
 CG_DEFVK(vkDestroyDescriptorSetLayout);
 CG_DEFVK(vkGetDescriptorSetLayoutSupport); // 1.1
@@ -409,6 +420,11 @@ CG_DEFVK(vkCmdSetStencilReference);
 CG_DEFVK(vkCmdSetBlendConstants);
 CG_DEFVK(vkCmdDispatch);
 CG_DEFVK(vkCmdDispatchIndirect);
+CG_DEFVK(vkCmdResetQueryPool);
+CG_DEFVK(vkCmdBeginQuery);
+CG_DEFVK(vkCmdEndQuery);
+CG_DEFVK(vkCmdWriteTimestamp);
+CG_DEFVK(vkCmdCopyQueryPoolResults);
 CG_DEFVK(vkCreateSwapchainKHR); // VK_KHR_swapchain
 CG_DEFVK(vkDestroySwapchainKHR); // VK_KHR_swapchain
 CG_DEFVK(vkGetSwapchainImagesKHR); // VK_KHR_swapchain
@@ -163,6 +163,9 @@ CG_DECLVK(vkBindBufferMemory);
 CG_DECLVK(vkBindImageMemory);
 CG_DECLVK(vkCreateSampler);
 CG_DECLVK(vkDestroySampler);
+CG_DECLVK(vkCreateQueryPool);
+CG_DECLVK(vkDestroyQueryPool);
+CG_DECLVK(vkGetQueryPoolResults);
 CG_DECLVK(vkCreateDescriptorSetLayout);
 CG_DECLVK(vkDestroyDescriptorSetLayout);
 CG_DECLVK(vkGetDescriptorSetLayoutSupport); // 1.1
@@ -204,6 +207,11 @@ CG_DECLVK(vkCmdSetStencilReference);
 CG_DECLVK(vkCmdSetBlendConstants);
 CG_DECLVK(vkCmdDispatch);
 CG_DECLVK(vkCmdDispatchIndirect);
+CG_DECLVK(vkCmdResetQueryPool);
+CG_DECLVK(vkCmdBeginQuery);
+CG_DECLVK(vkCmdEndQuery);
+CG_DECLVK(vkCmdWriteTimestamp);
+CG_DECLVK(vkCmdCopyQueryPoolResults);
 CG_DECLVK(vkCreateSwapchainKHR); // VK_KHR_swapchain
 CG_DECLVK(vkDestroySwapchainKHR); // VK_KHR_swapchain
 CG_DECLVK(vkGetSwapchainImagesKHR); // VK_KHR_swapchain
@@ -28,16 +28,20 @@ struct DcTableTest : Test {
       void write(uint32_t, DcId, uint32_t, Image&, uint32_t, uint32_t) { }
       void write(uint32_t, DcId, uint32_t, Image&, uint32_t, uint32_t,
                  Sampler&) { }
+      void begin() { }
+      void commit() { }
       const vector<DcEntry>& entries() const { return entries_; }
     };
 
     Assertions a;
 
     const vector<DcEntry> ents1{{4, DcTypeStorage, 1}, {2, DcTypeUniform, 1},
-                                {0, DcTypeImgSampler, 8}};
+                                {0, DcTypeImgSampler, 8},
+                                {3, DcTypeUniformDynamic, 2}};
     DcTable_ tab1(ents1);
 
-    const vector<DcEntry> ents2{{6, DcTypeImage, 32}};
+    const vector<DcEntry> ents2{{6, DcTypeImage, 32},
+                                {7, DcTypeImgSamplerArray, 1024}};
     DcTable_ tab2(ents2);
 
     bool chk = true;
@@ -48,13 +52,18 @@ struct DcTableTest : Test {
         chk = false;
       else if (e.id == 4 && (e.type != DcTypeStorage || e.elements != 1))
         chk = false;
+      else if (e.id == 3 &&
+               (e.type != DcTypeUniformDynamic || e.elements != 2))
+        chk = false;
     }
-    a.push_back({L"DcTable(ents1)", tab1.entries().size() == 3 && chk});
+    a.push_back({L"DcTable(ents1)", tab1.entries().size() == 4 && chk});
 
     a.push_back({L"DcTable(ents2)",
-                 tab2.entries().size() == 1 &&
+                 tab2.entries().size() == 2 &&
                  tab2.entries()[0].type == DcTypeImage &&
-                 tab2.entries()[0].elements == 32});
+                 tab2.entries()[0].elements == 32 &&
+                 tab2.entries()[1].type == DcTypeImgSamplerArray &&
+                 tab2.entries()[1].elements == 1024});
 
     return a;
   }
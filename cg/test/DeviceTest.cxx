@@ -24,6 +24,7 @@ struct DeviceTest : Test {
 
     auto& dev = device();
     auto& que = dev.defaultQueue();
+    auto& xferQue = dev.queue(Queue::Transfer);
     auto win = WS_NS::createWindow(400, 400, name_, WS_NS::Window::Resizable);
     auto wsi = dev.wsi(*win);
 
@@ -31,6 +32,8 @@ struct DeviceTest : Test {
 
     a.push_back({L"device()", true});
     a.push_back({L"dev.defaultQueue()", que.capabilities() != 0});
+    a.push_back({L"dev.queue(Transfer)",
+                 (xferQue.capabilities() & Queue::Transfer) != 0});
     a.push_back({L"dev.wsi(...)", wsi != nullptr});
 
     return a;
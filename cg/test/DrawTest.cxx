@@ -113,7 +113,8 @@ struct DrawTest : Test {
       TopologyTriangle,
       PolyModeFill,
       CullModeBack,
-      WindingCounterCw
+      WindingCounterCw,
+      {}
     };
     auto state = dev.state(config);
 
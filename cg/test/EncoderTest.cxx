@@ -5,6 +5,8 @@
 // Copyright © 2020-2023 Gustavo C. Viegas.
 //
 
+#include <cstring>
+
 #include "Test.h"
 #include "Encoder.h"
 #include "Device.h"
@@ -19,6 +21,64 @@ INTERNAL_NS_BEGIN
 struct EncoderTest : Test {
   EncoderTest() : Test(L"Encoder") { }
 
+  /// Encodes repeated binds that would not change the bound state and
+  /// checks that the command buffer dropped them.
+  ///
+  bool dropped() {
+    const vector<AttachDesc> desc{{Format::Rgba8Unorm, Samples1}};
+    auto pass = device().pass(&desc, nullptr, nullptr);
+    auto img = device().image({Format::Rgba8Unorm, {64, 64, 1}, 1, Samples1,
+                               Image::Dim2, Image::Attachment});
+    const vector<AttachImg> att{{img.get(), 0, 0}};
+    auto tgt = pass->target({64, 64}, 1, &att, nullptr, nullptr);
+
+    auto buf = device().buffer({1 << 12, Buffer::Shared, Buffer::Uniform |
+                                                         Buffer::Index |
+                                                         Buffer::Vertex});
+
+    auto vert = device().shader({StageVertex, "main", "test/data/vert"});
+    auto dtb = device().dcTable({{0, DcTypeUniform, 1}});
+    dtb->allocate(1);
+    dtb->write(0, 0, 0, *buf, 0, 64);
+    const VxInput vxIn{
+      {{0, VxFormatFlt3, 0}, {1, VxFormatFlt2, 12}}, 20, VxStepFnVertex
+    };
+    const GrState::Config conf{
+      pass.get(), {vert.get()}, {dtb.get()}, {vxIn},
+      TopologyTriangle, PolyModeFill, CullModeBack, WindingCounterCw, {}
+    };
+    auto gst = device().state(conf);
+
+    TargetOp tgtOp;
+    tgtOp.colorOps.push_back({LoadOpClear, StoreOpStore});
+    tgtOp.colorValues.push_back({0.0f, 0.0f, 0.0f, 1.0f});
+
+    const uint32_t repeat = 3;
+    GrEncoder enc;
+    for (uint32_t i = 0; i < repeat; i++) {
+      enc.setViewport({0.0f, 0.0f, 64.0f, 64.0f, 0.0f, 1.0f});
+      enc.setScissor({{}, {64, 64}});
+    }
+    enc.setTarget(*tgt, tgtOp);
+    enc.setState(*gst);
+    for (uint32_t i = 0; i < repeat; i++) {
+      enc.setDcTable(0, 0);
+      enc.setVertexBuffer(*buf, 256, 0);
+      enc.setIndexBuffer(*buf, 512, IndexTypeU16);
+    }
+    enc.drawIndexed(0, 3, 0, 0, 1);
+
+    auto cb = device().defaultQueue().cmdBuffer();
+    cb->encode(enc);
+    cb->enqueue();
+    device().defaultQueue().submit();
+
+    const auto drp = cb->dropped();
+    return drp.viewports == repeat - 1 && drp.scissors == repeat - 1 &&
+           drp.vxBuffers == repeat - 1 && drp.ixBuffers == repeat - 1 &&
+           drp.dcTables == repeat - 1;
+  }
+
   Assertions run(const vector<string>&) {
     Assertions a;
 
@@ -37,12 +97,13 @@ struct EncoderTest : Test {
     };
     const GrState::Config gconf{
       pass.get(), {vert.get()}, {dtb.get()}, {vxIn},
-      TopologyTriangle, PolyModeFill, CullModeBack, WindingCounterCw
+      TopologyTriangle, PolyModeFill, CullModeBack, WindingCounterCw,
+      {{StageVertex, 0, 16}}
     };
     auto gst = device().state(gconf);
 
     auto comp = device().shader({StageCompute, "main", "test/data/comp"});
-    const CpState::Config cconf{comp.get(), {}};
+    const CpState::Config cconf{comp.get(), {}, {{StageCompute, 0, 8}}};
     auto cst = device().state(cconf);
 
     auto buf = device().buffer({1 << 14, Buffer::Shared, Buffer::CopySrc |
@@ -60,20 +121,31 @@ struct EncoderTest : Test {
     enc1.setTarget(*tgt, tgtOp);
     enc1.setState(*gst);
     enc1.setDcTable(1, 15);
+    const float consts[] = {1.0f, 2.0f, 3.0f, 4.0f};
+    enc1.setConstants(StageVertex, 0, sizeof consts, consts);
     enc1.setVertexBuffer(*buf, 128, 0);
     enc1.setIndexBuffer(*buf, 256, IndexTypeU16);
     enc1.draw(0, 3, 0, 1);
     enc1.drawIndexed(6, 36, -6, 10, 50);
+    auto subCb = device().defaultQueue().subBuffer();
+    enc1.execute(*subCb);
 
     CpEncoder enc2;
     enc2.setState(*cst);
     enc2.setDcTable(0, 0);
     enc2.setDcTable(1, 20);
+    enc2.setDcTable(2, 3, {256, 768});
+    const uint32_t index = 42;
+    enc2.setConstants(StageCompute, 4, sizeof index, &index);
     enc2.dispatch({64, 64, 16});
 
+    auto qpool = device().queryPool({QueryPool::Timestamp, 4});
+
     TfEncoder enc3;
     enc3.copy(*buf, 3002, *buf, 60, 4096);
     enc3.copy(*img, {64, 32}, 4, 2, *img, {192, 16}, 1, 2, {64, 64}, 3);
+    enc3.resetQueries(*qpool, 1, 3);
+    enc3.copyQueries(*buf, 512, *qpool, 1, 2);
 
     wstring str;
     bool chk;
@@ -102,7 +174,15 @@ struct EncoderTest : Test {
       case Cmd::DcTableT: {
         auto sub = static_cast<DcTableCmd*>(cmd.get());
         str = L"Cmd::DcTableT";
-        chk = sub->tableIndex == 1 && sub->allocIndex == 15;
+        chk = sub->tableIndex == 1 && sub->allocIndex == 15 &&
+              sub->dynamicOffsets.empty();
+      } break;
+      case Cmd::ConstT: {
+        auto sub = static_cast<ConstCmd*>(cmd.get());
+        str = L"Cmd::ConstT";
+        chk = sub->stageMask == StageVertex && sub->offset == 0 &&
+              sub->data.size() == sizeof consts &&
+              memcmp(sub->data.data(), consts, sizeof consts) == 0;
       } break;
       case Cmd::VxBufferT: {
         auto sub = static_cast<VxBufferCmd*>(cmd.get());
@@ -129,6 +209,10 @@ struct EncoderTest : Test {
               sub->vertexOffset == -6 && sub->baseInstance == 10 &&
               sub->instanceCount == 50;
       } break;
+      case Cmd::ExecuteT:
+        str = L"Cmd::ExecuteT";
+        chk = &static_cast<ExecuteCmd*>(cmd.get())->subBuffer == subCb.get();
+        break;
       default:
         str = L"#Invalid Cmd#";
         chk = false;
@@ -147,7 +231,16 @@ struct EncoderTest : Test {
         auto sub = static_cast<DcTableCmd*>(cmd.get());
         str = L"Cmd::DcTableT";
         chk = (sub->tableIndex == 0 && sub->allocIndex == 0) ||
-              (sub->tableIndex == 1 && sub->allocIndex == 20);
+              (sub->tableIndex == 1 && sub->allocIndex == 20) ||
+              (sub->tableIndex == 2 && sub->allocIndex == 3 &&
+               sub->dynamicOffsets == vector<uint32_t>{256, 768});
+      } break;
+      case Cmd::ConstT: {
+        auto sub = static_cast<ConstCmd*>(cmd.get());
+        str = L"Cmd::ConstT";
+        chk = sub->stageMask == StageCompute && sub->offset == 4 &&
+              sub->data.size() == sizeof index &&
+              memcmp(sub->data.data(), &index, sizeof index) == 0;
       } break;
       case Cmd::DispatchT:
         str = L"Cmd::DispatchT";
@@ -180,6 +273,17 @@ struct EncoderTest : Test {
               sub->srcLevel == 2 &&
               sub->size == Size2{64, 64} && sub->layerCount == 3;
       } break;
+      case Cmd::ResetQueriesT: {
+        auto sub = static_cast<ResetQueriesCmd*>(cmd.get());
+        str = L"Cmd::ResetQueriesT";
+        chk = &sub->pool == qpool.get() && sub->first == 1 && sub->count == 3;
+      } break;
+      case Cmd::CopyQueriesT: {
+        auto sub = static_cast<CopyQueriesCmd*>(cmd.get());
+        str = L"Cmd::CopyQueriesT";
+        chk = &sub->dst == buf.get() && sub->dstOffset == 512 &&
+              &sub->pool == qpool.get() && sub->first == 1 && sub->count == 2;
+      } break;
       default:
         str = L"#Invalid Cmd#";
         chk = false;
@@ -187,6 +291,8 @@ struct EncoderTest : Test {
       a.push_back({str, chk});
     }
 
+    a.push_back({L"CmdBuffer::dropped()", dropped()});
+
     return a;
   }
 };
@@ -45,6 +45,15 @@ struct ImageTest : Test {
                  img.usageMask() == (Image::CopyDst | Image::Sampled |
                                      Image::CopySrc)});
 
+    a.push_back({L"Image::texelSize(), Image::blockSize()",
+                 Image::texelSize(Format::Rgba8Srgb) == 4 &&
+                 Image::blockSize(Format::Rgba8Srgb) == Size2(1, 1) &&
+                 Image::texelSize(Format::Bc1Srgb) == 8 &&
+                 Image::texelSize(Format::Bc4Norm) == 8 &&
+                 Image::texelSize(Format::Bc5Unorm) == 16 &&
+                 Image::texelSize(Format::Bc7Srgb) == 16 &&
+                 Image::blockSize(Format::Bc3Unorm) == Size2(4, 4)});
+
     return a;
   }
 };
@@ -54,9 +54,15 @@ struct LimitsTest : Test {
           << lim.minDcStorageWriteAlignedOffset
           << "\n maxDcStorageWriteSize          = "
           << lim.maxDcStorageWriteSize
+          << "\n maxDcImgSamplerArray           = "
+          << lim.maxDcImgSamplerArray
+          << "\n"
+          << "\n maxConstSize = " << lim.maxConstSize
           << "\n"
           << "\n maxVxInputs = " << lim.maxVxInputs
           << "\n maxVxAttrs  = " << lim.maxVxAttrs
+          << "\n"
+          << "\n timestampPeriod = " << lim.timestampPeriod
           << "\n";
 
     return {{L"device().limits()", true}};
@@ -0,0 +1,96 @@
+//
+// CG
+// QueryTest.cxx
+//
+// Copyright © 2023 Gustavo C. Viegas.
+//
+
+#include "Test.h"
+#include "Query.h"
+#include "Device.h"
+#include "Encoder.h"
+#include "yf/Except.h"
+
+using namespace YF_NS;
+using namespace TEST_NS;
+using namespace CG_NS;
+using namespace std;
+
+INTERNAL_NS_BEGIN
+
+struct QueryTest : Test {
+  QueryTest() : Test(L"Query") { }
+
+  Assertions run(const vector<string>&) {
+    Assertions a;
+    auto& dev = device();
+
+    auto tsPool = dev.queryPool({QueryPool::Timestamp, 4});
+    a.push_back({L"queryPool({Timestamp, 4})",
+                 tsPool->type() == QueryPool::Timestamp &&
+                 tsPool->count() == 4 && tsPool->statisticMask() == 0 &&
+                 tsPool->resultCount() == 1});
+
+    auto occPool = dev.queryPool({QueryPool::Occlusion, 16});
+    a.push_back({L"queryPool({Occlusion, 16})",
+                 occPool->type() == QueryPool::Occlusion &&
+                 occPool->count() == 16 && occPool->resultCount() == 1});
+
+    try {
+      const auto mask = QueryPool::InputVertices |
+                        QueryPool::FragmentInvocations |
+                        QueryPool::ComputeInvocations;
+      auto stPool = dev.queryPool({QueryPool::Statistics, 2, mask});
+      a.push_back({L"queryPool({Statistics, 2, mask})",
+                   stPool->type() == QueryPool::Statistics &&
+                   stPool->count() == 2 && stPool->statisticMask() == mask &&
+                   stPool->resultCount() == 3});
+    } catch (const UnsupportedExcept&) {
+      // Pipeline statistics are an optional feature
+    }
+
+    auto invalid = [&](const QueryPool::Desc& desc) {
+      try {
+        dev.queryPool(desc);
+      } catch (const invalid_argument&) {
+        return true;
+      }
+      return false;
+    };
+    a.push_back({L"queryPool() invalid desc",
+                 invalid({QueryPool::Timestamp, 0}) &&
+                 invalid({QueryPool::Statistics, 1, 0}) &&
+                 invalid({QueryPool::Statistics, 1, 0x80})});
+
+    // Timestamps written and copied in a single submission
+    auto& que = dev.defaultQueue();
+    auto buf = dev.buffer({32, Buffer::Shared, Buffer::Query});
+    auto cb = que.cmdBuffer();
+
+    TfEncoder enc;
+    enc.resetQueries(*tsPool, 0, 4);
+    enc.writeTimestamp(*tsPool, 0);
+    enc.writeTimestamp(*tsPool, 1);
+    enc.copyQueries(*buf, 0, *tsPool, 0, 2);
+    cb->encode(enc);
+    cb->enqueue();
+    que.submit();
+
+    uint64_t results[2]{};
+    a.push_back({L"read()", tsPool->read(0, 2, results) &&
+                            results[1] >= results[0]});
+
+    return a;
+  }
+};
+
+INTERNAL_NS_END
+
+TEST_NS_BEGIN
+
+Test* queryTest() {
+  static QueryTest test;
+  return &test;
+}
+
+TEST_NS_END
@@ -34,6 +34,7 @@ struct QueueTest : Test {
      public:
       Queue_(CapabilityMask capab) : capab_(capab) { }
       CmdBuffer::Ptr cmdBuffer() { return make_unique<CmdBuffer_>(*this); }
+      CmdBuffer::Ptr subBuffer() { return make_unique<CmdBuffer_>(*this); }
       void submit() { }
       CapabilityMask capabilities() const { return capab_; }
     };
@@ -43,6 +44,7 @@ struct QueueTest : Test {
     Queue_ q1(Queue::Graphics | Queue::Transfer);
     Queue_ q2(Queue::Compute);
     auto cb = q1.cmdBuffer();
+    auto sb = q2.subBuffer();
 
     a.push_back({L"Queue q1(Graphics | Transfer)",
                  q1.capabilities() == (Queue::Graphics | Queue::Transfer)});
@@ -50,6 +52,8 @@ struct QueueTest : Test {
     a.push_back({L"cb = q1.cmdBuffer()", cb != nullptr});
     a.push_back({L"&cb->queue() == &q1", &cb->queue() == &q1});
     a.push_back({L"&cb->queue() == &q2", &cb->queue() != &q2});
+    a.push_back({L"sb = q2.subBuffer()", sb != nullptr});
+    a.push_back({L"&sb->queue() == &q2", &sb->queue() == &q2});
 
     return a;
   }
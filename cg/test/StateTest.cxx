@@ -45,7 +45,7 @@ struct StateTest : Test {
     gc.winding = WindingCounterCw;
     GrState_ gs(gc);
 
-    CpState::Config cc{nullptr, {}};
+    CpState::Config cc{nullptr, {}, {}};
     CpState_ cs(cc);
 
     a.push_back({L"GrState(config)",
@@ -62,7 +62,8 @@ struct StateTest : Test {
 
     a.push_back({L"CpState(config)",
                  cs.config().shader == nullptr &&
-                 cs.config().dcTables.empty()});
+                 cs.config().dcTables.empty() &&
+                 cs.config().constRanges.empty()});
 
     return a;
   }
@@ -0,0 +1,101 @@
+//
+// CG
+// TransientTest.cxx
+//
+// Copyright © 2023 Gustavo C. Viegas.
+//
+
+#include <cstring>
+
+#include "Test.h"
+#include "TransientBuffer.h"
+#include "Device.h"
+#include "Encoder.h"
+
+using namespace TEST_NS;
+using namespace CG_NS;
+using namespace std;
+
+INTERNAL_NS_BEGIN
+
+struct TransientTest : Test {
+  TransientTest() : Test(L"TransientBuffer") { }
+
+  Assertions run(const vector<string>&) {
+    Assertions a;
+
+    auto tb = device().transientBuffer({4096, Buffer::Uniform});
+    const auto alignment = device().limits().minDcUniformWriteAlignedOffset;
+
+    // Allocations are aligned, mapped and disjoint
+    bool allocChk = tb->usageMask() == Buffer::Uniform && tb->size() == 4096;
+    uint64_t end = 0;
+    for (const uint64_t size : {1, 100, 256, 64}) {
+      auto alloc = tb->allocate(size);
+      allocChk &= alloc.buffer && alloc.data &&
+                  alloc.offset % alignment == 0 && alloc.offset >= end &&
+                  alloc.offset + size <= alloc.buffer->size();
+      memset(alloc.data, 0xFF, size);
+      end = alloc.offset + size;
+    }
+    a.push_back({L"allocate()", allocChk});
+
+    // The ring grows instead of failing when exhausted
+    auto alloc = tb->allocate(10'000, 16);
+    a.push_back({L"allocate() (grow)",
+                 tb->size() >= 10'000 && alloc.offset % 16 == 0 &&
+                 alloc.offset + 10'000 <= alloc.buffer->size()});
+
+    // Space is reclaimed only when the command buffer that allocations
+    // were committed to completes, regardless of other submissions
+    auto& que = device().defaultQueue();
+    auto src = device().buffer({64, Buffer::Shared, Buffer::CopySrc});
+    auto dst = device().buffer({64, Buffer::Shared, Buffer::CopyDst});
+    TfEncoder enc;
+    enc.copy(*dst, 0, *src, 0, 64);
+
+    auto tb2 = device().transientBuffer({4096, Buffer::Uniform});
+    auto alloc1 = tb2->allocate(3000);
+    memset(alloc1.data, 0xAB, 3000);
+
+    auto cb1 = que.cmdBuffer();
+    cb1->encode(enc);
+    cb1->enqueue();
+    que.submit();
+
+    auto alloc2 = tb2->allocate(2000);
+    bool intact = true;
+    for (size_t i = 0; i < 3000; i++)
+      intact &= reinterpret_cast<unsigned char*>(alloc1.data)[i] == 0xAB;
+    a.push_back({L"allocate() (unrelated submit)",
+                 intact &&
+                 (alloc2.buffer != alloc1.buffer ||
+                  alloc2.offset >= alloc1.offset + 3000 ||
+                  alloc2.offset + 2000 <= alloc1.offset)});
+
+    auto cb2 = que.cmdBuffer();
+    tb2->commit(*cb2);
+    cb2->encode(enc);
+    cb2->enqueue();
+    que.submit();
+
+    const auto size = tb2->size();
+    auto alloc3 = tb2->allocate(size);
+    a.push_back({L"commit()",
+                 tb2->size() == size && alloc3.offset == 0 &&
+                 alloc3.buffer == alloc2.buffer});
+
+    return a;
+  }
+};
+
+INTERNAL_NS_END
+
+TEST_NS_BEGIN
+
+Test* transientTest() {
+  static TransientTest test;
+  return &test;
+}
+
+TEST_NS_END
@@ -23,6 +23,7 @@ Test* typesTest();
 Test* deviceTest();
 Test* queueTest();
 Test* bufferTest();
+Test* transientTest();
 Test* imageTest();
 Test* shaderTest();
 Test* dcTableTest();
@@ -33,6 +34,7 @@ Test* wsiTest();
 Test* limitsTest();
 Test* drawTest();
 Test* copyTest();
+Test* queryTest();
 
 using TestFn = std::function<Test* ()>;
 using TestID = std::pair<std::string, std::vector<TestFn>>;
@@ -41,6 +43,7 @@ const std::vector<TestID> TIDs{
   TestID("device", {deviceTest}),
   TestID("queue", {queueTest}),
   TestID("buffer", {bufferTest}),
+  TestID("transient", {transientTest}),
   TestID("image", {imageTest}),
   TestID("shader", {shaderTest}),
   TestID("dctable", {dcTableTest}),
@@ -51,9 +54,11 @@ const std::vector<TestID> TIDs{
   TestID("limits", {limitsTest}),
   TestID("draw", {drawTest}),
   TestID("copy", {copyTest}),
-  TestID("all", {typesTest, deviceTest, queueTest, bufferTest, imageTest,
-                 shaderTest, dcTableTest, passTest, stateTest, encoderTest,
-                 wsiTest, limitsTest, drawTest, copyTest})
+  TestID("query", {queryTest}),
+  TestID("all", {typesTest, deviceTest, queueTest, bufferTest, transientTest,
+                 imageTest, shaderTest, dcTableTest, passTest, stateTest,
+                 encoderTest, wsiTest, limitsTest, drawTest, copyTest,
+                 queryTest})
 };
 
 inline std::vector<Test*> unitTests(const std::string& id) {
@@ -26,7 +26,7 @@ SG_NS_BEGIN
 ///
 class Collection {
  public:
-  Collection(const std::string& pathname);
+  Collection(const std::string& pathname, bool mipmaps = false);
   Collection();
   Collection(const Collection&) = delete;
   Collection(Collection&&);
@@ -36,7 +36,44 @@ class Collection {
 
   /// Loads collection from file.
   ///
-  void load(const std::string& pathname);
+  /// Both glTF and cooked collection files are accepted. If `mipmaps` is
+  /// set, full mip chains are generated for glTF images - cooked files
+  /// are loaded with the levels they were cooked with.
+  ///
+  void load(const std::string& pathname, bool mipmaps = false);
+
+  /// Block compression of cooked images.
+  ///
+  enum Compression {
+    /// Images are stored as decoded.
+    ///
+    Uncompressed,
+
+    /// BC1 is used, unless the image has partial transparency, in which
+    /// case BC3 is used.
+    ///
+    Standard,
+
+    /// BC7 is used.
+    ///
+    High
+  };
+
+  /// Converts a glTF file into a cooked collection file.
+  ///
+  /// Cooked files store contents in a form that is ready for use (e.g.,
+  /// decoded images and vertex streams), so they can be loaded with
+  /// minimal processing. If `mipmaps` is set, images are stored with
+  /// their full mip chains. Images are encoded as given by `compression`,
+  /// with `quality` ranging from zero (fastest) to one (most exhaustive
+  /// search). Compression requires images of 8-bit RGB, RGBA or BGRA
+  /// formats - if any image has another format, `UnsupportedExcept` is
+  /// thrown.
+  ///
+  static void cook(const std::string& srcPathname,
+                   const std::string& dstPathname, bool mipmaps = false,
+                   Compression compression = Uncompressed,
+                   float quality = 0.5f);
 
   /// Clears collection contents.
   ///
@@ -32,8 +32,12 @@ class Texture {
  public:
   using Ptr = std::unique_ptr<Texture>;
 
-  Texture(const std::string& pathname);
-  Texture(std::ifstream& stream);
+  /// Loads texture from file.
+  ///
+  /// If `mipmaps` is set, a full mip chain is generated from the image.
+  ///
+  Texture(const std::string& pathname, bool mipmaps = false);
+  Texture(std::ifstream& stream, bool mipmaps = false);
 
   /// Texture data for direct initialization.
   ///
@@ -0,0 +1,382 @@
+//
+// SG
+// Checksum.cxx
+//
+// Copyright © 2021 Gustavo C. Viegas.
+//
+
+#include <cstring>
+#include <algorithm>
+
+#include "Checksum.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+# include <immintrin.h>
+# define SG_CRC_CLMUL
+#elif defined(__aarch64__) && defined(__linux__)
+# include <arm_acle.h>
+# include <sys/auxv.h>
+# include <asm/hwcap.h>
+# define SG_CRC_ARMV8
+#endif
+
+#if defined(__SSE2__)
+# include <emmintrin.h>
+#elif defined(__ARM_NEON)
+# include <arm_neon.h>
+#endif
+
+using namespace SG_NS;
+using namespace std;
+
+INTERNAL_NS_BEGIN
+
+/// Lookup tables for slice-by-8 CRC computation.
+///
+struct CRCTable {
+  uint32_t entries[8][256];
+
+  constexpr CRCTable() : entries() {
+    for (uint32_t i = 0; i < 256; i++) {
+      auto x = i;
+      for (uint32_t j = 0; j < 8; j++)
+        x = (x & 1) ? (0xEDB88320 ^ (x >> 1)) : (x >> 1);
+      entries[0][i] = x;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+      for (uint32_t j = 1; j < 8; j++) {
+        const auto x = entries[j-1][i];
+        entries[j][i] = entries[0][x & 0xFF] ^ (x >> 8);
+      }
+    }
+  }
+};
+
+constexpr CRCTable CRCTab{};
+
+/// Updates a (pre-conditioned) CRC eight bytes at a time.
+///
+uint32_t crcSlice8(const uint8_t* data, size_t size, uint32_t crc) {
+  const auto& t = CRCTab.entries;
+
+  for (; size >= 8; size -= 8, data += 8) {
+    uint32_t lo, hi;
+    memcpy(&lo, data, 4);
+    memcpy(&hi, data+4, 4);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    lo = __builtin_bswap32(lo);
+    hi = __builtin_bswap32(hi);
+#endif
+    lo ^= crc;
+    crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^
+          t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+          t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^
+          t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+  }
+
+  for (; size > 0; size--)
+    crc = t[0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+
+  return crc;
+}
+
+#if defined(SG_CRC_CLMUL)
+
+/// Folds 128 bits of CRC state into the next 128 bits of data.
+///
+__attribute__((target("pclmul,sse4.1")))
+inline __m128i fold(__m128i x, __m128i k, __m128i y) {
+  const auto lo = _mm_clmulepi64_si128(x, k, 0x00);
+  const auto hi = _mm_clmulepi64_si128(x, k, 0x11);
+  return _mm_xor_si128(_mm_xor_si128(hi, lo), y);
+}
+
+/// Updates a (pre-conditioned) CRC using carry-less multiplication.
+///
+/// `size` must be a multiple of 16, no less than 64. Data is folded
+/// 64 bytes at a time and then reduced, as described in Intel's "Fast CRC
+/// Computation for Generic Polynomials Using PCLMULQDQ Instruction".
+///
+__attribute__((target("pclmul,sse4.1")))
+uint32_t crcClmul(const uint8_t* data, size_t size, uint32_t crc) {
+  alignas(16) static const uint64_t k1k2[]{0x0154442BD4, 0x01C6E41596};
+  alignas(16) static const uint64_t k3k4[]{0x01751997D0, 0x00CCAA009E};
+  alignas(16) static const uint64_t k5k0[]{0x0163CD6124, 0x0000000000};
+  alignas(16) static const uint64_t poly[]{0x01DB710641, 0x01F7011641};
+
+  auto load = [](const uint8_t* p) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+  };
+
+  auto x1 = _mm_xor_si128(load(data), _mm_cvtsi32_si128(crc));
+  auto x2 = load(data+16);
+  auto x3 = load(data+32);
+  auto x4 = load(data+48);
+  data += 64;
+  size -= 64;
+
+  // Fold 64 bytes at a time
+  auto k = _mm_load_si128(reinterpret_cast<const __m128i*>(k1k2));
+  for (; size >= 64; size -= 64, data += 64) {
+    x1 = fold(x1, k, load(data));
+    x2 = fold(x2, k, load(data+16));
+    x3 = fold(x3, k, load(data+32));
+    x4 = fold(x4, k, load(data+48));
+  }
+
+  // Fold into 128 bits, then 16 bytes at a time
+  k = _mm_load_si128(reinterpret_cast<const __m128i*>(k3k4));
+  x1 = fold(x1, k, x2);
+  x1 = fold(x1, k, x3);
+  x1 = fold(x1, k, x4);
+  for (; size >= 16; size -= 16, data += 16)
+    x1 = fold(x1, k, load(data));
+
+  // Fold 128 bits to 64 bits
+  const auto mask = _mm_setr_epi32(~0, 0, ~0, 0);
+  x2 = _mm_clmulepi64_si128(x1, k, 0x10);
+  x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+
+  k = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(k5k0));
+  x2 = _mm_srli_si128(x1, 4);
+  x1 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask), k, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+
+  // Barrett reduction to 32 bits
+  k = _mm_load_si128(reinterpret_cast<const __m128i*>(poly));
+  x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask), k, 0x10);
+  x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, mask), k, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+
+  return _mm_extract_epi32(x1, 1);
+}
+
+/// Checks whether `crcClmul()` can be used.
+///
+bool hasClmul() {
+  static const bool has = __builtin_cpu_supports("pclmul") &&
+                          __builtin_cpu_supports("sse4.1");
+  return has;
+}
+
+#elif defined(SG_CRC_ARMV8)
+
+/// Updates a (pre-conditioned) CRC using ARMv8 CRC instructions.
+///
+__attribute__((target("+crc")))
+uint32_t crcArmv8(const uint8_t* data, size_t size, uint32_t crc) {
+  for (; size >= 8; size -= 8, data += 8) {
+    uint64_t x;
+    memcpy(&x, data, sizeof x);
+    crc = __crc32d(crc, x);
+  }
+  for (; size > 0; size--)
+    crc = __crc32b(crc, *data++);
+  return crc;
+}
+
+/// Checks whether `crcArmv8()` can be used.
+///
+bool hasArmv8() {
+  static const bool has = getauxval(AT_HWCAP) & HWCAP_CRC32;
+  return has;
+}
+
+#endif // defined(SG_CRC_CLMUL)
+
+/// Adler-32 modulus.
+///
+constexpr uint32_t AdlerMod = 65521;
+
+/// Maximum number of bytes that can be summed before reducing.
+///
+constexpr size_t AdlerMax = 5552;
+
+#if defined(__x86_64__) || defined(__i386__)
+
+/// Updates Adler-32 sums 32 bytes at a time, using AVX2.
+///
+/// Processes as much of `size` as possible and returns the number of
+/// bytes left. Sums are reduced modulo `AdlerMod` before returning.
+///
+__attribute__((target("avx2")))
+size_t adlerAvx2(const uint8_t*& data, size_t size, uint32_t& s1,
+                 uint32_t& s2) {
+
+  const auto zero = _mm256_setzero_si256();
+  const auto ones = _mm256_set1_epi16(1);
+  const auto weights = _mm256_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25,
+                                        24, 23, 22, 21, 20, 19, 18, 17,
+                                        16, 15, 14, 13, 12, 11, 10, 9,
+                                        8, 7, 6, 5, 4, 3, 2, 1);
+
+  while (size >= 32) {
+    const size_t n = min(size, AdlerMax) / 32;
+    s2 += s1 * 32 * n;
+
+    auto vs1 = zero;
+    auto vs2 = zero;
+    auto vps = zero;
+
+    for (size_t k = 0; k < n; k++, data += 32) {
+      const auto x =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+      vps = _mm256_add_epi32(vps, vs1);
+      vs1 = _mm256_add_epi32(vs1, _mm256_sad_epu8(x, zero));
+      vs2 = _mm256_add_epi32(vs2, _mm256_madd_epi16(
+                                    _mm256_maddubs_epi16(x, weights), ones));
+    }
+
+    alignas(32) uint32_t v1[8], v2[8], vp[8];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(v1), vs1);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(v2), vs2);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(vp), vps);
+
+    uint64_t sum1 = 0, sum2 = 0, sumP = 0;
+    for (size_t i = 0; i < 8; i++) {
+      sum1 += v1[i];
+      sum2 += v2[i];
+      sumP += vp[i];
+    }
+
+    s1 = (s1 + sum1) % AdlerMod;
+    s2 = (s2 + sum2 + sumP * 32) % AdlerMod;
+    size -= n * 32;
+  }
+
+  return size;
+}
+
+/// Checks whether `adlerAvx2()` can be used.
+///
+bool hasAvx2() {
+  static const bool has = __builtin_cpu_supports("avx2");
+  return has;
+}
+
+#endif // defined(__x86_64__) || defined(__i386__)
+
+#if defined(__SSE2__) || defined(__ARM_NEON)
+
+/// Updates Adler-32 sums 16 bytes at a time.
+///
+/// Processes as much of `size` as possible and returns the number of
+/// bytes left. Sums are reduced modulo `AdlerMod` before returning.
+///
+size_t adlerVector(const uint8_t*& data, size_t size, uint32_t& s1,
+                   uint32_t& s2) {
+
+  while (size >= 16) {
+    const size_t n = min(size, AdlerMax) / 16;
+
+    // For block `k` of `n`, `s2` gets `16 * s1` plus the previous blocks'
+    // sums (`ps`) plus the block's bytes weighted from 16 down to 1
+    s2 += s1 * 16 * n;
+
+# if defined(__SSE2__)
+    const auto zero = _mm_setzero_si128();
+    const auto wlo = _mm_setr_epi16(16, 15, 14, 13, 12, 11, 10, 9);
+    const auto whi = _mm_setr_epi16(8, 7, 6, 5, 4, 3, 2, 1);
+    auto vs1 = zero;
+    auto vs2 = zero;
+    auto vps = zero;
+
+    for (size_t k = 0; k < n; k++, data += 16) {
+      const auto x =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+      vps = _mm_add_epi32(vps, vs1);
+      vs1 = _mm_add_epi32(vs1, _mm_sad_epu8(x, zero));
+      vs2 = _mm_add_epi32(vs2, _mm_madd_epi16(_mm_unpacklo_epi8(x, zero),
+                                              wlo));
+      vs2 = _mm_add_epi32(vs2, _mm_madd_epi16(_mm_unpackhi_epi8(x, zero),
+                                              whi));
+    }
+
+    alignas(16) uint32_t v1[4], v2[4], vp[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(v1), vs1);
+    _mm_store_si128(reinterpret_cast<__m128i*>(v2), vs2);
+    _mm_store_si128(reinterpret_cast<__m128i*>(vp), vps);
+# else
+    static const uint8_t weights[16]{16, 15, 14, 13, 12, 11, 10, 9,
+                                     8, 7, 6, 5, 4, 3, 2, 1};
+    const auto wlo = vld1_u8(weights);
+    const auto whi = vld1_u8(weights+8);
+    auto vs1 = vdupq_n_u32(0);
+    auto vs2 = vdupq_n_u32(0);
+    auto vps = vdupq_n_u32(0);
+
+    for (size_t k = 0; k < n; k++, data += 16) {
+      const auto x = vld1q_u8(data);
+      vps = vaddq_u32(vps, vs1);
+      vs1 = vpadalq_u16(vs1, vpaddlq_u8(x));
+      vs2 = vpadalq_u16(vs2, vmull_u8(vget_low_u8(x), wlo));
+      vs2 = vpadalq_u16(vs2, vmull_u8(vget_high_u8(x), whi));
+    }
+
+    uint32_t v1[4], v2[4], vp[4];
+    vst1q_u32(v1, vs1);
+    vst1q_u32(v2, vs2);
+    vst1q_u32(vp, vps);
+# endif
+
+    const uint64_t sum1 = uint64_t(v1[0]) + v1[1] + v1[2] + v1[3];
+    const uint64_t sum2 = uint64_t(v2[0]) + v2[1] + v2[2] + v2[3];
+    const uint64_t sumP = uint64_t(vp[0]) + vp[1] + vp[2] + vp[3];
+
+    s1 = (s1 + sum1) % AdlerMod;
+    s2 = (s2 + sum2 + sumP * 16) % AdlerMod;
+    size -= n * 16;
+  }
+
+  return size;
+}
+
+#endif // defined(__SSE2__) || defined(__ARM_NEON)
+
+INTERNAL_NS_END
+
+uint32_t SG_NS::crc32(const void* data, size_t size, uint32_t crc) {
+  auto bytes = reinterpret_cast<const uint8_t*>(data);
+  crc = ~crc;
+
+#if defined(SG_CRC_CLMUL)
+  if (size >= 64 && hasClmul()) {
+    const size_t n = size & ~size_t(15);
+    crc = crcClmul(bytes, n, crc);
+    bytes += n;
+    size -= n;
+  }
+#elif defined(SG_CRC_ARMV8)
+  if (hasArmv8())
+    return ~crcArmv8(bytes, size, crc);
+#endif
+
+  return ~crcSlice8(bytes, size, crc);
+}
+
+uint32_t SG_NS::adler32(const void* data, size_t size, uint32_t adler) {
+  auto bytes = reinterpret_cast<const uint8_t*>(data);
+  uint32_t s1 = adler & 0xFFFF;
+  uint32_t s2 = adler >> 16;
+
+#if defined(__x86_64__) || defined(__i386__)
+  if (hasAvx2())
+    size = adlerAvx2(bytes, size, s1, s2);
+#endif
+#if defined(__SSE2__) || defined(__ARM_NEON)
+  size = adlerVector(bytes, size, s1, s2);
+#endif
+
+  while (size > 0) {
+    const size_t n = min(size, AdlerMax);
+    for (size_t i = 0; i < n; i++) {
+      s1 += *bytes++;
+      s2 += s1;
+    }
+    s1 %= AdlerMod;
+    s2 %= AdlerMod;
+    size -= n;
+  }
+
+  return (s2 << 16) | s1;
+}
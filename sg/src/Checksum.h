@@ -0,0 +1,34 @@
+//
+// SG
+// Checksum.h
+//
+// Copyright © 2021 Gustavo C. Viegas.
+//
+
+#ifndef YF_SG_CHECKSUM_H
+#define YF_SG_CHECKSUM_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "yf/sg/Defs.h"
+
+SG_NS_BEGIN
+
+/// Computes the CRC-32 (ISO 3309) of data.
+///
+/// `crc` is the CRC of preceding data, which allows the computation to be
+/// split in any number of calls.
+///
+uint32_t crc32(const void* data, size_t size, uint32_t crc = 0);
+
+/// Computes the Adler-32 (RFC 1950) of data.
+///
+/// `adler` is the checksum of preceding data, which allows the computation
+/// to be split in any number of calls.
+///
+uint32_t adler32(const void* data, size_t size, uint32_t adler = 1);
+
+SG_NS_END
+
+#endif // YF_SG_CHECKSUM_H
@@ -7,6 +7,7 @@
 
 #include "Collection.h"
 #include "DataGLTF.h"
+#include "DataCooked.h"
 
 using namespace SG_NS;
 using namespace std;
@@ -29,8 +30,10 @@ class Collection::Impl {
   vector<Animation::Ptr> animations_{};
 };
 
-Collection::Collection(const string& pathname) : Collection() {
-  load(pathname);
+Collection::Collection(const string& pathname, bool mipmaps)
+  : Collection() {
+
+  load(pathname, mipmaps);
 }
 
 Collection::Collection() : impl_(make_unique<Impl>()) { }
@@ -44,8 +47,17 @@ Collection& Collection::operator=(Collection&& other) {
 
 Collection::~Collection() { }
 
-void Collection::load(const string& pathname) {
-  loadGLTF(*this, pathname);
+void Collection::load(const string& pathname, bool mipmaps) {
+  if (isCooked(pathname))
+    loadCooked(*this, pathname);
+  else
+    loadGLTF(*this, pathname, mipmaps);
+}
+
+void Collection::cook(const string& srcPathname, const string& dstPathname,
+                      bool mipmaps, Compression compression,
+                      float quality) {
+  cookGLTF(srcPathname, dstPathname, mipmaps, compression, quality);
 }
 
 void Collection::clear() {
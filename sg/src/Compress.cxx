@@ -0,0 +1,1061 @@
+//
+// SG
+// Compress.cxx
+//
+// Copyright © 2021 Gustavo C. Viegas.
+//
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <array>
+
+#include "Compress.h"
+#include "TextureImpl.h"
+#include "Workers.h"
+#include "yf/Except.h"
+
+using namespace YF_NS;
+using namespace SG_NS;
+using namespace std;
+
+INTERNAL_NS_BEGIN
+
+/// Block of 4x4 RGBA texels, in row-major order.
+///
+struct Block {
+  uint8_t texels[16][4];
+};
+
+/// Color with channels in the [0, 255] range.
+///
+using Color = array<float, 4>;
+
+/// Layout of source texels.
+///
+struct Source {
+  uint32_t channels;
+  bool bgra;
+  bool srgb;
+};
+
+/// Gets the source layout of a given format.
+///
+Source sourceOf(CG_NS::PxFormat format) {
+  switch (format) {
+  case CG_NS::PxFormatRgb8Unorm:  return {3, false, false};
+  case CG_NS::PxFormatRgb8Srgb:   return {3, false, true};
+  case CG_NS::PxFormatRgba8Unorm: return {4, false, false};
+  case CG_NS::PxFormatRgba8Srgb:  return {4, false, true};
+  case CG_NS::PxFormatBgra8Unorm: return {4, true, false};
+  case CG_NS::PxFormatBgra8Srgb:  return {4, true, true};
+  default:
+    throw UnsupportedExcept("Unsupported format for block compression");
+  }
+}
+
+/// Search effort derived from the quality setting.
+///
+struct Effort {
+  uint32_t iterations;
+  int32_t alphaRadius;
+  uint32_t partitions;
+  bool pbits;
+};
+
+/// Gets the search effort for a given quality.
+///
+Effort effortOf(float quality) {
+  const float q = max(0.0f, min(1.0f, quality));
+  return {1 + uint32_t(q * 3.0f + 0.5f),
+          int32_t(q * 4.0f + 0.5f),
+          q < 0.2f ? 0 : (q >= 1.0f ? 64 : 1 + uint32_t(q * 15.0f)),
+          q >= 0.5f};
+}
+
+/// Copies a block of texels whose top-left texel is at (x, y).
+///
+/// Coordinates past the edges are clamped, so partial blocks repeat
+/// their edge texels.
+///
+void fetch(Block& block, const Source& src, const uint8_t* texels,
+           CG_NS::Size2 size, uint32_t x, uint32_t y) {
+
+  for (uint32_t i = 0; i < 16; i++) {
+    const uint32_t tx = min(x + (i & 3), size.width - 1);
+    const uint32_t ty = min(y + (i >> 2), size.height - 1);
+    auto t = texels + (size_t(ty) * size.width + tx) * src.channels;
+    auto& dst = block.texels[i];
+    dst[0] = t[src.bgra ? 2 : 0];
+    dst[1] = t[1];
+    dst[2] = t[src.bgra ? 0 : 2];
+    dst[3] = src.channels == 4 ? t[3] : 255;
+  }
+}
+
+/// Computes the squared error between two texels.
+///
+uint32_t errorOf(const uint8_t* a, const uint8_t* b, uint32_t channels) {
+  uint32_t err = 0;
+  for (uint32_t i = 0; i < channels; i++) {
+    const int32_t d = int32_t(a[i]) - int32_t(b[i]);
+    err += d * d;
+  }
+  return err;
+}
+
+/// Fits a line through a subset of texels.
+///
+/// Endpoints are placed at the extents of the texel projections onto the
+/// principal axis. Returns the sum of squared distances from the texels
+/// to the line.
+///
+float fitLine(const Block& block, const uint8_t* subset, uint32_t count,
+              uint32_t channels, Color (&endpoints)[2]) {
+
+  Color mean{};
+  for (uint32_t i = 0; i < count; i++) {
+    for (uint32_t c = 0; c < channels; c++)
+      mean[c] += block.texels[subset[i]][c];
+  }
+  for (uint32_t c = 0; c < channels; c++)
+    mean[c] /= count;
+
+  float cov[4][4]{};
+  for (uint32_t i = 0; i < count; i++) {
+    Color d;
+    for (uint32_t c = 0; c < channels; c++)
+      d[c] = block.texels[subset[i]][c] - mean[c];
+    for (uint32_t j = 0; j < channels; j++) {
+      for (uint32_t k = j; k < channels; k++)
+        cov[j][k] += d[j] * d[k];
+    }
+  }
+  float trace = 0.0f;
+  uint32_t widest = 0;
+  for (uint32_t j = 0; j < channels; j++) {
+    for (uint32_t k = 0; k < j; k++)
+      cov[j][k] = cov[k][j];
+    trace += cov[j][j];
+    if (cov[j][j] > cov[widest][widest])
+      widest = j;
+  }
+
+  endpoints[0] = endpoints[1] = mean;
+  if (trace <= 0.0f)
+    return 0.0f;
+
+  // Power iteration, starting from the row of largest variance
+  Color axis{};
+  for (uint32_t c = 0; c < channels; c++)
+    axis[c] = cov[widest][c];
+  for (uint32_t n = 0; n < 8; n++) {
+    Color v{};
+    float norm = 0.0f;
+    for (uint32_t j = 0; j < channels; j++) {
+      for (uint32_t k = 0; k < channels; k++)
+        v[j] += cov[j][k] * axis[k];
+      norm = max(norm, fabs(v[j]));
+    }
+    if (norm == 0.0f)
+      break;
+    for (uint32_t c = 0; c < channels; c++)
+      axis[c] = v[c] / norm;
+  }
+  float len = 0.0f;
+  for (uint32_t c = 0; c < channels; c++)
+    len += axis[c] * axis[c];
+  if (len == 0.0f)
+    return trace;
+  len = sqrt(len);
+  for (uint32_t c = 0; c < channels; c++)
+    axis[c] /= len;
+
+  float lambda = 0.0f;
+  for (uint32_t j = 0; j < channels; j++) {
+    for (uint32_t k = 0; k < channels; k++)
+      lambda += axis[j] * cov[j][k] * axis[k];
+  }
+
+  float tMin = HUGE_VALF;
+  float tMax = -HUGE_VALF;
+  for (uint32_t i = 0; i < count; i++) {
+    float t = 0.0f;
+    for (uint32_t c = 0; c < channels; c++)
+      t += (block.texels[subset[i]][c] - mean[c]) * axis[c];
+    tMin = min(tMin, t);
+    tMax = max(tMax, t);
+  }
+  for (uint32_t c = 0; c < channels; c++) {
+    endpoints[0][c] = max(0.0f, min(255.0f, mean[c] + axis[c] * tMin));
+    endpoints[1][c] = max(0.0f, min(255.0f, mean[c] + axis[c] * tMax));
+  }
+
+  return max(0.0f, trace - lambda);
+}
+
+/// Solves for the endpoints that best reproduce a subset of texels.
+///
+/// `weights` gives the interpolation factor of each texel's index (zero
+/// for the first endpoint, one for the second). Returns `false` if the
+/// system is singular, in which case `endpoints` is not changed.
+///
+bool refine(const Block& block, const uint8_t* subset, uint32_t count,
+            uint32_t channels, const float* weights, Color (&endpoints)[2]) {
+
+  float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+  Color xa{}, xb{};
+  for (uint32_t i = 0; i < count; i++) {
+    const float w = weights[i];
+    aa += (1.0f - w) * (1.0f - w);
+    ab += (1.0f - w) * w;
+    bb += w * w;
+    for (uint32_t c = 0; c < channels; c++) {
+      xa[c] += (1.0f - w) * block.texels[subset[i]][c];
+      xb[c] += w * block.texels[subset[i]][c];
+    }
+  }
+
+  const float det = aa * bb - ab * ab;
+  if (fabs(det) < 1e-6f)
+    return false;
+
+  for (uint32_t c = 0; c < channels; c++) {
+    const float a = (bb * xa[c] - ab * xb[c]) / det;
+    const float b = (aa * xb[c] - ab * xa[c]) / det;
+    endpoints[0][c] = max(0.0f, min(255.0f, a));
+    endpoints[1][c] = max(0.0f, min(255.0f, b));
+  }
+  return true;
+}
+
+/// Writes a little-endian integer.
+///
+template<class T>
+void writeLE(T x, uint8_t* dst) {
+  for (size_t i = 0; i < sizeof(T); i++)
+    dst[i] = x >> (i * 8);
+}
+
+//
+// BC1
+//
+
+/// Expands a 5-bit value to 8 bits.
+///
+inline uint8_t expand5(uint32_t x) {
+  return (x << 3) | (x >> 2);
+}
+
+/// Expands a 6-bit value to 8 bits.
+///
+inline uint8_t expand6(uint32_t x) {
+  return (x << 2) | (x >> 4);
+}
+
+/// Converts a color to RGB565.
+///
+uint16_t to565(const Color& color) {
+  const uint32_t r = color[0] * 31.0f / 255.0f + 0.5f;
+  const uint32_t g = color[1] * 63.0f / 255.0f + 0.5f;
+  const uint32_t b = color[2] * 31.0f / 255.0f + 0.5f;
+  return (r << 11) | (g << 5) | b;
+}
+
+/// Endpoints whose interpolation best reproduces single values.
+///
+/// Entries hold the 5 or 6-bit endpoints for which the value lying one
+/// third of the way from the first to the second is closest to the index.
+///
+struct SingleColor {
+  uint8_t five[256][2];
+  uint8_t six[256][2];
+
+  SingleColor() {
+    auto build = [](uint8_t (&table)[256][2], uint32_t bits) {
+      const uint32_t n = 1 << bits;
+      for (uint32_t v = 0; v < 256; v++) {
+        int32_t best = INT32_MAX;
+        for (uint32_t a = 0; a < n; a++) {
+          for (uint32_t b = 0; b < n; b++) {
+            const int32_t x = bits == 5 ? expand5(a) : expand6(a);
+            const int32_t y = bits == 5 ? expand5(b) : expand6(b);
+            const int32_t err = abs((2 * x + y) / 3 - int32_t(v)) * 256 +
+                                abs(int32_t(a) - int32_t(b));
+            if (err < best) {
+              best = err;
+              table[v][0] = a;
+              table[v][1] = b;
+            }
+          }
+        }
+      }
+    };
+    build(five, 5);
+    build(six, 6);
+  }
+};
+
+/// Decodes the palette of a BC1 color block.
+///
+void paletteOf(uint16_t c0, uint16_t c1, bool fourColor,
+               uint8_t (&palette)[4][4]) {
+
+  palette[0][0] = expand5(c0 >> 11);
+  palette[0][1] = expand6((c0 >> 5) & 63);
+  palette[0][2] = expand5(c0 & 31);
+  palette[1][0] = expand5(c1 >> 11);
+  palette[1][1] = expand6((c1 >> 5) & 63);
+  palette[1][2] = expand5(c1 & 31);
+  palette[0][3] = palette[1][3] = palette[2][3] = 255;
+
+  for (uint32_t c = 0; c < 3; c++) {
+    const uint32_t a = palette[0][c];
+    const uint32_t b = palette[1][c];
+    if (fourColor) {
+      palette[2][c] = (2 * a + b) / 3;
+      palette[3][c] = (a + 2 * b) / 3;
+    } else {
+      palette[2][c] = (a + b) / 2;
+      palette[3][c] = 0;
+    }
+  }
+  palette[3][3] = fourColor ? 255 : 0;
+}
+
+/// Encodes the color block of BC1 and BC3.
+///
+/// When `punchThrough` is set, texels whose alpha is below one half are
+/// encoded as transparent using the three-color mode. Otherwise, alpha
+/// is ignored and the four-color mode is always used.
+///
+void encodeColor(const Block& block, bool punchThrough, uint32_t iterations,
+                 uint8_t* dst) {
+
+  uint8_t subset[16];
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < 16; i++) {
+    if (!punchThrough || block.texels[i][3] >= 128)
+      subset[count++] = i;
+  }
+  const bool fourColor = count == 16;
+
+  if (count == 0) {
+    writeLE<uint16_t>(0, dst);
+    writeLE<uint16_t>(0, dst+2);
+    writeLE<uint32_t>(~0U, dst+4);
+    return;
+  }
+
+  uint16_t c0, c1;
+  uint8_t indices[16]{};
+
+  // Assigns indices of the current endpoints and returns the error
+  auto assign = [&](uint8_t (&idx)[16]) {
+    uint8_t palette[4][4];
+    paletteOf(c0, c1, fourColor, palette);
+    uint32_t err = 0;
+    for (uint32_t i = 0; i < 16; i++) {
+      if (punchThrough && block.texels[i][3] < 128) {
+        idx[i] = 3;
+        continue;
+      }
+      uint32_t best = UINT32_MAX;
+      for (uint32_t k = 0; k < (fourColor ? 4U : 3U); k++) {
+        const auto e = errorOf(block.texels[i], palette[k], 3);
+        if (e < best) {
+          best = e;
+          idx[i] = k;
+        }
+      }
+      err += best;
+    }
+    return err;
+  };
+
+  Color endpoints[2];
+  fitLine(block, subset, count, 3, endpoints);
+
+  const auto& first = block.texels[subset[0]];
+  bool single = true;
+  for (uint32_t i = 1; i < count && single; i++)
+    single = memcmp(block.texels[subset[i]], first, 3) == 0;
+
+  if (single && fourColor) {
+    // Interpolated values reproduce single colors more closely
+    static const SingleColor table;
+    c0 = (table.five[first[0]][0] << 11) | (table.six[first[1]][0] << 5) |
+         table.five[first[2]][0];
+    c1 = (table.five[first[0]][1] << 11) | (table.six[first[1]][1] << 5) |
+         table.five[first[2]][1];
+    uint8_t index = 2;
+    if (c0 < c1) {
+      swap(c0, c1);
+      index = 3;
+    } else if (c0 == c1) {
+      index = 0;
+    }
+    memset(indices, index, sizeof indices);
+
+  } else {
+    uint32_t bestErr = UINT32_MAX;
+    uint16_t best0 = 0, best1 = 0;
+
+    for (uint32_t n = 0; n < iterations; n++) {
+      c0 = to565(endpoints[0]);
+      c1 = to565(endpoints[1]);
+      if (fourColor ? c0 < c1 : c0 > c1) {
+        swap(c0, c1);
+        swap(endpoints[0], endpoints[1]);
+      }
+
+      uint8_t idx[16];
+      uint32_t err;
+      if (fourColor && c0 == c1) {
+        // Equal endpoints would select the three-color mode
+        memset(idx, 0, sizeof idx);
+        err = 0;
+        uint8_t palette[4][4];
+        paletteOf(c0, c1, true, palette);
+        for (uint32_t i = 0; i < 16; i++)
+          err += errorOf(block.texels[i], palette[0], 3);
+      } else {
+        err = assign(idx);
+      }
+
+      if (err < bestErr) {
+        bestErr = err;
+        best0 = c0;
+        best1 = c1;
+        memcpy(indices, idx, sizeof indices);
+      }
+      if (err == 0)
+        break;
+
+      float weights[16];
+      for (uint32_t i = 0; i < count; i++) {
+        switch (idx[subset[i]]) {
+        case 0:  weights[i] = 0.0f; break;
+        case 1:  weights[i] = 1.0f; break;
+        case 2:  weights[i] = fourColor ? 1.0f / 3.0f : 0.5f; break;
+        default: weights[i] = 2.0f / 3.0f; break;
+        }
+      }
+      if (!refine(block, subset, count, 3, weights, endpoints))
+        break;
+    }
+
+    c0 = best0;
+    c1 = best1;
+  }
+
+  uint32_t bits = 0;
+  for (uint32_t i = 0; i < 16; i++)
+    bits |= uint32_t(indices[i]) << (i * 2);
+  writeLE(c0, dst);
+  writeLE(c1, dst+2);
+  writeLE(bits, dst+4);
+}
+
+/// Encodes a BC1 block.
+///
+void encodeBC1(const Block& block, const Effort& effort, uint8_t* dst) {
+  encodeColor(block, true, effort.iterations, dst);
+}
+
+//
+// BC3
+//
+
+/// Decodes the palette of a BC3 alpha block.
+///
+void paletteOf(uint8_t a0, uint8_t a1, uint8_t (&palette)[8]) {
+  palette[0] = a0;
+  palette[1] = a1;
+  if (a0 > a1) {
+    for (uint32_t i = 1; i < 7; i++)
+      palette[i+1] = ((7 - i) * a0 + i * a1) / 7;
+  } else {
+    for (uint32_t i = 1; i < 5; i++)
+      palette[i+1] = ((5 - i) * a0 + i * a1) / 5;
+    palette[6] = 0;
+    palette[7] = 255;
+  }
+}
+
+/// Encodes the alpha block of BC3.
+///
+/// Both the eight-value and the six-value modes are tried, searching
+/// endpoints within `radius` of the alpha extents.
+///
+void encodeAlpha(const Block& block, int32_t radius, uint8_t* dst) {
+  uint8_t lo = 255, hi = 0;
+  uint8_t innerLo = 255, innerHi = 0;
+  for (const auto& t : block.texels) {
+    lo = min(lo, t[3]);
+    hi = max(hi, t[3]);
+    if (t[3] != 0 && t[3] != 255) {
+      innerLo = min(innerLo, t[3]);
+      innerHi = max(innerHi, t[3]);
+    }
+  }
+  if (innerLo > innerHi)
+    innerLo = innerHi = lo;
+
+  uint32_t bestErr = UINT32_MAX;
+  uint8_t best[2]{lo, lo};
+  uint8_t indices[16]{};
+
+  auto evaluate = [&](int32_t a0, int32_t a1) {
+    uint8_t palette[8];
+    paletteOf(a0, a1, palette);
+    uint8_t idx[16];
+    uint32_t err = 0;
+    for (uint32_t i = 0; i < 16 && err < bestErr; i++) {
+      uint32_t e = UINT32_MAX;
+      for (uint32_t k = 0; k < 8; k++) {
+        const int32_t d = int32_t(block.texels[i][3]) - palette[k];
+        if (uint32_t(d * d) < e) {
+          e = d * d;
+          idx[i] = k;
+        }
+      }
+      err += e;
+    }
+    if (err < bestErr) {
+      bestErr = err;
+      best[0] = a0;
+      best[1] = a1;
+      memcpy(indices, idx, sizeof indices);
+    }
+  };
+
+  for (int32_t d0 = -radius; d0 <= radius && bestErr > 0; d0++) {
+    for (int32_t d1 = -radius; d1 <= radius && bestErr > 0; d1++) {
+      // Eight values, interpolated from the extents
+      const int32_t a0 = min(255, hi + d0);
+      const int32_t a1 = max(0, lo + d1);
+      if (a0 > a1)
+        evaluate(a0, a1);
+      // Six values, plus exact zero and one
+      const int32_t b0 = max(0, innerLo + d1);
+      const int32_t b1 = min(255, innerHi + d0);
+      if (b0 <= b1)
+        evaluate(b0, b1);
+    }
+  }
+
+  uint64_t bits = 0;
+  for (uint32_t i = 0; i < 16; i++)
+    bits |= uint64_t(indices[i]) << (i * 3);
+  dst[0] = best[0];
+  dst[1] = best[1];
+  for (uint32_t i = 0; i < 6; i++)
+    dst[2+i] = bits >> (i * 8);
+}
+
+/// Encodes a BC3 block.
+///
+void encodeBC3(const Block& block, const Effort& effort, uint8_t* dst) {
+  encodeAlpha(block, effort.alphaRadius, dst);
+  encodeColor(block, false, effort.iterations, dst+8);
+}
+
+//
+// BC7
+//
+
+/// Two-subset partitions.
+///
+/// Bit `i` is set if texel `i` belongs to the second subset.
+///
+constexpr uint16_t Partitions[64] = {
+  0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+  0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+  0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+  0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+  0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A,
+  0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+  0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C,
+  0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22
+};
+
+/// Anchor texel of the second subset of each partition.
+///
+constexpr uint8_t Anchors[64] = {
+  15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+  15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+  15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+   6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15
+};
+
+/// Interpolation weights of 2-bit indices.
+///
+constexpr uint8_t Weights2[4] = {0, 21, 43, 64};
+
+/// Interpolation weights of 3-bit indices.
+///
+constexpr uint8_t Weights3[8] = {0, 9, 18, 27, 37, 46, 55, 64};
+
+/// Interpolation weights of 4-bit indices.
+///
+constexpr uint8_t Weights4[16] = {
+  0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64
+};
+
+/// P-bit usage of a BC7 mode.
+///
+enum Pbit {
+  PbitNone,
+  PbitShared,
+  PbitUnique
+};
+
+/// Endpoint and index precision of a BC7 mode.
+///
+/// `bits` is the precision of endpoint channels, including the p-bit.
+///
+struct Mode {
+  uint32_t bits;
+  Pbit pbit;
+  uint32_t channels;
+  const uint8_t* weights;
+  uint32_t indices;
+};
+
+/// Mode 1: two subsets, RGB 6.6.6 with shared p-bits and 3-bit indices.
+///
+constexpr Mode Mode1{7, PbitShared, 3, Weights3, 8};
+
+/// Mode 5: RGB 7.7.7 and separate 8-bit alpha, both with 2-bit indices.
+///
+constexpr Mode Mode5Color{7, PbitNone, 3, Weights2, 4};
+constexpr Mode Mode5Alpha{8, PbitNone, 1, Weights2, 4};
+
+/// Mode 6: one subset, RGBA 7.7.7.7 with p-bits and 4-bit indices.
+///
+constexpr Mode Mode6{8, PbitUnique, 4, Weights4, 16};
+
+/// Quantized endpoints of a subset.
+///
+struct Endpoints {
+  uint8_t codes[2][4];
+  uint8_t pbits[2];
+  uint8_t colors[2][4];
+};
+
+/// Expands an endpoint channel to 8 bits.
+///
+inline uint8_t expand(uint32_t x, uint32_t bits) {
+  return (x << (8 - bits)) | (x >> (2 * bits - 8));
+}
+
+/// Quantizes a channel, returning the code with smallest error.
+///
+/// A negative `pbit` means that the mode has no p-bits.
+///
+uint32_t quantize(float value, int32_t pbit, uint32_t bits,
+                  uint32_t& error) {
+
+  const int32_t maxCode = (1 << (pbit < 0 ? bits : bits - 1)) - 1;
+  const float scaled = value * ((1 << bits) - 1) / 255.0f;
+  const int32_t guess = lround(pbit < 0 ? scaled : (scaled - pbit) * 0.5f);
+  uint32_t code = 0;
+  error = UINT32_MAX;
+  for (int32_t c = max(0, guess - 1); c <= min(maxCode, guess + 1); c++) {
+    const float d = expand(pbit < 0 ? c : (c << 1) | pbit, bits) - value;
+    const uint32_t e = d * d + 0.5f;
+    if (e < error) {
+      error = e;
+      code = c;
+    }
+  }
+  return code;
+}
+
+/// Quantizes a pair of endpoints.
+///
+/// Bit `e` of `pbits` gives the p-bit of endpoint `e` (only the first bit
+/// is used if the mode shares p-bits). If `pbits` is negative, p-bits are
+/// chosen by quantization error. Modes without p-bits ignore `pbits`.
+///
+void quantize(const Color (&colors)[2], const Mode& mode, int32_t pbits,
+              Endpoints& dst) {
+
+  uint32_t codes[2][2][4];
+  uint32_t errors[2][2]{};
+  for (int32_t p = 0; p < 2; p++) {
+    for (uint32_t e = 0; e < 2; e++) {
+      for (uint32_t c = 0; c < mode.channels; c++) {
+        uint32_t err;
+        codes[p][e][c] = quantize(colors[e][c],
+                                  mode.pbit == PbitNone ? -1 : p,
+                                  mode.bits, err);
+        errors[p][e] += err;
+      }
+    }
+  }
+
+  for (uint32_t e = 0; e < 2; e++) {
+    uint32_t p;
+    if (mode.pbit == PbitNone)
+      p = 0;
+    else if (pbits >= 0)
+      p = (pbits >> (mode.pbit == PbitShared ? 0 : e)) & 1;
+    else if (mode.pbit == PbitShared)
+      p = errors[1][0] + errors[1][1] < errors[0][0] + errors[0][1];
+    else
+      p = errors[1][e] < errors[0][e];
+    dst.pbits[e] = p;
+    for (uint32_t c = 0; c < 4; c++) {
+      if (c < mode.channels) {
+        const uint32_t code = codes[p][e][c];
+        dst.codes[e][c] = code;
+        dst.colors[e][c] = expand(mode.pbit == PbitNone ? code :
+                                  (code << 1) | p, mode.bits);
+      } else {
+        dst.codes[e][c] = 0;
+        dst.colors[e][c] = 255;
+      }
+    }
+  }
+}
+
+/// Assigns indices to a subset of texels, returning the error.
+///
+uint32_t assign(const Block& block, const uint8_t* subset, uint32_t count,
+                const Mode& mode, const Endpoints& endpoints,
+                uint8_t* indices) {
+
+  uint8_t palette[16][4];
+  for (uint32_t k = 0; k < mode.indices; k++) {
+    const uint32_t w = mode.weights[k];
+    for (uint32_t c = 0; c < 4; c++)
+      palette[k][c] = ((64 - w) * endpoints.colors[0][c] +
+                       w * endpoints.colors[1][c] + 32) >> 6;
+  }
+
+  uint32_t err = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    const auto texel = block.texels[subset[i]];
+    uint32_t best = UINT32_MAX;
+    for (uint32_t k = 0; k < mode.indices; k++) {
+      const auto e = errorOf(texel, palette[k], mode.channels);
+      if (e < best) {
+        best = e;
+        indices[subset[i]] = k;
+      }
+    }
+    err += best;
+  }
+  return err;
+}
+
+/// Encodes a subset, refining endpoints from the texel assignments.
+///
+/// Indices are written to `indices` by texel. Returns the error.
+///
+uint32_t encodeSubset(const Block& block, const uint8_t* subset,
+                      uint32_t count, const Mode& mode, const Effort& effort,
+                      Endpoints& endpoints, uint8_t* indices) {
+
+  Color colors[2];
+  fitLine(block, subset, count, mode.channels, colors);
+
+  // Either try every p-bit combination or pick them by quantization
+  int32_t combinations = 0;
+  if (effort.pbits && mode.pbit != PbitNone)
+    combinations = mode.pbit == PbitShared ? 2 : 4;
+
+  uint32_t bestErr = UINT32_MAX;
+  for (uint32_t n = 0; n < effort.iterations; n++) {
+    uint8_t idx[16];
+    uint32_t err = UINT32_MAX;
+    for (int32_t p = combinations > 0 ? 0 : -1; p < combinations; p++) {
+      Endpoints ep;
+      quantize(colors, mode, p, ep);
+      uint8_t pIdx[16];
+      const auto pErr = assign(block, subset, count, mode, ep, pIdx);
+      if (pErr < err) {
+        err = pErr;
+        memcpy(idx, pIdx, sizeof idx);
+        if (err < bestErr) {
+          bestErr = err;
+          endpoints = ep;
+          for (uint32_t i = 0; i < count; i++)
+            indices[subset[i]] = idx[subset[i]];
+        }
+      }
+    }
+    if (err == 0)
+      break;
+
+    float weights[16];
+    for (uint32_t i = 0; i < count; i++)
+      weights[i] = mode.weights[idx[subset[i]]] / 64.0f;
+    if (!refine(block, subset, count, mode.channels, weights, colors))
+      break;
+  }
+  return bestErr;
+}
+
+/// Swaps endpoints so that the anchor index has its high bit clear.
+///
+void fixAnchor(const uint8_t* subset, uint32_t count, uint32_t anchor,
+               const Mode& mode, Endpoints& endpoints, uint8_t* indices) {
+
+  if (indices[anchor] < mode.indices / 2)
+    return;
+  swap(endpoints.codes[0], endpoints.codes[1]);
+  swap(endpoints.colors[0], endpoints.colors[1]);
+  swap(endpoints.pbits[0], endpoints.pbits[1]);
+  for (uint32_t i = 0; i < count; i++)
+    indices[subset[i]] = mode.indices - 1 - indices[subset[i]];
+}
+
+/// Writes bit fields in increasing bit order.
+///
+class BitWriter {
+ public:
+  explicit BitWriter(uint8_t* dst) : dst_(dst) { memset(dst, 0, 16); }
+
+  void put(uint32_t value, uint32_t bits) {
+    for (uint32_t i = 0; i < bits; i++, pos_++) {
+      if ((value >> i) & 1)
+        dst_[pos_ >> 3] |= 1 << (pos_ & 7);
+    }
+  }
+
+ private:
+  uint8_t* dst_;
+  uint32_t pos_ = 0;
+};
+
+/// Encodes a BC7 block.
+///
+/// Mode 6 is tried for every block. Blocks with transparency also try
+/// mode 5, which encodes alpha separately, while opaque blocks try the
+/// two-subset partitions of mode 1 that best fit a line per subset.
+///
+void encodeBC7(const Block& block, const Effort& effort, uint8_t* dst) {
+  static constexpr uint8_t All[16] = {
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15
+  };
+
+  // Endpoints and indices of the best mode, by subset (mode 5 stores
+  // color in the first and alpha in the second)
+  uint32_t mode = 6;
+  int32_t partition = -1;
+  Endpoints endpoints[2];
+  uint8_t indices[2][16];
+  uint8_t subsets[2][16];
+  uint32_t counts[2]{16, 0};
+  memcpy(subsets[0], All, sizeof All);
+
+  uint32_t bestErr = encodeSubset(block, All, 16, Mode6, effort,
+                                  endpoints[0], indices[0]);
+
+  bool opaque = true;
+  for (const auto& t : block.texels)
+    opaque &= t[3] == 255;
+
+  if (!opaque && bestErr > 0) {
+    Block alpha;
+    for (uint32_t i = 0; i < 16; i++)
+      alpha.texels[i][0] = block.texels[i][3];
+
+    Endpoints ep[2];
+    uint8_t idx[2][16];
+    const auto err =
+      encodeSubset(block, All, 16, Mode5Color, effort, ep[0], idx[0]) +
+      encodeSubset(alpha, All, 16, Mode5Alpha, effort, ep[1], idx[1]);
+    if (err < bestErr) {
+      bestErr = err;
+      mode = 5;
+      memcpy(endpoints, ep, sizeof ep);
+      memcpy(indices, idx, sizeof idx);
+    }
+  }
+
+  if (opaque && effort.partitions > 0 && bestErr > 0) {
+    auto split = [](uint32_t p, uint8_t (&sub)[2][16], uint32_t (&n)[2]) {
+      n[0] = n[1] = 0;
+      for (uint32_t i = 0; i < 16; i++) {
+        const uint32_t s = (Partitions[p] >> i) & 1;
+        sub[s][n[s]++] = i;
+      }
+    };
+
+    // Only the partitions with smallest line fit error are encoded
+    pair<float, uint32_t> ranks[64];
+    for (uint32_t p = 0; p < 64; p++) {
+      uint8_t sub[2][16];
+      uint32_t n[2];
+      split(p, sub, n);
+      Color unused[2];
+      ranks[p] = {fitLine(block, sub[0], n[0], 3, unused) +
+                  fitLine(block, sub[1], n[1], 3, unused), p};
+    }
+    partial_sort(ranks, ranks + effort.partitions, ranks + 64);
+
+    for (uint32_t r = 0; r < effort.partitions; r++) {
+      const uint32_t p = ranks[r].second;
+      uint8_t sub[2][16];
+      uint32_t n[2];
+      split(p, sub, n);
+      Endpoints ep[2];
+      uint8_t idx[16];
+      const auto err =
+        encodeSubset(block, sub[0], n[0], Mode1, effort, ep[0], idx) +
+        encodeSubset(block, sub[1], n[1], Mode1, effort, ep[1], idx);
+      if (err < bestErr) {
+        bestErr = err;
+        mode = 1;
+        partition = p;
+        memcpy(endpoints, ep, sizeof ep);
+        memcpy(indices[0], idx, sizeof idx);
+        memcpy(subsets, sub, sizeof sub);
+        memcpy(counts, n, sizeof n);
+      }
+    }
+  }
+
+  BitWriter writer(dst);
+
+  switch (mode) {
+  case 1: {
+    const uint32_t anchor = Anchors[partition];
+    fixAnchor(subsets[0], counts[0], 0, Mode1, endpoints[0], indices[0]);
+    fixAnchor(subsets[1], counts[1], anchor, Mode1, endpoints[1],
+              indices[0]);
+    writer.put(1 << 1, 2);
+    writer.put(partition, 6);
+    for (uint32_t c = 0; c < 3; c++) {
+      for (const auto& ep : endpoints) {
+        writer.put(ep.codes[0][c], 6);
+        writer.put(ep.codes[1][c], 6);
+      }
+    }
+    writer.put(endpoints[0].pbits[0], 1);
+    writer.put(endpoints[1].pbits[0], 1);
+    for (uint32_t i = 0; i < 16; i++)
+      writer.put(indices[0][i], i == 0 || i == anchor ? 2 : 3);
+  } break;
+
+  case 5:
+    // No channel rotation
+    fixAnchor(All, 16, 0, Mode5Color, endpoints[0], indices[0]);
+    fixAnchor(All, 16, 0, Mode5Alpha, endpoints[1], indices[1]);
+    writer.put(1 << 5, 6);
+    writer.put(0, 2);
+    for (uint32_t c = 0; c < 3; c++) {
+      writer.put(endpoints[0].codes[0][c], 7);
+      writer.put(endpoints[0].codes[1][c], 7);
+    }
+    writer.put(endpoints[1].codes[0][0], 8);
+    writer.put(endpoints[1].codes[1][0], 8);
+    for (const auto& idx : indices) {
+      for (uint32_t i = 0; i < 16; i++)
+        writer.put(idx[i], i == 0 ? 1 : 2);
+    }
+    break;
+
+  default:
+    fixAnchor(All, 16, 0, Mode6, endpoints[0], indices[0]);
+    writer.put(1 << 6, 7);
+    for (uint32_t c = 0; c < 4; c++) {
+      writer.put(endpoints[0].codes[0][c], 7);
+      writer.put(endpoints[0].codes[1][c], 7);
+    }
+    writer.put(endpoints[0].pbits[0], 1);
+    writer.put(endpoints[0].pbits[1], 1);
+    for (uint32_t i = 0; i < 16; i++)
+      writer.put(indices[0][i], i == 0 ? 3 : 4);
+    break;
+  }
+}
+
+INTERNAL_NS_END
+
+void SG_NS::compressTexture(Texture::Data& dst, BlockEncoding encoding,
+                            float quality) {
+
+  const auto src = sourceOf(dst.format);
+  const auto effort = effortOf(quality);
+
+  CG_NS::PxFormat format;
+  size_t blockSize;
+  void (*encode)(const Block&, const Effort&, uint8_t*);
+  switch (encoding) {
+  case BlockEncodingBC1:
+    format = src.srgb ? CG_NS::PxFormatBc1Srgb : CG_NS::PxFormatBc1Unorm;
+    blockSize = 8;
+    encode = encodeBC1;
+    break;
+  case BlockEncodingBC3:
+    format = src.srgb ? CG_NS::PxFormatBc3Srgb : CG_NS::PxFormatBc3Unorm;
+    blockSize = 16;
+    encode = encodeBC3;
+    break;
+  case BlockEncodingBC7:
+    format = src.srgb ? CG_NS::PxFormatBc7Srgb : CG_NS::PxFormatBc7Unorm;
+    blockSize = 16;
+    encode = encodeBC7;
+    break;
+  default:
+    throw UnsupportedExcept("Unsupported block encoding");
+  }
+
+  const uint32_t levels = max(1U, dst.levels);
+  auto data = make_unique<char[]>(dataSizeOf(format, dst.size, levels));
+  auto texels = reinterpret_cast<const uint8_t*>(dst.data.get());
+  auto blocks = reinterpret_cast<uint8_t*>(data.get());
+  CG_NS::Size2 size = dst.size;
+
+  for (uint32_t i = 0; i < levels; i++) {
+    const uint32_t width = (size.width + 3) >> 2;
+    const uint32_t height = (size.height + 3) >> 2;
+
+    // Split block rows in bands, keeping small levels in the calling thread
+    const uint32_t bands = width * height < 256 ? 1 :
+                           min(height, workerCount() * 4);
+    parallelFor(bands, [&](uint32_t band) {
+      const uint32_t beg = height * band / bands;
+      const uint32_t end = height * (band + 1) / bands;
+      Block block;
+      for (uint32_t y = beg; y < end; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+          fetch(block, src, texels, size, x << 2, y << 2);
+          encode(block, effort, blocks + (size_t(y) * width + x) * blockSize);
+        }
+      }
+    });
+
+    texels += size_t(size.width) * size.height * src.channels;
+    blocks += size_t(width) * height * blockSize;
+    size.width = max(1U, size.width >> 1);
+    size.height = max(1U, size.height >> 1);
+  }
+
+  dst.data = move(data);
+  dst.format = format;
+  dst.levels = levels;
+}
+
+BlockEncoding SG_NS::blockEncodingOf(const Texture::Data& data,
+                                     bool highQuality) {
+  if (highQuality)
+    return BlockEncodingBC7;
+
+  const auto src = sourceOf(data.format);
+  if (src.channels == 4) {
+    auto texels = reinterpret_cast<const uint8_t*>(data.data.get());
+    const size_t n = size_t(data.size.width) * data.size.height;
+    for (size_t i = 0; i < n; i++) {
+      if (texels[i*4+3] != 0 && texels[i*4+3] != 255)
+        return BlockEncodingBC3;
+    }
+  }
+  return BlockEncodingBC1;
+}
@@ -0,0 +1,45 @@
+//
+// SG
+// Compress.h
+//
+// Copyright © 2021 Gustavo C. Viegas.
+//
+
+#ifndef YF_SG_COMPRESS_H
+#define YF_SG_COMPRESS_H
+
+#include "Texture.h"
+
+SG_NS_BEGIN
+
+/// Block compression encodings.
+///
+enum BlockEncoding {
+  BlockEncodingBC1,
+  BlockEncodingBC3,
+  BlockEncodingBC7
+};
+
+/// Compresses texture data into blocks.
+///
+/// Every level of `dst` is encoded, and the data is replaced by a new
+/// allocation storing the compressed levels. Source data must be 8-bit
+/// RGB, RGBA or BGRA, and sRGB formats are encoded into sRGB block
+/// formats. BC1 encodes texels whose alpha is below one half as fully
+/// transparent, which suits opaque and alpha-tested textures.
+///
+/// `quality` ranges from zero (fastest) to one (most exhaustive search).
+///
+void compressTexture(Texture::Data& dst, BlockEncoding encoding,
+                     float quality = 0.5f);
+
+/// Selects a block encoding for the given texture data.
+///
+/// BC7 is used when `highQuality` is set. Otherwise, BC1 is used unless
+/// the data has alpha values other than zero and one, which requires BC3.
+///
+BlockEncoding blockEncodingOf(const Texture::Data& data, bool highQuality);
+
+SG_NS_END
+
+#endif // YF_SG_COMPRESS_H
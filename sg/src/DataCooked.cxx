@@ -0,0 +1,1059 @@
+//
+// SG
+// DataCooked.cxx
+//
+// Copyright © 2021 Gustavo C. Viegas.
+//
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+#include <unordered_map>
+#include <type_traits>
+#include <stdexcept>
+
+#include "DataCooked.h"
+#include "DataGLTF.h"
+#include "Compress.h"
+#include "Model.h"
+#include "TextureImpl.h"
+#include "yf/Except.h"
+
+#if defined(__linux__) || defined(__APPLE__)
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+#endif
+
+using namespace YF_NS;
+using namespace SG_NS;
+using namespace std;
+
+INTERNAL_NS_BEGIN
+
+//
+// File layout
+//
+// A cooked file starts with a `Header`, followed by a table of contents
+// (`header.sectionN` `Section`s). Each section is an array of fixed-size
+// records that can be accessed in place. Variable-length contents (names,
+// vertex streams, pixels, etc.) are stored in the `SectionBlob` section
+// and referenced by records through `Ref`s. All sections and blob entries
+// are aligned to `Alignment` bytes, so a mapped file can be used directly.
+//
+
+constexpr char Magic[8]{'Y', 'F', 'C', 'O', 'O', 'K', 'E', 'D'};
+constexpr uint32_t ByteOrder = 0x01020304;
+constexpr uint32_t Version = 1;
+constexpr uint64_t Alignment = 16;
+
+/// File header.
+///
+struct Header {
+  char magic[8];
+  uint32_t byteOrder;
+  uint32_t version;
+  uint64_t fileSize;
+  uint32_t sectionN;
+  uint32_t reserved;
+};
+static_assert(sizeof(Header) == 32);
+
+/// Section types.
+///
+enum SectionType : uint32_t {
+  SectionNode,
+  SectionScene,
+  SectionMesh,
+  SectionPrimitive,
+  SectionStream,
+  SectionImage,
+  SectionTexture,
+  SectionMaterial,
+  SectionSkin,
+  SectionAnimation,
+  SectionTrack,
+  SectionAction,
+  SectionBlob,
+
+  SectionN
+};
+
+/// Table of contents entry.
+///
+struct Section {
+  uint32_t type;
+  uint32_t count;
+  uint64_t offset;
+  uint64_t size;
+};
+static_assert(sizeof(Section) == 24);
+
+/// Reference to blob data.
+///
+struct Ref {
+  uint64_t offset;
+  uint64_t size;
+};
+
+/// Node kinds.
+///
+enum NodeKind : uint32_t {
+  KindNode,
+  KindModel,
+  KindJoint
+};
+
+/// Node record.
+///
+/// `children` is an array of `int32_t` node indices.
+///
+struct NodeRec {
+  uint32_t kind;
+  int32_t mesh;
+  int32_t skin;
+  uint32_t reserved;
+  float transform[16];
+  Ref name;
+  Ref children;
+};
+
+/// Scene record.
+///
+struct SceneRec {
+  float color[4];
+  Ref name;
+  Ref children;
+};
+
+/// Mesh record.
+///
+struct MeshRec {
+  uint32_t primitive;
+  uint32_t primitiveN;
+};
+
+/// Primitive record.
+///
+struct PrimitiveRec {
+  uint32_t topology;
+  int32_t material;
+  uint32_t stream;
+  uint32_t streamN;
+};
+
+/// Vertex/index stream record.
+///
+/// Vertex streams are stored tightly packed, in the element format that
+/// `vxInputFor()` expects for the given semantic.
+///
+struct StreamRec {
+  uint32_t semantic;
+  uint32_t elementN;
+  uint32_t elementSize;
+  uint32_t reserved;
+  Ref data;
+};
+
+/// Image record.
+///
+/// `data` stores all mip levels, largest first.
+///
+struct ImageRec {
+  uint32_t format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t levels;
+  uint32_t samples;
+  uint32_t reserved;
+  Ref data;
+};
+
+/// Sampler record.
+///
+struct SamplerRec {
+  uint32_t wrapU;
+  uint32_t wrapV;
+  uint32_t wrapW;
+  uint32_t magFilter;
+  uint32_t minFilter;
+};
+
+/// Texture record.
+///
+struct TextureRec {
+  int32_t image;
+  uint32_t coordSet;
+  SamplerRec sampler;
+};
+
+/// Material record.
+///
+struct MaterialRec {
+  struct {
+    int32_t texture;
+    uint32_t coordSet;
+  } maps[5];
+  float colorFac[4];
+  float metallic;
+  float roughness;
+  float normalScale;
+  float occlusionStrength;
+  float emissiveFac[3];
+  uint32_t alphaMode;
+  float alphaCutoff;
+  uint32_t doubleSided;
+};
+
+/// Skin record.
+///
+/// `joints` is an array of `int32_t` node indices.
+///
+struct SkinRec {
+  uint32_t jointN;
+  uint32_t reserved;
+  Ref joints;
+  Ref inverseBind;
+};
+
+/// Animation record.
+///
+/// Tracks are stored contiguously, in the order: inputs, translations,
+/// rotations and scales.
+///
+struct AnimationRec {
+  uint32_t track;
+  uint32_t inputN;
+  uint32_t outTN;
+  uint32_t outRN;
+  uint32_t outSN;
+  uint32_t action;
+  uint32_t actionN;
+  uint32_t reserved;
+  Ref name;
+};
+
+/// Animation track record.
+///
+/// Rotations are stored as `[r, v[0], v[1], v[2]]`.
+///
+struct TrackRec {
+  uint32_t count;
+  uint32_t components;
+  Ref data;
+};
+
+/// Animation action record.
+///
+struct ActionRec {
+  int32_t target;
+  uint32_t type;
+  uint32_t method;
+  uint32_t input;
+  uint32_t output;
+};
+
+/// Aligns a value to `Alignment`.
+///
+constexpr uint64_t alignUp(uint64_t value) {
+  return (value + Alignment - 1) & ~(Alignment - 1);
+}
+
+/// Cooked file writer.
+///
+class Writer {
+ public:
+  Writer() : sections_(SectionN), counts_(SectionN) { }
+
+  /// Appends a record to a section.
+  ///
+  template<class T>
+  uint32_t put(SectionType section, const T& record) {
+    static_assert(is_trivially_copyable<T>());
+    auto& sec = sections_[section];
+    const auto off = sec.size();
+    sec.resize(off + sizeof record);
+    memcpy(sec.data() + off, &record, sizeof record);
+    return counts_[section]++;
+  }
+
+  /// Gets the number of records in a section.
+  ///
+  uint32_t count(SectionType section) const {
+    return counts_[section];
+  }
+
+  /// Appends data to the blob.
+  ///
+  Ref blob(const void* data, uint64_t size) {
+    auto& sec = sections_[SectionBlob];
+    const auto off = alignUp(sec.size());
+    sec.resize(off + size);
+    if (size > 0)
+      memcpy(sec.data() + off, data, size);
+    return {off, size};
+  }
+
+  /// Appends a string to the blob.
+  ///
+  Ref blob(const wstring& str) {
+    vector<uint32_t> units(str.begin(), str.end());
+    return blob(units.data(), units.size() * sizeof(uint32_t));
+  }
+
+  /// Appends an index list to the blob.
+  ///
+  Ref blob(const vector<int32_t>& indices) {
+    return blob(indices.data(), indices.size() * sizeof(int32_t));
+  }
+
+  /// Writes the file.
+  ///
+  void write(const string& pathname) {
+    Header hdr{};
+    memcpy(hdr.magic, Magic, sizeof Magic);
+    hdr.byteOrder = ByteOrder;
+    hdr.version = Version;
+    hdr.sectionN = SectionN;
+
+    vector<Section> toc(SectionN);
+    uint64_t off = alignUp(sizeof hdr + SectionN * sizeof(Section));
+    for (uint32_t i = 0; i < SectionN; i++) {
+      toc[i] = {i, counts_[i], off, sections_[i].size()};
+      off = alignUp(off + sections_[i].size());
+    }
+    hdr.fileSize = off;
+
+    ofstream ofs(pathname, ios_base::binary | ios_base::trunc);
+    if (!ofs)
+      throw FileExcept("Could not open cooked file for writing");
+
+    const char padding[Alignment]{};
+    auto pad = [&] {
+      const uint64_t pos = ofs.tellp();
+      ofs.write(padding, alignUp(pos) - pos);
+    };
+
+    ofs.write(reinterpret_cast<const char*>(&hdr), sizeof hdr);
+    ofs.write(reinterpret_cast<const char*>(toc.data()),
+              toc.size() * sizeof(Section));
+    pad();
+    for (const auto& sec : sections_) {
+      ofs.write(sec.data(), sec.size());
+      pad();
+    }
+
+    if (!ofs)
+      throw FileExcept("Could not write to cooked file");
+  }
+
+ private:
+  vector<vector<char>> sections_;
+  vector<uint32_t> counts_;
+};
+
+/// Read-only file mapping.
+///
+class Mapping {
+ public:
+  Mapping(const string& pathname) {
+#if defined(__linux__) || defined(__APPLE__)
+    const int fd = open(pathname.data(), O_RDONLY);
+    if (fd == -1)
+      throw FileExcept("Could not open cooked file");
+
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+      close(fd);
+      throw FileExcept("Could not stat cooked file");
+    }
+
+    size_ = st.st_size;
+    if (size_ == 0) {
+      close(fd);
+      throw FileExcept("Invalid cooked file");
+    }
+
+    void* addr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED)
+      throw FileExcept("Could not map cooked file");
+
+    data_ = static_cast<const char*>(addr);
+#else
+    // Read the whole file instead
+    ifstream ifs(pathname, ios_base::binary | ios_base::ate);
+    if (!ifs)
+      throw FileExcept("Could not open cooked file");
+
+    size_ = ifs.tellg();
+    buffer_ = make_unique<char[]>(size_);
+    if (!ifs.seekg(0) || !ifs.read(buffer_.get(), size_))
+      throw FileExcept("Could not read from cooked file");
+
+    data_ = buffer_.get();
+#endif
+  }
+
+  Mapping(const Mapping&) = delete;
+  Mapping& operator=(const Mapping&) = delete;
+
+  ~Mapping() {
+#if defined(__linux__) || defined(__APPLE__)
+    munmap(const_cast<char*>(data_), size_);
+#endif
+  }
+
+  const char* data() const {
+    return data_;
+  }
+
+  uint64_t size() const {
+    return size_;
+  }
+
+ private:
+  const char* data_ = nullptr;
+  uint64_t size_ = 0;
+#if !defined(__linux__) && !defined(__APPLE__)
+  unique_ptr<char[]> buffer_{};
+#endif
+};
+
+/// Cooked file reader.
+///
+/// Records are read in place from the mapped file.
+///
+class Reader {
+ public:
+  Reader(const string& pathname) : mapping_(pathname) {
+    if (mapping_.size() < sizeof(Header))
+      throw FileExcept("Invalid cooked file");
+
+    const auto& hdr = *reinterpret_cast<const Header*>(mapping_.data());
+    if (memcmp(hdr.magic, Magic, sizeof Magic) != 0)
+      throw FileExcept("Invalid cooked file");
+    if (hdr.byteOrder != ByteOrder || hdr.version != Version)
+      throw UnsupportedExcept("Unsupported cooked file");
+    if (hdr.fileSize != mapping_.size() || hdr.sectionN < SectionN ||
+        sizeof hdr + hdr.sectionN * sizeof(Section) > mapping_.size())
+      throw FileExcept("Invalid cooked file");
+
+    toc_ = reinterpret_cast<const Section*>(mapping_.data() + sizeof hdr);
+    for (uint32_t i = 0; i < SectionN; i++) {
+      const auto& sec = toc_[i];
+      if (sec.type != i || sec.offset % Alignment != 0 ||
+          sec.offset > mapping_.size() ||
+          sec.size > mapping_.size() - sec.offset)
+        throw FileExcept("Invalid cooked file");
+    }
+  }
+
+  /// Gets the records of a section.
+  ///
+  template<class T>
+  pair<const T*, uint32_t> records(SectionType section) const {
+    const auto& sec = toc_[section];
+    if (sec.count * sizeof(T) != sec.size)
+      throw FileExcept("Invalid cooked file");
+    return {reinterpret_cast<const T*>(mapping_.data() + sec.offset),
+            sec.count};
+  }
+
+  /// Gets blob data.
+  ///
+  const char* blob(const Ref& ref) const {
+    const auto& sec = toc_[SectionBlob];
+    if (ref.offset > sec.size || ref.size > sec.size - ref.offset)
+      throw FileExcept("Invalid cooked file");
+    return mapping_.data() + sec.offset + ref.offset;
+  }
+
+  /// Gets a name from the blob.
+  ///
+  wstring name(const Ref& ref) const {
+    auto units = reinterpret_cast<const uint32_t*>(blob(ref));
+    return wstring(units, units + ref.size / sizeof(uint32_t));
+  }
+
+  /// Gets an index list from the blob.
+  ///
+  pair<const int32_t*, size_t> indices(const Ref& ref) const {
+    return {reinterpret_cast<const int32_t*>(blob(ref)),
+            ref.size / sizeof(int32_t)};
+  }
+
+ private:
+  Mapping mapping_;
+  const Section* toc_ = nullptr;
+};
+
+/// Checks that an index refers to an element of a container.
+///
+template<class T>
+inline void checkIndex(int64_t index, const T& container) {
+  if (index < 0 || static_cast<uint64_t>(index) >= container.size())
+    throw FileExcept("Invalid cooked file");
+}
+
+INTERNAL_NS_END
+
+bool SG_NS::isCooked(const string& pathname) {
+  ifstream ifs(pathname, ios_base::binary);
+  char magic[sizeof Magic];
+  return ifs.read(magic, sizeof magic) &&
+         memcmp(magic, Magic, sizeof Magic) == 0;
+}
+
+void SG_NS::writeCooked(const Collection& collection, const CookData& cookData,
+                        const string& pathname) {
+
+  if (cookData.meshes.size() != collection.meshes().size() ||
+      cookData.primitiveMaterials.size() != collection.meshes().size() ||
+      cookData.textures.size() != collection.textures().size() ||
+      cookData.materials.size() != collection.materials().size())
+    throw invalid_argument("writeCooked() cook data does not match");
+
+  Writer wr;
+
+  // Index maps
+  unordered_map<const Node*, int32_t> nodeMap;
+  for (size_t i = 0; i < collection.nodes().size(); i++)
+    nodeMap.emplace(collection.nodes()[i].get(), i);
+
+  unordered_map<const Mesh*, int32_t> meshMap;
+  for (size_t i = 0; i < collection.meshes().size(); i++)
+    meshMap.emplace(collection.meshes()[i].get(), i);
+
+  unordered_map<const Skin*, int32_t> skinMap;
+  for (size_t i = 0; i < collection.skins().size(); i++)
+    skinMap.emplace(collection.skins()[i].get(), i);
+
+  auto nodeIndices = [&](const vector<Node*>& nodes) {
+    vector<int32_t> indices;
+    for (const auto& nd : nodes) {
+      auto it = nodeMap.find(nd);
+      if (it == nodeMap.end())
+        throw invalid_argument("writeCooked() node not in collection");
+      indices.push_back(it->second);
+    }
+    return indices;
+  };
+
+  // Nodes
+  static_assert(sizeof(Mat4f) == sizeof NodeRec::transform);
+
+  for (const auto& nd : collection.nodes()) {
+    if (!nd)
+      throw invalid_argument("writeCooked() null node");
+
+    NodeRec rec{};
+    rec.kind = KindNode;
+    rec.mesh = -1;
+    rec.skin = -1;
+
+    if (auto model = dynamic_cast<Model*>(nd.get())) {
+      rec.kind = KindModel;
+      if (model->mesh())
+        rec.mesh = meshMap.at(model->mesh());
+      if (model->skin())
+        rec.skin = skinMap.at(model->skin());
+    } else if (dynamic_cast<Joint*>(nd.get())) {
+      rec.kind = KindJoint;
+    }
+
+    memcpy(rec.transform, nd->transform().data(), sizeof rec.transform);
+    rec.name = wr.blob(nd->name());
+    rec.children = wr.blob(nodeIndices(nd->children()));
+    wr.put(SectionNode, rec);
+  }
+
+  // Scenes
+  for (const auto& scn : collection.scenes()) {
+    SceneRec rec{};
+    copy(scn->color().begin(), scn->color().end(), rec.color);
+    rec.name = wr.blob(scn->name());
+    rec.children = wr.blob(nodeIndices(scn->children()));
+    wr.put(SectionScene, rec);
+  }
+
+  // Meshes
+  for (size_t i = 0; i < cookData.meshes.size(); i++) {
+    const auto& data = cookData.meshes[i];
+    const auto& matls = cookData.primitiveMaterials[i];
+    if (data.primitives.size() != matls.size())
+      throw invalid_argument("writeCooked() cook data does not match");
+
+    MeshRec mesh{wr.count(SectionPrimitive),
+                 static_cast<uint32_t>(data.primitives.size())};
+
+    for (size_t j = 0; j < data.primitives.size(); j++) {
+      const auto& prim = data.primitives[j];
+      PrimitiveRec rec{static_cast<uint32_t>(prim.topology), matls[j],
+                       wr.count(SectionStream),
+                       static_cast<uint32_t>(prim.accessors.size())};
+
+      for (const auto& acc : prim.accessors) {
+        const auto size = static_cast<uint64_t>(acc.elementN) *
+                          acc.elementSize;
+        wr.put(SectionStream, StreamRec{
+          acc.semantic, acc.elementN, acc.elementSize, 0,
+          wr.blob(&data.data[acc.dataIndex][acc.dataOffset], size)});
+      }
+
+      wr.put(SectionPrimitive, rec);
+    }
+
+    wr.put(SectionMesh, mesh);
+  }
+
+  // Images - only the ones that were decoded are written, so texture
+  // records refer to their position among these
+  vector<int32_t> imageIndices(cookData.images.size(), -1);
+  for (size_t i = 0; i < cookData.images.size(); i++) {
+    const auto& img = cookData.images[i];
+    if (!img.data)
+      continue;
+
+    imageIndices[i] = static_cast<int32_t>(wr.count(SectionImage));
+    const auto size = dataSizeOf(img.format, img.size, img.levels);
+    wr.put(SectionImage, ImageRec{
+      static_cast<uint32_t>(img.format), img.size.width, img.size.height,
+      img.levels, static_cast<uint32_t>(img.samples), 0,
+      wr.blob(img.data.get(), size)});
+  }
+
+  // Textures
+  for (size_t i = 0; i < collection.textures().size(); i++) {
+    const auto& tex = *collection.textures()[i];
+    const auto& splr = tex.sampler();
+    const auto image = cookData.textures[i];
+    if (image < 0 || static_cast<size_t>(image) >= imageIndices.size() ||
+        imageIndices[image] < 0)
+      throw invalid_argument("writeCooked() cook data does not match");
+    wr.put(SectionTexture, TextureRec{
+      imageIndices[image], static_cast<uint32_t>(tex.coordSet()),
+      {static_cast<uint32_t>(splr.wrapU), static_cast<uint32_t>(splr.wrapV),
+       static_cast<uint32_t>(splr.wrapW), static_cast<uint32_t>(splr.magFilter),
+       static_cast<uint32_t>(splr.minFilter)}});
+  }
+
+  // Materials
+  for (size_t i = 0; i < collection.materials().size(); i++) {
+    const auto& matl = *collection.materials()[i];
+    const Texture* maps[]{matl.pbrmr().colorTex.get(),
+                          matl.pbrmr().metalRoughTex.get(),
+                          matl.normal().texture.get(),
+                          matl.occlusion().texture.get(),
+                          matl.emissive().texture.get()};
+
+    MaterialRec rec{};
+    for (size_t j = 0; j < size(maps); j++) {
+      rec.maps[j].texture = maps[j] ? cookData.materials[i][j] : -1;
+      rec.maps[j].coordSet = maps[j] ? maps[j]->coordSet() : TexCoordSet0;
+    }
+    for (size_t j = 0; j < 4; j++)
+      rec.colorFac[j] = matl.pbrmr().colorFac[j];
+    rec.metallic = matl.pbrmr().metallic;
+    rec.roughness = matl.pbrmr().roughness;
+    rec.normalScale = matl.normal().scale;
+    rec.occlusionStrength = matl.occlusion().strength;
+    for (size_t j = 0; j < 3; j++)
+      rec.emissiveFac[j] = matl.emissive().factor[j];
+    rec.alphaMode = matl.alphaMode();
+    rec.alphaCutoff = matl.alphaCutoff();
+    rec.doubleSided = matl.doubleSided();
+    wr.put(SectionMaterial, rec);
+  }
+
+  // Skins
+  static_assert(is_trivially_copyable<Mat4f>());
+  static_assert(sizeof(Mat4f) == Mat4f::dataSize());
+
+  for (const auto& sk : collection.skins()) {
+    vector<Node*> joints(sk->joints().begin(), sk->joints().end());
+    const auto& ib = sk->inverseBind();
+    wr.put(SectionSkin, SkinRec{
+      static_cast<uint32_t>(joints.size()), 0,
+      wr.blob(nodeIndices(joints)),
+      wr.blob(ib.data(), ib.size() * sizeof(Mat4f))});
+  }
+
+  // Animations
+  static_assert(sizeof(Vec3f) == Vec3f::dataSize());
+
+  for (const auto& an : collection.animations()) {
+    AnimationRec rec{};
+    rec.track = wr.count(SectionTrack);
+    rec.inputN = an->inputs().size();
+    rec.outTN = an->outT().size();
+    rec.outRN = an->outR().size();
+    rec.outSN = an->outS().size();
+    rec.action = wr.count(SectionAction);
+    rec.actionN = an->actions().size();
+    rec.name = wr.blob(an->name());
+
+    for (const auto& in : an->inputs())
+      wr.put(SectionTrack, TrackRec{
+        static_cast<uint32_t>(in.size()), 1,
+        wr.blob(in.data(), in.size() * sizeof(float))});
+
+    for (const auto& t : an->outT())
+      wr.put(SectionTrack, TrackRec{
+        static_cast<uint32_t>(t.size()), 3,
+        wr.blob(t.data(), t.size() * sizeof(Vec3f))});
+
+    for (const auto& r : an->outR()) {
+      vector<float> tmp;
+      for (const auto& q : r)
+        tmp.insert(tmp.end(), {q.r(), q.v()[0], q.v()[1], q.v()[2]});
+      wr.put(SectionTrack, TrackRec{
+        static_cast<uint32_t>(r.size()), 4,
+        wr.blob(tmp.data(), tmp.size() * sizeof(float))});
+    }
+
+    for (const auto& s : an->outS())
+      wr.put(SectionTrack, TrackRec{
+        static_cast<uint32_t>(s.size()), 3,
+        wr.blob(s.data(), s.size() * sizeof(Vec3f))});
+
+    for (const auto& act : an->actions())
+      wr.put(SectionAction, ActionRec{
+        nodeMap.at(act.target), act.type, act.method,
+        static_cast<uint32_t>(act.input), static_cast<uint32_t>(act.output)});
+
+    wr.put(SectionAnimation, rec);
+  }
+
+  wr.write(pathname);
+}
+
+void SG_NS::loadCooked(Collection& collection, const string& pathname) {
+  CookData cookData;
+  loadCooked(collection, cookData, pathname);
+}
+
+void SG_NS::loadCooked(Collection& collection, CookData& cookData,
+                       const string& pathname) {
+
+  Reader rd(pathname);
+  Collection coll;
+
+  const auto nodes = rd.records<NodeRec>(SectionNode);
+  const auto scenes = rd.records<SceneRec>(SectionScene);
+  const auto meshes = rd.records<MeshRec>(SectionMesh);
+  const auto prims = rd.records<PrimitiveRec>(SectionPrimitive);
+  const auto streams = rd.records<StreamRec>(SectionStream);
+  const auto images = rd.records<ImageRec>(SectionImage);
+  const auto textures = rd.records<TextureRec>(SectionTexture);
+  const auto materials = rd.records<MaterialRec>(SectionMaterial);
+  const auto skins = rd.records<SkinRec>(SectionSkin);
+  const auto anims = rd.records<AnimationRec>(SectionAnimation);
+  const auto tracks = rd.records<TrackRec>(SectionTrack);
+  const auto actions = rd.records<ActionRec>(SectionAction);
+
+  // Nodes
+  for (uint32_t i = 0; i < nodes.second; i++) {
+    const auto& rec = nodes.first[i];
+    switch (rec.kind) {
+    case KindNode:
+      coll.nodes().push_back(make_unique<Node>());
+      break;
+    case KindModel:
+      coll.nodes().push_back(make_unique<Model>());
+      break;
+    case KindJoint:
+      coll.nodes().push_back(make_unique<Joint>());
+      break;
+    default:
+      throw FileExcept("Invalid cooked file");
+    }
+    auto& nd = *coll.nodes().back();
+    memcpy(nd.transform().data(), rec.transform, sizeof rec.transform);
+    nd.name() = rd.name(rec.name);
+  }
+
+  auto insertChildren = [&](Node& parent, const Ref& ref) {
+    const auto children = rd.indices(ref);
+    for (size_t i = 0; i < children.second; i++) {
+      checkIndex(children.first[i], coll.nodes());
+      parent.insert(*coll.nodes()[children.first[i]]);
+    }
+  };
+
+  for (uint32_t i = 0; i < nodes.second; i++)
+    insertChildren(*coll.nodes()[i], nodes.first[i].children);
+
+  // Scenes
+  for (uint32_t i = 0; i < scenes.second; i++) {
+    const auto& rec = scenes.first[i];
+    coll.scenes().push_back(make_unique<Scene>());
+    auto& scn = *coll.scenes().back();
+    copy(rec.color, rec.color + 4, scn.color().begin());
+    scn.name() = rd.name(rec.name);
+    insertChildren(scn, rec.children);
+  }
+
+  // Images
+  cookData.images = vector<Texture::Data>(images.second);
+  vector<Texture::Ptr> imgTextures;
+
+  for (uint32_t i = 0; i < images.second; i++) {
+    const auto& rec = images.first[i];
+    auto& data = cookData.images[i];
+    data.format = static_cast<CG_NS::PxFormat>(rec.format);
+    data.size = {rec.width, rec.height};
+    data.levels = rec.levels;
+    data.samples = static_cast<CG_NS::Samples>(rec.samples);
+
+    const auto size = dataSizeOf(data.format, data.size, data.levels);
+    if (rec.data.size != size)
+      throw FileExcept("Invalid cooked file");
+    data.data = make_unique<char[]>(size);
+    memcpy(data.data.get(), rd.blob(rec.data), size);
+
+    imgTextures.push_back(make_unique<Texture>(data));
+  }
+
+  // Textures
+  cookData.textures.clear();
+  for (uint32_t i = 0; i < textures.second; i++) {
+    const auto& rec = textures.first[i];
+    checkIndex(rec.image, imgTextures);
+
+    CG_NS::Sampler splr{};
+    splr.wrapU = static_cast<CG_NS::WrapMode>(rec.sampler.wrapU);
+    splr.wrapV = static_cast<CG_NS::WrapMode>(rec.sampler.wrapV);
+    splr.wrapW = static_cast<CG_NS::WrapMode>(rec.sampler.wrapW);
+    splr.magFilter = static_cast<CG_NS::Filter>(rec.sampler.magFilter);
+    splr.minFilter = static_cast<CG_NS::Filter>(rec.sampler.minFilter);
+
+    coll.textures().push_back(
+      make_unique<Texture>(*imgTextures[rec.image], splr,
+                           static_cast<TexCoordSet>(rec.coordSet)));
+    cookData.textures.push_back(rec.image);
+  }
+
+  // Materials
+  cookData.materials.clear();
+  for (uint32_t i = 0; i < materials.second; i++) {
+    const auto& rec = materials.first[i];
+    coll.materials().push_back(make_unique<Material>());
+    auto& matl = *coll.materials().back();
+    cookData.materials.push_back({});
+
+    Texture::Ptr* maps[]{&matl.pbrmr().colorTex, &matl.pbrmr().metalRoughTex,
+                         &matl.normal().texture, &matl.occlusion().texture,
+                         &matl.emissive().texture};
+
+    for (size_t j = 0; j < size(maps); j++) {
+      const auto tex = rec.maps[j].texture;
+      cookData.materials.back()[j] = tex;
+      if (tex < 0)
+        continue;
+      checkIndex(tex, coll.textures());
+      const auto& texture = *coll.textures()[tex];
+      *maps[j] = make_unique<Texture>(
+        texture, texture.sampler(),
+        static_cast<TexCoordSet>(rec.maps[j].coordSet));
+    }
+
+    matl.pbrmr().colorFac = {rec.colorFac[0], rec.colorFac[1],
+                             rec.colorFac[2], rec.colorFac[3]};
+    matl.pbrmr().metallic = rec.metallic;
+    matl.pbrmr().roughness = rec.roughness;
+    matl.normal().scale = rec.normalScale;
+    matl.occlusion().strength = rec.occlusionStrength;
+    matl.emissive().factor = {rec.emissiveFac[0], rec.emissiveFac[1],
+                              rec.emissiveFac[2]};
+    matl.setAlphaMode(static_cast<Material::AlphaMode>(rec.alphaMode));
+    matl.setAlphaCutoff(rec.alphaCutoff);
+    matl.setDoubleSided(rec.doubleSided);
+  }
+
+  // Meshes
+  cookData.meshes = vector<Mesh::Data>(meshes.second);
+  cookData.primitiveMaterials.assign(meshes.second, {});
+
+  for (uint32_t i = 0; i < meshes.second; i++) {
+    const auto& rec = meshes.first[i];
+    if (rec.primitive > prims.second ||
+        rec.primitiveN > prims.second - rec.primitive)
+      throw FileExcept("Invalid cooked file");
+
+    auto& data = cookData.meshes[i];
+
+    for (uint32_t j = 0; j < rec.primitiveN; j++) {
+      const auto& prim = prims.first[rec.primitive + j];
+      if (prim.stream > streams.second ||
+          prim.streamN > streams.second - prim.stream)
+        throw FileExcept("Invalid cooked file");
+
+      data.primitives.push_back({static_cast<CG_NS::Topology>(prim.topology)});
+      auto& primData = data.primitives.back();
+
+      for (uint32_t k = 0; k < prim.streamN; k++) {
+        const auto& strm = streams.first[prim.stream + k];
+        if (strm.data.size !=
+            static_cast<uint64_t>(strm.elementN) * strm.elementSize)
+          throw FileExcept("Invalid cooked file");
+
+        primData.accessors.push_back({static_cast<VxData>(strm.semantic),
+                                      static_cast<uint32_t>(data.data.size()),
+                                      0, strm.elementN, strm.elementSize});
+        data.data.push_back(make_unique<char[]>(strm.data.size));
+        memcpy(data.data.back().get(), rd.blob(strm.data), strm.data.size);
+      }
+
+      if (prim.material >= 0) {
+        checkIndex(prim.material, coll.materials());
+        primData.material = make_unique<Material>(
+          *coll.materials()[prim.material]);
+      }
+      cookData.primitiveMaterials[i].push_back(prim.material);
+    }
+
+    coll.meshes().push_back(make_unique<Mesh>(data));
+  }
+
+  // Skins
+  for (uint32_t i = 0; i < skins.second; i++) {
+    const auto& rec = skins.first[i];
+    const auto joints = rd.indices(rec.joints);
+    if (joints.second != rec.jointN || rec.inverseBind.size % sizeof(Mat4f))
+      throw FileExcept("Invalid cooked file");
+
+    vector<Mat4f> inverseBind(rec.inverseBind.size / sizeof(Mat4f));
+    auto ib = reinterpret_cast<char*>(inverseBind.data());
+    memcpy(ib, rd.blob(rec.inverseBind), rec.inverseBind.size);
+
+    coll.skins().push_back(make_unique<Skin>(rec.jointN, inverseBind));
+    for (uint32_t j = 0; j < rec.jointN; j++) {
+      checkIndex(joints.first[j], coll.nodes());
+      auto joint = dynamic_cast<Joint*>(coll.nodes()[joints.first[j]].get());
+      if (!joint)
+        throw FileExcept("Invalid cooked file");
+      coll.skins().back()->setJoint(*joint, j);
+    }
+  }
+
+  // Models
+  for (uint32_t i = 0; i < nodes.second; i++) {
+    const auto& rec = nodes.first[i];
+    if (rec.kind != KindModel)
+      continue;
+    auto& model = static_cast<Model&>(*coll.nodes()[i]);
+    if (rec.mesh >= 0) {
+      checkIndex(rec.mesh, coll.meshes());
+      model.setMesh(coll.meshes()[rec.mesh].get());
+    }
+    if (rec.skin >= 0) {
+      checkIndex(rec.skin, coll.skins());
+      model.setSkin(coll.skins()[rec.skin].get());
+    }
+  }
+
+  // Animations
+  for (uint32_t i = 0; i < anims.second; i++) {
+    const auto& rec = anims.first[i];
+    const uint64_t trackN = static_cast<uint64_t>(rec.inputN) + rec.outTN +
+                            rec.outRN + rec.outSN;
+    if (rec.track > tracks.second || trackN > tracks.second - rec.track ||
+        rec.action > actions.second ||
+        rec.actionN > actions.second - rec.action)
+      throw FileExcept("Invalid cooked file");
+
+    auto track = tracks.first + rec.track;
+
+    // Gets track data as an array of floats
+    auto getTrack = [&](uint32_t components) {
+      const auto& trk = *track++;
+      if (trk.components != components ||
+          trk.data.size != sizeof(float) * components * trk.count)
+        throw FileExcept("Invalid cooked file");
+      return make_pair(reinterpret_cast<const float*>(rd.blob(trk.data)),
+                       trk.count);
+    };
+
+    vector<Animation::Timeline> inputs;
+    for (uint32_t j = 0; j < rec.inputN; j++) {
+      const auto trk = getTrack(1);
+      inputs.push_back(Animation::Timeline(trk.first, trk.first + trk.second));
+    }
+
+    vector<Animation::Translation> outT;
+    for (uint32_t j = 0; j < rec.outTN; j++) {
+      const auto trk = getTrack(3);
+      outT.push_back(Animation::Translation(trk.second));
+      memcpy(reinterpret_cast<char*>(outT.back().data()), trk.first,
+             trk.second * sizeof(Vec3f));
+    }
+
+    vector<Animation::Rotation> outR;
+    for (uint32_t j = 0; j < rec.outRN; j++) {
+      const auto trk = getTrack(4);
+      outR.push_back({});
+      for (uint32_t k = 0; k < trk.second; k++) {
+        const auto v = trk.first + k * 4;
+        outR.back().push_back(Qnionf(v[0], {v[1], v[2], v[3]}));
+      }
+    }
+
+    vector<Animation::Scale> outS;
+    for (uint32_t j = 0; j < rec.outSN; j++) {
+      const auto trk = getTrack(3);
+      outS.push_back(Animation::Scale(trk.second));
+      memcpy(reinterpret_cast<char*>(outS.back().data()), trk.first,
+             trk.second * sizeof(Vec3f));
+    }
+
+    coll.animations().push_back(make_unique<Animation>(inputs,
+                                                       outT, outR, outS));
+    auto& anim = *coll.animations().back();
+    anim.name() = rd.name(rec.name);
+
+    for (uint32_t j = 0; j < rec.actionN; j++) {
+      const auto& act = actions.first[rec.action + j];
+      checkIndex(act.target, coll.nodes());
+      checkIndex(act.input, inputs);
+      switch (act.type) {
+      case Animation::T: checkIndex(act.output, outT); break;
+      case Animation::R: checkIndex(act.output, outR); break;
+      case Animation::S: checkIndex(act.output, outS); break;
+      default:
+        throw FileExcept("Invalid cooked file");
+      }
+      if (act.method > Animation::Cubic)
+        throw FileExcept("Invalid cooked file");
+      anim.actions().push_back({coll.nodes()[act.target].get(),
+                                static_cast<Animation::Type>(act.type),
+                                static_cast<Animation::Method>(act.method),
+                                act.input, act.output});
+    }
+  }
+
+  collection = move(coll);
+}
+
+void SG_NS::cookGLTF(const string& srcPathname, const string& dstPathname,
+                     bool mipmaps, Collection::Compression compression,
+                     float quality) {
+
+  Collection coll;
+  CookData cookData;
+  loadGLTF(coll, cookData, srcPathname, mipmaps);
+
+  if (compression != Collection::Uncompressed) {
+    const bool highQuality = compression == Collection::High;
+    for (auto& image : cookData.images) {
+      // Images that no texture uses are not decoded
+      if (image.data)
+        compressTexture(image, blockEncodingOf(image, highQuality), quality);
+    }
+  }
+
+  writeCooked(coll, cookData, dstPathname);
+}
@@ -0,0 +1,77 @@
+//
+// SG
+// DataCooked.h
+//
+// Copyright © 2021 Gustavo C. Viegas.
+//
+
+#ifndef YF_SG_DATACOOKED_H
+#define YF_SG_DATACOOKED_H
+
+#include <cstdint>
+#include <array>
+#include <vector>
+#include <string>
+
+#include "Collection.h"
+#include "Mesh.h"
+#include "Texture.h"
+
+SG_NS_BEGIN
+
+/// CPU-side data of a collection, as required to write a cooked file.
+///
+/// Mesh and texture resources do not retain the data used to create them,
+/// so this data must be gathered while the collection is being loaded.
+///
+struct CookData {
+  /// Mesh data, one per `Collection::meshes()` element.
+  ///
+  std::vector<Mesh::Data> meshes{};
+
+  /// Material index of each mesh primitive (`-1` if none).
+  ///
+  std::vector<std::vector<int32_t>> primitiveMaterials{};
+
+  /// Decoded images.
+  ///
+  /// Images that no texture uses are left empty, and are not cooked.
+  ///
+  std::vector<Texture::Data> images{};
+
+  /// Image index of each `Collection::textures()` element.
+  ///
+  std::vector<int32_t> textures{};
+
+  /// Texture index of each material map (`-1` if none).
+  ///
+  /// Maps are ordered as: color, metal-rough, normal, occlusion, emissive.
+  ///
+  std::vector<std::array<int32_t, 5>> materials{};
+};
+
+/// Checks whether a file is a cooked collection file.
+///
+bool isCooked(const std::string& pathname);
+
+/// Writes contents to a cooked collection file.
+///
+void writeCooked(const Collection& collection, const CookData& cookData,
+                 const std::string& pathname);
+
+/// Loads contents from a cooked collection file.
+///
+void loadCooked(Collection& collection, const std::string& pathname);
+void loadCooked(Collection& collection, CookData& cookData,
+                const std::string& pathname);
+
+/// Converts a glTF file into a cooked collection file.
+///
+void cookGLTF(const std::string& srcPathname, const std::string& dstPathname,
+              bool mipmaps = false,
+              Collection::Compression compression = Collection::Uncompressed,
+              float quality = 0.5f);
+
+SG_NS_END
+
+#endif // YF_SG_DATACOOKED_H
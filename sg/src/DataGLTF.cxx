@@ -15,6 +15,10 @@
 #include <stdexcept>
 
 #include "DataGLTF.h"
+#include "DataCooked.h"
+#include "DataPNG.h"
+#include "DataKTX.h"
+#include "Mipmap.h"
 #include "Model.h"
 #include "yf/Except.h"
 
@@ -403,6 +407,7 @@ class GLTF {
   struct Texture {
     int32_t sampler = -1;
     int32_t source = -1;
+    int32_t basisuSource = -1;
     string name{};
   };
 
@@ -1335,6 +1340,35 @@ class GLTF {
     assert(symbol.type() == Symbol::Str);
     assert(symbol.tokens() == "textures");
 
+    // `KHR_texture_basisu` provides an alternative, KTX2 source
+    auto parseExtensions = [&] {
+      bool basisu = false;
+
+      while (true) {
+        switch (symbol.next()) {
+        case Symbol::Str:
+          if (symbol.tokens() == "KHR_texture_basisu")
+            basisu = true;
+          else if (basisu && symbol.tokens() == "source")
+            parseNum(symbol, textures_.back().basisuSource);
+          else
+            symbol.consumeProperty();
+          break;
+
+        case Symbol::Op:
+          if (symbol.token() == '}') {
+            if (!basisu)
+              return;
+            basisu = false;
+          }
+          break;
+
+        default:
+          throw FileExcept("Invalid glTF file");
+        }
+      }
+    };
+
     parseObjectArray(symbol, [&] {
       textures_.push_back({});
 
@@ -1347,6 +1381,8 @@ class GLTF {
             parseNum(symbol, textures_.back().source);
           else if (symbol.tokens() == "name")
             parseStr(symbol, textures_.back().name);
+          else if (symbol.tokens() == "extensions")
+            parseExtensions();
           else
             symbol.consumeProperty();
           break;
@@ -1872,9 +1908,11 @@ class GLTF {
 ///
 class DataLoad {
  public:
-  DataLoad(const GLTF& gltf)
+  DataLoad(const GLTF& gltf, CookData* cookData = nullptr,
+           bool mipmaps = false)
     : gltf_(gltf), collection_(), buffers_(gltf.buffers().size()),
-      images_(gltf.images().size()), joints_(gltf.nodes().size()) {
+      images_(gltf.images().size()), joints_(gltf.nodes().size()),
+      cookData_(cookData), mipmaps_(mipmaps) {
 
     collection_.scenes().resize(gltf.scenes().size());
     collection_.nodes().resize(gltf.nodes().size());
@@ -1888,6 +1926,29 @@ class DataLoad {
       for (const auto& jt : sk.joints)
         joints_[jt] = true;
     }
+
+    // Alpha-tested materials need their coverage kept across mip levels
+    if (mipmaps_) {
+      alphaCutoffs_.assign(gltf.images().size(), -1.0f);
+      for (const auto& matl : gltf.materials()) {
+        const auto texture = matl.pbrMetallicRoughness.baseColorTexture.index;
+        if (matl.alphaMode != "MASK" || texture < 0)
+          continue;
+        const auto image = gltf.textures()[texture].source;
+        if (image >= 0)
+          alphaCutoffs_[image] = matl.alphaCutoff;
+      }
+    }
+
+    if (cookData_) {
+      cookData_->meshes = vector<Mesh::Data>(gltf.meshes().size());
+      cookData_->primitiveMaterials.clear();
+      cookData_->primitiveMaterials.resize(gltf.meshes().size());
+      cookData_->images = vector<Texture::Data>(gltf.images().size());
+      cookData_->textures.assign(gltf.textures().size(), -1);
+      cookData_->materials.assign(gltf.materials().size(),
+                                  {-1, -1, -1, -1, -1});
+    }
   }
 
   DataLoad(const DataLoad&) = delete;
@@ -2026,6 +2087,8 @@ class DataLoad {
 
     const auto& tex = gltf_.textures()[texture];
     CG_NS::Sampler splr{};
+    if (mipmaps_)
+      splr.minFilter = CG_NS::FilterLinearLinear;
 
     if (tex.sampler > -1) {
       const auto& sampler = gltf_.samplers()[tex.sampler];
@@ -2057,6 +2120,9 @@ class DataLoad {
 
       switch (sampler.minFilter) {
       case GLTF::Sampler::Undefined:
+        splr.minFilter = mipmaps_ ? CG_NS::FilterLinearLinear :
+                                    CG_NS::FilterNearest;
+        break;
       case GLTF::Sampler::Nearest:
         splr.minFilter = CG_NS::FilterNearest;
         break;
@@ -2080,9 +2146,28 @@ class DataLoad {
       }
     }
 
-    const auto& image = loadImage(tex.source);
+    // Prefer the KTX2 source, unless its payload cannot be used (e.g.,
+    // Basis Universal data) and there is a fallback
+    int32_t source = tex.source;
+    if (tex.basisuSource > -1) {
+      try {
+        loadImage(tex.basisuSource);
+        source = tex.basisuSource;
+      } catch (const UnsupportedExcept&) {
+        if (tex.source < 0)
+          throw;
+        // The unused source is not cooked
+        if (cookData_)
+          cookData_->images[tex.basisuSource] = {};
+      }
+    }
+
+    const auto& image = loadImage(source);
     collection_.textures()[texture] = make_unique<Texture>(image, splr,
                                                            TexCoordSet0);
+    if (cookData_)
+      cookData_->textures[texture] = source;
+
     return *collection_.textures()[texture];
   }
 
@@ -2119,6 +2204,14 @@ class DataLoad {
     const auto& matl = gltf_.materials()[material];
     auto& dst = *(collection_.materials()[material] = make_unique<Material>());
 
+    if (cookData_)
+      cookData_->materials[material] = {
+        matl.pbrMetallicRoughness.baseColorTexture.index,
+        matl.pbrMetallicRoughness.metallicRoughnessTexture.index,
+        matl.normalTexture.index,
+        matl.occlusionTexture.index,
+        matl.emissiveTexture.index};
+
     // PBRMR
     const auto& pbrmr = matl.pbrMetallicRoughness;
     dst.pbrmr().colorTex = getTexture(pbrmr.baseColorTexture);
@@ -2173,6 +2266,16 @@ class DataLoad {
     if (collection_.meshes()[mesh])
       return *collection_.meshes()[mesh];
 
+    if (cookData_) {
+      auto& data = cookData_->meshes[mesh];
+      getMeshData(data, mesh);
+      for (const auto& prim : gltf_.meshes()[mesh].primitives)
+        cookData_->primitiveMaterials[mesh].push_back(prim.material);
+
+      collection_.meshes()[mesh] = make_unique<Mesh>(data);
+      return *collection_.meshes()[mesh];
+    }
+
     Mesh::Data data{};
     getMeshData(data, mesh);
 
@@ -2471,6 +2574,9 @@ class DataLoad {
   vector<ifstream> buffers_{};
   vector<Texture::Ptr> images_{};
   vector<bool> joints_{};
+  CookData* cookData_ = nullptr;
+  bool mipmaps_ = false;
+  vector<float> alphaCutoffs_{};
 
   /// Seeks into buffer as specified by a `GLTF::BufferView`.
   ///
@@ -2530,6 +2636,33 @@ class DataLoad {
       return *images_[image];
 
     const auto& img = gltf_.images()[image];
+
+    if (cookData_ || mipmaps_) {
+      // Decode into texture data, keeping it if cooking
+      Texture::Data tmp;
+      auto& data = cookData_ ? cookData_->images[image] : tmp;
+
+      ifstream file;
+      if (!img.uri.empty()) {
+        file.open(gltf_.directory() + '/' + img.uri, ios_base::binary);
+        if (!file)
+          throw FileExcept("Could not open glTF image file");
+      }
+      auto& ifs = img.uri.empty() ? seekBufferView(img.bufferView) : file;
+
+      // KTX2 files provide their own mip levels
+      if (isKTX(ifs)) {
+        loadKTX(data, ifs);
+      } else {
+        loadPNG(data, ifs);
+        if (mipmaps_)
+          generateMipmaps(data, MipFilterKaiser, alphaCutoffs_[image]);
+      }
+
+      images_[image] = make_unique<Texture>(data);
+      return *images_[image];
+    }
+
     if (img.uri.empty()) {
       // Image provided through a buffer view
       auto& ifs = seekBufferView(img.bufferView);
@@ -2547,21 +2680,36 @@ class DataLoad {
 
 INTERNAL_NS_END
 
-void SG_NS::loadGLTF(Collection& collection, const string& pathname) {
+void SG_NS::loadGLTF(Collection& collection, const string& pathname,
+                     bool mipmaps) {
+
   GLTF gltf(pathname);
 
   gltf.print();
 
-  DataLoad data(gltf);
+  DataLoad data(gltf, nullptr, mipmaps);
   collection = move(data.loadContents());
 }
 
-void SG_NS::loadGLTF(Collection& collection, ifstream& stream) {
+void SG_NS::loadGLTF(Collection& collection, ifstream& stream,
+                     bool mipmaps) {
+
   GLTF gltf(stream, "");
 
   gltf.print();
 
-  DataLoad data(gltf);
+  DataLoad data(gltf, nullptr, mipmaps);
+  collection = move(data.loadContents());
+}
+
+void SG_NS::loadGLTF(Collection& collection, CookData& cookData,
+                     const string& pathname, bool mipmaps) {
+
+  GLTF gltf(pathname);
+
+  gltf.print();
+
+  DataLoad data(gltf, &cookData, mipmaps);
   collection = move(data.loadContents());
 }
 
@@ -2726,6 +2874,7 @@ void GLTF::print() const {
     wprintf(L"\n  texture `%s`:", tex.name.data());
     wprintf(L"\n   sampler: %d", tex.sampler);
     wprintf(L"\n   source: %d", tex.source);
+    wprintf(L"\n   KHR_texture_basisu source: %d", tex.basisuSource);
   }
 
   wprintf(L"\n samplers:");
@@ -17,10 +17,21 @@
 
 SG_NS_BEGIN
 
+struct CookData;
+
 /// Loads contents from a glTF file.
 ///
-void loadGLTF(Collection& collection, const std::string& pathname);
-void loadGLTF(Collection& collection, std::ifstream& stream);
+/// If `mipmaps` is set, full mip chains are generated for every image.
+///
+void loadGLTF(Collection& collection, const std::string& pathname,
+              bool mipmaps = false);
+void loadGLTF(Collection& collection, std::ifstream& stream,
+              bool mipmaps = false);
+
+/// Loads contents from a glTF file, retaining CPU-side data for cooking.
+///
+void loadGLTF(Collection& collection, CookData& cookData,
+              const std::string& pathname, bool mipmaps = false);
 
 /// Loads mesh data from a glTF file.
 ///
@@ -0,0 +1,188 @@
+//
+// SG
+// DataKTX.cxx
+//
+// Copyright © 2021 Gustavo C. Viegas.
+//
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+#include "DataKTX.h"
+#include "TextureImpl.h"
+#include "yf/Except.h"
+
+using namespace YF_NS;
+using namespace SG_NS;
+using namespace std;
+
+INTERNAL_NS_BEGIN
+
+/// KTX2 file identifier.
+///
+constexpr uint8_t Identifier[] = {
+  0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A
+};
+
+/// Size of the fixed part of the header (identifier, header and index).
+///
+constexpr size_t HeaderSize = 80;
+
+/// Size of a level index entry.
+///
+constexpr size_t LevelSize = 24;
+
+/// Supercompression schemes.
+///
+enum Supercompression : uint32_t {
+  SupercompressionNone  = 0,
+  SupercompressionBasis = 1,
+  SupercompressionZstd  = 2,
+  SupercompressionZlib  = 3
+};
+
+/// Reads a little-endian integer.
+///
+template<class T>
+T readLE(const uint8_t* src) {
+  T x = 0;
+  for (size_t i = 0; i < sizeof(T); i++)
+    x |= static_cast<T>(src[i]) << (i * 8);
+  return x;
+}
+
+/// Converts from a `VkFormat` value.
+///
+/// Formats that do not match any of the texture formats are converted to
+/// `PxFormatUndefined`.
+///
+CG_NS::PxFormat fromVkFormat(uint32_t vkFormat) {
+  switch (vkFormat) {
+  case 9:   return CG_NS::PxFormatR8Unorm;
+  case 16:  return CG_NS::PxFormatRg8Unorm;
+  case 23:  return CG_NS::PxFormatRgb8Unorm;
+  case 29:  return CG_NS::PxFormatRgb8Srgb;
+  case 37:  return CG_NS::PxFormatRgba8Unorm;
+  case 43:  return CG_NS::PxFormatRgba8Srgb;
+  case 44:  return CG_NS::PxFormatBgra8Unorm;
+  case 50:  return CG_NS::PxFormatBgra8Srgb;
+  case 70:  return CG_NS::PxFormatR16Unorm;
+  case 77:  return CG_NS::PxFormatRg16Unorm;
+  case 84:  return CG_NS::PxFormatRgb16Unorm;
+  case 91:  return CG_NS::PxFormatRgba16Unorm;
+
+  // BC1 RGB blocks decode the same as RGBA blocks with opaque colors
+  case 131:
+  case 133: return CG_NS::PxFormatBc1Unorm;
+  case 132:
+  case 134: return CG_NS::PxFormatBc1Srgb;
+  case 137: return CG_NS::PxFormatBc3Unorm;
+  case 138: return CG_NS::PxFormatBc3Srgb;
+  case 139: return CG_NS::PxFormatBc4Unorm;
+  case 140: return CG_NS::PxFormatBc4Norm;
+  case 141: return CG_NS::PxFormatBc5Unorm;
+  case 142: return CG_NS::PxFormatBc5Norm;
+  case 145: return CG_NS::PxFormatBc7Unorm;
+  case 146: return CG_NS::PxFormatBc7Srgb;
+
+  default:  return CG_NS::PxFormatUndefined;
+  }
+}
+
+/// Reads KTX2 data from a stream.
+///
+void readKTX(Texture::Data& dst, ifstream& ifs) {
+  const auto base = ifs.tellg();
+
+  uint8_t header[HeaderSize];
+  if (!ifs.read(reinterpret_cast<char*>(header), HeaderSize))
+    throw FileExcept("Could not read from KTX2 file");
+  if (memcmp(header, Identifier, sizeof Identifier) != 0)
+    throw FileExcept("Invalid KTX2 file");
+
+  const auto vkFormat = readLE<uint32_t>(header+12);
+  const auto width = readLE<uint32_t>(header+20);
+  const auto height = readLE<uint32_t>(header+24);
+  const auto depth = readLE<uint32_t>(header+28);
+  const auto layers = readLE<uint32_t>(header+32);
+  const auto faces = readLE<uint32_t>(header+36);
+  const auto levels = max(1U, readLE<uint32_t>(header+40));
+  const auto scheme = readLE<uint32_t>(header+44);
+
+  switch (scheme) {
+  case SupercompressionNone:
+    break;
+  case SupercompressionBasis:
+    throw UnsupportedExcept("Basis supercompression of KTX2 not supported");
+  default:
+    throw UnsupportedExcept("Unsupported KTX2 supercompression scheme");
+  }
+
+  // Basis Universal UASTC payloads use an undefined format
+  const auto format = fromVkFormat(vkFormat);
+  if (format == CG_NS::PxFormatUndefined)
+    throw UnsupportedExcept("Unsupported KTX2 format");
+
+  if (width == 0 || height == 0 || depth > 1 || layers > 1 || faces != 1)
+    throw UnsupportedExcept("Only 2D textures supported in KTX2 files");
+  if (levels > 32 || (max(width, height) >> (levels - 1)) == 0)
+    throw FileExcept("Invalid KTX2 level count");
+
+  vector<uint8_t> index(levels * LevelSize);
+  if (!ifs.read(reinterpret_cast<char*>(index.data()), index.size()))
+    throw FileExcept("Could not read from KTX2 file");
+
+  const CG_NS::Size2 size{width, height};
+  auto data = make_unique<char[]>(dataSizeOf(format, size, levels));
+  auto bytes = data.get();
+
+  // The index starts at the base level, although level data is stored
+  // in the file smallest first
+  CG_NS::Size2 lvlSize = size;
+  for (uint32_t i = 0; i < levels; i++) {
+    const auto offset = readLE<uint64_t>(&index[i*LevelSize]);
+    const auto length = readLE<uint64_t>(&index[i*LevelSize+8]);
+    const auto lvlBytes = levelSizeOf(format, lvlSize);
+
+    if (length != lvlBytes)
+      throw FileExcept("Invalid KTX2 level size");
+    if (!ifs.seekg(base + static_cast<streamoff>(offset)) ||
+        !ifs.read(bytes, length))
+      throw FileExcept("Could not read from KTX2 file");
+
+    bytes += lvlBytes;
+    lvlSize.width = max(1U, lvlSize.width >> 1);
+    lvlSize.height = max(1U, lvlSize.height >> 1);
+  }
+
+  dst.data = move(data);
+  dst.format = format;
+  dst.size = size;
+  dst.levels = levels;
+  dst.samples = CG_NS::Samples1;
+}
+
+INTERNAL_NS_END
+
+bool SG_NS::isKTX(ifstream& stream) {
+  const auto pos = stream.tellg();
+  char id[sizeof Identifier];
+  const bool res = stream.read(id, sizeof id) &&
+                   memcmp(id, Identifier, sizeof id) == 0;
+  stream.clear();
+  stream.seekg(pos);
+  return res;
+}
+
+void SG_NS::loadKTX(Texture::Data& dst, const string& pathname) {
+  ifstream ifs(pathname, ios_base::binary);
+  if (!ifs)
+    throw FileExcept("Could not open KTX2 file");
+  readKTX(dst, ifs);
+}
+
+void SG_NS::loadKTX(Texture::Data& dst, ifstream& stream) {
+  readKTX(dst, stream);
+}
@@ -0,0 +1,35 @@
+//
+// SG
+// DataKTX.h
+//
+// Copyright © 2021 Gustavo C. Viegas.
+//
+
+#ifndef YF_SG_DATAKTX_H
+#define YF_SG_DATAKTX_H
+
+#include <string>
+#include <fstream>
+
+#include "Texture.h"
+
+SG_NS_BEGIN
+
+/// Checks whether a stream is positioned at the start of a KTX2 file.
+///
+/// The stream position is left unchanged.
+///
+bool isKTX(std::ifstream& stream);
+
+/// Loads texture data from a KTX2 file.
+///
+/// Only 2D textures whose levels are stored without supercompression are
+/// supported. Every level in the file is loaded, so block-compressed
+/// data can be used as is.
+///
+void loadKTX(Texture::Data& dst, const std::string& pathname);
+void loadKTX(Texture::Data& dst, std::ifstream& stream);
+
+SG_NS_END
+
+#endif // YF_SG_DATAKTX_H
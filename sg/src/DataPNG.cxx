@@ -10,18 +10,20 @@
 #include <cwchar>
 #include <cstring>
 #include <cassert>
-#include <atomic>
 #include <algorithm>
 #include <vector>
+#include <functional>
 #include <stdexcept>
 
 #include "DataPNG.h"
+#include "Checksum.h"
 #include "yf/Except.h"
 
 #if defined(_DEFAULT_SOURCE)
 # include <endian.h>
 inline uint16_t letoh(uint16_t v) { return le16toh(v); }
 inline uint32_t letoh(uint32_t v) { return le32toh(v); }
+inline uint64_t letoh(uint64_t v) { return le64toh(v); }
 inline uint16_t htole(uint16_t v) { return htole16(v); }
 inline uint32_t htole(uint32_t v) { return htole16(v); }
 inline uint16_t betoh(uint16_t v) { return be16toh(v); }
@@ -33,6 +35,15 @@ inline uint32_t htobe(uint32_t v) { return htobe16(v); }
 # error "Invalid platform"
 #endif
 
+#if defined(__SSE2__)
+# include <emmintrin.h>
+# if defined(__SSSE3__)
+#  include <tmmintrin.h>
+# endif
+#elif defined(__ARM_NEON)
+# include <arm_neon.h>
+#endif
+
 #ifdef YF_DEVEL
 # include <cstdio>
 #endif
@@ -43,6 +54,586 @@ using namespace std;
 
 INTERNAL_NS_BEGIN
 
+/// Provider of compressed data.
+///
+/// Sets the next span of data and returns `true`, or returns `false` when
+/// there is no more data.
+///
+using ZInput = function<bool (const uint8_t*& data, size_t& size)>;
+
+/// Consumer of decompressed data.
+///
+using ZOutput = function<void (const uint8_t* data, size_t size)>;
+
+/// Bit reader for compressed data.
+///
+/// Bits are consumed LSB first from a 64-bit buffer, which is refilled
+/// with as many whole bytes as it can hold. Data may be split in any
+/// number of spans, which are requested from `ZInput` as needed.
+///
+class ZBits {
+ public:
+  ZBits(const ZInput& input) : input_(input) { }
+
+  /// Refills the buffer so that it holds at least 56 bits.
+  ///
+  void refill() {
+    if (end_ - cur_ >= 8) {
+      uint64_t word;
+      memcpy(&word, cur_, sizeof word);
+      buf_ |= letoh(word) << n_;
+      cur_ += (63 - n_) >> 3;
+      n_ |= 56;
+    } else {
+      while (n_ <= 56) {
+        if (cur_ != end_ || next())
+          buf_ |= static_cast<uint64_t>(*cur_++) << n_;
+        else
+          // Zero padding past the end of data
+          pad_++;
+        n_ += 8;
+      }
+    }
+  }
+
+  /// Gets the next `n` bits without consuming them.
+  ///
+  uint32_t peek(uint32_t n) const {
+    assert(n <= 32);
+    return buf_ & ((uint64_t(1) << n) - 1);
+  }
+
+  /// Consumes `n` bits.
+  ///
+  void consume(uint32_t n) {
+    assert(n <= n_);
+    buf_ >>= n;
+    n_ -= n;
+  }
+
+  /// Consumes and returns `n` bits.
+  ///
+  /// The buffer must hold at least `n` bits.
+  ///
+  uint32_t take(uint32_t n) {
+    const auto value = peek(n);
+    consume(n);
+    return value;
+  }
+
+  /// Consumes and returns `n` bits, refilling the buffer as needed.
+  ///
+  uint32_t bits(uint32_t n) {
+    if (n_ < n)
+      refill();
+    return take(n);
+  }
+
+  /// Discards bits up to the next byte boundary.
+  ///
+  void alignToByte() {
+    consume(n_ & 7);
+  }
+
+  /// Copies `n` bytes.
+  ///
+  /// Must be called on a byte boundary, after `alignToByte()`.
+  ///
+  void copy(uint8_t* dst, size_t n) {
+    assert((n_ & 7) == 0);
+
+    // Buffered bytes first
+    for (; n > 0 && n_ > 0; n--) {
+      if (n_ <= pad_ * 8)
+        throw runtime_error("Invalid data for decompression");
+      *dst++ = take(8);
+    }
+    if (n == 0)
+      return;
+
+    // XXX: Bits past `n_` are stale once bytes are read from `cur_`
+    buf_ = 0;
+    while (n > 0) {
+      if (cur_ == end_ && !next())
+        throw runtime_error("Invalid data for decompression");
+      const size_t size = min(n, static_cast<size_t>(end_ - cur_));
+      memcpy(dst, cur_, size);
+      dst += size;
+      cur_ += size;
+      n -= size;
+    }
+  }
+
+  /// Checks whether bits past the end of data were consumed.
+  ///
+  bool overrun() const {
+    return pad_ * 8 > n_;
+  }
+
+ private:
+  const ZInput& input_;
+  const uint8_t* cur_ = nullptr;
+  const uint8_t* end_ = nullptr;
+  uint64_t buf_ = 0;
+  uint32_t n_ = 0;
+  uint32_t pad_ = 0;
+
+  /// Moves to the next non-empty span of data.
+  ///
+  bool next() {
+    size_t size = 0;
+    do {
+      if (!input_(cur_, size)) {
+        cur_ = end_ = nullptr;
+        return false;
+      }
+    } while (size == 0);
+    end_ = cur_ + size;
+    return true;
+  }
+};
+
+/// Decoding table for a prefix code.
+///
+/// Codes are looked up using the next `primaryBits` bits of input. Codes
+/// that are longer than this are resolved through a second-level table,
+/// which the primary entry links to.
+///
+/// Entry layout: bits [0, 8) hold the code length (or, for links, zero),
+/// bits [8, 12) hold the index width of a linked table, bit 15 flags a
+/// link and bits [16, 32) hold the symbol (or the linked table's offset).
+///
+class ZTable {
+ public:
+  ZTable() = default;
+
+  ZTable(const uint8_t* codeLengths, uint32_t n, uint32_t primaryBits)
+    : table_(1 << primaryBits), primaryBits_(primaryBits) {
+
+    assert(primaryBits > 0 && primaryBits <= 15);
+
+    // Count number of codes per length
+    uint32_t count[MaxLength + 1]{};
+    for (uint32_t i = 0; i < n; i++) {
+      if (codeLengths[i] > MaxLength)
+        throw runtime_error("Invalid data for decompression");
+      count[codeLengths[i]]++;
+    }
+
+    // Set initial codes for each length
+    count[0] = 0;
+    uint32_t nextCode[MaxLength + 1]{};
+    for (uint32_t i = 1; i <= MaxLength; i++)
+      nextCode[i] = (nextCode[i-1] + count[i-1]) << 1;
+
+    // Fill primary entries and find the size of each second-level table
+    const uint32_t mask = (1 << primaryBits) - 1;
+    vector<uint16_t> codes(n);
+    vector<uint8_t> subBits(1 << primaryBits);
+
+    for (uint32_t i = 0; i < n; i++) {
+      const uint32_t length = codeLengths[i];
+      if (length == 0)
+        continue;
+
+      const uint32_t code = nextCode[length]++;
+      if (code >> length)
+        throw runtime_error("Invalid data for decompression");
+
+      // Codes are stored MSB first
+      uint32_t rev = 0;
+      for (uint32_t j = 0; j < length; j++)
+        rev |= ((code >> j) & 1) << (length-j-1);
+      codes[i] = rev;
+
+      if (length <= primaryBits) {
+        for (uint32_t k = rev; k <= mask; k += 1 << length)
+          table_[k] = (i << 16) | length;
+      } else {
+        auto& sb = subBits[rev & mask];
+        sb = max<uint8_t>(sb, length - primaryBits);
+      }
+    }
+
+    // Link and fill second-level tables
+    for (uint32_t i = 0; i <= mask; i++) {
+      if (subBits[i] == 0)
+        continue;
+      table_[i] = (table_.size() << 16) | Link | (subBits[i] << 8);
+      table_.resize(table_.size() + (1 << subBits[i]));
+    }
+
+    for (uint32_t i = 0; i < n; i++) {
+      const uint32_t length = codeLengths[i];
+      if (length <= primaryBits)
+        continue;
+
+      const auto link = table_[codes[i] & mask];
+      const uint32_t offset = link >> 16;
+      const uint32_t size = 1 << ((link >> 8) & 0xF);
+      const uint32_t subLength = length - primaryBits;
+      for (uint32_t k = codes[i] >> primaryBits; k < size; k += 1 << subLength)
+        table_[offset+k] = (i << 16) | subLength;
+    }
+  }
+
+  /// Decodes a symbol.
+  ///
+  /// The bit buffer must hold at least `MaxLength` bits.
+  ///
+  uint32_t decode(ZBits& bits) const {
+    auto entry = table_[bits.peek(primaryBits_)];
+    if (entry & Link) {
+      bits.consume(primaryBits_);
+      entry = table_[(entry >> 16) + bits.peek((entry >> 8) & 0xF)];
+    }
+
+    const uint32_t length = entry & 0xFF;
+    if (length == 0)
+      throw runtime_error("Invalid data for decompression");
+
+    bits.consume(length);
+    return entry >> 16;
+  }
+
+  /// Maximum code length.
+  ///
+  static constexpr uint32_t MaxLength = 15;
+
+ private:
+  static constexpr uint32_t Link = 0x8000;
+
+  vector<uint32_t> table_{};
+  uint32_t primaryBits_ = 0;
+};
+
+/// Index widths of the primary decoding tables.
+///
+constexpr uint32_t LiteralBits = 10;
+constexpr uint32_t DistanceBits = 8;
+constexpr uint32_t LengthBits = 7;
+
+/// Base values and extra bits of length codes (257-285).
+///
+constexpr uint16_t LengthBase[29]{3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17,
+                                  19, 23, 27, 31, 35, 43, 51, 59, 67, 83,
+                                  99, 115, 131, 163, 195, 227, 258};
+constexpr uint8_t LengthExtra[29]{0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2,
+                                  2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5,
+                                  0};
+
+/// Base values and extra bits of distance codes (0-29).
+///
+constexpr uint16_t DistanceBase[30]{1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49,
+                                    65, 97, 129, 193, 257, 385, 513, 769,
+                                    1025, 1537, 2049, 3073, 4097, 6145, 8193,
+                                    12289, 16385, 24577};
+constexpr uint8_t DistanceExtra[30]{0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5,
+                                    6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11,
+                                    12, 12, 13, 13};
+
+/// Gets the decoding table for fixed literal/length codes.
+///
+const ZTable& fixedLiterals() {
+  static const ZTable table = [] {
+    uint8_t lengths[288];
+    fill_n(lengths, 144, 8);
+    fill_n(lengths+144, 112, 9);
+    fill_n(lengths+256, 24, 7);
+    fill_n(lengths+280, 8, 8);
+    return ZTable(lengths, 288, LiteralBits);
+  }();
+  return table;
+}
+
+/// Gets the decoding table for fixed distance codes.
+///
+const ZTable& fixedDistances() {
+  static const ZTable table = [] {
+    uint8_t lengths[32];
+    fill_n(lengths, 32, 5);
+    return ZTable(lengths, 32, DistanceBits);
+  }();
+  return table;
+}
+
+/// Copies `length` bytes from `distance` bytes behind `dst`.
+///
+/// Overlapping matches are copied in chunks, either eight bytes at a time
+/// (if `dstEnd` leaves room for overwriting) or by doubling the size of the
+/// repeated pattern.
+///
+inline void copyMatch(uint8_t* dst, uint32_t distance, uint32_t length,
+                      const uint8_t* dstEnd) {
+
+  const uint8_t* src = dst - distance;
+
+  if (distance >= 8 && static_cast<size_t>(dstEnd - dst) >= length + 8) {
+    const auto end = dst + length;
+    do {
+      memcpy(dst, src, 8);
+      dst += 8;
+      src += 8;
+    } while (dst < end);
+
+  } else if (distance == 1) {
+    memset(dst, *src, length);
+
+  } else {
+    uint32_t n = distance;
+    while (length > 0) {
+      n = min(n, length);
+      memcpy(dst, src, n);
+      dst += n;
+      length -= n;
+      n <<= 1;
+    }
+  }
+}
+
+/// Size of the sliding window of compressed data.
+///
+constexpr size_t WindowSize = 32768;
+
+/// Decompresses data.
+///
+/// Decompressed data is produced in a sliding window and passed to
+/// `output` whenever the window is full, so memory usage does not depend
+/// on the size of the data. If `verify` is set, the Adler-32 checksum of
+/// decompressed data is checked.
+///
+void inflate(const ZInput& input, const ZOutput& output, bool verify) {
+  ZBits bits(input);
+
+  // Datastream header
+  const uint32_t cmf = bits.bits(8);
+  const uint32_t flg = bits.bits(8);
+
+  if ((cmf & 15) != 8 || (cmf >> 4) > 7 || (flg & 32) != 0 ||
+      ((cmf << 8) + flg) % 31 != 0)
+    throw runtime_error("Invalid data for decompression");
+
+  // Process blocks
+  // XXX: The window must have room for a match of maximum length (258)
+  // plus the eight bytes that `copyMatch()` may overwrite
+  vector<uint8_t> window(WindowSize * 4);
+  uint8_t* const out = window.data();
+  const uint8_t* const outEnd = out + window.size();
+  const size_t outLimit = window.size() - 266;
+  size_t dataOff = 0;
+  size_t flushOff = 0;
+  uint32_t adler = 1;
+
+  // Outputs pending data
+  auto flush = [&] {
+    if (verify)
+      adler = adler32(out+flushOff, dataOff-flushOff, adler);
+    output(out+flushOff, dataOff-flushOff);
+  };
+
+  // Outputs pending data and makes room in the window
+  auto slide = [&] {
+    flush();
+    if (dataOff > WindowSize) {
+      memmove(out, out+dataOff-WindowSize, WindowSize);
+      dataOff = WindowSize;
+    }
+    flushOff = dataOff;
+  };
+
+  while (true) {
+    const auto bfinal = bits.bits(1);
+    const auto btype = bits.bits(2);
+
+    if (btype == 0) {
+      // No compression
+      bits.alignToByte();
+
+      uint16_t len;
+      bits.copy(reinterpret_cast<uint8_t*>(&len), sizeof len);
+      len = letoh(len);
+
+      uint16_t nlen;
+      bits.copy(reinterpret_cast<uint8_t*>(&nlen), sizeof nlen);
+      nlen = letoh(nlen);
+
+      if ((nlen ^ len) != 0xFFFF)
+        throw runtime_error("Invalid data for decompression");
+
+      while (len > 0) {
+        if (dataOff > outLimit)
+          slide();
+        const auto n = min(static_cast<size_t>(len), window.size() - dataOff);
+        bits.copy(out+dataOff, n);
+        dataOff += n;
+        len -= n;
+      }
+
+    } else {
+      // Compression
+      const ZTable* literals;
+      const ZTable* distances;
+      ZTable dynLiterals;
+      ZTable dynDistances;
+
+      if (btype == 1) {
+        // Fixed H. codes
+        literals = &fixedLiterals();
+        distances = &fixedDistances();
+
+      } else if (btype == 2) {
+        // Dynamic H. codes
+        const uint32_t hlit = bits.bits(5) + 257;
+        const uint32_t hdist = bits.bits(5) + 1;
+        const uint32_t hclen = bits.bits(4) + 4;
+
+        // Literal/length codes 286-287 and distance codes 30-31 never
+        // occur in valid data
+        if (hlit > 286 || hdist > 30)
+          throw runtime_error("Invalid data for decompression");
+
+        // Create code length table
+        static constexpr uint8_t lenMap[19]{16, 17, 18, 0, 8, 7, 9, 6, 10, 5,
+                                            11, 4, 12, 3, 13, 2, 14, 1, 15};
+        uint8_t lenLengths[19]{};
+        for (uint32_t i = 0; i < hclen; i++)
+          lenLengths[lenMap[i]] = bits.bits(3);
+        const ZTable lenTable(lenLengths, 19, LengthBits);
+
+        // Decompress literal & distance code lengths (as a single sequence)
+        uint8_t lengths[286 + 32];
+        uint32_t count = 0;
+        while (count < hlit + hdist) {
+          bits.refill();
+          const auto value = lenTable.decode(bits);
+          uint32_t times;
+          uint8_t length = 0;
+
+          if (value < 16) {
+            // Code length
+            lengths[count++] = value;
+            continue;
+          } else if (value == 16) {
+            // Copy previous
+            if (count == 0)
+              throw runtime_error("Invalid data for decompression");
+            times = 3 + bits.take(2);
+            length = lengths[count-1];
+          } else if (value == 17) {
+            // Repeat zero length
+            times = 3 + bits.take(3);
+          } else {
+            // Repeat zero length
+            times = 11 + bits.take(7);
+          }
+
+          if (times > hlit + hdist - count)
+            throw runtime_error("Invalid data for decompression");
+          fill_n(lengths+count, times, length);
+          count += times;
+        }
+
+        // Create literal & distance code tables
+        dynLiterals = ZTable(lengths, hlit, LiteralBits);
+        dynDistances = ZTable(lengths+hlit, hdist, DistanceBits);
+        literals = &dynLiterals;
+        distances = &dynDistances;
+
+      } else {
+        throw runtime_error("Invalid data for decompression");
+      }
+
+      // Decompress data using the literal and distance code tables
+      while (true) {
+        if (dataOff > outLimit)
+          slide();
+
+        // At most 48 bits are consumed per iteration
+        bits.refill();
+
+        // Decode literal/length
+        auto value = literals->decode(bits);
+
+        if (value < 256) {
+          // Literal
+          out[dataOff++] = value;
+
+        } else if (value == 256) {
+          // End of block
+          break;
+
+        } else if (value < 286) {
+          // Length/Distance pair
+          value -= 257;
+          const uint32_t length = LengthBase[value] +
+                                  bits.take(LengthExtra[value]);
+
+          value = distances->decode(bits);
+          if (value >= 30)
+            throw runtime_error("Invalid data for decompression");
+          const uint32_t distance = DistanceBase[value] +
+                                    bits.take(DistanceExtra[value]);
+
+          if (distance > dataOff)
+            throw runtime_error("Invalid data for decompression");
+
+          // Copy data
+          copyMatch(out+dataOff, distance, length, outEnd);
+          dataOff += length;
+
+        } else {
+          throw runtime_error("Invalid data for decompression");
+        }
+      }
+    }
+
+    if (bits.overrun())
+      throw runtime_error("Invalid data for decompression");
+
+    if (bfinal)
+      break;
+  }
+
+  flush();
+
+  // Datastream checksum
+  if (verify) {
+    bits.alignToByte();
+    uint32_t check;
+    bits.copy(reinterpret_cast<uint8_t*>(&check), sizeof check);
+    if (betoh(check) != adler)
+      throw runtime_error("Invalid checksum for decompressed data");
+  }
+}
+
+/// Decompresses data.
+///
+/// Throws if decompressed data does not fit in `dst`.
+///
+void inflate(const vector<uint8_t>& src, vector<uint8_t>& dst) {
+  bool pending = true;
+  ZInput input = [&](const uint8_t*& data, size_t& size) {
+    if (!pending)
+      return false;
+    pending = false;
+    data = src.data();
+    size = src.size();
+    return true;
+  };
+
+  size_t dataOff = 0;
+  ZOutput output = [&](const uint8_t* data, size_t size) {
+    if (size > dst.size() - dataOff)
+      throw runtime_error("Invalid data for decompression");
+    memcpy(dst.data()+dataOff, data, size);
+    dataOff += size;
+  };
+
+  inflate(input, output, true);
+}
+
+#ifdef YF_DEVEL
+
 /// Node of a code tree.
 ///
 struct ZNode {
@@ -116,9 +707,12 @@ void createCodeTree(const vector<uint8_t>& codeLengths, ZTree& codeTree) {
 
 void printCodeTree(const ZTree& codeTree);
 
-/// Decompresses data.
+/// Decompresses data (reference implementation).
 ///
-void inflate(const vector<uint8_t>& src, vector<uint8_t>& dst) {
+/// This decoder walks the code trees one bit at a time. It is kept for
+/// validation and benchmarking of `inflate()`.
+///
+void inflateTree(const vector<uint8_t>& src, vector<uint8_t>& dst) {
   assert(src.size() > 2);
   assert(!dst.empty());
 
@@ -358,95 +952,368 @@ void inflate(const vector<uint8_t>& src, vector<uint8_t>& dst) {
   }
 }
 
+#endif // YF_DEVEL
+
+/// Reverses the filter of a scanline.
+///
+/// `cur` and `prior` point past the filter byte. When there is no prior
+/// scanline, `prior` must point to zeroed memory.
+///
+void unfilterScalar(uint8_t filter, uint8_t* cur, const uint8_t* prior,
+                    uint32_t size, uint32_t Bpp) {
+
+  switch (filter) {
+  case 0:
+    // None
+    break;
+
+  case 1:
+    // Sub
+    for (uint32_t i = Bpp; i < size; i++)
+      cur[i] += cur[i-Bpp];
+    break;
+
+  case 2:
+    // Up
+    for (uint32_t i = 0; i < size; i++)
+      cur[i] += prior[i];
+    break;
+
+  case 3:
+    // Average
+    for (uint32_t i = 0; i < Bpp; i++)
+      cur[i] += prior[i] >> 1;
+    for (uint32_t i = Bpp; i < size; i++) {
+      const uint16_t prev = cur[i-Bpp];
+      const uint16_t above = prior[i];
+      cur[i] += (prev + above) >> 1;
+    }
+    break;
+
+  case 4:
+    // Paeth
+    for (uint32_t i = 0; i < Bpp; i++)
+      cur[i] += prior[i];
+    for (uint32_t i = Bpp; i < size; i++) {
+      const int16_t a = cur[i-Bpp];
+      const int16_t b = prior[i];
+      const int16_t c = prior[i-Bpp];
+      const int16_t p = a + b - c;
+      const int16_t pa = abs(p-a);
+      const int16_t pb = abs(p-b);
+      const int16_t pc = abs(p-c);
+      cur[i] += (pa <= pb && pa <= pc) ? (a) : (pb <= pc ? b : c);
+    }
+    break;
+
+  default:
+    throw runtime_error("Invalid PNG data for unfiltering");
+  }
+}
+
+#if defined(__SSE2__)
+
+// Filters that use the previous pixel are processed one pixel at a
+// time, with all of its bytes in a single vector.
+
+template<uint32_t Bpp>
+inline __m128i loadPixel(const uint8_t* src) {
+  int32_t x = 0;
+  memcpy(&x, src, Bpp);
+  return _mm_cvtsi32_si128(x);
+}
+
+template<uint32_t Bpp>
+inline void storePixel(uint8_t* dst, __m128i x) {
+  const int32_t y = _mm_cvtsi128_si32(x);
+  memcpy(dst, &y, Bpp);
+}
+
+inline __m128i absolute(__m128i x) {
+#if defined(__SSSE3__)
+  return _mm_abs_epi16(x);
+#else
+  return _mm_max_epi16(x, _mm_sub_epi16(_mm_setzero_si128(), x));
+#endif
+}
+
+inline __m128i select(__m128i mask, __m128i a, __m128i b) {
+  return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+void unfilterUp(uint8_t* cur, const uint8_t* prior, uint32_t size) {
+  uint32_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    const auto x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur+i));
+    const auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prior+i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(cur+i), _mm_add_epi8(x, b));
+  }
+  for (; i < size; i++)
+    cur[i] += prior[i];
+}
+
+template<uint32_t Bpp>
+void unfilterSub(uint8_t* cur, uint32_t size) {
+  auto a = _mm_setzero_si128();
+  for (uint32_t i = 0; i < size; i += Bpp) {
+    a = _mm_add_epi8(a, loadPixel<Bpp>(cur+i));
+    storePixel<Bpp>(cur+i, a);
+  }
+}
+
+template<uint32_t Bpp>
+void unfilterAverage(uint8_t* cur, const uint8_t* prior, uint32_t size) {
+  const auto one = _mm_set1_epi8(1);
+  auto a = _mm_setzero_si128();
+  for (uint32_t i = 0; i < size; i += Bpp) {
+    const auto b = loadPixel<Bpp>(prior+i);
+    // `_mm_avg_epu8` rounds up
+    const auto avg = _mm_sub_epi8(_mm_avg_epu8(a, b),
+                                  _mm_and_si128(_mm_xor_si128(a, b), one));
+    a = _mm_add_epi8(avg, loadPixel<Bpp>(cur+i));
+    storePixel<Bpp>(cur+i, a);
+  }
+}
+
+template<uint32_t Bpp>
+void unfilterPaeth(uint8_t* cur, const uint8_t* prior, uint32_t size) {
+  const auto zero = _mm_setzero_si128();
+  auto a = zero;
+  auto c = zero;
+  for (uint32_t i = 0; i < size; i += Bpp) {
+    const auto b = _mm_unpacklo_epi8(loadPixel<Bpp>(prior+i), zero);
+    // |p-a| = |b-c|, |p-b| = |a-c|, |p-c| = |(b-c)+(a-c)|
+    auto pa = _mm_sub_epi16(b, c);
+    auto pb = _mm_sub_epi16(a, c);
+    auto pc = _mm_add_epi16(pa, pb);
+    pa = absolute(pa);
+    pb = absolute(pb);
+    pc = absolute(pc);
+    const auto min = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+    const auto pred = select(_mm_cmpeq_epi16(min, pa), a,
+                             select(_mm_cmpeq_epi16(min, pb), b, c));
+    const auto x = _mm_add_epi8(_mm_packus_epi16(pred, pred),
+                                loadPixel<Bpp>(cur+i));
+    storePixel<Bpp>(cur+i, x);
+    a = _mm_unpacklo_epi8(x, zero);
+    c = b;
+  }
+}
+
+#elif defined(__ARM_NEON)
+
+// Filters that use the previous pixel are processed one pixel at a
+// time, with all of its bytes in a single vector.
+
+template<uint32_t Bpp>
+inline uint8x8_t loadPixel(const uint8_t* src) {
+  uint32_t x = 0;
+  memcpy(&x, src, Bpp);
+  return vreinterpret_u8_u32(vdup_n_u32(x));
+}
+
+template<uint32_t Bpp>
+inline void storePixel(uint8_t* dst, uint8x8_t x) {
+  const uint32_t y = vget_lane_u32(vreinterpret_u32_u8(x), 0);
+  memcpy(dst, &y, Bpp);
+}
+
+void unfilterUp(uint8_t* cur, const uint8_t* prior, uint32_t size) {
+  uint32_t i = 0;
+  for (; i + 16 <= size; i += 16)
+    vst1q_u8(cur+i, vaddq_u8(vld1q_u8(cur+i), vld1q_u8(prior+i)));
+  for (; i < size; i++)
+    cur[i] += prior[i];
+}
+
+template<uint32_t Bpp>
+void unfilterSub(uint8_t* cur, uint32_t size) {
+  auto a = vdup_n_u8(0);
+  for (uint32_t i = 0; i < size; i += Bpp) {
+    a = vadd_u8(a, loadPixel<Bpp>(cur+i));
+    storePixel<Bpp>(cur+i, a);
+  }
+}
+
+template<uint32_t Bpp>
+void unfilterAverage(uint8_t* cur, const uint8_t* prior, uint32_t size) {
+  auto a = vdup_n_u8(0);
+  for (uint32_t i = 0; i < size; i += Bpp) {
+    const auto avg = vhadd_u8(a, loadPixel<Bpp>(prior+i));
+    a = vadd_u8(avg, loadPixel<Bpp>(cur+i));
+    storePixel<Bpp>(cur+i, a);
+  }
+}
+
+template<uint32_t Bpp>
+void unfilterPaeth(uint8_t* cur, const uint8_t* prior, uint32_t size) {
+  auto a = vdup_n_u8(0);
+  auto c = vdup_n_u8(0);
+  for (uint32_t i = 0; i < size; i += Bpp) {
+    const auto b = loadPixel<Bpp>(prior+i);
+    // |p-a| = |b-c|, |p-b| = |a-c|, |p-c| = |(b-c)+(a-c)|
+    const auto pa = vmovl_u8(vabd_u8(b, c));
+    const auto pb = vmovl_u8(vabd_u8(a, c));
+    const auto pc = vreinterpretq_u16_s16(
+      vabsq_s16(vaddq_s16(vreinterpretq_s16_u16(vsubl_u8(b, c)),
+                          vreinterpretq_s16_u16(vsubl_u8(a, c)))));
+    const auto useA = vmovn_u16(vandq_u16(vcleq_u16(pa, pb),
+                                          vcleq_u16(pa, pc)));
+    const auto useB = vmovn_u16(vcleq_u16(pb, pc));
+    const auto pred = vbsl_u8(useA, a, vbsl_u8(useB, b, c));
+    a = vadd_u8(pred, loadPixel<Bpp>(cur+i));
+    storePixel<Bpp>(cur+i, a);
+    c = b;
+  }
+}
+
+#endif // defined(__SSE2__)
+
+/// Reverses the filter of a scanline, using vector code when possible.
+///
+void unfilterScanline(uint8_t filter, uint8_t* cur, const uint8_t* prior,
+                      uint32_t size, uint32_t Bpp) {
+
+#if defined(__SSE2__) || defined(__ARM_NEON)
+  if (filter == 2) {
+    unfilterUp(cur, prior, size);
+    return;
+  }
+
+  if (filter != 0 && (Bpp == 3 || Bpp == 4) && size % Bpp == 0) {
+    switch (filter) {
+    case 1:
+      Bpp == 3 ? unfilterSub<3>(cur, size) : unfilterSub<4>(cur, size);
+      break;
+    case 3:
+      Bpp == 3 ? unfilterAverage<3>(cur, prior, size) :
+                 unfilterAverage<4>(cur, prior, size);
+      break;
+    case 4:
+      Bpp == 3 ? unfilterPaeth<3>(cur, prior, size) :
+                 unfilterPaeth<4>(cur, prior, size);
+      break;
+    default:
+      throw runtime_error("Invalid PNG data for unfiltering");
+    }
+    return;
+  }
+#endif
+
+  unfilterScalar(filter, cur, prior, size, Bpp);
+}
+
+/// Reverses the filters of consecutive scanlines.
+///
+/// Each scanline is `sclnSize` bytes long, including the filter byte.
+///
+void unfilterScanlines(vector<uint8_t>& data, uint32_t sclnSize,
+                       uint32_t Bpp) {
+  assert(sclnSize > 1);
+  assert(data.size() % sclnSize == 0);
+
+  const vector<uint8_t> zero(sclnSize);
+  const uint8_t* prior = zero.data() + 1;
+
+  for (size_t off = 0; off < data.size(); off += sclnSize) {
+    unfilterScanline(data[off], &data[off+1], prior, sclnSize - 1, Bpp);
+    prior = &data[off+1];
+  }
+}
+
 /// PNG.
 ///
 class PNG {
  public:
-  PNG(const string& pathname)
-    : ihdr_{}, plte_{}, idat_{},
-      components_(0), bpp_(0), Bpp_(0), sclnSize_(0) {
+  PNG(const string& pathname, bool verify)
+    : file_(pathname), ifs_(file_), verify_(verify) {
 
-    ifstream ifs(pathname);
-    if (!ifs)
+    if (!ifs_)
       throw FileExcept("Could not open PNG file");
 
-    init(ifs);
+    init();
   }
 
-  PNG(ifstream& ifs)
-    : ihdr_{}, plte_{}, idat_{},
-      components_(0), bpp_(0), Bpp_(0), sclnSize_(0) {
-
-    init(ifs);
+  PNG(ifstream& ifs, bool verify) : ifs_(ifs), verify_(verify) {
+    init();
   }
 
   PNG(const PNG&) = delete;
   PNG& operator=(const PNG&) = delete;
   ~PNG() = default;
 
+  /// Size of `imageData()`, in bytes.
+  ///
+  size_t imageSize() const {
+    return lnSize_ * ihdr_.height;
+  }
+
   /// Produces raw image data.
   ///
-  unique_ptr<char[]> imageData() const {
-    vector<uint8_t> cdata{};
-    decompress(cdata);
-    unfilter(cdata);
+  unique_ptr<char[]> imageData() {
+    auto idata = make_unique<char[]>(imageSize());
+    imageData(idata.get());
+    return idata;
+  }
 
-    const size_t lnSize = ihdr_.width * (ihdr_.colorType == 3 ? 3 : Bpp_);
-    const size_t size = lnSize * ihdr_.height;
-    auto idata = make_unique<char[]>(size);
+  /// Produces raw image data in caller-supplied memory.
+  ///
+  /// `dst` must have room for `imageSize()` bytes. Compressed data is
+  /// read from file one chunk at a time and decompressed into a window
+  /// of two scanlines, which are unfiltered and written to `dst` as soon
+  /// as they are complete.
+  ///
+  void imageData(char* dst) {
+    assert(dst);
+
+    // Scanline window
+    vector<uint8_t> sclns(sclnSize_ * 2);
+    uint8_t* curScln = sclns.data();
+    uint8_t* priorScln = curScln + sclnSize_;
+    uint32_t sclnOff = 0;
+    uint32_t row = 0;
+
+    ZInput input = [&](const uint8_t*& data, size_t& size) {
+      if (!nextIDAT())
+        return false;
+      data = reinterpret_cast<const uint8_t*>(&buffer_[DataOff]);
+      size = length_;
+      return true;
+    };
 
-    // Palette indices
-    if (ihdr_.colorType == 3) {
-      // XXX: Needs testing
-      for (uint32_t i = 0; i < ihdr_.height; i++) {
-        const auto scanline = &cdata[1+i*sclnSize_];
-        uint32_t byteOff = 0;
-        uint32_t bitOff = 0;
-        for (uint32_t j = 0; j < ihdr_.width; j++) {
-          uint8_t index = 0;
-          for (uint8_t k = 0; k < ihdr_.bitDepth; k++)
-            index |= scanline[byteOff] & (1 << (k+bitOff));
-          index >>= bitOff;
-          memcpy(&idata[i*lnSize+j*3], &plte_[index], 3);
-          const div_t d = div(bitOff + ihdr_.bitDepth, 8);
-          byteOff += d.quot;
-          bitOff = d.rem;
-        }
-      }
+    ZOutput output = [&](const uint8_t* data, size_t size) {
+      while (size > 0) {
+        if (row == ihdr_.height)
+          throw FileExcept("Invalid PNG file");
 
-    // 1/2/4 bit depth greyscale
-    } else if (ihdr_.bitDepth < 8) {
-      // XXX: Needs testing
-      for (uint32_t i = 0; i < ihdr_.height; i++) {
-        const auto scanline = &cdata[1+i*sclnSize_];
-        uint32_t byteOff = 0;
-        uint32_t bitOff = 0;
-        for (uint32_t j = 0; j < ihdr_.width; j++) {
-          uint8_t value = 0;
-          for (uint8_t k = 0; k < ihdr_.bitDepth; k++)
-            value |= scanline[byteOff] & (1 << (k+bitOff));
-          idata[i*lnSize+j] = value >> bitOff;
-          const div_t d = div(bitOff + ihdr_.bitDepth, 8);
-          byteOff += d.quot;
-          bitOff = d.rem;
+        const auto n = min(size, static_cast<size_t>(sclnSize_ - sclnOff));
+        memcpy(curScln+sclnOff, data, n);
+        data += n;
+        size -= n;
+        sclnOff += n;
+
+        if (sclnOff == sclnSize_) {
+          unfilterScanline(curScln[0], curScln+1, priorScln+1, sclnSize_-1,
+                           Bpp_);
+          convert(curScln+1, dst+row*lnSize_);
+          swap(curScln, priorScln);
+          sclnOff = 0;
+          row++;
         }
       }
+    };
 
-    // 8/16 bit depth truecolor or greyscale
-    } else {
-      for (uint32_t i = 0; i < ihdr_.height; i++)
-        memcpy(&idata[i*lnSize], &cdata[1+i*sclnSize_], lnSize);
-      if (ihdr_.bitDepth == 16) {
-        for (size_t i = 0; i < size; i += 2) {
-          uint16_t x;
-          memcpy(&x, &idata[i], 2);
-          x = betoh(x);
-          memcpy(&idata[i], &x, 2);
-        }
-      }
-    }
+    inflate(input, output, verify_);
 
-    return idata;
+    if (row != ihdr_.height)
+      throw FileExcept("Invalid PNG file");
+
+    // Remaining chunks
+    while (nextIDAT()) { }
+    while (!ended_) {
+      readChunk();
+      processChunk();
+    }
   }
 
   /// Width of `imageData()`.
@@ -513,6 +1380,12 @@ class PNG {
   static constexpr uint8_t IDATType[]{'I', 'D', 'A', 'T'};
   static constexpr uint8_t IENDType[]{'I', 'E', 'N', 'D'};
 
+  /// Chunk layout.
+  ///
+  static constexpr uint32_t LengthOff = 0;
+  static constexpr uint32_t TypeOff = 4;
+  static constexpr uint32_t DataOff = 8;
+
   /// IHDR.
   ///
   struct IHDR {
@@ -527,103 +1400,54 @@ class PNG {
   static constexpr uint32_t IHDRSize = 13;
   static_assert(offsetof(IHDR, interlaceMethod) == IHDRSize-1, "!offsetof");
 
+  ifstream file_{};
+  ifstream& ifs_;
+  bool verify_ = true;
+
   IHDR ihdr_{};
   vector<uint8_t> plte_{};
-  vector<uint8_t> idat_{}; // XXX: Concatenation of chunks
 
   uint32_t components_ = 0;
   uint32_t bpp_ = 0;
   uint32_t Bpp_ = 0;
   uint32_t sclnSize_ = 0; // XXX: Including filter byte
+  uint32_t lnSize_ = 0;
+
+  /// Current chunk.
+  ///
+  vector<char> buffer_ = vector<char>(4096);
+  uint32_t length_ = 0;
+  bool idat_ = false;
+  bool pending_ = false;
+  bool ended_ = false;
 
   /// Initializes PNG data from file stream.
   ///
-  void init(ifstream& ifs) {
+  /// Chunks are read up to the first IDAT chunk.
+  ///
+  void init() {
     // Check signature
     uint8_t sign[sizeof Signature];
 
-    if (!ifs.read(reinterpret_cast<char*>(sign), sizeof sign))
+    if (!ifs_.read(reinterpret_cast<char*>(sign), sizeof sign))
       throw FileExcept("Could not read from PNG file");
 
     if (memcmp(sign, Signature, sizeof sign) != 0)
       throw FileExcept("Invalid PNG file");
 
     // Process chunks
-    vector<char> buffer{};
-    buffer.resize(4096);
-
-    const uint32_t lengthOff = 0;
-    const uint32_t typeOff = 4;
-    const uint32_t dataOff = 8;
-    uint32_t length;
-    uint32_t type;
-    uint32_t crc;
-
-    auto setLength = [&] {
-      memcpy(&length, &buffer[lengthOff], sizeof length);
-      length = betoh(length);
-      const auto required = dataOff + length + sizeof crc;
-      if (required > buffer.size())
-        buffer.resize(required);
-    };
-
-    while (true) {
-      // Read length and type
-      if (!ifs.read(buffer.data(), dataOff))
-        throw FileExcept("Could not read from PNG file");
-
-      setLength();
-
-      // Read data and CRC
-      if (!ifs.read(&buffer[dataOff], length + sizeof crc))
-        throw FileExcept("Could not read from PNG file");
-
-      // Check CRC
-      memcpy(&crc, &buffer[dataOff+length], sizeof crc);
-      crc = betoh(crc);
-      if (crc != computeCRC(&buffer[typeOff], length + sizeof type))
-        throw FileExcept("Invalid CRC for PNG file");
-
-      // Copy data
-      if (memcmp(&buffer[typeOff], IHDRType, sizeof IHDRType) == 0) {
-        // IHDR
-        if (length < IHDRSize)
-          throw FileExcept("Invalid PNG file");
-
-        memcpy(&ihdr_, &buffer[dataOff], length);
-        ihdr_.width = betoh(ihdr_.width);
-        ihdr_.height = betoh(ihdr_.height);
-
-      } else if (memcmp(&buffer[typeOff], PLTEType, sizeof PLTEType) == 0) {
-        // PLTE
-        if (length % 3 != 0 || plte_.size() != 0)
-          throw FileExcept("Invalid PNG file");
-
-        plte_.resize(length);
-        memcpy(plte_.data(), &buffer[dataOff], length);
-
-      } else if (memcmp(&buffer[typeOff], IDATType, sizeof IDATType) == 0) {
-        // IDAT
-        if (length > 0) {
-          const auto offset = idat_.size();
-          idat_.resize(offset + length);
-          memcpy(&idat_[offset], &buffer[dataOff], length);
-        }
-
-      } else if (memcmp(&buffer[typeOff], IENDType, sizeof IENDType) == 0) {
-        // IEND
-        break;
-
-      } else if (!(buffer[typeOff] & 32)) {
-        // XXX: Cannot ignore critical chunks
-        throw UnsupportedExcept("Unsupported PNG file");
-      }
-    }
+    do {
+      readChunk();
+      processChunk();
+      if (ended_)
+        throw FileExcept("Invalid PNG file");
+    } while (!idat_);
+    pending_ = true;
 
     // Validate
     if (ihdr_.width == 0 || ihdr_.height == 0 ||
         ihdr_.compressionMethod != 0 || ihdr_.filterMethod != 0 ||
-        ihdr_.interlaceMethod > 1 || idat_.empty())
+        ihdr_.interlaceMethod > 1)
       throw FileExcept("Invalid PNG file");
 
     if (ihdr_.colorType == 2 || ihdr_.colorType == 4 || ihdr_.colorType == 6) {
@@ -675,168 +1499,198 @@ class PNG {
     } else {
       sclnSize_ = 1 + ihdr_.width * Bpp_;
     }
+
+    lnSize_ = ihdr_.width * (ihdr_.colorType == 3 ? 3 : Bpp_);
   }
 
-  /// Decompresses concatenated IDAT datastream.
+  /// Reads the next chunk into `buffer_`.
   ///
-  void decompress(vector<uint8_t>& dst) const {
-    assert(dst.empty());
+  void readChunk() {
+    uint32_t type;
+    uint32_t crc;
+
+    // Read length and type
+    if (!ifs_.read(buffer_.data(), DataOff))
+      throw FileExcept("Could not read from PNG file");
+
+    memcpy(&length_, &buffer_[LengthOff], sizeof length_);
+    length_ = betoh(length_);
+    const auto required = DataOff + length_ + sizeof crc;
+    if (required > buffer_.size())
+      buffer_.resize(required);
 
-    dst.resize(sclnSize_ * ihdr_.height);
-    inflate(idat_, dst);
+    // Read data and CRC
+    if (!ifs_.read(&buffer_[DataOff], length_ + sizeof crc))
+      throw FileExcept("Could not read from PNG file");
+
+    // Check CRC
+    if (verify_) {
+      memcpy(&crc, &buffer_[DataOff+length_], sizeof crc);
+      crc = betoh(crc);
+      if (crc != crc32(&buffer_[TypeOff], length_ + sizeof type))
+        throw FileExcept("Invalid CRC for PNG file");
+    }
   }
 
-  /// Reverses filters from decompressed data.
+  /// Processes the chunk in `buffer_`.
   ///
-  void unfilter(vector<uint8_t>& data) const {
-    assert(!data.empty());
-
-    uint8_t* curScln = nullptr;
-    uint8_t* priorScln = nullptr;
-    uint8_t filter = UINT8_MAX;
+  /// IDAT data is not copied - `idat_` is set instead.
+  ///
+  void processChunk() {
+    const auto type = &buffer_[TypeOff];
+    idat_ = false;
 
-    // Don't have prior scanline
-    auto reverse0 = [&] {
-      switch (filter) {
-      case 0:
-      case 2:
-        // None/Up
-        break;
+    if (memcmp(type, IHDRType, sizeof IHDRType) == 0) {
+      // IHDR
+      if (length_ < IHDRSize)
+        throw FileExcept("Invalid PNG file");
 
-      case 1:
-      case 4:
-        // Sub/Paeth
-        for (uint32_t i = Bpp_+1; i < sclnSize_; i++)
-          curScln[i] += curScln[i-Bpp_];
-        break;
+      memcpy(&ihdr_, &buffer_[DataOff], IHDRSize);
+      ihdr_.width = betoh(ihdr_.width);
+      ihdr_.height = betoh(ihdr_.height);
 
-      case 3:
-        // Average
-        for (uint32_t i = Bpp_+1; i < sclnSize_; i++)
-          curScln[i] += curScln[i-Bpp_] >> 1;
-        break;
+    } else if (memcmp(type, PLTEType, sizeof PLTEType) == 0) {
+      // PLTE
+      if (length_ % 3 != 0 || plte_.size() != 0)
+        throw FileExcept("Invalid PNG file");
 
-      default:
-        throw runtime_error("Invalid PNG data for unfiltering");
-      }
-    };
+      plte_.resize(length_);
+      memcpy(plte_.data(), &buffer_[DataOff], length_);
 
-    // Have prior scanline
-    auto reverse = [&] {
-      switch (filter) {
-      case 0:
-        // None
-        break;
-
-      case 1:
-        // Sub
-        for (uint32_t i = Bpp_+1; i < sclnSize_; i++)
-          curScln[i] += curScln[i-Bpp_];
-        break;
-
-      case 2:
-        // Up
-        for (uint32_t i = 1; i < sclnSize_; i++)
-          curScln[i] += priorScln[i];
-        break;
-
-      case 3:
-        // Average
-        for (uint32_t i = 1; i <= Bpp_; i++)
-          curScln[i] += priorScln[i] >> 1;
-        for (uint32_t i = Bpp_+1; i < sclnSize_; i++) {
-          const uint16_t prev = curScln[i-Bpp_];
-          const uint16_t prior = priorScln[i];
-          curScln[i] += (prev + prior) >> 1;
-        }
-        break;
-
-      case 4:
-        // Paeth
-        for (uint32_t i = 1; i <= Bpp_; i++)
-          curScln[i] += priorScln[i];
-        for (uint32_t i = Bpp_+1; i < sclnSize_; i++) {
-          const int16_t a = curScln[i-Bpp_];
-          const int16_t b = priorScln[i];
-          const int16_t c = priorScln[i-Bpp_];
-          const int16_t p = a + b - c;
-          const int16_t pa = abs(p-a);
-          const int16_t pb = abs(p-b);
-          const int16_t pc = abs(p-c);
-          curScln[i] += (pa <= pb && pa <= pc) ? (a) : (pb <= pc ? b : c);
-        }
-        break;
+    } else if (memcmp(type, IDATType, sizeof IDATType) == 0) {
+      // IDAT
+      idat_ = true;
 
-      default:
-        throw runtime_error("Invalid PNG data for unfiltering");
-      }
-    };
+    } else if (memcmp(type, IENDType, sizeof IENDType) == 0) {
+      // IEND
+      ended_ = true;
 
-    curScln = data.data();
-    filter = curScln[0];
-    reverse0();
-    for (uint32_t i = 1; i < ihdr_.height; i++) {
-      priorScln = curScln;
-      curScln = &data[i*sclnSize_];
-      filter = curScln[0];
-      reverse();
+    } else if (!(type[0] & 32)) {
+      // XXX: Cannot ignore critical chunks
+      throw UnsupportedExcept("Unsupported PNG file");
     }
   }
 
-  /// Computes the CRC of a chunk.
+  /// Moves to the next IDAT chunk.
   ///
-  uint32_t computeCRC(const char* data, uint32_t n) const {
-    assert(data);
-    assert(n > 0);
+  /// Returns `false` if the chunk that follows is not an IDAT chunk.
+  ///
+  bool nextIDAT() {
+    if (!idat_)
+      return false;
+
+    // The first IDAT chunk is read by `init()`
+    if (pending_) {
+      pending_ = false;
+      return true;
+    }
 
-    static uint32_t table[256]{};
-    static atomic pending{true};
-    static bool wait = true;
+    readChunk();
+    processChunk();
+    return idat_;
+  }
 
-    if (pending.exchange(false)) {
-      for (uint32_t i = 0; i < 256; i++) {
-        auto x = i;
-        for (uint32_t j = 0; j < 8; j++)
-          x = (x & 1) ? (0xEDB88320 ^ (x >> 1)) : (x >> 1);
-        table[i] = x;
+  /// Converts an unfiltered scanline into a row of raw image data.
+  ///
+  void convert(const uint8_t* scanline, char* dst) const {
+    // Palette indices
+    if (ihdr_.colorType == 3) {
+      // XXX: Needs testing
+      uint32_t byteOff = 0;
+      uint32_t bitOff = 0;
+      for (uint32_t j = 0; j < ihdr_.width; j++) {
+        uint8_t index = 0;
+        for (uint8_t k = 0; k < ihdr_.bitDepth; k++)
+          index |= scanline[byteOff] & (1 << (k+bitOff));
+        index >>= bitOff;
+        memcpy(&dst[j*3], &plte_[index], 3);
+        const div_t d = div(bitOff + ihdr_.bitDepth, 8);
+        byteOff += d.quot;
+        bitOff = d.rem;
+      }
+
+    // 1/2/4 bit depth greyscale
+    } else if (ihdr_.bitDepth < 8) {
+      // XXX: Needs testing
+      uint32_t byteOff = 0;
+      uint32_t bitOff = 0;
+      for (uint32_t j = 0; j < ihdr_.width; j++) {
+        uint8_t value = 0;
+        for (uint8_t k = 0; k < ihdr_.bitDepth; k++)
+          value |= scanline[byteOff] & (1 << (k+bitOff));
+        dst[j] = value >> bitOff;
+        const div_t d = div(bitOff + ihdr_.bitDepth, 8);
+        byteOff += d.quot;
+        bitOff = d.rem;
       }
-      wait = false;
-    } else {
-      while (wait) { }
-    }
 
-    uint32_t crc = 0xFFFFFFFF;
-    for (uint32_t i = 0; i < n; i++)
-      crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    // 8 bit depth truecolor or greyscale
+    } else if (ihdr_.bitDepth == 8) {
+      memcpy(dst, scanline, lnSize_);
 
-    return crc ^ 0xFFFFFFFF;
+    // 16 bit depth truecolor or greyscale
+    } else {
+      for (uint32_t i = 0; i < lnSize_; i += 2) {
+        uint16_t x;
+        memcpy(&x, &scanline[i], 2);
+        x = betoh(x);
+        memcpy(&dst[i], &x, 2);
+      }
+    }
   }
 };
 
+/// Sets texture data members that describe the image.
+///
+void setDescription(Texture::Data& dst, const PNG& png) {
+  dst.format = png.format();
+  dst.size = {png.width(), png.height()};
+  dst.levels = 1;
+  dst.samples = CG_NS::Samples1;
+}
+
+/// Decodes image data into caller-supplied memory.
+///
+void decode(Texture::Data& dst, PNG& png, const PNGMemoryFn& memory) {
+  png.print();
+
+  setDescription(dst, png);
+  const auto data = memory(dst, png.imageSize());
+  if (!data)
+    throw invalid_argument("loadPNG() requires memory for image data");
+  png.imageData(data);
+}
+
 INTERNAL_NS_END
 
-void SG_NS::loadPNG(Texture::Data& dst, const string& pathname) {
-  PNG png(pathname);
+void SG_NS::loadPNG(Texture::Data& dst, const string& pathname, bool verify) {
+  PNG png(pathname, verify);
 
   png.print();
 
+  setDescription(dst, png);
   dst.data = png.imageData();
-  dst.format = png.format();
-  dst.size = {png.width(), png.height()};
-  dst.levels = 1;
-  dst.samples = CG_NS::Samples1;
 }
 
-void SG_NS::loadPNG(Texture::Data& dst, ifstream& stream) {
-  PNG png(stream);
+void SG_NS::loadPNG(Texture::Data& dst, ifstream& stream, bool verify) {
+  PNG png(stream, verify);
 
   png.print();
 
+  setDescription(dst, png);
   dst.data = png.imageData();
-  dst.format = png.format();
-  dst.size = {png.width(), png.height()};
-  dst.levels = 1;
-  dst.samples = CG_NS::Samples1;
+}
+
+void SG_NS::loadPNG(Texture::Data& dst, const string& pathname,
+                    const PNGMemoryFn& memory, bool verify) {
+  PNG png(pathname, verify);
+  decode(dst, png, memory);
+}
+
+void SG_NS::loadPNG(Texture::Data& dst, ifstream& stream,
+                    const PNGMemoryFn& memory, bool verify) {
+  PNG png(stream, verify);
+  decode(dst, png, memory);
 }
 
 //
@@ -857,7 +1711,6 @@ void PNG::print() const {
   wprintf(L"\n  filterMethod: %u", ihdr_.filterMethod);
   wprintf(L"\n  interlaceMethod: %u", ihdr_.interlaceMethod);
   wprintf(L"\n PLTE: %lu byte(s)", plte_.size());
-  wprintf(L"\n IDAT: %lu byte(s)", idat_.size());
   wprintf(L"\n *Aux.:");
   wprintf(L"\n  *Components: %u", components_);
   wprintf(L"\n  *bpp: %u", bpp_);
@@ -868,6 +1721,7 @@ void PNG::print() const {
 #endif
 }
 
+#ifdef YF_DEVEL
 [[maybe_unused]] void printCodeTree([[maybe_unused]] const ZTree& codeTree) {
 #ifdef YF_DEVEL_PNG
   wprintf(L"\nCode Tree");
@@ -881,5 +1735,30 @@ void PNG::print() const {
   wprintf(L"\n");
 #endif
 }
+#endif // YF_DEVEL
 
 INTERNAL_NS_END
+
+#ifdef YF_DEVEL
+void SG_NS::inflatePNG(const vector<uint8_t>& src, vector<uint8_t>& dst,
+                       bool reference) {
+  if (reference)
+    inflateTree(src, dst);
+  else
+    inflate(src, dst);
+}
+
+void SG_NS::unfilterPNG(vector<uint8_t>& data, uint32_t sclnSize, uint32_t Bpp,
+                        bool reference) {
+  if (reference) {
+    const vector<uint8_t> zero(sclnSize);
+    const uint8_t* prior = zero.data() + 1;
+    for (size_t off = 0; off < data.size(); off += sclnSize) {
+      unfilterScalar(data[off], &data[off+1], prior, sclnSize - 1, Bpp);
+      prior = &data[off+1];
+    }
+  } else {
+    unfilterScanlines(data, sclnSize, Bpp);
+  }
+}
+#endif // YF_DEVEL
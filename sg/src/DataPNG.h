@@ -8,8 +8,11 @@
 #ifndef YF_SG_DATAPNG_H
 #define YF_SG_DATAPNG_H
 
+#include <cstdint>
 #include <string>
 #include <fstream>
+#include <vector>
+#include <functional>
 
 #include "Texture.h"
 
@@ -17,8 +20,50 @@ SG_NS_BEGIN
 
 /// Loads texture data from a PNG file.
 ///
-void loadPNG(Texture::Data& dst, const std::string& pathname);
-void loadPNG(Texture::Data& dst, std::ifstream& stream);
+/// If `verify` is not set, chunk CRCs and the Adler-32 checksum of image
+/// data are not checked. This should only be done for trusted files.
+///
+void loadPNG(Texture::Data& dst, const std::string& pathname,
+             bool verify = true);
+void loadPNG(Texture::Data& dst, std::ifstream& stream, bool verify = true);
+
+/// Provider of memory for decoded PNG data.
+///
+/// It is called once the image header is read, with `dst` describing the
+/// image and `size` set to the number of bytes required. The memory must
+/// remain valid until `loadPNG()` returns.
+///
+using PNGMemoryFn = std::function<char* (const Texture::Data& dst,
+                                         size_t size)>;
+
+/// Loads texture data from a PNG file into caller-supplied memory.
+///
+/// Image data is decoded directly into the memory provided by `memory`
+/// (e.g., a mapped staging buffer), and `dst.data` is left unchanged.
+///
+void loadPNG(Texture::Data& dst, const std::string& pathname,
+             const PNGMemoryFn& memory, bool verify = true);
+void loadPNG(Texture::Data& dst, std::ifstream& stream,
+             const PNGMemoryFn& memory, bool verify = true);
+
+#ifdef YF_DEVEL
+/// Decompresses zlib data from a PNG datastream.
+///
+/// If `reference` is set, the bit-by-bit, code tree decoder is used
+/// instead of the table-driven one.
+///
+void inflatePNG(const std::vector<uint8_t>& src, std::vector<uint8_t>& dst,
+                bool reference = false);
+
+/// Reverses the filters of decompressed PNG scanlines.
+///
+/// Each scanline is `sclnSize` bytes long, including the filter byte, and
+/// `Bpp` is the number of bytes per complete pixel (rounded up to one).
+/// If `reference` is set, the scalar implementation is used.
+///
+void unfilterPNG(std::vector<uint8_t>& data, uint32_t sclnSize, uint32_t Bpp,
+                 bool reference = false);
+#endif
 
 SG_NS_END
 
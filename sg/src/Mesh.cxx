@@ -5,6 +5,7 @@
 // Copyright © 2020-2021 Gustavo C. Viegas.
 //
 
+#include <algorithm>
 #include <cassert>
 
 #include "yf/cg/Device.h"
@@ -43,7 +44,23 @@ Primitive::Impl& Primitive::impl() {
 // TODO: Consider allowing custom buffer size values
 constexpr uint64_t Size = 1ULL << 21;
 
-CG_NS::Buffer::Ptr Primitive::Impl::buffer_{CG_NS::device().buffer(Size)};
+INTERNAL_NS_BEGIN
+
+/// Creates a buffer for primitive data.
+///
+/// The buffer is device-local, so writes go through staging copies.
+///
+CG_NS::Buffer::Ptr makeBuffer(uint64_t size) {
+  return CG_NS::device().buffer({size, CG_NS::Buffer::Private,
+                                 CG_NS::Buffer::CopySrc |
+                                 CG_NS::Buffer::CopyDst |
+                                 CG_NS::Buffer::Vertex |
+                                 CG_NS::Buffer::Index});
+}
+
+INTERNAL_NS_END
+
+CG_NS::Buffer::Ptr Primitive::Impl::buffer_{makeBuffer(Size)};
 list<Primitive::Impl::Segment> Primitive::Impl::segments_{{0, Size}};
 
 Primitive::Impl::~Impl() {
@@ -236,7 +253,7 @@ bool Primitive::Impl::resizeBuffer(uint64_t newSize) {
   // XXX: This restricts the size to half the available memory
   CG_NS::Buffer::Ptr newBuf;
   try {
-    buffer_ = dev.buffer(newSize);
+    newBuf = makeBuffer(newSize);
   } catch (DeviceExcept&) {
     return false;
   }
@@ -244,7 +261,7 @@ bool Primitive::Impl::resizeBuffer(uint64_t newSize) {
   // Copy data to new buffer
   // TODO: Consider copying only used ranges
   CG_NS::TfEncoder enc;
-  enc.copy(*newBuf, 0, *buffer_, 0, buffer_->size());
+  enc.copy(*newBuf, 0, *buffer_, 0, min(oldSize, newSize));
   auto& que = dev.queue(CG_NS::Queue::Transfer);
   auto cb = que.cmdBuffer();
   cb->encode(enc);
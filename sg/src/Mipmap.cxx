@@ -0,0 +1,436 @@
+//
+// SG
+// Mipmap.cxx
+//
+// Copyright © 2021 Gustavo C. Viegas.
+//
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "Mipmap.h"
+#include "Workers.h"
+#include "yf/Except.h"
+
+#if defined(__SSE2__)
+# include <emmintrin.h>
+#elif defined(__ARM_NEON)
+# include <arm_neon.h>
+#endif
+
+using namespace YF_NS;
+using namespace SG_NS;
+using namespace std;
+
+INTERNAL_NS_BEGIN
+
+/// Texel of four floating-point components.
+///
+#if defined(__SSE2__)
+using Texel = __m128;
+
+inline Texel load(const float* src) { return _mm_loadu_ps(src); }
+inline void store(float* dst, Texel x) { _mm_storeu_ps(dst, x); }
+inline Texel zero() { return _mm_setzero_ps(); }
+inline Texel madd(Texel acc, Texel x, float w) {
+  return _mm_add_ps(acc, _mm_mul_ps(x, _mm_set1_ps(w)));
+}
+#elif defined(__ARM_NEON)
+using Texel = float32x4_t;
+
+inline Texel load(const float* src) { return vld1q_f32(src); }
+inline void store(float* dst, Texel x) { vst1q_f32(dst, x); }
+inline Texel zero() { return vdupq_n_f32(0.0f); }
+inline Texel madd(Texel acc, Texel x, float w) {
+  return vmlaq_n_f32(acc, x, w);
+}
+#else
+struct Texel { float c[4]; };
+
+inline Texel load(const float* src) {
+  return {src[0], src[1], src[2], src[3]};
+}
+inline void store(float* dst, Texel x) { memcpy(dst, x.c, sizeof x.c); }
+inline Texel zero() { return {}; }
+inline Texel madd(Texel acc, Texel x, float w) {
+  for (uint32_t i = 0; i < 4; i++)
+    acc.c[i] += x.c[i] * w;
+  return acc;
+}
+#endif
+
+/// Texel layout of a pixel format.
+///
+struct Layout {
+  uint32_t channels;
+  uint32_t channelSize;
+  bool srgb;
+};
+
+Layout layoutOf(CG_NS::PxFormat format) {
+  switch (format) {
+  case CG_NS::PxFormatR8Unorm:     return {1, 1, false};
+  case CG_NS::PxFormatRg8Unorm:    return {2, 1, false};
+  case CG_NS::PxFormatRgb8Unorm:   return {3, 1, false};
+  case CG_NS::PxFormatRgb8Srgb:    return {3, 1, true};
+  case CG_NS::PxFormatRgba8Unorm:
+  case CG_NS::PxFormatBgra8Unorm:  return {4, 1, false};
+  case CG_NS::PxFormatRgba8Srgb:
+  case CG_NS::PxFormatBgra8Srgb:   return {4, 1, true};
+  case CG_NS::PxFormatR16Unorm:    return {1, 2, false};
+  case CG_NS::PxFormatRg16Unorm:   return {2, 2, false};
+  case CG_NS::PxFormatRgb16Unorm:  return {3, 2, false};
+  case CG_NS::PxFormatRgba16Unorm: return {4, 2, false};
+  default:
+    throw UnsupportedExcept("Unsupported format for mipmap generation");
+  }
+}
+
+/// Conversion between sRGB encoded values and linear intensities.
+///
+/// Encoding searches the midpoints between consecutive codes, so results
+/// are rounded exactly as in sRGB space.
+///
+struct SRGBTable {
+  float decode[256];
+  float midpoints[256];
+
+  SRGBTable() {
+    auto toLinear = [](double x) {
+      return x <= 0.04045 ? x / 12.92 : pow((x + 0.055) / 1.055, 2.4);
+    };
+    for (uint32_t i = 0; i < 256; i++) {
+      decode[i] = toLinear(i / 255.0);
+      midpoints[i] = i < 255 ? toLinear((i + 0.5) / 255.0) : HUGE_VALF;
+    }
+  }
+
+  uint8_t encode(float x) const {
+    uint32_t code = 0;
+    for (uint32_t step = 128; step > 0; step >>= 1) {
+      if (x >= midpoints[code + step - 1])
+        code += step;
+    }
+    return code;
+  }
+};
+
+const SRGBTable& srgbTable() {
+  static const SRGBTable table;
+  return table;
+}
+
+/// Filter kernel for 2:1 reduction.
+///
+/// Destination texel `i` is the weighted sum of source texels
+/// `2 * i + offset + j`, for `j` in [0, weights.size()).
+///
+struct Kernel {
+  int32_t offset;
+  vector<float> weights;
+};
+
+Kernel kernelOf(MipFilter filter) {
+  switch (filter) {
+  case MipFilterBox:
+    return {0, {0.5f, 0.5f}};
+
+  case MipFilterKaiser: {
+    // Windowed sinc with a radius of two destination texels
+    const double radius = 2.0;
+    const double alpha = 4.0;
+    auto bessel = [](double x) {
+      double sum = 1.0;
+      double term = 1.0;
+      for (uint32_t k = 1; k < 32; k++) {
+        term *= (x * 0.5 / k) * (x * 0.5 / k);
+        sum += term;
+      }
+      return sum;
+    };
+
+    Kernel kernel{-3, vector<float>(8)};
+    double sum = 0.0;
+    for (int32_t j = 0; j < 8; j++) {
+      const double t = (kernel.offset + j - 0.5) * 0.5;
+      const double sinc = sin(M_PI * t) / (M_PI * t);
+      const double u = t / radius;
+      const double window = bessel(alpha * sqrt(1.0 - u * u)) / bessel(alpha);
+      kernel.weights[j] = sinc * window;
+      sum += kernel.weights[j];
+    }
+    for (auto& w : kernel.weights)
+      w /= sum;
+    return kernel;
+  }
+
+  default:
+    throw invalid_argument("Invalid mip filter");
+  }
+}
+
+/// Maps a texel coordinate into the [0, size) range.
+///
+uint32_t wrap(int64_t coord, uint32_t size, CG_NS::WrapMode mode) {
+  const int64_t n = size;
+  switch (mode) {
+  case CG_NS::WrapModeRepeat:
+    return ((coord % n) + n) % n;
+  case CG_NS::WrapModeMirror: {
+    const int64_t m = ((coord % (2 * n)) + 2 * n) % (2 * n);
+    return m < n ? m : 2 * n - 1 - m;
+  }
+  default:
+    return clamp<int64_t>(coord, 0, n - 1);
+  }
+}
+
+/// Reduction of one mip level into the next.
+///
+class Reduction {
+ public:
+  Reduction(const Layout& layout, const Kernel& kernel,
+            const CG_NS::Sampler& sampler, const char* src,
+            CG_NS::Size2 srcSize, char* dst, CG_NS::Size2 dstSize)
+    : layout_(layout), kernel_(kernel), sampler_(sampler), src_(src),
+      srcSize_(srcSize), dst_(dst), dstSize_(dstSize),
+      columns_(dstSize.width * kernel.weights.size()) {
+
+    for (uint32_t x = 0; x < dstSize.width; x++) {
+      for (uint32_t j = 0; j < kernel.weights.size(); j++) {
+        const int64_t coord = 2 * int64_t(x) + kernel.offset + j;
+        columns_[x * kernel.weights.size() + j] =
+          wrap(coord, srcSize.width, sampler.wrapU);
+      }
+    }
+  }
+
+  /// Produces destination rows in the [begin, end) range.
+  ///
+  void operator()(uint32_t begin, uint32_t end) const {
+    const auto taps = kernel_.weights.size();
+    const uint32_t rowLength = dstSize_.width * 4;
+
+    // Horizontally filtered source rows, indexed by unwrapped coordinate
+    vector<float> ring(taps * rowLength);
+    vector<int64_t> tags(taps, INT64_MIN);
+    vector<float> line(srcSize_.width * 4);
+    vector<float> row(rowLength);
+
+    for (uint32_t y = begin; y < end; y++) {
+      for (uint32_t x = 0; x < dstSize_.width; x++)
+        store(row.data() + x * 4, zero());
+
+      for (uint32_t j = 0; j < taps; j++) {
+        const int64_t coord = 2 * int64_t(y) + kernel_.offset + j;
+        const auto slot = ((coord % int64_t(taps)) + taps) % taps;
+        float* filtered = ring.data() + slot * rowLength;
+
+        if (tags[slot] != coord) {
+          decode(wrap(coord, srcSize_.height, sampler_.wrapV), line.data());
+          filterRow(line.data(), filtered);
+          tags[slot] = coord;
+        }
+
+        const float w = kernel_.weights[j];
+        for (uint32_t x = 0; x < dstSize_.width; x++)
+          store(row.data() + x * 4,
+                madd(load(row.data() + x * 4), load(filtered + x * 4), w));
+      }
+
+      encode(row.data(), y);
+    }
+  }
+
+ private:
+  const Layout& layout_;
+  const Kernel& kernel_;
+  const CG_NS::Sampler& sampler_;
+  const char* src_;
+  CG_NS::Size2 srcSize_;
+  char* dst_;
+  CG_NS::Size2 dstSize_;
+  vector<uint32_t> columns_;
+
+  /// Converts a source row into linear, four-component texels.
+  ///
+  void decode(uint32_t y, float* dst) const {
+    const uint32_t n = srcSize_.width * layout_.channels;
+    const size_t off = size_t(y) * n * layout_.channelSize;
+    const auto& srgb = srgbTable();
+
+    for (uint32_t i = 0, t = 0; i < n; i += layout_.channels, t += 4) {
+      for (uint32_t c = 0; c < 4; c++) {
+        if (c >= layout_.channels) {
+          dst[t+c] = 0.0f;
+        } else if (layout_.channelSize == 2) {
+          uint16_t v;
+          memcpy(&v, src_ + off + (i + c) * 2, 2);
+          dst[t+c] = v * (1.0f / 65535.0f);
+        } else {
+          const uint8_t v = src_[off + i + c];
+          dst[t+c] = (layout_.srgb && c < 3) ? srgb.decode[v] :
+                                                v * (1.0f / 255.0f);
+        }
+      }
+    }
+  }
+
+  /// Filters a row of texels horizontally.
+  ///
+  void filterRow(const float* src, float* dst) const {
+    const auto taps = kernel_.weights.size();
+    const uint32_t* column = columns_.data();
+
+    for (uint32_t x = 0; x < dstSize_.width; x++, column += taps) {
+      Texel acc = zero();
+      for (uint32_t j = 0; j < taps; j++)
+        acc = madd(acc, load(src + column[j] * 4), kernel_.weights[j]);
+      store(dst + x * 4, acc);
+    }
+  }
+
+  /// Converts a row of texels into the destination format.
+  ///
+  void encode(const float* src, uint32_t y) const {
+    const uint32_t n = dstSize_.width * layout_.channels;
+    const size_t off = size_t(y) * n * layout_.channelSize;
+    const auto& srgb = srgbTable();
+
+    for (uint32_t i = 0, t = 0; i < n; i += layout_.channels, t += 4) {
+      for (uint32_t c = 0; c < layout_.channels; c++) {
+        const float v = clamp(src[t+c], 0.0f, 1.0f);
+        if (layout_.channelSize == 2) {
+          const uint16_t x = v * 65535.0f + 0.5f;
+          memcpy(dst_ + off + (i + c) * 2, &x, 2);
+        } else {
+          dst_[off + i + c] = (layout_.srgb && c < 3) ?
+                              srgb.encode(v) : uint8_t(v * 255.0f + 0.5f);
+        }
+      }
+    }
+  }
+};
+
+/// Rescales the alpha of a level to match a given alpha-test coverage.
+///
+template<class T>
+void scaleAlpha(T* texels, size_t n, double coverage, double cutoff) {
+  constexpr uint32_t Max = numeric_limits<T>::max();
+  if (coverage <= 0.0)
+    return;
+
+  vector<size_t> histogram(Max + 1);
+  for (size_t i = 0; i < n; i++)
+    histogram[texels[i*4+3]]++;
+
+  // Find the alpha value for which the coverage is attained
+  const double target = coverage * n;
+  size_t count = 0;
+  uint32_t threshold = Max;
+  for (; threshold > 0; threshold--) {
+    count += histogram[threshold];
+    if (count >= target)
+      break;
+  }
+  if (threshold == 0)
+    return;
+
+  // Texels at the threshold must still pass the test after rounding
+  const double scale = cutoff * Max / threshold;
+  const double pass = ceil(cutoff * Max);
+  for (size_t i = 0; i < n; i++) {
+    double a = min<double>(Max, texels[i*4+3] * scale + 0.5);
+    if (texels[i*4+3] >= threshold)
+      a = max(a, pass);
+    texels[i*4+3] = static_cast<T>(a);
+  }
+}
+
+/// Computes the fraction of texels that pass an alpha test.
+///
+template<class T>
+double coverageOf(const T* texels, size_t n, double cutoff) {
+  constexpr uint32_t Max = numeric_limits<T>::max();
+  const double ref = cutoff * Max;
+
+  size_t count = 0;
+  for (size_t i = 0; i < n; i++)
+    count += texels[i*4+3] >= ref;
+  return n > 0 ? double(count) / n : 0.0;
+}
+
+INTERNAL_NS_END
+
+void SG_NS::generateMipmaps(Texture::Data& dst, MipFilter filter,
+                            float alphaCutoff) {
+  if (!dst.data || dst.size.width == 0 || dst.size.height == 0)
+    throw invalid_argument("generateMipmaps() requires texture data");
+  if (dst.samples != CG_NS::Samples1)
+    throw UnsupportedExcept("Mipmaps of multisample textures not supported");
+
+  const auto layout = layoutOf(dst.format);
+  const auto kernel = kernelOf(filter);
+  const size_t texelSize = layout.channels * layout.channelSize;
+
+  // Compute the size of the whole chain
+  vector<CG_NS::Size2> sizes{dst.size};
+  vector<size_t> offsets{0};
+  size_t size = size_t(dst.size.width) * dst.size.height * texelSize;
+  while (sizes.back().width > 1 || sizes.back().height > 1) {
+    const auto& prev = sizes.back();
+    sizes.push_back({max(1U, prev.width >> 1), max(1U, prev.height >> 1)});
+    offsets.push_back(size);
+    size += size_t(sizes.back().width) * sizes.back().height * texelSize;
+  }
+
+  auto data = make_unique<char[]>(size);
+  memcpy(data.get(), dst.data.get(), offsets.size() > 1 ? offsets[1] : size);
+
+  for (size_t i = 1; i < sizes.size(); i++) {
+    const Reduction reduction(layout, kernel, dst.sampler,
+                              data.get() + offsets[i-1], sizes[i-1],
+                              data.get() + offsets[i], sizes[i]);
+
+    // Split rows in bands, keeping small levels in the calling thread
+    const uint32_t height = sizes[i].height;
+    const size_t texels = size_t(sizes[i].width) * height;
+    const uint32_t bands = texels < 16384 ? 1 :
+                           min(height, workerCount() * 4);
+
+    if (bands == 1) {
+      reduction(0, height);
+    } else {
+      parallelFor(bands, [&](uint32_t band) {
+        reduction(uint64_t(height) * band / bands,
+                  uint64_t(height) * (band + 1) / bands);
+      });
+    }
+  }
+
+  // Preserve alpha-tested coverage
+  if (layout.channels == 4 && alphaCutoff > 0.0f && alphaCutoff < 1.0f) {
+    const size_t n = size_t(dst.size.width) * dst.size.height;
+    if (layout.channelSize == 2) {
+      auto texels = reinterpret_cast<uint16_t*>(data.get());
+      const auto coverage = coverageOf(texels, n, alphaCutoff);
+      for (size_t i = 1; i < sizes.size(); i++)
+        scaleAlpha(reinterpret_cast<uint16_t*>(data.get() + offsets[i]),
+                   size_t(sizes[i].width) * sizes[i].height, coverage,
+                   alphaCutoff);
+    } else {
+      auto texels = reinterpret_cast<uint8_t*>(data.get());
+      const auto coverage = coverageOf(texels, n, alphaCutoff);
+      for (size_t i = 1; i < sizes.size(); i++)
+        scaleAlpha(reinterpret_cast<uint8_t*>(data.get() + offsets[i]),
+                   size_t(sizes[i].width) * sizes[i].height, coverage,
+                   alphaCutoff);
+    }
+  }
+
+  dst.data = move(data);
+  dst.levels = sizes.size();
+}
@@ -0,0 +1,38 @@
+//
+// SG
+// Mipmap.h
+//
+// Copyright © 2021 Gustavo C. Viegas.
+//
+
+#ifndef YF_SG_MIPMAP_H
+#define YF_SG_MIPMAP_H
+
+#include "Texture.h"
+
+SG_NS_BEGIN
+
+/// Filters for mip level reduction.
+///
+enum MipFilter {
+  MipFilterBox,
+  MipFilterKaiser
+};
+
+/// Generates the full mip chain of texture data.
+///
+/// The first level of `dst` is used as source, and the data is replaced
+/// by a new allocation storing every level, largest first. Filtering is
+/// done in linear space (sRGB formats are converted), and edges are
+/// handled according to the sampler's wrap modes.
+///
+/// When `alphaCutoff` is in the (0, 1) range, the alpha of each level is
+/// rescaled so that the fraction of texels passing the alpha test matches
+/// that of the first level.
+///
+void generateMipmaps(Texture::Data& dst, MipFilter filter = MipFilterKaiser,
+                     float alphaCutoff = -1.0f);
+
+SG_NS_END
+
+#endif // YF_SG_MIPMAP_H
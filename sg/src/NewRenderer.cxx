@@ -32,37 +32,23 @@ constexpr char ShaderPath[] = "bin/";
 constexpr uint64_t UnifBufferSize = 1 << 21;
 constexpr CG_NS::DcEntry GlobalUnif{0, CG_NS::DcTypeUniform, 1};
 constexpr CG_NS::DcEntry LightUnif{1, CG_NS::DcTypeUniform, 1};
-constexpr CG_NS::DcEntry InstanceUnif{0, CG_NS::DcTypeUniform, 1};
-constexpr CG_NS::DcEntry MaterialUnif{1, CG_NS::DcTypeUniform, 1};
+constexpr CG_NS::DcEntry InstanceUnif{0, CG_NS::DcTypeUniformDynamic, 1};
+constexpr CG_NS::DcEntry MaterialUnif{1, CG_NS::DcTypeUniformDynamic, 1};
 constexpr CG_NS::DcId FirstImgSampler = MaterialUnif.id + 1;
 
 NewRenderer::NewRenderer() {
   auto& dev = CG_NS::device();
 
   cmdBuffer_ = dev.defaultQueue().cmdBuffer();
-  unifBuffer_ = dev.buffer(UnifBufferSize);
+
+  // Uniform data is streamed every frame - the transient buffer takes
+  // care of alignment and grows as needed
+  unifBuffer_ = dev.transientBuffer({UnifBufferSize,
+                                     CG_NS::Buffer::Uniform});
 
   // This table will contain data common to all drawables
   mainTable_ = dev.dcTable({GlobalUnif, LightUnif});
   mainTable_->allocate(1);
-
-  // Uniforms have device-imposed alignment requirements
-  const uint64_t alignedOff = dev.limits().minDcUniformWriteAlignedOffset;
-  if (alignedOff != 0) {
-    uint64_t mod;
-    if ((mod = sizeof(Global) % alignedOff))
-      globalPad_ = alignedOff - mod;
-    if ((mod = sizeof(Light) % alignedOff))
-      lightPad_ = alignedOff - mod;
-    if ((mod = sizeof(InstanceWithSkin) % alignedOff))
-      instanceWithSkinPad_ = alignedOff - mod;
-    if ((mod = sizeof(InstanceNoSkin) % alignedOff))
-      instanceNoSkinPad_ = alignedOff - mod;
-    if ((mod = sizeof(MaterialPbr) % alignedOff))
-      materialPbrPad_ = alignedOff - mod;
-    if ((mod = sizeof(MaterialUnlit) % alignedOff))
-      materialUnlitPad_ = alignedOff - mod;
-  }
 }
 
 void NewRenderer::render(Scene& scene, CG_NS::Target& target) {
@@ -341,19 +327,12 @@ bool NewRenderer::setTables(DrawableReqMask mask,
         entries.push_back(imgSampler());
     }
 
-    uint64_t unifSize;
-    if (mask & RSkin0)
-      unifSize = sizeof(InstanceWithSkin) + instanceWithSkinPad_;
-    else
-      unifSize = sizeof(InstanceNoSkin) + instanceNoSkinPad_;
-    if (mask & RUnlit)
-      unifSize += sizeof(MaterialUnlit) + materialUnlitPad_;
-    else
-      unifSize += sizeof(MaterialPbr) + materialPbrPad_;
+    const bool shared = entries.size() == 2;
 
     try {
       tables_.insert(tables_.begin() + index.first,
-                     {CG_NS::device().dcTable(entries), 0, mask, unifSize, 0});
+                     {CG_NS::device().dcTable(entries), 0, mask, 0, shared,
+                      false, {}});
     } catch (...) {
       return false;
     }
@@ -430,21 +409,19 @@ NewRenderer::Table& NewRenderer::getTable(DrawableReqMask mask) {
 }
 
 void NewRenderer::allocateTables() {
-  auto size = mainUnifSize();
   bool failed = false;
 
   for (auto& table : tables_) {
     try {
-      table.table->allocate(table.count);
-      table.remaining = table.count;
-      size += unifSize(table);
+      allocateTable(table, table.count);
+      table.remaining = table.table->allocations();
     } catch (...) {
       failed = true;
       break;
     }
   }
 
-  if (failed || !checkUnifBuffer(size))
+  if (failed)
     // Try with fewer allocations
     allocateTablesSubset();
 }
@@ -452,39 +429,38 @@ void NewRenderer::allocateTables() {
 void NewRenderer::allocateTablesSubset() {
   uint32_t minimum = 0;
 
+  // Tables only release memory when emptied, so start from scratch
   for (auto& table : tables_) {
-    if (table.count == 0)
-      table.table->allocate(0);
-    else
+    allocateTable(table, 0);
+    if (table.count > 0)
       minimum++;
-    table.remaining = table.count;
+    table.remaining = table.shared ? min(table.count, 1U) : table.count;
   }
 
   while (true) {
-    auto size = mainUnifSize();
     bool failed = false;
     uint32_t limit = 0;
 
     for (auto& table : tables_) {
       if (table.count == 0)
         continue;
-      size += unifSize(table);
       if (table.remaining == 1) {
         limit++;
         if (table.table->allocations() == 1)
           continue;
       }
       try {
-        table.table->allocate(table.remaining);
+        allocateTable(table, table.remaining);
       } catch (...) {
         failed = true;
       }
     }
 
-    if (failed || !checkUnifBuffer(size)) {
+    if (failed) {
       if (limit == minimum)
         throw runtime_error("Cannot allocate required tables");
       for (auto& table : tables_) {
+        allocateTable(table, 0);
         if (table.remaining > 1)
           table.remaining = max(1U, table.remaining >> 1);
       }
@@ -494,61 +470,36 @@ void NewRenderer::allocateTablesSubset() {
   }
 }
 
-uint64_t NewRenderer::mainUnifSize() {
-  const uint64_t global = sizeof(Global) + globalPad_;
-  const uint64_t light = sizeof(Light) + lightPad_;
-  return global + light;
-}
-
-uint64_t NewRenderer::unifSize(const Table& table) {
-  return table.unifSize * table.remaining;
-}
-
-bool NewRenderer::checkUnifBuffer(uint64_t requiredSize) {
-  const uint64_t size = unifBuffer_->size();
-  uint64_t newSize;
+void NewRenderer::allocateTable(Table& table, uint32_t n) {
+  if (table.shared)
+    n = min(n, 1U);
 
-  if (requiredSize > size) {
-    newSize = (requiredSize & ~(UnifBufferSize - 1)) + UnifBufferSize;
-    newSize = max(requiredSize, newSize);
-  } else if (requiredSize < size) {
-    if (requiredSize <= UnifBufferSize)
-      newSize = UnifBufferSize;
-    else
-      newSize = (requiredSize & ~(UnifBufferSize - 1)) + UnifBufferSize;
-    if (newSize > (size >> 1))
-      return true;
-  } else {
-    return true;
-  }
+  table.table->allocate(n);
 
-  try {
-    unifBuffer_.reset();
-    unifBuffer_ = CG_NS::device().buffer(newSize);
-  } catch (...) {
-    return false;
-  }
-  return true;
+  // Kept allocations retain their uniform buffers, new ones have none
+  table.bindings.resize(table.table->allocations(), {});
 }
 
 bool NewRenderer::renderOnce(CG_NS::Target& target) {
   CG_NS::GrEncoder encoder;
-  uint64_t offset = 0;
+
+  for (auto& table : tables_)
+    table.bound = false;
 
   encoder.setViewport(viewport_);
   encoder.setScissor(scissor_);
   encoder.setTarget(target, onceOp_);
-  writeGlobal(offset);
-  writeLight(offset);
+  writeGlobal();
+  writeLight();
   encoder.setDcTable(0, 0);
 
   bool check;
-  if (!renderOpaqueDrawables(encoder, offset) ||
-      !renderBlendDrawables(encoder, offset))
+  if (!renderOpaqueDrawables(encoder) || !renderBlendDrawables(encoder))
     check = false;
   else
     check = true;
 
+  unifBuffer_->commit(*cmdBuffer_);
   cmdBuffer_->encode(encoder);
   cmdBuffer_->enqueue();
   cmdBuffer_->queue().submit();
@@ -557,44 +508,44 @@ bool NewRenderer::renderOnce(CG_NS::Target& target) {
 
 bool NewRenderer::renderAgain(CG_NS::Target& target) {
   CG_NS::GrEncoder encoder;
-  uint64_t offset = mainUnifSize();
 
   willRenderAgain();
 
   encoder.setViewport(viewport_);
   encoder.setScissor(scissor_);
   encoder.setTarget(target, againOp_);
+  // Uniform data of the previous pass has been reclaimed
+  writeGlobal();
+  writeLight();
   encoder.setDcTable(0, 0);
 
   bool check;
-  if (!renderOpaqueDrawables(encoder, offset) ||
-      !renderBlendDrawables(encoder, offset))
+  if (!renderOpaqueDrawables(encoder) || !renderBlendDrawables(encoder))
     check = false;
   else
     check = true;
 
+  unifBuffer_->commit(*cmdBuffer_);
   cmdBuffer_->encode(encoder);
   cmdBuffer_->enqueue();
   cmdBuffer_->queue().submit();
   return check;
 }
 
-bool NewRenderer::renderOpaqueDrawables(CG_NS::GrEncoder& encoder,
-                                        uint64_t& offset) {
+bool NewRenderer::renderOpaqueDrawables(CG_NS::GrEncoder& encoder) {
   auto n = opaqueDrawables_.size();
   while (n-- != 0) {
     auto& drawable = opaqueDrawables_.front();
-    if (!renderDrawable(drawable, encoder, offset))
+    if (!renderDrawable(drawable, encoder))
       opaqueDrawables_.push_back(drawable);
     opaqueDrawables_.pop_front();
   }
   return opaqueDrawables_.size() == 0;
 }
 
-bool NewRenderer::renderBlendDrawables(CG_NS::GrEncoder& encoder,
-                                       uint64_t& offset) {
+bool NewRenderer::renderBlendDrawables(CG_NS::GrEncoder& encoder) {
   while (blendDrawables_.size() != 0) {
-    if (renderDrawable(blendDrawables_.front(), encoder, offset))
+    if (renderDrawable(blendDrawables_.front(), encoder))
       blendDrawables_.pop_front();
     else
       return false;
@@ -603,8 +554,7 @@ bool NewRenderer::renderBlendDrawables(CG_NS::GrEncoder& encoder,
 }
 
 bool NewRenderer::renderDrawable(Drawable& drawable,
-                                 CG_NS::GrEncoder& encoder,
-                                 uint64_t& offset) {
+                                 CG_NS::GrEncoder& encoder) {
   auto& state = getState(drawable.mask);
   auto& table = getTable(drawable.mask);
 
@@ -612,24 +562,42 @@ bool NewRenderer::renderDrawable(Drawable& drawable,
     // Out of resources
     return false;
 
-  const auto allocation = --table.remaining;
+  // Shared tables are never exhausted
+  const auto allocation = table.shared ? 0 : --table.remaining;
 
+  array<UnifBinding, 2> bindings;
+  vector<uint32_t> offsets(2);
   if (drawable.mask & RSkin0)
-    writeInstanceWithSkin(offset, drawable, allocation);
+    offsets[InstanceUnif.id] =
+      writeInstanceWithSkin(drawable, bindings[InstanceUnif.id]);
   else
-    writeInstanceNoSkin(offset, drawable, allocation);
+    offsets[InstanceUnif.id] =
+      writeInstanceNoSkin(drawable, bindings[InstanceUnif.id]);
   if (drawable.mask & RUnlit)
-    writeMaterialUnlit(offset, drawable, allocation);
+    offsets[MaterialUnif.id] =
+      writeMaterialUnlit(drawable, bindings[MaterialUnif.id]);
   else
-    writeMaterialPbr(offset, drawable, allocation);
-  writeTextureMaps(drawable, allocation);
+    offsets[MaterialUnif.id] =
+      writeMaterialPbr(drawable, bindings[MaterialUnif.id]);
+
+  // Descriptor updates of a drawable are applied in a single batch
+  table.table->begin();
+  const bool bound = bindUnifs(table, allocation, bindings);
+  if (bound)
+    writeTextureMaps(drawable, allocation);
+  table.table->commit();
+
+  if (!bound)
+    // Must wait for the pass to complete
+    return false;
 
   if (drawable.mask & RAlphaBlend)
     // TODO: Improve this
     encoder.synchronize();
 
   encoder.setState(*state.state);
-  encoder.setDcTable(1, allocation);
+  encoder.setDcTable(1, allocation, offsets);
+  table.bound = true;
   drawable.primitive.impl().encodeBindings(encoder);
   drawable.primitive.impl().encodeDraw(encoder, 0, 1);
 
@@ -637,8 +605,11 @@ bool NewRenderer::renderDrawable(Drawable& drawable,
   return true;
 }
 
-void NewRenderer::writeGlobal(uint64_t& offset) {
-  Global global;
+void NewRenderer::writeGlobal() {
+  const uint64_t size = sizeof(Global);
+  const auto alloc = unifBuffer_->allocate(size, alignof(Global));
+  auto& global = *static_cast<Global*>(alloc.data);
+
   const auto& cam = scene_->camera();
   memcpy(global.v, cam.view().data(), sizeof global.v);
   memcpy(global.p, cam.projection().data(), sizeof global.p);
@@ -657,15 +628,15 @@ void NewRenderer::writeGlobal(uint64_t& offset) {
   global.vport[0].zFar = viewport_.zFar;
   global.vport[0].pad1 = 0.0f;
 
-  const uint64_t size = sizeof global;
-  unifBuffer_->write(offset, size, &global);
-  mainTable_->write(0, GlobalUnif.id, 0, *unifBuffer_, offset, size);
-  offset += size + globalPad_;
+  mainTable_->write(0, GlobalUnif.id, 0, *alloc.buffer, alloc.offset, size);
 }
 
-void NewRenderer::writeLight(uint64_t& offset) {
+void NewRenderer::writeLight() {
+  const uint64_t size = sizeof(Light);
+  const auto alloc = unifBuffer_->allocate(size, alignof(Light));
+  auto& light = *static_cast<Light*>(alloc.data);
+
   // TODO: Light nodes not implemented yet
-  Light light;
   //light.l[0].notUsed = 1;
 
   light.l[0].notUsed = 0;
@@ -687,21 +658,21 @@ void NewRenderer::writeLight(uint64_t& offset) {
   if (LightN > 1)
     light.l[1].notUsed = 1;
 
-  const uint64_t size = sizeof light;
-  unifBuffer_->write(offset, size, &light);
-  mainTable_->write(0, LightUnif.id, 0, *unifBuffer_, offset, size);
-  offset += size + lightPad_;
+  mainTable_->write(0, LightUnif.id, 0, *alloc.buffer, alloc.offset, size);
 }
 
-void NewRenderer::writeInstanceWithSkin(uint64_t& offset, Drawable& drawable,
-                                        uint32_t allocation) {
+uint32_t NewRenderer::writeInstanceWithSkin(Drawable& drawable,
+                                            UnifBinding& binding) {
   assert(drawable.mask & RSkin0);
 
   // TODO
   if (InstanceN > 1)
     throw runtime_error("Cannot render multiple instances");
 
-  InstanceWithSkin inst;
+  const uint64_t size = sizeof(InstanceWithSkin);
+  const auto alloc = unifBuffer_->allocate(size, alignof(InstanceWithSkin));
+  auto& inst = *static_cast<InstanceWithSkin*>(alloc.data);
+
   const auto& m = drawable.node.worldTransform();
   const auto& v = scene_->camera().view();
   const auto mv = v * m;
@@ -711,11 +682,8 @@ void NewRenderer::writeInstanceWithSkin(uint64_t& offset, Drawable& drawable,
   memcpy(inst.i[0].norm, norm.data(), sizeof inst.i[0].norm);
   copyInstanceSkin(inst.i[0], drawable);
 
-  auto& table = *getTable(drawable.mask).table;
-  const uint64_t size = sizeof inst;
-  unifBuffer_->write(offset, size, &inst);
-  table.write(allocation, InstanceUnif.id, 0, *unifBuffer_, offset, size);
-  offset += size + instanceWithSkinPad_;
+  binding = {alloc.buffer, size};
+  return static_cast<uint32_t>(alloc.offset);
 }
 
 void NewRenderer::copyInstanceSkin(PerInstanceWithSkin& instance,
@@ -764,15 +732,18 @@ void NewRenderer::copyInstanceSkin(PerInstanceWithSkin& instance,
 #endif
 }
 
-void NewRenderer::writeInstanceNoSkin(uint64_t& offset, Drawable& drawable,
-                                      uint32_t allocation) {
+uint32_t NewRenderer::writeInstanceNoSkin(Drawable& drawable,
+                                          UnifBinding& binding) {
   assert(!(drawable.mask & RSkin0));
 
   // TODO
   if (InstanceN > 1)
     throw runtime_error("Cannot render multiple instances");
 
-  InstanceNoSkin inst;
+  const uint64_t size = sizeof(InstanceNoSkin);
+  const auto alloc = unifBuffer_->allocate(size, alignof(InstanceNoSkin));
+  auto& inst = *static_cast<InstanceNoSkin*>(alloc.data);
+
   const auto& m = drawable.node.worldTransform();
   const auto& v = scene_->camera().view();
   const auto mv = v * m;
@@ -781,18 +752,18 @@ void NewRenderer::writeInstanceNoSkin(uint64_t& offset, Drawable& drawable,
   memcpy(inst.i[0].mv, mv.data(), sizeof inst.i[0].mv);
   memcpy(inst.i[0].norm, norm.data(), sizeof inst.i[0].norm);
 
-  auto& table = *getTable(drawable.mask).table;
-  const uint64_t size = sizeof inst;
-  unifBuffer_->write(offset, size, &inst);
-  table.write(allocation, InstanceUnif.id, 0, *unifBuffer_, offset, size);
-  offset += size + instanceNoSkinPad_;
+  binding = {alloc.buffer, size};
+  return static_cast<uint32_t>(alloc.offset);
 }
 
-void NewRenderer::writeMaterialPbr(uint64_t& offset, Drawable& drawable,
-                                   uint32_t allocation) {
+uint32_t NewRenderer::writeMaterialPbr(Drawable& drawable,
+                                       UnifBinding& binding) {
   assert(!(drawable.mask & RUnlit));
 
-  MaterialPbr pbr;
+  const uint64_t size = sizeof(MaterialPbr);
+  const auto alloc = unifBuffer_->allocate(size, alignof(MaterialPbr));
+  auto& pbr = *static_cast<MaterialPbr*>(alloc.data);
+
   const auto& material = *drawable.primitive.material();
 
   if (drawable.mask & RPbrsg) {
@@ -813,18 +784,18 @@ void NewRenderer::writeMaterialPbr(uint64_t& offset, Drawable& drawable,
     pbr.pad1 = 0.0f;
   }
 
-  auto& table = *getTable(drawable.mask).table;
-  const uint64_t size = sizeof pbr;
-  unifBuffer_->write(offset, size, &pbr);
-  table.write(allocation, MaterialUnif.id, 0, *unifBuffer_, offset, size);
-  offset += size + materialPbrPad_;
+  binding = {alloc.buffer, size};
+  return static_cast<uint32_t>(alloc.offset);
 }
 
-void NewRenderer::writeMaterialUnlit(uint64_t& offset, Drawable& drawable,
-                                     uint32_t allocation) {
+uint32_t NewRenderer::writeMaterialUnlit(Drawable& drawable,
+                                         UnifBinding& binding) {
   assert(drawable.mask & RUnlit);
 
-  MaterialUnlit unlit;
+  const uint64_t size = sizeof(MaterialUnlit);
+  const auto alloc = unifBuffer_->allocate(size, alignof(MaterialUnlit));
+  auto& unlit = *static_cast<MaterialUnlit*>(alloc.data);
+
   const auto& material = *drawable.primitive.material();
   // TODO: Unlit color data in 'sg::Material'
   memcpy(unlit.colorFac, Vec4f(1.0f).data(), sizeof unlit.colorFac);
@@ -832,11 +803,29 @@ void NewRenderer::writeMaterialUnlit(uint64_t& offset, Drawable& drawable,
   unlit.doubleSided = material.doubleSided();
   unlit.pad1 = unlit.pad2 = 0.0f;
 
-  auto& table = *getTable(drawable.mask).table;
-  const uint64_t size = sizeof unlit;
-  unifBuffer_->write(offset, size, &unlit);
-  table.write(allocation, MaterialUnif.id, 0, *unifBuffer_, offset, size);
-  offset += size + materialUnlitPad_;
+  binding = {alloc.buffer, size};
+  return static_cast<uint32_t>(alloc.offset);
+}
+
+bool NewRenderer::bindUnifs(Table& table, uint32_t allocation,
+                            const array<UnifBinding, 2>& bindings) {
+  auto& current = table.bindings[allocation];
+
+  for (CG_NS::DcId id = 0; id < bindings.size(); id++) {
+    const auto& binding = bindings[id];
+    if (current[id].buffer == binding.buffer &&
+        current[id].size == binding.size)
+      continue;
+
+    // The shared allocation may be in use by encoded commands
+    if (table.shared && table.bound)
+      return false;
+
+    table.table->write(allocation, id, 0, *binding.buffer, 0, binding.size);
+    current[id] = binding;
+  }
+
+  return true;
 }
 
 void NewRenderer::writeTextureMaps(Drawable& drawable, uint32_t allocation) {
@@ -885,6 +874,7 @@ void NewRenderer::willRenderAgain() {
   for (auto& table : tables_) {
     if (table.count > 0)
       table.remaining = table.table->allocations();
+    table.bound = false;
   }
 }
 
@@ -913,9 +903,8 @@ void NewRenderer::print() const {
     wprintf(L"   table: %p\n"
             L"   count: %u\n"
             L"   mask: %Xh\n"
-            L"   unif. size: %u\n"
             L"   remaining: %u\n",
-            (void*)table.table.get(), table.count, table.mask, table.unifSize,
+            (void*)table.table.get(), table.count, table.mask,
             table.remaining);
   };
 
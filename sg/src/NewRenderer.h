@@ -9,6 +9,7 @@
 #define YF_SG_NEWRENDERER_H
 
 #include <cstddef>
+#include <array>
 #include <vector>
 #include <deque>
 #include <utility>
@@ -48,7 +49,7 @@ class NewRenderer {
 
  private:
   CG_NS::CmdBuffer::Ptr cmdBuffer_{};
-  CG_NS::Buffer::Ptr unifBuffer_{};
+  CG_NS::TransientBuffer::Ptr unifBuffer_{};
   CG_NS::DcTable::Ptr mainTable_{};
 
   Scene* scene_{};
@@ -71,8 +72,8 @@ class NewRenderer {
     ROcclusionMap = 1 << 7,
     REmissiveMap  = 1 << 8,
 
-    // Table req. mask
-    RTableMask = 0xFFF,
+    // Table req. mask (`RSkin0` determines the instance uniform size)
+    RTableMask = 0xFFF | 1 << 19,
 
     // Which alpha mode (default is opaque)
     RAlphaBlend = 1 << 12,
@@ -116,12 +117,25 @@ class NewRenderer {
     DrawableReqMask mask;
   };
 
+  /// Buffer range that a dynamic uniform descriptor refers to.
+  ///
+  struct UnifBinding {
+    CG_NS::Buffer* buffer;
+    uint64_t size;
+  };
+
+  /// Tables whose only entries are dynamic uniforms are `shared` by
+  /// every drawable, using a single allocation. Such an allocation
+  /// cannot be rebound once `bound` in the current pass.
+  ///
   struct Table {
     CG_NS::DcTable::Ptr table;
     uint32_t count;
     DrawableReqMask mask;
-    uint64_t unifSize;
     uint32_t remaining;
+    bool shared;
+    bool bound;
+    std::vector<std::array<UnifBinding, 2>> bindings;
   };
 
   struct State {
@@ -155,16 +169,13 @@ class NewRenderer {
 
   void allocateTables();
   void allocateTablesSubset();
-
-  uint64_t mainUnifSize();
-  uint64_t unifSize(const Table&);
-  bool checkUnifBuffer(uint64_t requiredSize);
+  void allocateTable(Table&, uint32_t n);
 
   bool renderOnce(CG_NS::Target&);
   bool renderAgain(CG_NS::Target&);
-  bool renderOpaqueDrawables(CG_NS::GrEncoder&, uint64_t& offset);
-  bool renderBlendDrawables(CG_NS::GrEncoder&, uint64_t& offset);
-  bool renderDrawable(Drawable&, CG_NS::GrEncoder&, uint64_t& offset);
+  bool renderOpaqueDrawables(CG_NS::GrEncoder&);
+  bool renderBlendDrawables(CG_NS::GrEncoder&);
+  bool renderDrawable(Drawable&, CG_NS::GrEncoder&);
 
   static constexpr uint32_t ViewportN = 1;
 
@@ -274,20 +285,15 @@ class NewRenderer {
 
   static_assert(sizeof(MaterialUnlit) == 32);
 
-  uint64_t globalPad_{};
-  uint64_t lightPad_{};
-  uint64_t instanceWithSkinPad_{};
-  uint64_t instanceNoSkinPad_{};
-  uint64_t materialPbrPad_{};
-  uint64_t materialUnlitPad_{};
-
-  void writeGlobal(uint64_t& offset);
-  void writeLight(uint64_t& offset);
-  void writeInstanceWithSkin(uint64_t& offset, Drawable&, uint32_t allocation);
+  void writeGlobal();
+  void writeLight();
+  uint32_t writeInstanceWithSkin(Drawable&, UnifBinding&);
   void copyInstanceSkin(PerInstanceWithSkin&, Drawable&);
-  void writeInstanceNoSkin(uint64_t& offset, Drawable&, uint32_t allocation);
-  void writeMaterialPbr(uint64_t& offset, Drawable&, uint32_t allocation);
-  void writeMaterialUnlit(uint64_t& offset, Drawable&, uint32_t allocation);
+  uint32_t writeInstanceNoSkin(Drawable&, UnifBinding&);
+  uint32_t writeMaterialPbr(Drawable&, UnifBinding&);
+  uint32_t writeMaterialUnlit(Drawable&, UnifBinding&);
+  bool bindUnifs(Table&, uint32_t allocation,
+                 const std::array<UnifBinding, 2>&);
   void writeTextureMaps(Drawable&, uint32_t allocation);
 
   void didRenderDrawable(Drawable&);
@@ -12,22 +12,42 @@
 
 #include "TextureImpl.h"
 #include "DataPNG.h"
+#include "DataKTX.h"
+#include "Mipmap.h"
 #include "yf/Except.h"
 
 using namespace SG_NS;
 using namespace std;
 
-Texture::Texture(const string& pathname) {
-  // TODO: Consider checking the type of the file.
+INTERNAL_NS_BEGIN
+
+/// Loads texture data from a PNG or KTX2 file.
+///
+void loadData(Texture::Data& dst, ifstream& ifs, bool mipmaps) {
+  // KTX2 files provide their own mip levels
+  if (isKTX(ifs)) {
+    loadKTX(dst, ifs);
+  } else {
+    loadPNG(dst, ifs);
+    if (mipmaps)
+      generateMipmaps(dst);
+  }
+}
+
+INTERNAL_NS_END
+
+Texture::Texture(const string& pathname, bool mipmaps) {
+  ifstream ifs(pathname, ios_base::binary);
+  if (!ifs)
+    throw FileExcept("Could not open texture file");
   Data data;
-  loadPNG(data, pathname);
+  loadData(data, ifs, mipmaps);
   impl_ = make_unique<Impl>(data);
 }
 
-Texture::Texture(ifstream& stream) {
-  // TODO: Consider checking the type of the file.
+Texture::Texture(ifstream& stream, bool mipmaps) {
   Data data;
-  loadPNG(data, stream);
+  loadData(data, stream, mipmaps);
   impl_ = make_unique<Impl>(data);
 }
 
@@ -116,13 +136,12 @@ Texture::Impl::Impl(const Data& data)
   // Copy the data
   CG_NS::Image& image = *resource.image;
   CG_NS::Size2 size = data.size;
-  const uint32_t txSz = image.texelSize();
   const char* bytes = data.data.get();
 
   // TODO: Check if this works as expected
   for (uint32_t i = 0; i < data.levels; i++) {
     image.write({0}, size, layer_, i, bytes);
-    bytes += size.width * size.height * txSz;
+    bytes += levelSizeOf(data.format, size);
     size.width = max(1U, size.width >> 1);
     size.height = max(1U, size.height >> 1);
   }
@@ -257,3 +276,77 @@ bool Texture::Impl::setLayerCount(Resource& resource, uint32_t newCount) {
 
   return true;
 }
+
+bool SG_NS::isCompressed(CG_NS::PxFormat format) {
+  switch (format) {
+  case CG_NS::PxFormatBc1Unorm:
+  case CG_NS::PxFormatBc1Srgb:
+  case CG_NS::PxFormatBc3Unorm:
+  case CG_NS::PxFormatBc3Srgb:
+  case CG_NS::PxFormatBc4Unorm:
+  case CG_NS::PxFormatBc4Norm:
+  case CG_NS::PxFormatBc5Unorm:
+  case CG_NS::PxFormatBc5Norm:
+  case CG_NS::PxFormatBc7Unorm:
+  case CG_NS::PxFormatBc7Srgb:
+    return true;
+  default:
+    return false;
+  }
+}
+
+size_t SG_NS::levelSizeOf(CG_NS::PxFormat format, CG_NS::Size2 size) {
+  const size_t width = size.width;
+  const size_t height = size.height;
+
+  switch (format) {
+  case CG_NS::PxFormatR8Unorm:
+    return width * height;
+  case CG_NS::PxFormatRg8Unorm:
+  case CG_NS::PxFormatR16Unorm:
+  case CG_NS::PxFormatD16Unorm:
+    return width * height * 2;
+  case CG_NS::PxFormatRgb8Unorm:
+  case CG_NS::PxFormatRgb8Srgb:
+    return width * height * 3;
+  case CG_NS::PxFormatRgba8Unorm:
+  case CG_NS::PxFormatRgba8Srgb:
+  case CG_NS::PxFormatBgra8Unorm:
+  case CG_NS::PxFormatBgra8Srgb:
+  case CG_NS::PxFormatRg16Unorm:
+    return width * height * 4;
+  case CG_NS::PxFormatRgb16Unorm:
+    return width * height * 6;
+  case CG_NS::PxFormatRgba16Unorm:
+    return width * height * 8;
+
+  // 4x4 blocks
+  case CG_NS::PxFormatBc1Unorm:
+  case CG_NS::PxFormatBc1Srgb:
+  case CG_NS::PxFormatBc4Unorm:
+  case CG_NS::PxFormatBc4Norm:
+    return ((width + 3) >> 2) * ((height + 3) >> 2) * 8;
+  case CG_NS::PxFormatBc3Unorm:
+  case CG_NS::PxFormatBc3Srgb:
+  case CG_NS::PxFormatBc5Unorm:
+  case CG_NS::PxFormatBc5Norm:
+  case CG_NS::PxFormatBc7Unorm:
+  case CG_NS::PxFormatBc7Srgb:
+    return ((width + 3) >> 2) * ((height + 3) >> 2) * 16;
+
+  default:
+    throw invalid_argument("Invalid texture format");
+  }
+}
+
+size_t SG_NS::dataSizeOf(CG_NS::PxFormat format, CG_NS::Size2 size,
+                         uint32_t levels) {
+
+  size_t total = 0;
+  for (uint32_t i = 0; i < levels; i++) {
+    total += levelSizeOf(format, size);
+    size.width = max(1U, size.width >> 1);
+    size.height = max(1U, size.height >> 1);
+  }
+  return total;
+}
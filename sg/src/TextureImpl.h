@@ -107,6 +107,19 @@ class Texture::Impl {
 #endif
 };
 
+/// Checks whether a format is block-compressed.
+///
+bool isCompressed(CG_NS::PxFormat format);
+
+/// Gets the size of one mip level of texture data.
+///
+size_t levelSizeOf(CG_NS::PxFormat format, CG_NS::Size2 size);
+
+/// Gets the size of texture data, including all mip levels.
+///
+size_t dataSizeOf(CG_NS::PxFormat format, CG_NS::Size2 size,
+                  uint32_t levels);
+
 SG_NS_END
 
 #endif // YF_SG_TEXTUREIMPL_H
@@ -0,0 +1,125 @@
+//
+// SG
+// Workers.cxx
+//
+// Copyright © 2021 Gustavo C. Viegas.
+//
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "Workers.h"
+
+using namespace SG_NS;
+using namespace std;
+
+INTERNAL_NS_BEGIN
+
+/// Pool of worker threads.
+///
+class Workers {
+ public:
+  Workers() {
+    const uint32_t n = thread::hardware_concurrency();
+    for (uint32_t i = 1; i < n; i++)
+      threads_.emplace_back([this] { work(); });
+  }
+
+  Workers(const Workers&) = delete;
+  Workers& operator=(const Workers&) = delete;
+
+  ~Workers() {
+    unique_lock<mutex> lock(mutex_);
+    stop_ = true;
+    lock.unlock();
+    wake_.notify_all();
+    for (auto& t : threads_)
+      t.join();
+  }
+
+  /// Number of threads available, including the caller's.
+  ///
+  uint32_t count() const {
+    return threads_.size() + 1;
+  }
+
+  /// Calls `fn` for every index in [0, n) and waits for completion.
+  ///
+  void run(uint32_t n, const function<void (uint32_t)>& fn) {
+    lock_guard<mutex> runLock(runMutex_);
+
+    unique_lock<mutex> lock(mutex_);
+    fn_ = &fn;
+    count_ = n;
+    next_ = 0;
+    done_ = 0;
+    generation_++;
+    lock.unlock();
+    wake_.notify_all();
+
+    execute(generation_);
+
+    lock.lock();
+    finished_.wait(lock, [&] { return done_ == count_; });
+    fn_ = nullptr;
+  }
+
+ private:
+  vector<thread> threads_{};
+  mutex runMutex_{};
+  mutex mutex_{};
+  condition_variable wake_{};
+  condition_variable finished_{};
+  const function<void (uint32_t)>* fn_ = nullptr;
+  uint32_t count_ = 0;
+  uint32_t next_ = 0;
+  uint32_t done_ = 0;
+  uint64_t generation_ = 0;
+  bool stop_ = false;
+
+  /// Executes indices of the given job until none remain.
+  ///
+  void execute(uint64_t generation) {
+    unique_lock<mutex> lock(mutex_);
+    while (generation == generation_ && next_ < count_) {
+      const auto index = next_++;
+      const auto& fn = *fn_;
+      lock.unlock();
+      fn(index);
+      lock.lock();
+      if (++done_ == count_)
+        finished_.notify_all();
+    }
+  }
+
+  void work() {
+    uint64_t seen = 0;
+    while (true) {
+      unique_lock<mutex> lock(mutex_);
+      wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+      if (stop_)
+        break;
+      seen = generation_;
+      lock.unlock();
+      execute(seen);
+    }
+  }
+};
+
+Workers& workers() {
+  static Workers workers;
+  return workers;
+}
+
+INTERNAL_NS_END
+
+void SG_NS::parallelFor(uint32_t count,
+                        const function<void (uint32_t)>& fn) {
+  workers().run(count, fn);
+}
+
+uint32_t SG_NS::workerCount() {
+  return workers().count();
+}
@@ -0,0 +1,31 @@
+//
+// SG
+// Workers.h
+//
+// Copyright © 2021 Gustavo C. Viegas.
+//
+
+#ifndef YF_SG_WORKERS_H
+#define YF_SG_WORKERS_H
+
+#include <cstdint>
+#include <functional>
+
+#include "yf/sg/Defs.h"
+
+SG_NS_BEGIN
+
+/// Calls `fn` for every index in [0, count), then waits for completion.
+///
+/// Indices are executed concurrently by a shared pool of worker threads
+/// and the calling thread. `fn` must not call `parallelFor()`.
+///
+void parallelFor(uint32_t count, const std::function<void (uint32_t)>& fn);
+
+/// Gets the number of threads used by `parallelFor()`.
+///
+uint32_t workerCount();
+
+SG_NS_END
+
+#endif // YF_SG_WORKERS_H
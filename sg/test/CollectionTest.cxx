@@ -6,11 +6,16 @@
 //
 
 #include <iostream>
+#include <cstring>
+#include <filesystem>
 
 #include "yf/ws/WS.h"
 
 #include "InteractiveTest.h"
 #include "SG.h"
+#include "DataGLTF.h"
+#include "DataCooked.h"
+#include "TextureImpl.h"
 
 using namespace TEST_NS;
 using namespace SG_NS;
@@ -112,10 +117,239 @@ struct CollectionTest : InteractiveTest {
                  coll.animations().front()->outR().size() == 1 &&
                  coll.animations().front()->outS().size() == 1});
 
+    a.push_back({L"Collection::cook()", cook("test/data/scene.glb", true) &&
+                                        cook("test/data/animation.glb",
+                                             false) &&
+                                        cook("test/data/unused-image.gltf",
+                                             false)});
+
     fromFile();
     return a;
   }
 
+  template<class T>
+  static bool same(const T& a, const T& b) {
+    return memcmp(a.data(), b.data(), T::dataSize()) == 0;
+  }
+
+  template<class T>
+  static bool same(const vector<T>& a, const vector<T>& b) {
+    if (a.size() != b.size())
+      return false;
+    for (size_t i = 0; i < a.size(); i++) {
+      if (!same(a[i], b[i]))
+        return false;
+    }
+    return true;
+  }
+
+  bool cook(const string& pathname, bool mipmaps) {
+    const auto cookedPath = (filesystem::temp_directory_path() /
+                             "yf-sg-collection.cooked").string();
+
+    Collection::cook(pathname, cookedPath, mipmaps);
+
+    // The glTF file is the reference, and the cooked file is also loaded
+    // through the internal loader so decoded contents can be compared
+    Collection src;
+    CookData srcData;
+    loadGLTF(src, srcData, pathname, mipmaps);
+
+    Collection dst;
+    CookData dstData;
+    loadCooked(dst, dstData, cookedPath);
+
+    Collection loaded;
+    loaded.load(cookedPath);
+    filesystem::remove(cookedPath);
+
+    if (loaded.scenes().size() != src.scenes().size() ||
+        loaded.nodes().size() != src.nodes().size() ||
+        loaded.meshes().size() != src.meshes().size() ||
+        loaded.skins().size() != src.skins().size() ||
+        loaded.textures().size() != src.textures().size() ||
+        loaded.materials().size() != src.materials().size() ||
+        loaded.animations().size() != src.animations().size())
+      return false;
+
+    if (src.scenes().size() != dst.scenes().size() ||
+        src.nodes().size() != dst.nodes().size() ||
+        src.meshes().size() != dst.meshes().size() ||
+        src.skins().size() != dst.skins().size() ||
+        src.textures().size() != dst.textures().size() ||
+        src.materials().size() != dst.materials().size() ||
+        src.animations().size() != dst.animations().size())
+      return false;
+
+    // Graph
+    auto sameChildren = [&](const Node& a, const Node& b) {
+      const auto ac = a.children();
+      const auto bc = b.children();
+      if (ac.size() != bc.size())
+        return false;
+      for (size_t i = 0; i < ac.size(); i++) {
+        if (ac[i]->name() != bc[i]->name())
+          return false;
+      }
+      return true;
+    };
+
+    for (size_t i = 0; i < src.scenes().size(); i++) {
+      const auto& a = *src.scenes()[i];
+      const auto& b = *dst.scenes()[i];
+      if (a.name() != b.name() || a.color() != b.color() ||
+          !sameChildren(a, b))
+        return false;
+    }
+
+    for (size_t i = 0; i < src.nodes().size(); i++) {
+      const auto& a = *src.nodes()[i];
+      const auto& b = *dst.nodes()[i];
+      if (a.name() != b.name() || !same(a.transform(), b.transform()) ||
+          !sameChildren(a, b) ||
+          !dynamic_cast<const Model*>(&a) != !dynamic_cast<const Model*>(&b) ||
+          !dynamic_cast<const Joint*>(&a) != !dynamic_cast<const Joint*>(&b))
+        return false;
+    }
+
+    // Meshes
+    for (size_t i = 0; i < srcData.meshes.size(); i++) {
+      const auto& a = srcData.meshes[i];
+      const auto& b = dstData.meshes[i];
+      if (a.primitives.size() != b.primitives.size() ||
+          srcData.primitiveMaterials[i] != dstData.primitiveMaterials[i] ||
+          src.meshes()[i]->primitiveCount() !=
+            dst.meshes()[i]->primitiveCount())
+        return false;
+
+      for (size_t j = 0; j < a.primitives.size(); j++) {
+        const auto& ap = a.primitives[j];
+        const auto& bp = b.primitives[j];
+        if (ap.topology != bp.topology ||
+            ap.accessors.size() != bp.accessors.size() ||
+            (*src.meshes()[i])[j].dataMask() !=
+              (*dst.meshes()[i])[j].dataMask())
+          return false;
+
+        for (size_t k = 0; k < ap.accessors.size(); k++) {
+          const auto& aa = ap.accessors[k];
+          const auto& ba = bp.accessors[k];
+          if (aa.semantic != ba.semantic || aa.elementN != ba.elementN ||
+              aa.elementSize != ba.elementSize ||
+              memcmp(&a.data[aa.dataIndex][aa.dataOffset],
+                     &b.data[ba.dataIndex][ba.dataOffset],
+                     aa.elementN * aa.elementSize) != 0)
+            return false;
+        }
+      }
+    }
+
+    // Images/textures - only images used by textures are cooked, so they
+    // are compared through the textures that refer to them
+    size_t imageN = 0;
+    for (const auto& img : srcData.images)
+      imageN += img.data ? 1 : 0;
+    if (imageN != dstData.images.size() ||
+        srcData.textures.size() != dstData.textures.size() ||
+        srcData.materials != dstData.materials)
+      return false;
+
+    for (size_t i = 0; i < srcData.textures.size(); i++) {
+      const auto& a = srcData.images[srcData.textures[i]];
+      const auto& b = dstData.images[dstData.textures[i]];
+      if (a.format != b.format || a.size != b.size || a.levels != b.levels ||
+          (mipmaps && a.levels == 1 && a.size != CG_NS::Size2{1, 1}) ||
+          memcmp(a.data.get(), b.data.get(),
+                 dataSizeOf(a.format, a.size, a.levels)) != 0)
+        return false;
+    }
+
+    for (size_t i = 0; i < src.textures().size(); i++) {
+      const auto& a = *src.textures()[i];
+      const auto& b = *dst.textures()[i];
+      if (a.coordSet() != b.coordSet() ||
+          a.sampler().wrapU != b.sampler().wrapU ||
+          a.sampler().wrapV != b.sampler().wrapV ||
+          a.sampler().magFilter != b.sampler().magFilter ||
+          a.sampler().minFilter != b.sampler().minFilter)
+        return false;
+    }
+
+    // Materials
+    for (size_t i = 0; i < src.materials().size(); i++) {
+      const auto& a = *src.materials()[i];
+      const auto& b = *dst.materials()[i];
+      if (!same(a.pbrmr().colorFac, b.pbrmr().colorFac) ||
+          a.pbrmr().metallic != b.pbrmr().metallic ||
+          a.pbrmr().roughness != b.pbrmr().roughness ||
+          a.normal().scale != b.normal().scale ||
+          a.occlusion().strength != b.occlusion().strength ||
+          !same(a.emissive().factor, b.emissive().factor) ||
+          a.alphaMode() != b.alphaMode() ||
+          a.alphaCutoff() != b.alphaCutoff() ||
+          a.doubleSided() != b.doubleSided() ||
+          !a.pbrmr().colorTex != !b.pbrmr().colorTex ||
+          !a.normal().texture != !b.normal().texture)
+        return false;
+    }
+
+    // Skins
+    for (size_t i = 0; i < src.skins().size(); i++) {
+      const auto& a = *src.skins()[i];
+      const auto& b = *dst.skins()[i];
+      if (a.joints().size() != b.joints().size() ||
+          !same(a.inverseBind(), b.inverseBind()))
+        return false;
+      for (size_t j = 0; j < a.joints().size(); j++) {
+        if (a.joints()[j]->name() != b.joints()[j]->name())
+          return false;
+      }
+    }
+
+    // Animations
+    for (size_t i = 0; i < src.animations().size(); i++) {
+      const auto& a = *src.animations()[i];
+      const auto& b = *dst.animations()[i];
+      if (a.name() != b.name() || a.inputs() != b.inputs() ||
+          a.outT().size() != b.outT().size() ||
+          a.outS().size() != b.outS().size() ||
+          a.outR().size() != b.outR().size() ||
+          a.actions().size() != b.actions().size())
+        return false;
+
+      for (size_t j = 0; j < a.outT().size(); j++) {
+        if (!same(a.outT()[j], b.outT()[j]))
+          return false;
+      }
+
+      for (size_t j = 0; j < a.outS().size(); j++) {
+        if (!same(a.outS()[j], b.outS()[j]))
+          return false;
+      }
+
+      for (size_t j = 0; j < a.outR().size(); j++) {
+        if (a.outR()[j].size() != b.outR()[j].size())
+          return false;
+        for (size_t k = 0; k < a.outR()[j].size(); k++) {
+          if (a.outR()[j][k].r() != b.outR()[j][k].r() ||
+              !same(a.outR()[j][k].v(), b.outR()[j][k].v()))
+            return false;
+        }
+      }
+
+      for (size_t j = 0; j < a.actions().size(); j++) {
+        const auto& x = a.actions()[j];
+        const auto& y = b.actions()[j];
+        if (x.target->name() != y.target->name() || x.type != y.type ||
+            x.method != y.method || x.input != y.input ||
+            x.output != y.output)
+          return false;
+      }
+    }
+
+    return true;
+  }
+
   void fromFile() {
     Collection coll("test/data/scene.glb");
 
@@ -0,0 +1,362 @@
+//
+// SG
+// CompressTest.cxx
+//
+// Copyright © 2021 Gustavo C. Viegas.
+//
+
+#include <cstring>
+#include <cmath>
+
+#include "Test.h"
+#include "Compress.h"
+#include "DataPNG.h"
+#include "Mipmap.h"
+#include "TextureImpl.h"
+
+using namespace TEST_NS;
+using namespace SG_NS;
+using namespace std;
+
+INTERNAL_NS_BEGIN
+
+/// Reads bit fields in increasing bit order.
+///
+class BitReader {
+ public:
+  explicit BitReader(const uint8_t* src) : src_(src) { }
+
+  uint32_t get(uint32_t bits) {
+    uint32_t x = 0;
+    for (uint32_t i = 0; i < bits; i++, pos_++)
+      x |= ((src_[pos_ >> 3] >> (pos_ & 7)) & 1U) << i;
+    return x;
+  }
+
+ private:
+  const uint8_t* src_;
+  uint32_t pos_ = 0;
+};
+
+/// Decodes a BC1 color block.
+///
+void decodeColor(const uint8_t* src, bool fourColor, uint8_t (&dst)[16][4]) {
+  const uint32_t c[2] = {src[0] | (uint32_t(src[1]) << 8),
+                         src[2] | (uint32_t(src[3]) << 8)};
+  fourColor |= c[0] > c[1];
+  uint8_t palette[4][4];
+  for (uint32_t i = 0; i < 2; i++) {
+    palette[i][0] = ((c[i] >> 11) << 3) | (c[i] >> 13);
+    palette[i][1] = (((c[i] >> 5) & 63) << 2) | ((c[i] >> 9) & 3);
+    palette[i][2] = ((c[i] & 31) << 3) | ((c[i] >> 2) & 7);
+  }
+  for (uint32_t j = 0; j < 3; j++) {
+    const uint32_t a = palette[0][j], b = palette[1][j];
+    palette[2][j] = fourColor ? (2 * a + b) / 3 : (a + b) / 2;
+    palette[3][j] = fourColor ? (a + 2 * b) / 3 : 0;
+  }
+  palette[0][3] = palette[1][3] = palette[2][3] = 255;
+  palette[3][3] = fourColor ? 255 : 0;
+  for (uint32_t i = 0; i < 16; i++)
+    memcpy(dst[i], palette[(src[4 + i/4] >> (i%4*2)) & 3], 4);
+}
+
+/// Decodes a BC3 alpha block.
+///
+void decodeAlpha(const uint8_t* src, uint8_t (&dst)[16][4]) {
+  const uint32_t a0 = src[0], a1 = src[1];
+  uint8_t palette[8]{uint8_t(a0), uint8_t(a1), 0, 0, 0, 0, 0, 255};
+  for (uint32_t i = 1; i < (a0 > a1 ? 7U : 5U); i++) {
+    const uint32_t n = a0 > a1 ? 7 : 5;
+    palette[i+1] = ((n - i) * a0 + i * a1) / n;
+  }
+  BitReader reader(src + 2);
+  for (uint32_t i = 0; i < 16; i++)
+    dst[i][3] = palette[reader.get(3)];
+}
+
+/// Decodes a BC7 block encoded with modes 1, 5 or 6.
+///
+bool decodeBC7(const uint8_t* src, uint8_t (&dst)[16][4]) {
+  static constexpr uint16_t Partitions[64] = {
+    0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+    0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+    0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+    0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+    0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A,
+    0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+    0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C,
+    0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22
+  };
+  static constexpr uint8_t Anchors[64] = {
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+    15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+     6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15
+  };
+  static constexpr uint8_t Weights2[4] = {0, 21, 43, 64};
+  static constexpr uint8_t Weights3[8] = {0, 9, 18, 27, 37, 46, 55, 64};
+  static constexpr uint8_t Weights4[16] = {
+    0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64
+  };
+
+  BitReader reader(src);
+  uint32_t mode = 0;
+  while (mode < 8 && reader.get(1) == 0)
+    mode++;
+
+  uint32_t ep[2][2][4]{};
+  uint16_t partition = 0;
+  uint32_t anchor = 0;
+  const uint8_t* weights;
+  uint32_t indexBits;
+
+  if (mode == 6) {
+    for (uint32_t c = 0; c < 4; c++) {
+      ep[0][0][c] = reader.get(7) << 1;
+      ep[0][1][c] = reader.get(7) << 1;
+    }
+    const uint32_t p0 = reader.get(1), p1 = reader.get(1);
+    for (uint32_t c = 0; c < 4; c++) {
+      ep[0][0][c] |= p0;
+      ep[0][1][c] |= p1;
+    }
+    weights = Weights4;
+    indexBits = 4;
+  } else if (mode == 1) {
+    const uint32_t p = reader.get(6);
+    partition = Partitions[p];
+    anchor = Anchors[p];
+    for (uint32_t c = 0; c < 3; c++) {
+      for (uint32_t s = 0; s < 2; s++) {
+        ep[s][0][c] = reader.get(6) << 2;
+        ep[s][1][c] = reader.get(6) << 2;
+      }
+    }
+    for (uint32_t s = 0; s < 2; s++) {
+      const uint32_t pbit = reader.get(1);
+      for (uint32_t c = 0; c < 3; c++) {
+        for (uint32_t e = 0; e < 2; e++) {
+          ep[s][e][c] |= pbit << 1;
+          ep[s][e][c] |= ep[s][e][c] >> 7;
+        }
+      }
+      ep[s][0][3] = ep[s][1][3] = 255;
+    }
+    weights = Weights3;
+    indexBits = 3;
+  } else if (mode == 5) {
+    if (reader.get(2) != 0)
+      return false;
+    for (uint32_t c = 0; c < 3; c++) {
+      for (uint32_t e = 0; e < 2; e++) {
+        ep[0][e][c] = reader.get(7) << 1;
+        ep[0][e][c] |= ep[0][e][c] >> 7;
+      }
+    }
+    ep[0][0][3] = reader.get(8);
+    ep[0][1][3] = reader.get(8);
+    uint32_t color[16];
+    for (uint32_t i = 0; i < 16; i++)
+      color[i] = Weights2[reader.get(i == 0 ? 1 : 2)];
+    for (uint32_t i = 0; i < 16; i++) {
+      const uint32_t w = Weights2[reader.get(i == 0 ? 1 : 2)];
+      for (uint32_t c = 0; c < 4; c++) {
+        const uint32_t x = c < 3 ? color[i] : w;
+        dst[i][c] = ((64 - x) * ep[0][0][c] + x * ep[0][1][c] + 32) >> 6;
+      }
+    }
+    return true;
+  } else {
+    return false;
+  }
+
+  for (uint32_t i = 0; i < 16; i++) {
+    const uint32_t s = (partition >> i) & 1;
+    const uint32_t w = weights[reader.get(indexBits -
+                                          (i == 0 || i == anchor))];
+    for (uint32_t c = 0; c < 4; c++)
+      dst[i][c] = ((64 - w) * ep[s][0][c] + w * ep[s][1][c] + 32) >> 6;
+  }
+  return true;
+}
+
+/// Computes the PSNR of the first level of compressed data.
+///
+/// If `alpha` is set, every channel of every texel is compared.
+/// Otherwise, only color is compared, and texels whose alpha is below
+/// one half are ignored.
+///
+double psnrOf(const Texture::Data& original, const Texture::Data& compressed,
+              bool alpha = false) {
+
+  auto texels = reinterpret_cast<const uint8_t*>(original.data.get());
+  auto blocks = reinterpret_cast<const uint8_t*>(compressed.data.get());
+  const uint32_t width = (original.size.width + 3) / 4;
+  const uint32_t height = (original.size.height + 3) / 4;
+  const uint32_t channels = alpha ? 4 : 3;
+
+  double sum = 0.0;
+  size_t count = 0;
+  for (uint32_t by = 0; by < height; by++) {
+    for (uint32_t bx = 0; bx < width; bx++) {
+      uint8_t decoded[16][4];
+      switch (compressed.format) {
+      case CG_NS::PxFormatBc1Unorm:
+      case CG_NS::PxFormatBc1Srgb:
+        decodeColor(blocks, false, decoded);
+        blocks += 8;
+        break;
+      case CG_NS::PxFormatBc3Unorm:
+      case CG_NS::PxFormatBc3Srgb:
+        decodeColor(blocks + 8, true, decoded);
+        decodeAlpha(blocks, decoded);
+        blocks += 16;
+        break;
+      default:
+        if (!decodeBC7(blocks, decoded))
+          return 0.0;
+        blocks += 16;
+        break;
+      }
+      for (uint32_t i = 0; i < 16; i++) {
+        const uint32_t x = bx * 4 + i % 4, y = by * 4 + i / 4;
+        if (x >= original.size.width || y >= original.size.height)
+          continue;
+        const auto t = texels + (y * original.size.width + x) * 4;
+        if (!alpha && t[3] < 128)
+          continue;
+        count += channels;
+        for (uint32_t c = 0; c < channels; c++)
+          sum += (t[c] - decoded[i][c]) * (t[c] - decoded[i][c]);
+      }
+    }
+  }
+
+  const double mse = sum / count;
+  return mse == 0.0 ? INFINITY : 10.0 * log10(255.0 * 255.0 / mse);
+}
+
+/// Copies texture data.
+///
+void copyData(Texture::Data& dst, const Texture::Data& src) {
+  const auto n = dataSizeOf(src.format, src.size, src.levels);
+  dst.format = src.format;
+  dst.size = src.size;
+  dst.levels = src.levels;
+  dst.data = make_unique<char[]>(n);
+  memcpy(dst.data.get(), src.data.get(), n);
+}
+
+INTERNAL_NS_END
+
+TEST_NS_BEGIN
+
+struct CompressTest : Test {
+  CompressTest() : Test(L"Compress") { }
+
+  Assertions run(const vector<string>&) {
+    Assertions a;
+
+    Texture::Data cube;
+    loadPNG(cube, "test/data/cube.png");
+
+    // Smooth gradients with sharp edges and varying alpha
+    Texture::Data synth;
+    synth.format = CG_NS::PxFormatRgba8Unorm;
+    synth.size = {250, 130};
+    synth.data = make_unique<char[]>(250 * 130 * 4);
+    for (uint32_t y = 0; y < 130; y++) {
+      for (uint32_t x = 0; x < 250; x++) {
+        auto t = reinterpret_cast<uint8_t*>(&synth.data[(y * 250 + x) * 4]);
+        t[0] = x;
+        t[1] = ((x / 16 + y / 16) & 1) ? 200 : 40;
+        t[2] = 128 + 100 * sin(x * 0.05 + y * 0.11);
+        t[3] = y < 64 ? 255 : (y < 96 ? ((x ^ y) & 2 ? 255 : 0) : x);
+      }
+    }
+
+    const struct {
+      BlockEncoding encoding;
+      double minCube;
+      double minSynth;
+      bool alpha;
+    } encodings[] = {
+      {BlockEncodingBC1, 32.0, 38.0, false},
+      {BlockEncodingBC3, 32.0, 40.0, true},
+      {BlockEncodingBC7, 38.0, 45.0, true}
+    };
+
+    bool psnrChk = true;
+    bool qualityChk = true;
+    for (const auto& e : encodings) {
+      Texture::Data data;
+      copyData(data, cube);
+      compressTexture(data, e.encoding);
+      const double cubePsnr = psnrOf(cube, data);
+      if (cubePsnr < e.minCube)
+        psnrChk = false;
+
+      double prev = 0.0;
+      for (float quality : {0.0f, 0.5f, 1.0f}) {
+        copyData(data, synth);
+        compressTexture(data, e.encoding, quality);
+        const double synthPsnr = psnrOf(synth, data, e.alpha);
+        if (synthPsnr < e.minSynth)
+          psnrChk = false;
+        if (synthPsnr + 0.1 < prev)
+          qualityChk = false;
+        prev = synthPsnr;
+      }
+    }
+
+    // BC1 must keep alpha-tested texels exact
+    Texture::Data masked;
+    copyData(masked, synth);
+    compressTexture(masked, BlockEncodingBC1);
+    bool maskChk = true;
+    {
+      auto blocks = reinterpret_cast<const uint8_t*>(masked.data.get());
+      for (uint32_t by = 0; by < 33; by++) {
+        for (uint32_t bx = 0; bx < 63; bx++, blocks += 8) {
+          uint8_t decoded[16][4];
+          decodeColor(blocks, false, decoded);
+          for (uint32_t i = 0; i < 16; i++) {
+            const uint32_t x = min(249U, bx * 4 + i % 4);
+            const uint32_t y = min(129U, by * 4 + i / 4);
+            const uint8_t alpha = synth.data[(y * 250 + x) * 4 + 3];
+            if (y < 96 && decoded[i][3] != alpha)
+              maskChk = false;
+          }
+        }
+      }
+    }
+
+    // Every level of a mip chain is compressed
+    Texture::Data chain;
+    copyData(chain, synth);
+    generateMipmaps(chain, MipFilterBox);
+    const auto levels = chain.levels;
+    compressTexture(chain, BlockEncodingBC7, 0.0f);
+    const bool chainChk = chain.format == CG_NS::PxFormatBc7Unorm &&
+                          chain.levels == levels && levels == 8;
+
+    a.push_back({L"compressTexture() PSNR", psnrChk});
+    a.push_back({L"compressTexture() quality", qualityChk});
+    a.push_back({L"compressTexture() BC1 alpha", maskChk});
+    a.push_back({L"compressTexture() levels", chainChk});
+    a.push_back({L"blockEncodingOf()",
+                 blockEncodingOf(cube, false) == BlockEncodingBC1 &&
+                 blockEncodingOf(synth, false) == BlockEncodingBC3 &&
+                 blockEncodingOf(synth, true) == BlockEncodingBC7});
+
+    return a;
+  }
+};
+
+Test* compressTest() {
+  static CompressTest test;
+  return &test;
+}
+
+TEST_NS_END
@@ -0,0 +1,148 @@
+//
+// SG
+// KTXTest.cxx
+//
+// Copyright © 2021 Gustavo C. Viegas.
+//
+
+#include <cstring>
+#include <filesystem>
+
+#include "Test.h"
+#include "DataKTX.h"
+#include "TextureImpl.h"
+#include "yf/Except.h"
+
+using namespace TEST_NS;
+using namespace SG_NS;
+using namespace std;
+
+INTERNAL_NS_BEGIN
+
+/// Writes a 2D KTX2 file whose level data are sequential byte values.
+///
+void writeKTX(const string& pathname, uint32_t vkFormat,
+              CG_NS::PxFormat format, CG_NS::Size2 size, uint32_t levels,
+              uint32_t scheme = 0) {
+
+  vector<uint8_t> file{0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32,
+                       0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+
+  auto put = [&](uint64_t x, size_t n) {
+    for (size_t i = 0; i < n; i++)
+      file.push_back(x >> (i * 8));
+  };
+
+  put(vkFormat, 4);
+  put(1, 4);
+  put(size.width, 4);
+  put(size.height, 4);
+  put(0, 4);
+  put(0, 4);
+  put(1, 4);
+  put(levels, 4);
+  put(scheme, 4);
+  put(0, 32);
+
+  // Level data is stored smallest first
+  vector<size_t> sizes;
+  for (uint32_t i = 0; i < levels; i++) {
+    sizes.push_back(levelSizeOf(format, size));
+    size = {max(1U, size.width >> 1), max(1U, size.height >> 1)};
+  }
+
+  size_t offset = file.size() + levels * 24;
+  vector<size_t> offsets(levels);
+  for (uint32_t i = levels; i-- > 0;) {
+    offsets[i] = offset;
+    offset += sizes[i];
+  }
+  for (uint32_t i = 0; i < levels; i++) {
+    put(offsets[i], 8);
+    put(sizes[i], 8);
+    put(sizes[i], 8);
+  }
+  for (uint32_t i = levels; i-- > 0;) {
+    for (size_t j = 0; j < sizes[i]; j++)
+      file.push_back(i + j);
+  }
+
+  ofstream ofs(pathname, ios_base::binary);
+  ofs.write(reinterpret_cast<const char*>(file.data()), file.size());
+}
+
+INTERNAL_NS_END
+
+TEST_NS_BEGIN
+
+struct KTXTest : Test {
+  KTXTest() : Test(L"KTX") { }
+
+  Assertions run(const vector<string>&) {
+    Assertions a;
+
+    const auto pathname = filesystem::temp_directory_path() / "yf-sg.ktx2";
+
+    // BC7 with a full chain and BC1 with a partial one
+    bool loadChk = true;
+    bool levelChk = true;
+    for (const auto& t : {make_tuple(146U, CG_NS::PxFormatBc7Srgb,
+                                     CG_NS::Size2{64, 32}, 7U),
+                          make_tuple(131U, CG_NS::PxFormatBc1Unorm,
+                                     CG_NS::Size2{30, 30}, 3U)}) {
+      const auto [vkFormat, format, size, levels] = t;
+      writeKTX(pathname, vkFormat, format, size, levels);
+
+      ifstream ifs(pathname, ios_base::binary);
+      if (!isKTX(ifs) || ifs.tellg() != 0)
+        loadChk = false;
+
+      Texture::Data data;
+      loadKTX(data, ifs);
+      if (data.format != format || data.size != size ||
+          data.levels != levels)
+        loadChk = false;
+
+      auto bytes = reinterpret_cast<const uint8_t*>(data.data.get());
+      CG_NS::Size2 lvlSize = size;
+      for (uint32_t i = 0; i < levels; i++) {
+        const auto n = levelSizeOf(format, lvlSize);
+        for (size_t j = 0; j < n; j++) {
+          if (bytes[j] != uint8_t(i + j))
+            levelChk = false;
+        }
+        bytes += n;
+        lvlSize = {max(1U, lvlSize.width >> 1), max(1U, lvlSize.height >> 1)};
+      }
+    }
+
+    // Basis Universal data is not supported
+    bool basisChk = false;
+    writeKTX(pathname, 0, CG_NS::PxFormatR8Unorm, {16, 16}, 1, 1);
+    try {
+      Texture::Data data;
+      loadKTX(data, pathname);
+    } catch (const UnsupportedExcept&) {
+      basisChk = true;
+    }
+
+    filesystem::remove(pathname);
+
+    a.push_back({L"isKTX(), loadKTX()", loadChk});
+    a.push_back({L"loadKTX() levels", levelChk});
+    a.push_back({L"loadKTX() Basis", basisChk});
+    a.push_back({L"levelSizeOf()",
+                 levelSizeOf(CG_NS::PxFormatBc1Srgb, {5, 4}) == 16 &&
+                 levelSizeOf(CG_NS::PxFormatBc5Unorm, {1, 1}) == 16 &&
+                 levelSizeOf(CG_NS::PxFormatRgb8Srgb, {5, 4}) == 60});
+
+    return a;
+  }
+};
+
+Test* ktxTest() {
+  static KTXTest test;
+  return &test;
+}
+
+TEST_NS_END
@@ -0,0 +1,140 @@
+//
+// SG
+// MipmapTest.cxx
+//
+// Copyright © 2021 Gustavo C. Viegas.
+//
+
+#include <cstring>
+#include <random>
+#include <cmath>
+
+#include "Test.h"
+#include "Mipmap.h"
+
+using namespace TEST_NS;
+using namespace SG_NS;
+using namespace std;
+
+INTERNAL_NS_BEGIN
+
+/// Creates RGBA8 texture data filled by a function of texel coordinates.
+///
+template<class F>
+void makeData(Texture::Data& data, CG_NS::PxFormat format,
+              CG_NS::Size2 size, F fn) {
+  data.format = format;
+  data.size = size;
+  data.levels = 1;
+  data.data = make_unique<char[]>(size.width * size.height * 4);
+  auto texels = reinterpret_cast<uint8_t*>(data.data.get());
+  for (uint32_t y = 0; y < size.height; y++) {
+    for (uint32_t x = 0; x < size.width; x++)
+      fn(x, y, texels + (y * size.width + x) * 4);
+  }
+}
+
+/// Gets the texels of a given level.
+///
+const uint8_t* levelOf(const Texture::Data& data, uint32_t level) {
+  auto texels = reinterpret_cast<const uint8_t*>(data.data.get());
+  CG_NS::Size2 size = data.size;
+  for (uint32_t i = 0; i < level; i++) {
+    texels += size.width * size.height * 4;
+    size = {max(1U, size.width >> 1), max(1U, size.height >> 1)};
+  }
+  return texels;
+}
+
+INTERNAL_NS_END
+
+TEST_NS_BEGIN
+
+struct MipmapTest : Test {
+  MipmapTest() : Test(L"Mipmap") { }
+
+  Assertions run(const vector<string>&) {
+    Assertions a;
+
+    Texture::Data data;
+
+    // Chain layout, including non-square and non-power-of-two sizes
+    bool levelChk = true;
+    for (const auto& sz : {CG_NS::Size2{1, 1}, CG_NS::Size2{64, 64},
+                           CG_NS::Size2{37, 5}, CG_NS::Size2{1, 300}}) {
+      makeData(data, CG_NS::PxFormatRgba8Unorm, sz, [](auto, auto, auto) { });
+      generateMipmaps(data, MipFilterBox);
+      const uint32_t n = 32 - __builtin_clz(max(sz.width, sz.height));
+      if (data.levels != n || data.size != sz)
+        levelChk = false;
+    }
+
+    // Constant images must remain constant
+    bool constChk = true;
+    for (auto filter : {MipFilterBox, MipFilterKaiser}) {
+      makeData(data, CG_NS::PxFormatRgba8Srgb, {100, 60},
+               [](auto, auto, uint8_t* t) {
+        t[0] = 10;
+        t[1] = 128;
+        t[2] = 250;
+        t[3] = 77;
+      });
+      generateMipmaps(data, filter);
+      const auto last = levelOf(data, data.levels - 1);
+      if (last[0] != 10 || last[1] != 128 || last[2] != 250 || last[3] != 77)
+        constChk = false;
+    }
+
+    // Averaging black and white must happen in linear space
+    makeData(data, CG_NS::PxFormatRgba8Srgb, {2, 2},
+             [](auto x, auto, uint8_t* t) {
+      t[0] = t[1] = t[2] = t[3] = x == 0 ? 0 : 255;
+    });
+    generateMipmaps(data, MipFilterBox);
+    const auto srgb = levelOf(data, 1);
+    const bool srgbChk = srgb[0] == 188 && srgb[2] == 188 && srgb[3] == 128;
+
+    // Alpha-tested coverage must be kept across levels
+    makeData(data, CG_NS::PxFormatRgba8Unorm, {256, 256},
+             [&](auto x, auto y, uint8_t* t) {
+      t[0] = t[1] = t[2] = 255;
+      t[3] = sin(x * 0.3) * sin(y * 0.2) > 0.4 ? 255 : 0;
+    });
+    double coverage = 0.0;
+    for (size_t j = 0; j < 256 * 256; j++)
+      coverage += uint8_t(data.data[j*4+3]) >= 128;
+    coverage /= 256 * 256;
+    generateMipmaps(data, MipFilterKaiser, 0.5f);
+    bool alphaChk = true;
+    for (uint32_t i = 1; i <= 3; i++) {
+      const auto texels = levelOf(data, i);
+      const size_t n = (256 >> i) * (256 >> i);
+      size_t count = 0;
+      for (size_t j = 0; j < n; j++)
+        count += texels[j*4+3] >= 128;
+      if (fabs(double(count) / n - coverage) > 0.05)
+        alphaChk = false;
+    }
+
+    // Large chain, using worker threads
+    mt19937 rng(1);
+    makeData(data, CG_NS::PxFormatRgba8Srgb, {2048, 2048},
+             [&](auto, auto, uint8_t* t) { memset(t, rng(), 4); });
+    generateMipmaps(data, MipFilterKaiser);
+
+    a.push_back({L"generateMipmaps() levels", levelChk});
+    a.push_back({L"generateMipmaps() constant", constChk});
+    a.push_back({L"generateMipmaps() sRGB", srgbChk});
+    a.push_back({L"generateMipmaps() alpha coverage", alphaChk});
+    a.push_back({L"generateMipmaps() large", data.levels == 12});
+
+    return a;
+  }
+};
+
+Test* mipmapTest() {
+  static MipmapTest test;
+  return &test;
+}
+
+TEST_NS_END
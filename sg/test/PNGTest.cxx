@@ -0,0 +1,292 @@
+//
+// SG
+// PNGTest.cxx
+//
+// Copyright © 2021 Gustavo C. Viegas.
+//
+
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <chrono>
+#include <filesystem>
+#include <random>
+#include <algorithm>
+
+#include "Test.h"
+#include "DataPNG.h"
+#include "Checksum.h"
+
+using namespace TEST_NS;
+using namespace SG_NS;
+using namespace std;
+
+INTERNAL_NS_BEGIN
+
+/// Reads the compressed data and the scanline layout of a PNG.
+///
+bool readIDAT(const string& pathname, vector<uint8_t>& idat, size_t& size,
+              uint32_t& sclnSize, uint32_t& Bpp) {
+  ifstream ifs(pathname, ios::binary);
+  vector<uint8_t> file((istreambuf_iterator<char>(ifs)),
+                       istreambuf_iterator<char>());
+  if (file.size() < 8)
+    return false;
+
+  auto be32 = [&](size_t off) {
+    return (uint32_t(file[off]) << 24) | (uint32_t(file[off+1]) << 16) |
+           (uint32_t(file[off+2]) << 8) | uint32_t(file[off+3]);
+  };
+
+  size = 0;
+  for (size_t off = 8; off + 12 <= file.size();) {
+    const auto len = be32(off);
+    const auto type = reinterpret_cast<const char*>(&file[off+4]);
+    if (off + 12 + len > file.size())
+      return false;
+
+    if (memcmp(type, "IHDR", 4) == 0) {
+      const auto width = be32(off+8);
+      const auto height = be32(off+12);
+      const uint32_t bitDepth = file[off+16];
+      uint32_t components;
+      switch (file[off+17]) {
+      case 0:
+      case 3: components = 1; break;
+      case 4: components = 2; break;
+      case 2: components = 3; break;
+      case 6: components = 4; break;
+      default: return false;
+      }
+      sclnSize = 1 + (width * components * bitDepth + 7) / 8;
+      Bpp = max(components * bitDepth / 8, 1U);
+      size = sclnSize * height;
+    } else if (memcmp(type, "IDAT", 4) == 0) {
+      idat.insert(idat.end(), &file[off+8], &file[off+8+len]);
+    }
+    off += 12 + len;
+  }
+
+  return size > 0 && idat.size() > 2;
+}
+
+/// Creates a zlib stream whose single, dynamic block sets every code
+/// length to zero.
+///
+vector<uint8_t> dynamicHeader(uint32_t hlit, uint32_t hdist) {
+  vector<uint8_t> stream{0x78, 0x01};
+  uint32_t buf = 0;
+  uint32_t n = 0;
+  auto put = [&](uint32_t value, uint32_t count) {
+    buf |= value << n;
+    n += count;
+    while (n >= 8) {
+      stream.push_back(buf & 255);
+      buf >>= 8;
+      n -= 8;
+    }
+  };
+
+  put(1, 1);
+  put(2, 2);
+  put(hlit - 257, 5);
+  put(hdist - 1, 5);
+  put(15, 4);
+
+  // Code length code: '0' for length 0 and '1' for repeating zero
+  // (symbol 18), listed in the order 16, 17, 18, 0, ...
+  for (uint32_t i = 0; i < 19; i++)
+    put(i == 2 || i == 3, 3);
+
+  // Repeat zero 3 * 138 times, which is more than any table has
+  for (uint32_t i = 0; i < 3; i++) {
+    put(1, 1);
+    put(127, 7);
+  }
+
+  put(0, 8);
+  stream.resize(stream.size() + 64);
+  return stream;
+}
+
+/// Prints the mean time taken to inflate and unfilter a PNG's data.
+///
+void bench(const filesystem::path& path, const vector<uint8_t>& idat,
+           size_t size, uint32_t sclnSize, uint32_t Bpp) {
+  auto time = [](auto fn) {
+    const size_t n = 10;
+    const auto beg = chrono::steady_clock::now();
+    for (size_t i = 0; i < n; i++)
+      fn();
+    const auto end = chrono::steady_clock::now();
+    return chrono::duration<double, milli>(end - beg).count() / n;
+  };
+
+  vector<uint8_t> data(size);
+  const auto refTm = time([&] { inflatePNG(idat, data, true); });
+  const auto dstTm = time([&] { inflatePNG(idat, data, false); });
+
+  const auto inflated = data;
+  const auto refUfTm = time([&] {
+    data = inflated;
+    unfilterPNG(data, sclnSize, Bpp, true);
+  });
+  const auto dstUfTm = time([&] {
+    data = inflated;
+    unfilterPNG(data, sclnSize, Bpp, false);
+  });
+
+  wcout << "\n" << path.filename().wstring() << " ("
+        << idat.size() << " -> " << size << " bytes)"
+        << "\n inflate (code tree): " << refTm << " ms"
+        << "\n inflate (table):     " << dstTm << " ms"
+        << "\n unfilter (scalar):   " << refUfTm << " ms"
+        << "\n unfilter:            " << dstUfTm << " ms\n";
+}
+
+INTERNAL_NS_END
+
+TEST_NS_BEGIN
+
+struct PNGTest : Test {
+  PNGTest() : Test(L"PNG") { }
+
+  Assertions run(const vector<string>& args) {
+    Assertions a;
+
+    // Decoding times are only printed on request (i.e., `png bench`)
+    const bool timed = find(args.begin(), args.end(), "bench") != args.end();
+
+    bool inflateChk = true;
+    bool unfilterChk = true;
+    bool loadChk = true;
+
+    for (const auto& entry : filesystem::directory_iterator("test/data")) {
+      if (entry.path().extension() != ".png")
+        continue;
+
+      vector<uint8_t> idat;
+      size_t size = 0;
+      uint32_t sclnSize = 0;
+      uint32_t Bpp = 0;
+      if (!readIDAT(entry.path(), idat, size, sclnSize, Bpp)) {
+        inflateChk = unfilterChk = false;
+        continue;
+      }
+
+      vector<uint8_t> ref(size);
+      vector<uint8_t> dst(size);
+
+      inflatePNG(idat, ref, true);
+      inflatePNG(idat, dst, false);
+      if (ref != dst)
+        inflateChk = false;
+
+      ref = dst;
+      unfilterPNG(ref, sclnSize, Bpp, true);
+      unfilterPNG(dst, sclnSize, Bpp, false);
+      if (ref != dst)
+        unfilterChk = false;
+
+      if (timed)
+        bench(entry.path(), idat, size, sclnSize, Bpp);
+
+      Texture::Data data1;
+      loadPNG(data1, entry.path());
+
+      Texture::Data data2;
+      vector<char> memory;
+      loadPNG(data2, entry.path(), [&](const Texture::Data&, size_t size) {
+        memory.resize(size);
+        return memory.data();
+      });
+
+      if (data2.data || data1.format != data2.format ||
+          data1.size != data2.size ||
+          memcmp(data1.data.get(), memory.data(), memory.size()) != 0)
+        loadChk = false;
+    }
+
+    // Malformed streams
+    bool malformedChk = true;
+    for (const auto& hs : {pair{288U, 1U}, pair{287U, 30U}, pair{257U, 31U},
+                           pair{257U, 32U}, pair{288U, 32U}}) {
+      const auto src = dynamicHeader(hs.first, hs.second);
+      vector<uint8_t> dst(1 << 16);
+      try {
+        inflatePNG(src, dst, false);
+        malformedChk = false;
+      } catch (const runtime_error&) {
+      }
+    }
+
+    // Random scanlines using every filter type
+    mt19937 rng(1);
+    for (uint32_t Bpp = 1; Bpp <= 8; Bpp++) {
+      for (uint32_t width : {1U, 2U, 7U, 64U, 333U}) {
+        const uint32_t sclnSize = 1 + width * Bpp;
+        vector<uint8_t> ref(sclnSize * 10);
+        for (auto& x : ref)
+          x = rng();
+        for (size_t i = 0; i < ref.size(); i += sclnSize)
+          ref[i] = rng() % 5;
+
+        auto dst = ref;
+        unfilterPNG(ref, sclnSize, Bpp, true);
+        unfilterPNG(dst, sclnSize, Bpp, false);
+        if (ref != dst)
+          unfilterChk = false;
+      }
+    }
+
+    // Checksums of random data, at various sizes and alignments
+    bool crcChk = true;
+    bool adlerChk = true;
+    vector<uint8_t> data(1 << 16);
+    for (auto& x : data)
+      x = rng();
+    for (size_t size : {0, 1, 15, 16, 63, 64, 100, 5552, 5553, 50000}) {
+      for (size_t off = 0; off < 4; off++) {
+        const auto bytes = data.data() + off;
+
+        uint32_t crc = 0xFFFFFFFF;
+        for (size_t i = 0; i < size; i++) {
+          crc ^= bytes[i];
+          for (uint32_t j = 0; j < 8; j++)
+            crc = (crc & 1) ? (0xEDB88320 ^ (crc >> 1)) : (crc >> 1);
+        }
+        if (crc32(bytes, size) != ~crc)
+          crcChk = false;
+
+        uint32_t s1 = 1;
+        uint32_t s2 = 0;
+        for (size_t i = 0; i < size; i++) {
+          s1 = (s1 + bytes[i]) % 65521;
+          s2 = (s2 + s1) % 65521;
+        }
+        if (adler32(bytes, size) != ((s2 << 16) | s1))
+          adlerChk = false;
+      }
+    }
+
+    if (crc32(data.data()+100, 900, crc32(data.data(), 100)) !=
+        crc32(data.data(), 1000))
+      crcChk = false;
+
+    a.push_back({L"inflatePNG()", inflateChk});
+    a.push_back({L"inflatePNG() malformed", malformedChk});
+    a.push_back({L"unfilterPNG()", unfilterChk});
+    a.push_back({L"loadPNG(dst, pathname, memory)", loadChk});
+    a.push_back({L"crc32()", crcChk});
+    a.push_back({L"adler32()", adlerChk});
+
+    return a;
+  }
+};
+
+Test* pngTest() {
+  static PNGTest test;
+  return &test;
+}
+
+TEST_NS_END
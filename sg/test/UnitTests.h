@@ -36,6 +36,10 @@ Test* cameraTest();
 Test* renderTest();
 Test* bodyTest();
 Test* physicsTest();
+Test* pngTest();
+Test* mipmapTest();
+Test* ktxTest();
+Test* compressTest();
 
 using TestFn = std::function<Test* ()>;
 using TestID = std::pair<std::string, std::vector<TestFn>>;
@@ -57,10 +61,15 @@ const std::vector<TestID> TIDs{
   TestID("render", {renderTest}),
   TestID("body", {bodyTest}),
   TestID("physics", {physicsTest}),
+  TestID("png", {pngTest}),
+  TestID("mipmap", {mipmapTest}),
+  TestID("ktx", {ktxTest}),
+  TestID("compress", {compressTest}),
   TestID("all", {nodeTest, sceneTest, viewTest, vectorTest, quaternionTest,
                  matrixTest, meshTest, textureTest, materialTest, skinTest,
                  modelTest, animationTest, collectionTest, cameraTest,
-                 renderTest, bodyTest, physicsTest})
+                 renderTest, bodyTest, physicsTest, pngTest, mipmapTest,
+                 ktxTest, compressTest})
 };
 
 inline std::vector<Test*> unitTests(const std::string& id) {